@@ -0,0 +1,244 @@
+/*
+ * bench_adc.cc - benchmark of the paths of samples of ADC (peripherals.cc), by the same utilities
+ * (util/sample_ring.h and util/filter_chain.h, with the chain of VBAT)
+ * Timer, a sample by tick (as 0.3.1 - 20 ticks by second): each tick is a wakeup, the pin of sensor powered
+ * for each sample, and each sample by the ring to the chain
+ * Timer, bursts (ADC_SAMPLING_RATE optional): fewer ticks, the pin powered once by burst
+ * adcRead (default): a burst by second, read in main_Task, without ring and timer (nothing while idle)
+ * Reports the nanoseconds by sample and, by the rates of each one, the CPU by second, the wakeups and
+ * the changes of pin - the cost of CPU is small for these rates, so the DMA (I2S) of ADC is not used:
+ * what costs is the wakeups and the sensor powered, that the bursts reduce
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "util/sample_ring.h"
+#include "util/filter_chain.h"
+
+#include "../test/test.h"
+
+////// Definitions
+
+#define BENCH_SAMPLES 				2800000		// Multiple of bursts (4 and 7)
+
+#define BENCH_RING 					64			// As ADC_SAMPLING_RING
+
+// Rates (by second) - as 0.3.1, ADC_SAMPLING_RATE / ADC_SAMPLING_BURST and ADC_READINGS
+
+#define BENCH_SINGLE_TICKS 			20
+#define BENCH_BURST_TICKS 			2
+#define BENCH_BURST_SIZE 			4
+#define BENCH_READ_SIZE 			7
+
+// Chain of VBAT (as peripherals.cc)
+
+typedef FilterChain <uint16_t,
+						MedianStage <uint16_t, 7>,
+						DecimateStage <uint16_t, 5>,
+						EmaStage <uint16_t, 2>,
+						HysteresisStage <uint16_t, 3> > BenchChain_t;
+
+typedef struct {
+	uint8_t index;		// Index of channel
+	uint16_t value;		// Value readed
+} BenchSample_t;
+
+////// Variables
+
+static uint16_t mSamples[BENCH_SAMPLES];		// Stream of samples (as ADC readings)
+
+static volatile uint32_t mPinChanges = 0;		// Changes of pin of sensor (as gpioSetLevel)
+
+////// Routines
+
+/**
+ * @brief Read a burst (as adcSamples) - the pin powered once
+ */
+static void readBurst(uint32_t& next, uint16_t* values, uint8_t count) {
+
+	mPinChanges++;
+
+	for (uint8_t i = 0; i < count; i++) {
+		values[i] = mSamples[next++];
+	}
+
+	mPinChanges++;
+}
+
+////// Benchmark
+
+typedef struct {
+	const char* name;
+	double ns;					// Nanoseconds by sample
+	uint32_t samples;			// Samples by second
+	uint32_t wakeups;			// Wakeups by second (ticks of timer)
+	uint32_t pinChanges;		// Changes of pin by second
+	uint32_t check;				// Sum of outputs of chain (the same for all)
+} BenchResult_t;
+
+/**
+ * @brief By timer - ticks of burst samples, by the ring to the chain (consumer after each second of ticks)
+ */
+static BenchResult_t benchTimer(const char* name, uint32_t ticksBySecond, uint8_t burst) {
+
+	BenchResult_t result;
+
+	memset(&result, 0, sizeof(result));
+
+	result.name = name;
+
+	SampleRing <BenchSample_t, BENCH_RING> ring;
+	BenchChain_t chain;
+
+	mPinChanges = 0;
+
+	uint32_t next = 0;
+	uint32_t ticks = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	while ((next + burst) <= BENCH_SAMPLES) {
+
+		// Tick of timer (producer)
+
+		uint16_t values[BENCH_BURST_SIZE];
+
+		readBurst(next, values, burst);
+
+		for (uint8_t i = 0; i < burst; i++) {
+
+			BenchSample_t sample = { 0, values[i] };
+
+			ring.push(sample);
+		}
+
+		// Each second - adcRead (consumer)
+
+		if ((++ticks % ticksBySecond) == 0) {
+
+			BenchSample_t sample;
+
+			while (ring.pop(sample)) {
+
+				uint16_t out;
+
+				if (chain.process(sample.value, out)) {
+					result.check += out;
+				}
+			}
+		}
+	}
+
+	result.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / next;
+
+	TEST_CHECK(ring.dropped() == 0);
+
+	result.samples = (ticksBySecond * burst);
+	result.wakeups = ticksBySecond;
+	result.pinChanges = (uint32_t) (((uint64_t) mPinChanges * result.samples) / next);
+
+	return result;
+}
+
+/**
+ * @brief By adcRead - a burst by second, direct to the chain
+ */
+static BenchResult_t benchRead(const char* name, uint8_t burst) {
+
+	BenchResult_t result;
+
+	memset(&result, 0, sizeof(result));
+
+	result.name = name;
+
+	BenchChain_t chain;
+
+	mPinChanges = 0;
+
+	uint32_t next = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	while ((next + burst) <= BENCH_SAMPLES) {
+
+		uint16_t values[BENCH_READ_SIZE];
+
+		readBurst(next, values, burst);
+
+		for (uint8_t i = 0; i < burst; i++) {
+
+			uint16_t out;
+
+			if (chain.process(values[i], out)) {
+				result.check += out;
+			}
+		}
+	}
+
+	result.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / next;
+
+	result.samples = burst;
+	result.wakeups = 0; // In job of main_Task (it wakes up for others things too), none while idle
+	result.pinChanges = (uint32_t) (((uint64_t) mPinChanges * result.samples) / next);
+
+	return result;
+}
+
+////// Main
+
+int main() {
+
+	// Samples - ADC readings with noise (deterministic)
+
+	uint32_t random = 20171026;
+
+	for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+
+		random = (random * 1103515245u) + 12345u;
+
+		mSamples[i] = 2000 + ((random >> 8) % 200);
+	}
+
+	BenchResult_t results[] = {
+		benchTimer("timer_single", BENCH_SINGLE_TICKS, 1),
+		benchTimer("timer_burst", BENCH_BURST_TICKS, BENCH_BURST_SIZE),
+		benchRead("adc_read", BENCH_READ_SIZE) };
+
+	uint8_t count = (sizeof(results) / sizeof(results[0]));
+
+	printf("bench_adc: %u samples by path\n", (uint32_t) BENCH_SAMPLES);
+
+	for (uint8_t i = 0; i < count; i++) {
+
+		double cpu = (results[i].ns * results[i].samples) / 1000.0; // Micros of CPU by second
+
+		printf("bench_adc: %-12s - %5.1f ns/sample, %2u samples/s, CPU %6.3f us/s, wakeups %2u/s, pin changes %2u/s\n",
+					results[i].name, results[i].ns, results[i].samples, cpu, results[i].wakeups, results[i].pinChanges);
+	}
+
+	printf("{\"bench\":\"adc\",\"paths\":[");
+
+	for (uint8_t i = 0; i < count; i++) {
+		printf("%s{\"name\":\"%s\",\"ns\":%.1f,\"samples\":%u,\"wakeups\":%u,\"pin_changes\":%u}", (i > 0) ? "," : "",
+					results[i].name, results[i].ns, results[i].samples, results[i].wakeups, results[i].pinChanges);
+	}
+
+	printf("]}\n");
+
+	// The same outputs (the chain is the same, and all samples passed)
+
+	TEST_CHECK(results[0].check == results[1].check && results[0].check == results[2].check);
+
+	// Bursts - fewer wakeups and changes of pin
+
+	TEST_CHECK(results[1].wakeups < results[0].wakeups && results[1].pinChanges < results[0].pinChanges);
+	TEST_CHECK(results[2].pinChanges < results[0].pinChanges);
+
+	return testResult("bench_adc");
+}
+
+//////// End
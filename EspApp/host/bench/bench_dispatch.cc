@@ -0,0 +1,128 @@
+/*
+ * bench_dispatch.cc - benchmark of dispatch of messages by code (table of msg_table)
+ * Measures the lookup in table only, and the processBleMessage (parse, lookup, flags and handler)
+ * A code is registered here (as a module of App), to check that no need to edit main.cc
+ * Reports the nanoseconds by message - fails if a message is not dispatched or allocates
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+
+#include "sim.h"
+
+#include "util/fields.h"
+#include "util/msg_table.h"
+
+#include "../test/test.h"
+
+using namespace std;
+
+////// Firmware
+
+extern void processBleMessage(const char* message, uint16_t size);
+
+////// Definitions
+
+#define BENCH_ROUNDS 				50000
+
+////// Module (registers your code, without edit main.cc)
+
+static uint32_t mModuleCalls = 0;
+
+static void msgModule(const char* message, uint16_t size, FieldsView& fields, string& response) {
+
+	mModuleCalls += fields.getInt(2);
+}
+
+static MsgRegister mMsgModule(42, msgModule, NULL, MSG_FLAG_NONE);
+
+////// Corpus (messages without response sended, due BLE is not connected)
+
+static const char* mCorpus[] = {
+	"42:1",
+	"70:1:abcdefghijklmnopqrstuvwxyz",
+	"70:42:The quick brown fox jumps over the lazy dog",
+	"80:",
+	"80:",
+	"42:1",
+	"80:",
+	"70:9999:0123456789012345678901234567890123456789",
+};
+
+#define BENCH_CORPUS 				(sizeof(mCorpus) / sizeof(mCorpus[0]))
+
+////// Main
+
+int main() {
+
+	static uint16_t sizes[BENCH_CORPUS];
+	static uint8_t codes[BENCH_CORPUS];
+
+	uint32_t modulePerRound = 0;
+
+	for (uint16_t i = 0; i < BENCH_CORPUS; i++) {
+		sizes[i] = strlen(mCorpus[i]);
+		codes[i] = (mCorpus[i][0] - '0') * 10 + (mCorpus[i][1] - '0');
+		modulePerRound += (codes[i] == 42);
+	}
+
+	// Registers: of main.cc and of module, code duplicated or invalid
+
+	TEST_CHECK(msgLookup(1) != NULL && msgLookup(80) != NULL);
+	TEST_CHECK(msgLookup(42) != NULL && msgLookup(42)->handler == msgModule);
+	TEST_CHECK(msgLookup(43) == NULL && msgLookup(MSG_CODE_MAX + 1) == NULL);
+	TEST_CHECK(!msgRegister(42, msgModule));
+	TEST_CHECK(!msgRegister(0, msgModule) && !msgRegister(MSG_CODE_MAX + 1, msgModule));
+
+	double messages = (double) BENCH_ROUNDS * BENCH_CORPUS;
+
+	// Lookup only
+
+	uint32_t found = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+		for (uint16_t i = 0; i < BENCH_CORPUS; i++) {
+			const MsgEntry_t* volatile entry = msgLookup(codes[i]);
+			found += (entry != NULL);
+		}
+	}
+
+	double lookup = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+
+	// Dispatch (processBleMessage)
+
+	uint64_t allocations = simAllocations();
+
+	start = std::chrono::steady_clock::now();
+
+	for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+		for (uint16_t i = 0; i < BENCH_CORPUS; i++) {
+			processBleMessage(mCorpus[i], sizes[i]);
+		}
+	}
+
+	double dispatch = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+	double perMessage = (simAllocations() - allocations) / messages;
+
+	// Report
+
+	printf("bench_dispatch: %u messages of %u in corpus\n", (uint32_t) messages, (uint32_t) BENCH_CORPUS);
+	printf("bench_dispatch: lookup %8.1f ns/message\n", lookup);
+	printf("bench_dispatch: dispatch %6.1f ns/message %6.2f allocations/message (processBleMessage)\n", dispatch, perMessage);
+	printf("{\"bench\":\"dispatch\",\"lookup\":{\"ns\":%.1f},\"dispatch\":{\"ns\":%.1f,\"allocs\":%.2f}}\n",
+				lookup, dispatch, perMessage);
+
+	TEST_CHECK(found == (uint32_t) messages);
+	TEST_CHECK(mModuleCalls == (BENCH_ROUNDS * modulePerRound));
+	TEST_CHECK(perMessage < 0.01); // The first reserves the response
+
+	return testResult("bench_dispatch");
+}
+
+//////// End
@@ -0,0 +1,174 @@
+/*
+ * bench_fields.cc - microbenchmark of parsing of messages (nn:payload) - FieldsView x the old Fields
+ * The old Fields (version 0.1.0) copied the message to a string, and each field to a vector (strSplit)
+ * Reports the allocations and nanoseconds by message - fails if FieldsView allocates
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+
+#include "util/esp_util.h"
+#include "util/fields.h"
+
+#include "../test/test.h"
+
+using namespace std;
+
+////// Definitions
+
+#define BENCH_ROUNDS 				20000
+
+////// Corpus (messages of App, without the new line)
+
+static const char* mCorpus[] = {
+	"01:",
+	"01:BIN",
+	"11:ESP32",
+	"11:BLE",
+	"11:BLERX",
+	"11:LAT:R",
+	"70:1:abcdefghijklmnopqrstuvwxyz",
+	"70:42:The quick brown fox jumps over the lazy dog, the quick brown fox jumps over the lazy dog",
+	"70:9999:0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789",
+	"71:Y",
+	"71:N",
+	"72:100000:10",
+	"80:",
+	"80:",
+	"80:",
+	"98:",
+};
+
+#define BENCH_CORPUS 				(sizeof(mCorpus) / sizeof(mCorpus[0]))
+
+////// Old Fields (0.1.0) - copy of message, and a vector of fields by Esp_Util::strSplit
+
+static Esp_Util& mUtil = Esp_Util::getInstance();
+
+class OldFields {
+public:
+
+	OldFields(const string& str, const string& delimiter) {
+
+		mUtil.strSplit(_fields, str, delimiter);
+	}
+
+	string getString(uint8_t fieldNum) {
+
+		return (fieldNum > 0 && fieldNum <= _fields.size()) ? _fields[fieldNum - 1] : "";
+	}
+
+	bool isNum(uint8_t fieldNum) {
+
+		return (fieldNum > 0 && fieldNum <= _fields.size()) ? mUtil.strIsNum(_fields[fieldNum - 1]) : false;
+	}
+
+	int32_t getInt(uint8_t fieldNum) {
+
+		return (fieldNum > 0 && fieldNum <= _fields.size()) ? mUtil.strToInt(_fields[fieldNum - 1]) : 0;
+	}
+
+private:
+
+	vector<string> _fields;
+};
+
+////// Parsers (as processBleMessage: code, and the field 2)
+
+static uint32_t parseOld(const char* message, uint16_t size) {
+
+	string line(message, size);
+
+	OldFields fields(line, ":");
+
+	if (!fields.isNum(1)) {
+		return 0;
+	}
+
+	return fields.getInt(1) + fields.getString(2).size();
+}
+
+static uint32_t parseView(const char* message, uint16_t size) {
+
+	FieldsView fields(message, size, ':');
+
+	if (!fields.isNum(1)) {
+		return 0;
+	}
+
+	return fields.getInt(1) + fields.getString(2).size();
+}
+
+////// Benchmark
+
+typedef struct {
+	const char* name;
+	double nanos;				// Nanoseconds by message
+	double allocations;			// Allocations by message
+	uint32_t check;				// Sum of results (same for all)
+} BenchResult_t;
+
+static BenchResult_t bench(const char* name, uint32_t (*parse)(const char*, uint16_t)) {
+
+	static uint16_t sizes[BENCH_CORPUS];
+
+	for (uint16_t i = 0; i < BENCH_CORPUS; i++) {
+		sizes[i] = strlen(mCorpus[i]);
+	}
+
+	BenchResult_t result;
+
+	result.name = name;
+	result.check = 0;
+
+	uint64_t allocations = simAllocations();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+		for (uint16_t i = 0; i < BENCH_CORPUS; i++) {
+			result.check += parse(mCorpus[i], sizes[i]);
+		}
+	}
+
+	double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	double messages = (double) BENCH_ROUNDS * BENCH_CORPUS;
+
+	result.nanos = nanos / messages;
+	result.allocations = (simAllocations() - allocations) / messages;
+
+	return result;
+}
+
+////// Main
+
+int main() {
+
+	BenchResult_t old = bench("Fields (old)", parseOld);
+	BenchResult_t view = bench("FieldsView", parseView);
+
+	printf("bench_fields: %u messages of %u in corpus\n", (uint32_t) (BENCH_ROUNDS * BENCH_CORPUS), (uint32_t) BENCH_CORPUS);
+
+	const BenchResult_t* results[] = { &old, &view };
+
+	for (uint8_t i = 0; i < 2; i++) {
+		printf("bench_fields: %-14s %8.1f ns/message %6.2f allocations/message\n",
+					results[i]->name, results[i]->nanos, results[i]->allocations);
+	}
+
+	printf("{\"bench\":\"fields\",\"old\":{\"ns\":%.1f,\"allocs\":%.2f},\"view\":{\"ns\":%.1f,\"allocs\":%.2f}}\n",
+				old.nanos, old.allocations, view.nanos, view.allocations);
+
+	TEST_CHECK(old.check == view.check);
+	TEST_CHECK(view.allocations == 0.0);
+
+	return testResult("bench_fields");
+}
+
+//////// End
@@ -0,0 +1,194 @@
+/*
+ * bench_frame.cc - benchmark of messages of values - text mode x binary mode (frames of values)
+ * Text: numbers formatted to text (as BleServer::sendValues in text mode), and parsed by client (new line and fields)
+ * Binary: frame of values with CRC (varints), and read by client
+ * Reports the bytes on air and the nanoseconds by message (encode in device, decode in client)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "util/ble_frame.h"
+#include "util/fields.h"
+
+#include "../test/frame_reader.h"
+#include "../test/test.h"
+
+////// Definitions
+
+#define BENCH_ROUNDS 				20000
+#define BENCH_VALUES_MAX 			8
+
+////// Corpus (messages of values of firmware, with typical values)
+
+typedef struct {
+	uint8_t code;
+	const char* prefix;
+	uint8_t count;
+	uint32_t values[BENCH_VALUES_MAX];
+} BenchMessage_t;
+
+static const BenchMessage_t mCorpus[] = {
+	{ 11, "BLE", 8, { 15230, 15102, 0, 3, 12, 840, 96, 18 } },
+	{ 11, "BLERX", 6, { 8211, 8211, 0, 4, 2, 35 } },
+	{ 11, "FMEM", 1, { 187432 } },
+	{ 11, "VDD33", 1, { 3312 } },
+	{ 11, "ADC", 3, { 3600125, 2048, 1733 } },
+	{ 72, "S", 2, { 100000, 182 } },
+	{ 72, "E", 8, { 550, 100000, 4120, 24271, 2, 75, 0, 0 } },
+};
+
+#define BENCH_CORPUS 				(sizeof(mCorpus) / sizeof(mCorpus[0]))
+
+////// Text mode
+
+static uint16_t encodeText(const BenchMessage_t& message, uint8_t* out, uint16_t outMax) {
+
+	char* line = (char*) out;
+
+	uint16_t size = snprintf(line, outMax, "%02u:%s", message.code, message.prefix);
+
+	for (uint8_t i = 0; i < message.count; i++) {
+		size += snprintf(line + size, outMax - size, ":%u", message.values[i]);
+	}
+
+	line[size++] = '\n';
+
+	return size;
+}
+
+static uint32_t decodeText(const uint8_t* data, uint16_t size) {
+
+	const char* line = (const char*) data;
+	const char* end = (const char*) memchr(line, '\n', size);
+
+	if (end == NULL) {
+		return 0;
+	}
+
+	FieldsView fields(line, (end - line), ':');
+
+	uint32_t sum = fields.getInt(1);
+
+	for (uint8_t i = 3; i <= fields.size(); i++) {
+		sum += (uint32_t) fields.getInt(i);
+	}
+
+	return sum;
+}
+
+////// Binary mode
+
+static uint16_t encodeBinary(const BenchMessage_t& message, uint8_t* out, uint16_t outMax) {
+
+	return bleFrameEncodeValues(message.code, message.prefix, message.values, message.count, true, out, outMax);
+}
+
+static uint32_t decodeBinary(const uint8_t* data, uint16_t size) {
+
+	TestFrame_t frame;
+	bool valid;
+
+	if (testFrameRead(data, size, true, frame, valid) == 0 || !valid) {
+		return 0;
+	}
+
+	char prefix[16];
+	uint32_t values[BENCH_VALUES_MAX];
+
+	uint8_t count = testFrameValues(frame, prefix, sizeof(prefix), values, BENCH_VALUES_MAX);
+
+	uint32_t sum = frame.code;
+
+	for (uint8_t i = 0; i < count; i++) {
+		sum += values[i];
+	}
+
+	return sum;
+}
+
+////// Benchmark
+
+typedef struct {
+	const char* name;
+	double bytes;				// Bytes on air by message
+	double encode;				// Nanoseconds by message (device)
+	double decode;				// Nanoseconds by message (client)
+	uint32_t check;				// Sum of values decoded (same for all)
+} BenchResult_t;
+
+static BenchResult_t bench(const char* name,
+							uint16_t (*encode)(const BenchMessage_t&, uint8_t*, uint16_t),
+							uint32_t (*decode)(const uint8_t*, uint16_t)) {
+
+	static uint8_t data[BENCH_CORPUS][128];
+	static uint16_t sizes[BENCH_CORPUS];
+
+	BenchResult_t result;
+
+	result.name = name;
+	result.check = 0;
+
+	double messages = (double) BENCH_ROUNDS * BENCH_CORPUS;
+
+	// Encode
+
+	uint32_t bytes = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+		for (uint16_t i = 0; i < BENCH_CORPUS; i++) {
+			sizes[i] = encode(mCorpus[i], data[i], sizeof(data[i]));
+			bytes += sizes[i];
+		}
+	}
+
+	result.encode = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+	result.bytes = bytes / messages;
+
+	// Decode
+
+	start = std::chrono::steady_clock::now();
+
+	for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+		for (uint16_t i = 0; i < BENCH_CORPUS; i++) {
+			result.check += decode(data[i], sizes[i]);
+		}
+	}
+
+	result.decode = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+
+	return result;
+}
+
+////// Main
+
+int main() {
+
+	BenchResult_t text = bench("text", encodeText, decodeText);
+	BenchResult_t binary = bench("binary (CRC)", encodeBinary, decodeBinary);
+
+	printf("bench_frame: %u messages of values of %u in corpus\n", (uint32_t) (BENCH_ROUNDS * BENCH_CORPUS), (uint32_t) BENCH_CORPUS);
+
+	const BenchResult_t* results[] = { &text, &binary };
+
+	for (uint8_t i = 0; i < 2; i++) {
+		printf("bench_frame: %-13s %6.1f bytes/message, encode %6.1f ns/message, decode %6.1f ns/message\n",
+					results[i]->name, results[i]->bytes, results[i]->encode, results[i]->decode);
+	}
+
+	printf("{\"bench\":\"frame\",\"text\":{\"bytes\":%.1f,\"encode_ns\":%.1f,\"decode_ns\":%.1f}," \
+				"\"binary\":{\"bytes\":%.1f,\"encode_ns\":%.1f,\"decode_ns\":%.1f}}\n",
+				text.bytes, text.encode, text.decode, binary.bytes, binary.encode, binary.decode);
+
+	TEST_CHECK(text.check == binary.check);
+	TEST_CHECK(binary.bytes < text.bytes);
+
+	return testResult("bench_frame");
+}
+
+//////// End
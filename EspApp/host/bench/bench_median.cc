@@ -0,0 +1,306 @@
+/*
+ * bench_median.cc - benchmark of median filters (util/median_filter.h)
+ * Running: RunningMedian x the old filter - the window of last samples set in the filter and sorted all by
+ * comb sort, for each sample (as 0.1.0); RunningMedian inserts each sample in the window sorted (binary search)
+ * Batch: sorting network (MedianNetwork) x MedianFilter (network up to MEDIAN_NETWORK_MAX, selection above)
+ * x comb sort x std::nth_element - the network is faster only while it is an optimal one (up to 7)
+ * Reports the nanoseconds by sample (running, windows of 7 to 255) and by median (batch, windows of 3 to 32)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "util/median_filter.h"
+
+#include "../test/test.h"
+
+////// Definitions
+
+#define BENCH_SAMPLES 				200000
+#define BENCH_BATCHES 				200000
+
+////// Variables
+
+static uint16_t mSamples[BENCH_SAMPLES];		// Stream of samples (as ADC readings)
+
+////// Old filter (0.1.0) - comb sort of the window, for each median
+
+/**
+ * @brief Comb sort (as 0.1.0)
+ */
+template<typename T, unsigned int _size>
+static void combSort(T* buffer) {
+
+	unsigned int gap = _size;
+	unsigned int swapped = true;
+
+	while (gap > 1 || swapped == true) {
+		gap = (gap * 10) / 13;
+
+		if (gap < 1)
+			gap = 1;
+
+		swapped = false;
+
+		for (unsigned int i = 0; i < _size - gap; ++i) {
+			if (buffer[i] > buffer[i + gap]) {
+				T tmp = buffer[i];
+				buffer[i] = buffer[i + gap];
+				buffer[i + gap] = tmp;
+				swapped = true;
+			}
+		}
+	}
+}
+
+template<typename T, unsigned int _size>
+class CombMedian {
+public:
+
+	/**
+	 * @brief Add a sample (ring of last samples) and get the median of window
+	 */
+	T push(T value) {
+
+		_window[_next] = value;
+		_next = (_next + 1) % _size;
+
+		memcpy(_buffer, _window, sizeof(_buffer));
+
+		combSort<T, _size>(_buffer);
+
+		return _buffer[_size / 2];
+	}
+
+private:
+
+	T _window[_size] = {};	// Samples in order of arrival (ring)
+	T _buffer[_size];		// Samples to sort
+	unsigned int _next = 0;
+};
+
+////// Benchmark - running
+
+typedef struct {
+	unsigned int size;
+	double comb;				// Nanoseconds by sample - old
+	double running;				// Nanoseconds by sample - RunningMedian
+	uint32_t checkComb;			// Sum of medians (the same for both)
+	uint32_t checkRunning;
+} BenchResult_t;
+
+template<unsigned int _size>
+static BenchResult_t bench() {
+
+	BenchResult_t result;
+
+	result.size = _size;
+	result.checkComb = 0;
+	result.checkRunning = 0;
+
+	// Old - window starts with zeros (the running is primed with them too)
+
+	CombMedian<uint16_t, _size> comb;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+		result.checkComb += comb.push(mSamples[i]);
+	}
+
+	result.comb = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_SAMPLES;
+
+	// RunningMedian
+
+	RunningMedian<uint16_t, _size> running;
+
+	for (unsigned int i = 0; i < _size; i++) {
+		running.push(0);
+	}
+
+	start = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+
+		uint16_t median = 0;
+
+		running.push(mSamples[i]);
+		running.getMedian(median);
+
+		result.checkRunning += median;
+	}
+
+	result.running = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_SAMPLES;
+
+	return result;
+}
+
+////// Benchmark - batch (median of a window, all samples set)
+
+typedef struct {
+	unsigned int size;
+	double network;				// Nanoseconds by median - sorting network
+	double filter;				// Nanoseconds by median - MedianFilter
+	double comb;				// Nanoseconds by median - comb sort
+	double nth;					// Nanoseconds by median - std::nth_element
+	uint32_t check[4];			// Sum of medians (the same for all)
+} BenchBatch_t;
+
+template<unsigned int _size>
+static BenchBatch_t batch() {
+
+	BenchBatch_t result;
+
+	memset(&result, 0, sizeof(result));
+
+	result.size = _size;
+
+	uint32_t windows = (BENCH_SAMPLES - _size);
+
+	// Sorting network
+
+	uint16_t buffer[_size];
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (uint32_t n = 0; n < BENCH_BATCHES; n++) {
+
+		memcpy(buffer, &mSamples[n % windows], sizeof(buffer));
+
+		MedianNetwork<uint16_t, _size>::sort(buffer);
+
+		result.check[3] += buffer[_size / 2];
+	}
+
+	result.network = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_BATCHES;
+
+	// MedianFilter
+
+	MedianFilter<uint16_t, _size> filter;
+
+	start = std::chrono::steady_clock::now();
+
+	for (uint32_t n = 0; n < BENCH_BATCHES; n++) {
+
+		const uint16_t* samples = &mSamples[n % windows];
+
+		for (unsigned int i = 0; i < _size; i++) {
+			filter.set(i, samples[i]);
+		}
+
+		uint16_t median = 0;
+
+		filter.getMedian(median);
+
+		result.check[0] += median;
+	}
+
+	result.filter = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_BATCHES;
+
+	// Comb sort
+
+	start = std::chrono::steady_clock::now();
+
+	for (uint32_t n = 0; n < BENCH_BATCHES; n++) {
+
+		memcpy(buffer, &mSamples[n % windows], sizeof(buffer));
+
+		combSort<uint16_t, _size>(buffer);
+
+		result.check[1] += buffer[_size / 2];
+	}
+
+	result.comb = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_BATCHES;
+
+	// Selection of std
+
+	start = std::chrono::steady_clock::now();
+
+	for (uint32_t n = 0; n < BENCH_BATCHES; n++) {
+
+		memcpy(buffer, &mSamples[n % windows], sizeof(buffer));
+
+		std::nth_element(buffer, buffer + (_size / 2), buffer + _size);
+
+		result.check[2] += buffer[_size / 2];
+	}
+
+	result.nth = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_BATCHES;
+
+	return result;
+}
+
+////// Main
+
+int main() {
+
+	// Samples - ADC readings with noise (deterministic)
+
+	uint32_t random = 20171026;
+
+	for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+
+		random = (random * 1103515245u) + 12345u;
+
+		mSamples[i] = 2000 + ((random >> 8) % 200);
+	}
+
+	BenchResult_t results[] = { bench<7>(), bench<15>(), bench<31>(), bench<63>(), bench<127>(), bench<255>() };
+
+	uint8_t count = (sizeof(results) / sizeof(results[0]));
+
+	printf("bench_median: %u samples by window\n", (uint32_t) BENCH_SAMPLES);
+
+	for (uint8_t i = 0; i < count; i++) {
+		printf("bench_median: window %3u - comb sort %8.1f ns/sample, running %6.1f ns/sample (%5.1fx)\n",
+					results[i].size, results[i].comb, results[i].running, results[i].comb / results[i].running);
+	}
+
+	printf("{\"bench\":\"median\",\"windows\":[");
+
+	for (uint8_t i = 0; i < count; i++) {
+		printf("%s{\"size\":%u,\"comb_ns\":%.1f,\"running_ns\":%.1f}", (i > 0) ? "," : "",
+					results[i].size, results[i].comb, results[i].running);
+	}
+
+	printf("]}\n");
+
+	for (uint8_t i = 0; i < count; i++) {
+		TEST_CHECK(results[i].checkComb == results[i].checkRunning);
+	}
+
+	// Batch - sorting networks
+
+	BenchBatch_t batches[] = { batch<3>(), batch<5>(), batch<7>(), batch<8>(), batch<16>(), batch<32>() };
+
+	count = (sizeof(batches) / sizeof(batches[0]));
+
+	printf("bench_median: %u medians by window (batch)\n", (uint32_t) BENCH_BATCHES);
+
+	for (uint8_t i = 0; i < count; i++) {
+		printf("bench_median: window %3u - network %6.1f, filter %6.1f, comb sort %6.1f, nth_element %6.1f ns/median\n",
+					batches[i].size, batches[i].network, batches[i].filter, batches[i].comb, batches[i].nth);
+	}
+
+	printf("{\"bench\":\"median_network\",\"windows\":[");
+
+	for (uint8_t i = 0; i < count; i++) {
+		printf("%s{\"size\":%u,\"network_ns\":%.1f,\"filter_ns\":%.1f,\"comb_ns\":%.1f,\"nth_ns\":%.1f}", (i > 0) ? "," : "",
+					batches[i].size, batches[i].network, batches[i].filter, batches[i].comb, batches[i].nth);
+	}
+
+	printf("]}\n");
+
+	for (uint8_t i = 0; i < count; i++) {
+		TEST_CHECK(batches[i].check[0] == batches[i].check[1] && batches[i].check[0] == batches[i].check[2] &&
+					batches[i].check[0] == batches[i].check[3]);
+	}
+
+	return testResult("bench_median");
+}
+
+//////// End
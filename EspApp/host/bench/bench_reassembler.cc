@@ -0,0 +1,181 @@
+/*
+ * bench_reassembler.cc - benchmark of join of lines received in packets (MTU sized fragments)
+ * LineReassembler (memchr, copy only of parts of lines) x the old way (append of each char to a string)
+ * The stream of lines is fed in fragments of MTU size, as the BLE stack delivers at line rate
+ * Reports the nanoseconds by fragment and by line, and the bytes copied
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+
+#include "sim.h"
+
+#include "util/line_reassembler.h"
+
+#include "../test/test.h"
+
+using namespace std;
+
+////// Definitions
+
+#define BENCH_STREAM_SIZE 			65536		// Size of stream of lines
+#define BENCH_ROUNDS 				50
+#define BENCH_LINE_MAX 				350			// As BLE_LINE_MAX_SIZE
+
+////// Variables
+
+static char mStream[BENCH_STREAM_SIZE];			// Lines (as of App)
+static uint16_t mStreamSize = 0;
+static uint32_t mStreamLines = 0;
+
+////// Old way (append of each char, as ble_server 0.3.0)
+
+static string mOldBuffer;
+
+static uint32_t feedOld(const char* data, uint16_t size) {
+
+	uint32_t result = 0;
+
+	for (uint16_t i = 0; i < size; i++) {
+
+		char character = data[i];
+
+		if (character == '\n') {
+
+			if (mOldBuffer.size() > 0 && mOldBuffer[mOldBuffer.size() - 1] == '\r') {
+				mOldBuffer.erase(mOldBuffer.size() - 1);
+			}
+
+			result += mOldBuffer.size() + 1;
+			mOldBuffer = "";
+
+		} else {
+
+			mOldBuffer.append(1u, character);
+		}
+	}
+
+	return result;
+}
+
+////// Reassembler
+
+static LineReassembler<BENCH_LINE_MAX> mReassembler;
+
+static uint32_t feedReassembler(const char* data, uint16_t size) {
+
+	uint32_t result = 0;
+
+	while (size > 0) {
+
+		const char* line;
+		uint16_t sizeLine;
+
+		uint16_t used = mReassembler.feed(data, size, line, sizeLine);
+
+		if (line != NULL) {
+			result += sizeLine + 1;
+		}
+
+		data += used;
+		size -= used;
+	}
+
+	return result;
+}
+
+////// Benchmark
+
+typedef struct {
+	double nanosFragment;		// Nanoseconds by fragment
+	double nanosLine;			// Nanoseconds by line
+	double allocations;			// Allocations by line
+	uint32_t check;				// Sum of sizes of lines
+} BenchResult_t;
+
+static BenchResult_t bench(uint16_t mtu, uint32_t (*feed)(const char*, uint16_t)) {
+
+	BenchResult_t result;
+
+	result.check = 0;
+
+	uint32_t fragments = 0;
+
+	uint64_t allocations = simAllocations();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+
+		for (uint32_t pos = 0; pos < mStreamSize; pos += mtu) {
+
+			uint16_t size = ((mStreamSize - pos) < mtu) ? (mStreamSize - pos) : mtu;
+
+			result.check += feed(mStream + pos, size);
+			fragments++;
+		}
+	}
+
+	double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	double lines = (double) mStreamLines * BENCH_ROUNDS;
+
+	result.nanosFragment = nanos / fragments;
+	result.nanosLine = nanos / lines;
+	result.allocations = (simAllocations() - allocations) / lines;
+
+	return result;
+}
+
+////// Main
+
+int main() {
+
+	// Stream of lines (sizes as of App: commands and echoes)
+
+	uint32_t seq = 0;
+
+	while (mStreamSize < (BENCH_STREAM_SIZE - BENCH_LINE_MAX)) {
+
+		uint16_t payload = (seq * 37) % 200;
+
+		mStreamSize += snprintf(mStream + mStreamSize, BENCH_STREAM_SIZE - mStreamSize, "70:%u:", seq);
+
+		memset(mStream + mStreamSize, 'a' + (seq % 26), payload);
+		mStreamSize += payload;
+
+		mStream[mStreamSize++] = '\n';
+
+		seq++;
+	}
+
+	mStreamLines = seq;
+
+	printf("bench_reassembler: stream of %u bytes, %u lines, %u rounds\n", mStreamSize, mStreamLines, BENCH_ROUNDS);
+
+	const uint16_t mtus[] = { 20, 100, 244 };
+
+	for (uint8_t i = 0; i < (sizeof(mtus) / sizeof(mtus[0])); i++) {
+
+		BenchResult_t old = bench(mtus[i], feedOld);
+		BenchResult_t reassembler = bench(mtus[i], feedReassembler);
+
+		printf("bench_reassembler: mtu %3u old %7.1f ns/fragment %7.1f ns/line %5.2f allocations/line, " \
+					"reassembler %7.1f ns/fragment %7.1f ns/line %5.2f allocations/line\n",
+					mtus[i], old.nanosFragment, old.nanosLine, old.allocations,
+					reassembler.nanosFragment, reassembler.nanosLine, reassembler.allocations);
+
+		printf("{\"bench\":\"reassembler\",\"mtu\":%u,\"old\":{\"ns_fragment\":%.1f,\"ns_line\":%.1f}," \
+					"\"reassembler\":{\"ns_fragment\":%.1f,\"ns_line\":%.1f}}\n",
+					mtus[i], old.nanosFragment, old.nanosLine, reassembler.nanosFragment, reassembler.nanosLine);
+
+		TEST_CHECK(old.check == reassembler.check);
+		TEST_CHECK(reassembler.allocations == 0.0);
+	}
+
+	return testResult("bench_reassembler");
+}
+
+//////// End
@@ -0,0 +1,72 @@
+/*
+ * ble_uart_stub.c - BLE UART server is not simulated (the default transport of BleServer)
+ * The host uses the loopback (memory) or the socket transport, see bleSetTransport
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "ble_transport.h"
+
+////// Routines
+
+static esp_err_t stub_Initialize(const char* device_name) {
+
+	return ESP_FAIL;
+}
+
+static esp_err_t stub_Finalize() {
+
+	return ESP_OK;
+}
+
+static void stub_SetCallbackConnection(void (*callbackConnection)(), void (*callbackMTU)()) {
+}
+
+static void stub_SetCallbackReceiveData(void (*callbackReceived)(char* data, uint16_t size)) {
+}
+
+static void stub_SetCallbackCongestion(void (*callbackCongestion)(bool congested)) {
+}
+
+static bool stub_ClientConnected() {
+
+	return false;
+}
+
+static esp_err_t stub_SendData(const char* data, uint16_t size) {
+
+	return ESP_FAIL;
+}
+
+static uint16_t stub_MTU() {
+
+	return 20;
+}
+
+static const uint8_t* stub_MacAddress() {
+
+	static const uint8_t mac[6] = { 0 };
+
+	return mac;
+}
+
+////// Transport
+
+const BleTransport_t bleTransportUart = {
+	"ble_uart_server (not simulated)",
+	stub_Initialize,
+	stub_Finalize,
+	stub_SetCallbackConnection,
+	stub_SetCallbackReceiveData,
+	stub_SetCallbackCongestion,
+	stub_ClientConnected,
+	stub_SendData,
+	stub_MTU,
+	stub_MacAddress
+};
+
+//////// End
@@ -0,0 +1,49 @@
+/*
+ * adc.h - ADC driver of ESP-IDF (host simulation)
+ * The values of channels is set by simAdcInput (sim.h)
+ */
+
+#ifndef SIM_ADC_H_
+#define SIM_ADC_H_
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////// Types
+
+typedef enum {
+	ADC1_CHANNEL_0 = 0, ADC1_CHANNEL_1, ADC1_CHANNEL_2, ADC1_CHANNEL_3,
+	ADC1_CHANNEL_4, ADC1_CHANNEL_5, ADC1_CHANNEL_6, ADC1_CHANNEL_7,
+	ADC1_CHANNEL_MAX
+} adc1_channel_t;
+
+typedef enum {
+	ADC_ATTEN_0db = 0,
+	ADC_ATTEN_2_5db,
+	ADC_ATTEN_6db,
+	ADC_ATTEN_11db
+} adc_atten_t;
+
+typedef enum {
+	ADC_WIDTH_9Bit = 0,
+	ADC_WIDTH_10Bit,
+	ADC_WIDTH_11Bit,
+	ADC_WIDTH_12Bit
+} adc_bits_width_t;
+
+////// Prototypes
+
+extern esp_err_t adc1_config_width(adc_bits_width_t width);
+extern esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten);
+extern int adc1_get_raw(adc1_channel_t channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_ADC_H_ */
+
+//////// End
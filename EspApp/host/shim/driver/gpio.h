@@ -0,0 +1,79 @@
+/*
+ * gpio.h - GPIO driver of ESP-IDF (host simulation)
+ * The levels of inputs is set by simGpioInput (sim.h), that calls the handler of interrupt
+ */
+
+#ifndef SIM_GPIO_H_
+#define SIM_GPIO_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////// Types
+
+typedef enum {
+	GPIO_NUM_0 = 0, GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3, GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_6, GPIO_NUM_7,
+	GPIO_NUM_8, GPIO_NUM_9, GPIO_NUM_10, GPIO_NUM_11, GPIO_NUM_12, GPIO_NUM_13, GPIO_NUM_14, GPIO_NUM_15,
+	GPIO_NUM_16, GPIO_NUM_17, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_20, GPIO_NUM_21, GPIO_NUM_22, GPIO_NUM_23,
+	GPIO_NUM_25 = 25, GPIO_NUM_26, GPIO_NUM_27,
+	GPIO_NUM_32 = 32, GPIO_NUM_33, GPIO_NUM_34, GPIO_NUM_35, GPIO_NUM_36, GPIO_NUM_37, GPIO_NUM_38, GPIO_NUM_39,
+	GPIO_NUM_MAX = 40
+} gpio_num_t;
+
+typedef enum {
+	GPIO_MODE_DISABLE = 0,
+	GPIO_MODE_INPUT,
+	GPIO_MODE_OUTPUT
+} gpio_mode_t;
+
+typedef enum {
+	GPIO_PULLUP_DISABLE = 0,
+	GPIO_PULLUP_ENABLE
+} gpio_pullup_t;
+
+typedef enum {
+	GPIO_PULLDOWN_DISABLE = 0,
+	GPIO_PULLDOWN_ENABLE
+} gpio_pulldown_t;
+
+typedef enum {
+	GPIO_INTR_DISABLE = 0,
+	GPIO_INTR_POSEDGE,
+	GPIO_INTR_NEGEDGE,
+	GPIO_INTR_ANYEDGE,
+	GPIO_INTR_LOW_LEVEL,
+	GPIO_INTR_HIGH_LEVEL
+} gpio_int_type_t;
+
+typedef struct {
+	uint64_t pin_bit_mask;
+	gpio_mode_t mode;
+	gpio_pullup_t pull_up_en;
+	gpio_pulldown_t pull_down_en;
+	gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void* arg);
+
+////// Prototypes
+
+extern esp_err_t gpio_config(const gpio_config_t* config);
+extern esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level);
+extern int gpio_get_level(gpio_num_t gpio);
+
+extern esp_err_t gpio_install_isr_service(int flags);
+extern esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void* arg);
+extern esp_err_t gpio_isr_handler_remove(gpio_num_t gpio);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_GPIO_H_ */
+
+//////// End
@@ -0,0 +1,171 @@
+/*
+ * drivers.cc - drivers of ESP-IDF (host simulation) - GPIO, ADC and power
+ * The inputs is set by tests (simGpioInput, simAdcInput)
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "driver/adc.h"
+#include "esp_bt.h"
+
+#include "sim.h"
+
+////// Variables
+
+static int mGpioLevels[GPIO_NUM_MAX];					// Levels
+static gpio_int_type_t mGpioInterrupts[GPIO_NUM_MAX];	// Types of interrupts
+static gpio_isr_t mGpioHandlers[GPIO_NUM_MAX];			// Handlers of interrupts
+static void* mGpioArgs[GPIO_NUM_MAX];
+
+static int mAdcValues[ADC1_CHANNEL_MAX];				// Raw values of ADC
+
+static int mVdd33 = 3300;								// Voltage of ESP32
+
+////// GPIO
+
+esp_err_t gpio_config(const gpio_config_t* config) {
+
+	for (uint8_t gpio = 0; gpio < GPIO_NUM_MAX; gpio++) {
+		if (config->pin_bit_mask & (1ull << gpio)) {
+			mGpioInterrupts[gpio] = config->intr_type;
+		}
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level) {
+
+	if (gpio < 0 || gpio >= GPIO_NUM_MAX) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	mGpioLevels[gpio] = (level != 0);
+
+	return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio) {
+
+	if (gpio < 0 || gpio >= GPIO_NUM_MAX) {
+		return 0;
+	}
+
+	return mGpioLevels[gpio];
+}
+
+esp_err_t gpio_install_isr_service(int flags) {
+
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void* arg) {
+
+	if (gpio < 0 || gpio >= GPIO_NUM_MAX) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	mGpioHandlers[gpio] = handler;
+	mGpioArgs[gpio] = arg;
+
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio) {
+
+	if (gpio < 0 || gpio >= GPIO_NUM_MAX) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	mGpioHandlers[gpio] = NULL;
+
+	return ESP_OK;
+}
+
+/**
+ * @brief Level of input - calls the handler of interrupt (in the task of caller, as the ISR)
+ */
+void simGpioInput(gpio_num_t gpio, int level) {
+
+	if (gpio < 0 || gpio >= GPIO_NUM_MAX) {
+		return;
+	}
+
+	int last = mGpioLevels[gpio];
+
+	mGpioLevels[gpio] = (level != 0);
+
+	if (last == mGpioLevels[gpio] || mGpioHandlers[gpio] == NULL) {
+		return;
+	}
+
+	bool rising = (mGpioLevels[gpio] == 1);
+
+	switch (mGpioInterrupts[gpio]) {
+		case GPIO_INTR_POSEDGE:
+			if (!rising) return;
+			break;
+		case GPIO_INTR_NEGEDGE:
+			if (rising) return;
+			break;
+		case GPIO_INTR_ANYEDGE:
+			break;
+		default:
+			return;
+	}
+
+	mGpioHandlers[gpio](mGpioArgs[gpio]);
+}
+
+/**
+ * @brief Level of output
+ */
+int simGpioOutput(gpio_num_t gpio) {
+
+	return gpio_get_level(gpio);
+}
+
+////// ADC
+
+esp_err_t adc1_config_width(adc_bits_width_t width) {
+
+	return ESP_OK;
+}
+
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten) {
+
+	return ESP_OK;
+}
+
+int adc1_get_raw(adc1_channel_t channel) {
+
+	if (channel < 0 || channel >= ADC1_CHANNEL_MAX) {
+		return -1;
+	}
+
+	return mAdcValues[channel];
+}
+
+/**
+ * @brief Raw value of ADC channel
+ */
+void simAdcInput(adc1_channel_t channel, int value) {
+
+	if (channel >= 0 && channel < ADC1_CHANNEL_MAX) {
+		mAdcValues[channel] = value;
+	}
+}
+
+////// Power
+
+extern "C" int rom_phy_get_vdd33() {
+
+	return mVdd33;
+}
+
+esp_err_t esp_ble_tx_power_set(esp_ble_power_type_t type, esp_power_level_t level) {
+
+	return ESP_OK;
+}
+
+//////// End
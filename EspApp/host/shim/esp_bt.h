@@ -0,0 +1,33 @@
+/*
+ * esp_bt.h - controller of Bluetooth (host simulation - only the declarations, not linked)
+ */
+
+#ifndef SIM_ESP_BT_H_
+#define SIM_ESP_BT_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	ESP_BLE_PWR_TYPE_DEFAULT = 12
+} esp_ble_power_type_t;
+
+typedef enum {
+	ESP_PWR_LVL_N12 = 0, ESP_PWR_LVL_N9, ESP_PWR_LVL_N6, ESP_PWR_LVL_N3,
+	ESP_PWR_LVL_N0, ESP_PWR_LVL_P3, ESP_PWR_LVL_P6, ESP_PWR_LVL_P9
+} esp_power_level_t;
+
+extern esp_err_t esp_ble_tx_power_set(esp_ble_power_type_t type, esp_power_level_t level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_ESP_BT_H_ */
+
+//////// End
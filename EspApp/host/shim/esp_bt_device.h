@@ -0,0 +1,5 @@
+/*
+ * esp_bt_device.h - device of Bluetooth (host simulation - not used)
+ */
+
+//////// End
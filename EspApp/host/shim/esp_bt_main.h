@@ -0,0 +1,5 @@
+/*
+ * esp_bt_main.h - Bluedroid of ESP-IDF (host simulation - not used)
+ */
+
+//////// End
@@ -0,0 +1,39 @@
+/*
+ * esp_err.h - errors of ESP-IDF (host simulation)
+ */
+
+#ifndef SIM_ESP_ERR_H_
+#define SIM_ESP_ERR_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int32_t esp_err_t;
+
+#define ESP_OK 							0
+#define ESP_FAIL 						-1
+#define ESP_ERR_NO_MEM 					0x101
+#define ESP_ERR_INVALID_ARG 			0x102
+#define ESP_ERR_INVALID_STATE 			0x103
+#define ESP_ERR_NVS_NO_FREE_PAGES 		0x1100d
+
+#define ESP_ERROR_CHECK(x) do { 											\
+		esp_err_t __err = (x); 												\
+		if (__err != ESP_OK) { 												\
+			printf("ESP_ERROR_CHECK failed: 0x%x at %s:%d\n", (int) __err, __FILE__, __LINE__); \
+			abort(); 														\
+		} 																	\
+	} while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_ESP_ERR_H_ */
+
+//////// End
@@ -0,0 +1,59 @@
+/*
+ * esp_log.h - logging of ESP-IDF (host simulation)
+ * The level is checked in compile time (LOG_LOCAL_LEVEL) and in runtime (simLogLevel)
+ */
+
+#ifndef SIM_ESP_LOG_H_
+#define SIM_ESP_LOG_H_
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	ESP_LOG_NONE,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+#ifndef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#endif
+
+extern void simLog(esp_log_level_t level, const char* tag, const char* format, ...)
+					__attribute__ ((format (printf, 3, 4)));
+
+extern int xPortGetCoreID(void);
+
+#define ESP_LOG_LEVEL_LOCAL(level, tag, format, ...) do { 			\
+		if (LOG_LOCAL_LEVEL >= level) { 							\
+			simLog(level, tag, format, ##__VA_ARGS__); 				\
+		} 															\
+	} while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#define ESP_EARLY_LOGE ESP_LOGE
+#define ESP_EARLY_LOGW ESP_LOGW
+#define ESP_EARLY_LOGI ESP_LOGI
+#define ESP_EARLY_LOGD ESP_LOGD
+#define ESP_EARLY_LOGV ESP_LOGV
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_ESP_LOG_H_ */
+
+//////// End
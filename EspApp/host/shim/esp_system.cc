@@ -0,0 +1,201 @@
+/*
+ * esp_system.cc - system of ESP-IDF (host simulation) - logging, heap, chip, restart and sleep
+ * The heap is the allocations of C++ (operators new/delete), counted here
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+
+#include <atomic>
+#include <new>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+
+#include "sim.h"
+#include "sim_kernel.h"
+
+////// Definitions
+
+#define SIM_HEAP_SIZE 				160000u		// About the free heap of ESP32, with Bluedroid
+
+////// Variables
+
+static esp_log_level_t mLogLevel = (esp_log_level_t) -1;		// Level of logging (-1 - not initialized)
+
+static std::atomic<uint64_t> mAllocations(0);	// Allocations
+static std::atomic<int64_t> mHeapUsed(0);		// Bytes in use
+static std::atomic<int64_t> mHeapPeak(0);		// Peak of bytes in use
+
+static thread_local int tHeapQuiet = 0;			// Not count allocations ?
+
+////// Logging
+
+void simLogLevel(esp_log_level_t level) {
+
+	mLogLevel = level;
+}
+
+void simLog(esp_log_level_t level, const char* tag, const char* format, ...) {
+
+	if ((int) mLogLevel < 0) {
+
+		const char* env = getenv("ESPSIM_LOG");
+
+		mLogLevel = (env != NULL) ? (esp_log_level_t) atoi(env) : ESP_LOG_WARN;
+	}
+
+	if (level > mLogLevel) {
+		return;
+	}
+
+	static const char letters[] = "NEWIDV";
+
+	printf("%c (%llu) %s: ", letters[level], (unsigned long long) (simTime() / 1000u), tag);
+
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+
+	printf("\n");
+	fflush(stdout);
+}
+
+////// Heap
+
+SimHeapQuiet::SimHeapQuiet() {
+
+	tHeapQuiet++;
+}
+
+SimHeapQuiet::~SimHeapQuiet() {
+
+	tHeapQuiet--;
+}
+
+uint64_t simAllocations() {
+
+	return mAllocations;
+}
+
+int64_t simHeapUsed() {
+
+	return mHeapUsed;
+}
+
+static void* heapAllocate(size_t size) {
+
+	void* pointer = malloc((size > 0) ? size : 1);
+
+	if (pointer == NULL) {
+		throw std::bad_alloc();
+	}
+
+	if (tHeapQuiet == 0) {
+		mAllocations++;
+	}
+
+	int64_t used = (mHeapUsed += malloc_usable_size(pointer));
+
+	if (used > mHeapPeak) {
+		mHeapPeak = used;
+	}
+
+	return pointer;
+}
+
+static void heapFree(void* pointer) {
+
+	if (pointer != NULL) {
+
+		mHeapUsed -= malloc_usable_size(pointer);
+
+		free(pointer);
+	}
+}
+
+void* operator new(size_t size) {
+
+	return heapAllocate(size);
+}
+
+void* operator new[](size_t size) {
+
+	return heapAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+
+	heapFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+
+	heapFree(pointer);
+}
+
+uint32_t esp_get_free_heap_size() {
+
+	int64_t used = mHeapUsed;
+
+	return (used < SIM_HEAP_SIZE) ? (uint32_t) (SIM_HEAP_SIZE - used) : 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size() {
+
+	int64_t peak = mHeapPeak;
+
+	return (peak < SIM_HEAP_SIZE) ? (uint32_t) (SIM_HEAP_SIZE - peak) : 0;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+
+	return esp_get_free_heap_size();
+}
+
+////// System
+
+void esp_chip_info(esp_chip_info_t* info) {
+
+	info->model = CHIP_ESP32;
+	info->features = CHIP_FEATURE_WIFI_BGN | CHIP_FEATURE_BLE | CHIP_FEATURE_BT;
+	info->cores = 2;
+	info->revision = 1;
+}
+
+const char* esp_get_idf_version() {
+
+	return "v3.1-sim";
+}
+
+void esp_restart() {
+
+	simExit("restart");
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(int pin, int level) {
+
+	return ESP_OK;
+}
+
+void esp_deep_sleep_start() {
+
+	simExit("deep sleep");
+}
+
+esp_err_t nvs_flash_init() {
+
+	return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase() {
+
+	return ESP_OK;
+}
+
+//////// End
@@ -0,0 +1,61 @@
+/*
+ * esp_system.h - system of ESP-IDF (host simulation)
+ * The heap is the allocations of C++ (operators new/delete), counted in esp_system.cc
+ */
+
+#ifndef SIM_ESP_SYSTEM_H_
+#define SIM_ESP_SYSTEM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////// Types
+
+typedef enum {
+	CHIP_ESP32 = 1
+} esp_chip_model_t;
+
+typedef struct {
+	esp_chip_model_t model;
+	uint32_t features;
+	uint8_t cores;
+	uint8_t revision;
+} esp_chip_info_t;
+
+#define CHIP_FEATURE_EMB_FLASH 			(1 << 0)
+#define CHIP_FEATURE_WIFI_BGN 			(1 << 1)
+#define CHIP_FEATURE_BLE 				(1 << 4)
+#define CHIP_FEATURE_BT 				(1 << 5)
+
+#define MALLOC_CAP_8BIT 				(1 << 2)
+
+////// Prototypes
+
+extern void esp_chip_info(esp_chip_info_t* info);
+extern const char* esp_get_idf_version(void);
+
+extern void esp_restart(void);
+
+extern uint32_t esp_get_free_heap_size(void);
+extern uint32_t esp_get_minimum_free_heap_size(void);
+extern size_t heap_caps_get_free_size(uint32_t caps);
+
+// Sleep (esp_sleep.h)
+
+extern esp_err_t esp_sleep_enable_ext0_wakeup(int pin, int level);
+extern void esp_deep_sleep_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_ESP_SYSTEM_H_ */
+
+//////// End
@@ -0,0 +1,185 @@
+/*
+ * esp_timer.cc - high resolution timer of ESP-IDF (host simulation)
+ * The callbacks runs in the task of timer (priority of ESP-IDF), in time of alarm (microseconds)
+ */
+
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sim.h"
+#include "sim_kernel.h"
+
+////// Definitions
+
+#define SIM_TIMERS_MAX 				32
+#define SIM_TIMER_PRIORITY 			(configMAX_PRIORITIES - 3)
+
+////// Types
+
+struct SimTimer {
+	esp_timer_cb_t callback;		// Callback and argument
+	void* arg;
+	const char* name;				// Name
+	uint64_t alarm;					// Time of alarm
+	uint64_t period;				// Period (0 if once)
+	bool active;					// Active ?
+};
+
+////// Variables
+
+static SimTimer* mTimers[SIM_TIMERS_MAX];		// Timers
+static uint32_t mNumTimers = 0;
+
+////// Prototypes
+
+void simTimerInitialize();
+
+static void timer_Task(void* pvParameters);
+
+////// Routines
+
+/**
+ * @brief Initialize (by simRun) - creates the task of timer
+ */
+void simTimerInitialize() {
+
+	mNumTimers = 0;
+
+	xTaskCreatePinnedToCore(&timer_Task, "esp_timer", 4096, NULL, SIM_TIMER_PRIORITY, NULL, PRO_CPU_NUM);
+}
+
+int64_t esp_timer_get_time() {
+
+	return (int64_t) simTime();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+
+	if (args == NULL || args->callback == NULL || handle == NULL) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	if (mNumTimers >= SIM_TIMERS_MAX) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	SimHeapQuiet quiet;
+
+	SimTimer* timer = new SimTimer();
+
+	timer->callback = args->callback;
+	timer->arg = args->arg;
+	timer->name = args->name;
+	timer->active = false;
+
+	mTimers[mNumTimers++] = timer;
+
+	*handle = timer;
+
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout) {
+
+	if (timer == NULL || timer->active) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	timer->alarm = simTime() + timeout;
+	timer->period = 0;
+	timer->active = true;
+
+	simWake(mTimers);
+
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+
+	if (timer == NULL || timer->active || period == 0) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	timer->alarm = simTime() + period;
+	timer->period = period;
+	timer->active = true;
+
+	simWake(mTimers);
+
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+
+	if (timer == NULL || !timer->active) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	timer->active = false;
+
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+
+	if (timer == NULL || timer->active) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	for (uint32_t i = 0; i < mNumTimers; i++) {
+
+		if (mTimers[i] == timer) {
+
+			mTimers[i] = mTimers[--mNumTimers];
+			break;
+		}
+	}
+
+	SimHeapQuiet quiet;
+
+	delete timer;
+
+	return ESP_OK;
+}
+
+////// Private
+
+/**
+ * @brief Task of timer - runs the callbacks of timers expired
+ */
+static void timer_Task(void* pvParameters) {
+
+	for (;;) {
+
+		// Next alarm
+
+		SimTimer* next = NULL;
+
+		for (uint32_t i = 0; i < mNumTimers; i++) {
+			if (mTimers[i]->active && (next == NULL || mTimers[i]->alarm < next->alarm)) {
+				next = mTimers[i];
+			}
+		}
+
+		if (next == NULL || next->alarm > simTime()) {
+
+			simBlock(mTimers, (next != NULL) ? next->alarm : SIM_TIME_NEVER);
+			continue;
+		}
+
+		// Expired (the periodic is rearmed before the callback, it can stop the timer)
+
+		if (next->period > 0) {
+			next->alarm += next->period;
+		} else {
+			next->active = false;
+		}
+
+		next->callback(next->arg);
+	}
+}
+
+//////// End
@@ -0,0 +1,50 @@
+/*
+ * esp_timer.h - high resolution timer of ESP-IDF (host simulation)
+ * The callbacks runs in the task of timer (as ESP_TIMER_TASK)
+ */
+
+#ifndef SIM_ESP_TIMER_H_
+#define SIM_ESP_TIMER_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////// Types
+
+typedef struct SimTimer* esp_timer_handle_t;
+
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+	ESP_TIMER_TASK
+} esp_timer_dispatch_t;
+
+typedef struct {
+	esp_timer_cb_t callback;
+	void* arg;
+	esp_timer_dispatch_t dispatch_method;
+	const char* name;
+} esp_timer_create_args_t;
+
+////// Prototypes
+
+extern int64_t esp_timer_get_time(void);
+
+extern esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle);
+extern esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout);
+extern esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
+extern esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+extern esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_ESP_TIMER_H_ */
+
+//////// End
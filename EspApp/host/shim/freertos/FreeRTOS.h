@@ -0,0 +1,77 @@
+/*
+ * FreeRTOS.h - FreeRTOS of ESP-IDF (host simulation)
+ * The tasks are threads, but only one runs at a time (see sim_kernel.cc)
+ * So the critical sections is not needed (all is serialized by the simulation)
+ */
+
+#ifndef SIM_FREERTOS_H_
+#define SIM_FREERTOS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////// Types
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+typedef struct SimTask* TaskHandle_t;
+typedef struct SimQueue* QueueHandle_t;
+
+////// Definitions
+
+#define pdFALSE 						0
+#define pdTRUE 							1
+#define pdPASS 							pdTRUE
+#define pdFAIL 							pdFALSE
+#define errQUEUE_EMPTY 					0
+#define errQUEUE_FULL 					0
+
+#define portMAX_DELAY 					((TickType_t) 0xffffffffUL)
+
+#define configTICK_RATE_HZ 				CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES 			25
+
+#define portTICK_PERIOD_MS 				((TickType_t) (1000 / configTICK_RATE_HZ))
+#define portTICK_RATE_MS 				portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms) 				((TickType_t) (((TickType_t) (ms) * configTICK_RATE_HZ) / 1000))
+
+#define PRO_CPU_NUM 					0
+#define APP_CPU_NUM 					1
+#define tskNO_AFFINITY 					0x7FFFFFFF
+
+#define IRAM_ATTR
+
+// Critical sections (only one task runs at a time)
+
+typedef int portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED 	0
+
+#define portENTER_CRITICAL(mux) 		((void) (mux))
+#define portEXIT_CRITICAL(mux) 			((void) (mux))
+#define portENTER_CRITICAL_ISR(mux) 	((void) (mux))
+#define portEXIT_CRITICAL_ISR(mux) 		((void) (mux))
+
+#define portYIELD_FROM_ISR() 			taskYIELD()
+
+////// Prototypes
+
+extern void taskYIELD(void);
+extern int xPortGetCoreID(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_FREERTOS_H_ */
+
+//////// End
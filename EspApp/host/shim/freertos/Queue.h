@@ -0,0 +1,7 @@
+/*
+ * Queue.h - the firmware includes it with this name (case insensitive on the toolchain of Windows)
+ */
+
+#include "queue.h"
+
+//////// End
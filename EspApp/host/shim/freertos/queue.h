@@ -0,0 +1,43 @@
+/*
+ * queue.h - queues of FreeRTOS (host simulation)
+ */
+
+#ifndef SIM_QUEUE_H_
+#define SIM_QUEUE_H_
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////// Prototypes
+
+extern QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+extern void vQueueDelete(QueueHandle_t queue);
+
+extern BaseType_t xQueueGenericSend(QueueHandle_t queue, const void* item, TickType_t ticks, BaseType_t front);
+extern BaseType_t xQueueGenericReceive(QueueHandle_t queue, void* item, TickType_t ticks, BaseType_t peek);
+
+extern UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+extern UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+extern BaseType_t xQueueReset(QueueHandle_t queue);
+
+////// Macros
+
+#define xQueueSend(queue, item, ticks) 				xQueueGenericSend(queue, item, ticks, pdFALSE)
+#define xQueueSendToBack(queue, item, ticks) 		xQueueGenericSend(queue, item, ticks, pdFALSE)
+#define xQueueSendToFront(queue, item, ticks) 		xQueueGenericSend(queue, item, ticks, pdTRUE)
+#define xQueueReceive(queue, item, ticks) 			xQueueGenericReceive(queue, item, ticks, pdFALSE)
+#define xQueuePeek(queue, item, ticks) 				xQueueGenericReceive(queue, item, ticks, pdTRUE)
+
+#define xQueueSendFromISR(queue, item, woken) \
+		(((woken) != NULL ? (*(woken) = pdFALSE) : 0), xQueueGenericSend(queue, item, 0, pdFALSE))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_QUEUE_H_ */
+
+//////// End
@@ -0,0 +1,61 @@
+/*
+ * task.h - tasks of FreeRTOS (host simulation)
+ */
+
+#ifndef SIM_TASK_H_
+#define SIM_TASK_H_
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////// Types
+
+typedef void (*TaskFunction_t)(void*);
+
+typedef enum {
+	eNoAction = 0,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite,
+	eSetValueWithoutOverwrite
+} eNotifyAction;
+
+////// Prototypes
+
+extern BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+						void* parameters, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+extern void vTaskDelete(TaskHandle_t task);
+extern void vTaskDelay(TickType_t ticks);
+
+extern TickType_t xTaskGetTickCount(void);
+extern TaskHandle_t xTaskGetCurrentTaskHandle(void);
+extern UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+extern char* pcTaskGetTaskName(TaskHandle_t task);
+
+extern BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value, eNotifyAction action, uint32_t* previousValue);
+extern BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t* value, TickType_t ticks);
+extern uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+
+////// Macros
+
+#define xTaskCreate(function, name, stackDepth, parameters, priority, handle) \
+		xTaskCreatePinnedToCore(function, name, stackDepth, parameters, priority, handle, tskNO_AFFINITY)
+
+#define xTaskNotify(task, value, action) 		xTaskGenericNotify(task, value, action, NULL)
+#define xTaskNotifyGive(task) 					xTaskGenericNotify(task, 0, eIncrement, NULL)
+
+#define xTaskNotifyFromISR(task, value, action, woken) \
+		(((woken) != NULL ? (*(woken) = pdFALSE) : 0), xTaskGenericNotify(task, value, action, NULL))
+#define vTaskNotifyGiveFromISR(task, woken) \
+		((void) xTaskNotifyFromISR(task, 0, eIncrement, woken))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_TASK_H_ */
+
+//////// End
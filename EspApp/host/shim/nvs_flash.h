@@ -0,0 +1,23 @@
+/*
+ * nvs_flash.h - non volatile storage of ESP-IDF (host simulation)
+ */
+
+#ifndef SIM_NVS_FLASH_H_
+#define SIM_NVS_FLASH_H_
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern esp_err_t nvs_flash_init(void);
+extern esp_err_t nvs_flash_erase(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_NVS_FLASH_H_ */
+
+//////// End
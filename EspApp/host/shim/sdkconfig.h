@@ -0,0 +1,16 @@
+/*
+ * sdkconfig.h - configuration of host simulation (same values of EspApp/sdkconfig)
+ */
+
+#ifndef SIM_SDKCONFIG_H_
+#define SIM_SDKCONFIG_H_
+
+// Dual core (CONFIG_FREERTOS_UNICORE is not set)
+
+#define CONFIG_FREERTOS_HZ 100
+
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+
+#endif /* SIM_SDKCONFIG_H_ */
+
+//////// End
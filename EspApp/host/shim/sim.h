@@ -0,0 +1,62 @@
+/*
+ * sim.h - simulation of ESP-IDF and FreeRTOS in host (Linux), to tests and tools
+ * The tasks of FreeRTOS is threads, but only one runs at a time (as one CPU), by priority
+ * The clock can be virtual (jumps to next event - hours simulated in seconds) or real
+ */
+
+#ifndef SIM_SIM_H_
+#define SIM_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "driver/adc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////// Types
+
+typedef void (*SimMain_t)(void* arg);
+
+////// Prototypes
+
+// Simulation
+
+extern void simRun(SimMain_t main, void* arg, bool virtualClock);	// Runs main as a task (as app_main), until simStop
+extern void simStop(void);											// Stops the simulation - simRun returns
+extern const char* simExitReason(void);								// Reason of stop by firmware (ex: "restart"), or NULL
+
+extern uint64_t simTime(void);										// Time of simulation (microseconds)
+extern bool simVirtual(void);										// Virtual clock ?
+
+// Threads outside of simulation (ex: sockets) - runs as a task of high priority, between enter and leave
+
+extern bool simEnter(void);											// Returns false if the simulation is stopped
+extern void simLeave(void);
+
+// Logging (level in runtime, the initial is of environment ESPSIM_LOG, or warnings)
+
+extern void simLogLevel(esp_log_level_t level);
+
+// Heap (allocations of C++)
+
+extern uint64_t simAllocations(void);								// Allocations since the start
+extern int64_t simHeapUsed(void);									// Bytes in use
+
+// Peripherals
+
+extern void simGpioInput(gpio_num_t gpio, int level);				// Level of input - calls the handler of interrupt
+extern int simGpioOutput(gpio_num_t gpio);							// Level of output
+extern void simAdcInput(adc1_channel_t channel, int value);			// Raw value of ADC channel
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_SIM_H_ */
+
+//////// End
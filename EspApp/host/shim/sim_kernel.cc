@@ -0,0 +1,887 @@
+/*
+ * sim_kernel.cc - kernel of simulation - tasks and queues of FreeRTOS
+ * Each task is a thread, but only the current task runs (it have the lock of kernel),
+ * as in one CPU: the task ready with more priority runs (FIFO in same priority)
+ * A task gives the CPU when blocks (delay, queues, notifications), or when wakes a task with more priority
+ * When no task is ready, the idle (a thread) advances the clock:
+ *   - virtual: jumps to the next deadline (so hours is simulated in seconds)
+ *   - real: waits the next deadline (or a thread outside of simulation, see simEnter)
+ * Note: the ticks is of CONFIG_FREERTOS_HZ, the timeouts is aligned by ticks, as in FreeRTOS
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "sim.h"
+#include "sim_kernel.h"
+
+////// Definitions
+
+#define SIM_TASKS_MAX 				64
+#define SIM_TICK_US 				((uint64_t) portTICK_PERIOD_MS * 1000u)
+#define SIM_PRIORITY_EXTERNAL 		(configMAX_PRIORITIES - 1)
+
+////// Types
+
+struct SimTask {
+	std::condition_variable cv;		// To wait the CPU
+	TaskFunction_t function;		// Function and parameters
+	void* parameters;
+	char name[16];					// Name
+	UBaseType_t priority;			// Priority
+	BaseType_t core;				// Core (pinned)
+	bool ready;						// Ready to run ?
+	bool blocked;					// Blocked ?
+	bool external;					// Thread outside of simulation ?
+	uint64_t sequence;				// Sequence of ready (FIFO)
+	const void* object;				// Object of block
+	uint64_t deadline;				// Deadline of block
+	bool timedOut;					// Timeout of block ?
+	uint32_t notifyValue;			// Notification
+	bool notifyPending;
+};
+
+struct SimQueue {
+	uint8_t* items;					// Items (circular)
+	UBaseType_t length;				// Maximum of items
+	UBaseType_t itemSize;			// Size of item
+	UBaseType_t count;				// Items in queue
+	UBaseType_t head;				// First item
+};
+
+////// Variables
+
+// Note: the objects of kernel is never destroyed (the threads is detached)
+
+static std::mutex* mMutex = new std::mutex();
+static std::condition_variable* mIdleCv = new std::condition_variable();
+static std::condition_variable* mDoneCv = new std::condition_variable();
+
+static SimTask* mTasks[SIM_TASKS_MAX];			// Tasks
+static uint32_t mNumTasks = 0;
+
+static SimTask* mCurrent = NULL;				// Task running
+static uint64_t mSequence = 0;					// Sequence of ready
+static uint32_t mExternals = 0;					// Threads outside of simulation
+
+static bool mStopped = false;					// Stopped ?
+static bool mVirtual = true;					// Virtual clock ?
+static const char* mExitReason = NULL;			// Reason of exit by firmware
+
+static std::atomic<uint64_t> mNow(0);			// Virtual time (microseconds)
+static std::chrono::steady_clock::time_point mStart; // Start (real clock)
+
+static thread_local SimTask* tSelf = NULL;		// Task of this thread
+static thread_local std::unique_lock<std::mutex>* tLock = NULL; // Lock of kernel of this thread
+
+////// Prototypes
+
+extern void simTimerInitialize();
+
+static SimTask* createTask(TaskFunction_t function, const char* name, void* parameters, UBaseType_t priority, BaseType_t core);
+static void taskThread(SimTask* task);
+static void idleThread();
+
+static void makeReady(SimTask* task);
+static SimTask* nextReady();
+static void dispatch(SimTask* task);
+static void reschedule();
+static void preempt();
+static void expireTimeouts();
+static void park();
+static void check(const char* routine);
+static uint64_t deadlineOfTicks(TickType_t ticks);
+static void removeTask(SimTask* task);
+
+////// Simulation
+
+/**
+ * @brief Runs the main as a task (as app_main), until simStop
+ */
+void simRun(SimMain_t main, void* arg, bool virtualClock) {
+
+	std::unique_lock<std::mutex> lock(*mMutex);
+
+	mVirtual = virtualClock;
+	mStart = std::chrono::steady_clock::now();
+	mNow = 0;
+	mStopped = false;
+	mExitReason = NULL;
+
+	// Tasks of system and the main
+
+	simTimerInitialize();
+
+	createTask(main, "main", arg, 1, PRO_CPU_NUM);
+
+	// Idle (dispatch the tasks)
+
+	{
+		SimHeapQuiet quiet;
+
+		std::thread(idleThread).detach();
+	}
+
+	// Wait the stop
+
+	while (!mStopped) {
+		mDoneCv->wait(lock);
+	}
+}
+
+/**
+ * @brief Stops the simulation (the tasks is not runned anymore)
+ */
+void simStop() {
+
+	mStopped = true;
+	mCurrent = NULL;
+
+	mDoneCv->notify_all();
+	mIdleCv->notify_all();
+
+	for (uint32_t i = 0; i < mNumTasks; i++) {
+		if (mTasks[i]->external) {
+			mTasks[i]->cv.notify_all();
+		}
+	}
+
+	if (tSelf != NULL && !tSelf->external) {
+		park();
+	}
+}
+
+/**
+ * @brief Exit of simulation by firmware (ex: esp_restart)
+ */
+void simExit(const char* reason) {
+
+	mExitReason = reason;
+
+	simStop();
+}
+
+/**
+ * @brief Reason of exit by firmware
+ */
+const char* simExitReason() {
+
+	return mExitReason;
+}
+
+/**
+ * @brief Time of simulation (microseconds)
+ */
+uint64_t simTime() {
+
+	if (mVirtual) {
+		return mNow;
+	}
+
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - mStart).count();
+}
+
+/**
+ * @brief Virtual clock ?
+ */
+bool simVirtual() {
+
+	return mVirtual;
+}
+
+/**
+ * @brief A thread outside of simulation enters - runs as a task of high priority (until simLeave)
+ */
+bool simEnter() {
+
+	SimHeapQuiet quiet;
+
+	tLock = new std::unique_lock<std::mutex>(*mMutex);
+
+	if (tSelf == NULL) {
+
+		tSelf = new SimTask();
+
+		strncpy(tSelf->name, "external", sizeof(tSelf->name) - 1);
+		tSelf->priority = SIM_PRIORITY_EXTERNAL;
+		tSelf->core = tskNO_AFFINITY;
+		tSelf->external = true;
+
+		mTasks[mNumTasks++] = tSelf;
+		mExternals++;
+	}
+
+	if (mStopped) {
+		simLeave();
+		return false;
+	}
+
+	makeReady(tSelf);
+
+	mIdleCv->notify_all();
+
+	while (mCurrent != tSelf && !mStopped) {
+		tSelf->cv.wait(*tLock);
+	}
+
+	if (mStopped) {
+		simLeave();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief A thread outside of simulation leaves (gives the CPU)
+ */
+void simLeave() {
+
+	if (tLock == NULL) {
+		return;
+	}
+
+	tSelf->ready = false;
+
+	if (!mStopped && mCurrent == tSelf) {
+		dispatch(nextReady());
+	}
+
+	delete tLock;
+	tLock = NULL;
+}
+
+/**
+ * @brief Blocks the task until simWake(object) or the deadline - returns false on timeout
+ */
+bool simBlock(const void* object, uint64_t deadline) {
+
+	check("simBlock");
+
+	SimTask* self = tSelf;
+
+	self->blocked = true;
+	self->object = object;
+	self->deadline = deadline;
+	self->timedOut = false;
+
+	reschedule();
+
+	return !self->timedOut;
+}
+
+/**
+ * @brief Wakes the tasks blocked by this object
+ */
+void simWake(const void* object) {
+
+	for (uint32_t i = 0; i < mNumTasks; i++) {
+
+		SimTask* task = mTasks[i];
+
+		if (task->blocked && task->object == object) {
+			makeReady(task);
+		}
+	}
+
+	preempt();
+}
+
+////// FreeRTOS - tasks
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+						void* parameters, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+
+	SimTask* task = createTask(function, name, parameters, priority, core);
+
+	if (task == NULL) {
+		return pdFAIL;
+	}
+
+	if (handle != NULL) {
+		*handle = task;
+	}
+
+	preempt();
+
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+
+	if (task == NULL) {
+		task = tSelf;
+	}
+
+	removeTask(task);
+
+	if (task == tSelf) {
+
+		task->ready = false;
+		task->blocked = false;
+
+		dispatch(nextReady());
+
+		park();
+	}
+}
+
+void vTaskDelay(TickType_t ticks) {
+
+	check("vTaskDelay");
+
+	if (ticks == 0) {
+		taskYIELD();
+		return;
+	}
+
+	simBlock(tSelf, deadlineOfTicks(ticks));
+}
+
+void taskYIELD() {
+
+	if (tSelf == NULL || mCurrent != tSelf) {
+		return;
+	}
+
+	makeReady(tSelf);
+
+	reschedule();
+}
+
+TickType_t xTaskGetTickCount() {
+
+	return (TickType_t) (simTime() / SIM_TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+
+	return tSelf;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+
+	return 1024; // Not simulated
+}
+
+char* pcTaskGetTaskName(TaskHandle_t task) {
+
+	if (task == NULL) {
+		task = tSelf;
+	}
+
+	return (task != NULL) ? task->name : NULL;
+}
+
+int xPortGetCoreID() {
+
+	if (tSelf == NULL || tSelf->core == tskNO_AFFINITY) {
+		return PRO_CPU_NUM;
+	}
+
+	return tSelf->core;
+}
+
+////// FreeRTOS - notifications
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value, eNotifyAction action, uint32_t* previousValue) {
+
+	if (previousValue != NULL) {
+		*previousValue = task->notifyValue;
+	}
+
+	switch (action) {
+		case eSetBits:
+			task->notifyValue |= value;
+			break;
+		case eIncrement:
+			task->notifyValue++;
+			break;
+		case eSetValueWithOverwrite:
+			task->notifyValue = value;
+			break;
+		case eSetValueWithoutOverwrite:
+			if (task->notifyPending) {
+				return pdFAIL;
+			}
+			task->notifyValue = value;
+			break;
+		case eNoAction:
+			break;
+	}
+
+	task->notifyPending = true;
+
+	if (task->blocked && task->object == &task->notifyValue) {
+		makeReady(task);
+	}
+
+	preempt();
+
+	return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t* value, TickType_t ticks) {
+
+	check("xTaskNotifyWait");
+
+	SimTask* self = tSelf;
+
+	if (!self->notifyPending) {
+
+		self->notifyValue &= ~clearOnEntry;
+
+		if (ticks > 0) {
+			simBlock(&self->notifyValue, deadlineOfTicks(ticks));
+		}
+	}
+
+	if (value != NULL) {
+		*value = self->notifyValue;
+	}
+
+	if (!self->notifyPending) {
+		return pdFALSE;
+	}
+
+	self->notifyValue &= ~clearOnExit;
+	self->notifyPending = false;
+
+	return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+
+	check("ulTaskNotifyTake");
+
+	SimTask* self = tSelf;
+
+	if (self->notifyValue == 0 && ticks > 0) {
+		simBlock(&self->notifyValue, deadlineOfTicks(ticks));
+	}
+
+	uint32_t value = self->notifyValue;
+
+	if (value != 0) {
+		self->notifyValue = (clearOnExit) ? 0 : (value - 1);
+	}
+
+	self->notifyPending = false;
+
+	return value;
+}
+
+////// FreeRTOS - queues
+
+// Note: the receivers waits by the queue, and the senders by the queue + 1
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+
+	SimHeapQuiet quiet;
+
+	SimQueue* queue = new SimQueue();
+
+	queue->items = new uint8_t[length * itemSize];
+	queue->length = length;
+	queue->itemSize = itemSize;
+	queue->count = 0;
+	queue->head = 0;
+
+	return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+
+	SimHeapQuiet quiet;
+
+	if (queue != NULL) {
+		delete[] queue->items;
+		delete queue;
+	}
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t queue, const void* item, TickType_t ticks, BaseType_t front) {
+
+	uint64_t deadline = deadlineOfTicks(ticks);
+
+	while (queue->count >= queue->length) {
+
+		if (ticks == 0) {
+			return errQUEUE_FULL;
+		}
+
+		check("xQueueSend");
+
+		if (!simBlock((uint8_t*) queue + 1, deadline)) {
+			return errQUEUE_FULL;
+		}
+	}
+
+	UBaseType_t index;
+
+	if (front) {
+		queue->head = (queue->head + queue->length - 1) % queue->length;
+		index = queue->head;
+	} else {
+		index = (queue->head + queue->count) % queue->length;
+	}
+
+	memcpy(queue->items + (index * queue->itemSize), item, queue->itemSize);
+
+	queue->count++;
+
+	simWake(queue);
+
+	return pdPASS;
+}
+
+BaseType_t xQueueGenericReceive(QueueHandle_t queue, void* item, TickType_t ticks, BaseType_t peek) {
+
+	uint64_t deadline = deadlineOfTicks(ticks);
+
+	while (queue->count == 0) {
+
+		if (ticks == 0) {
+			return errQUEUE_EMPTY;
+		}
+
+		check("xQueueReceive");
+
+		if (!simBlock(queue, deadline)) {
+			return errQUEUE_EMPTY;
+		}
+	}
+
+	memcpy(item, queue->items + (queue->head * queue->itemSize), queue->itemSize);
+
+	if (!peek) {
+
+		queue->head = (queue->head + 1) % queue->length;
+		queue->count--;
+
+		simWake((uint8_t*) queue + 1);
+	}
+
+	return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+
+	return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+
+	return (queue->length - queue->count);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+
+	queue->count = 0;
+	queue->head = 0;
+
+	simWake((uint8_t*) queue + 1);
+
+	return pdPASS;
+}
+
+////// Private
+
+/**
+ * @brief Creates a task (ready to run)
+ */
+static SimTask* createTask(TaskFunction_t function, const char* name, void* parameters, UBaseType_t priority, BaseType_t core) {
+
+	if (mNumTasks >= SIM_TASKS_MAX) {
+		return NULL;
+	}
+
+	SimHeapQuiet quiet;
+
+	SimTask* task = new SimTask();
+
+	task->function = function;
+	task->parameters = parameters;
+	strncpy(task->name, name, sizeof(task->name) - 1);
+	task->priority = priority;
+	task->core = core;
+
+	mTasks[mNumTasks++] = task;
+
+	std::thread(taskThread, task).detach();
+
+	makeReady(task);
+
+	return task;
+}
+
+/**
+ * @brief Thread of task
+ */
+static void taskThread(SimTask* task) {
+
+	std::unique_lock<std::mutex> lock(*mMutex);
+
+	tSelf = task;
+	tLock = &lock;
+
+	while (mCurrent != task) {
+		task->cv.wait(lock);
+	}
+
+	task->function(task->parameters);
+
+	// Return of task function (not allowed in FreeRTOS) - as deleted
+
+	vTaskDelete(NULL);
+}
+
+/**
+ * @brief Thread of idle - dispatch the tasks and advances the clock
+ */
+static void idleThread() {
+
+	std::unique_lock<std::mutex> lock(*mMutex);
+
+	for (;;) {
+
+		if (mStopped || mCurrent != NULL) {
+			mIdleCv->wait(lock);
+			continue;
+		}
+
+		// Next task
+
+		expireTimeouts();
+
+		SimTask* task = nextReady();
+
+		if (task != NULL) {
+			dispatch(task);
+			continue;
+		}
+
+		// Next deadline
+
+		uint64_t deadline = SIM_TIME_NEVER;
+
+		for (uint32_t i = 0; i < mNumTasks; i++) {
+			if (mTasks[i]->blocked && mTasks[i]->deadline < deadline) {
+				deadline = mTasks[i]->deadline;
+			}
+		}
+
+		if (deadline == SIM_TIME_NEVER && mVirtual && mExternals == 0) {
+
+			// All tasks blocked forever
+
+			printf("sim: deadlock at %llu us - tasks:\n", (unsigned long long) simTime());
+
+			for (uint32_t i = 0; i < mNumTasks; i++) {
+				printf("sim:   %s (priority %u) blocked\n", mTasks[i]->name, mTasks[i]->priority);
+			}
+
+			fflush(stdout);
+			abort();
+		}
+
+		if (mVirtual && deadline != SIM_TIME_NEVER) {
+
+			if (deadline > mNow) {
+				mNow = deadline;
+			}
+
+		} else if (deadline == SIM_TIME_NEVER) {
+
+			mIdleCv->wait(lock);
+
+		} else {
+
+			mIdleCv->wait_until(lock, mStart + std::chrono::microseconds(deadline));
+		}
+	}
+}
+
+/**
+ * @brief Task is ready (in end of your priority)
+ */
+static void makeReady(SimTask* task) {
+
+	task->blocked = false;
+	task->ready = true;
+	task->sequence = ++mSequence;
+}
+
+/**
+ * @brief Next task to run - the ready with more priority (FIFO in same priority)
+ */
+static SimTask* nextReady() {
+
+	SimTask* next = NULL;
+
+	for (uint32_t i = 0; i < mNumTasks; i++) {
+
+		SimTask* task = mTasks[i];
+
+		if (task->ready && (next == NULL || task->priority > next->priority ||
+				(task->priority == next->priority && task->sequence < next->sequence))) {
+			next = task;
+		}
+	}
+
+	return next;
+}
+
+/**
+ * @brief Gives the CPU to this task (or to idle, if NULL)
+ */
+static void dispatch(SimTask* task) {
+
+	mCurrent = task;
+
+	if (task != NULL) {
+
+		task->ready = false;
+		task->cv.notify_one();
+
+	} else {
+
+		mIdleCv->notify_one();
+	}
+}
+
+/**
+ * @brief The current task gives the CPU, and waits to run again
+ */
+static void reschedule() {
+
+	SimTask* self = tSelf;
+
+	if (!mStopped) {
+
+		if (!mVirtual) {
+			expireTimeouts();
+		}
+
+		dispatch(nextReady());
+	}
+
+	while (mCurrent != self) {
+
+		if (mStopped) {
+
+			if (!self->external) {
+				park();
+			}
+
+			self->timedOut = true; // The thread outside of simulation returns
+			return;
+		}
+
+		self->cv.wait(*tLock);
+	}
+}
+
+/**
+ * @brief Gives the CPU if a task with more priority is ready
+ */
+static void preempt() {
+
+	if (tSelf == NULL || mCurrent != tSelf) {
+		return;
+	}
+
+	if (!mVirtual) {
+		expireTimeouts();
+	}
+
+	SimTask* next = nextReady();
+
+	if (next != NULL && next->priority > tSelf->priority) {
+
+		makeReady(tSelf);
+
+		reschedule();
+	}
+}
+
+/**
+ * @brief Tasks blocked with deadline expired is ready
+ */
+static void expireTimeouts() {
+
+	uint64_t now = simTime();
+
+	for (uint32_t i = 0; i < mNumTasks; i++) {
+
+		SimTask* task = mTasks[i];
+
+		if (task->blocked && task->deadline <= now) {
+			task->timedOut = true;
+			makeReady(task);
+		}
+	}
+}
+
+/**
+ * @brief The thread not runs anymore (task deleted or simulation stopped)
+ */
+static void park() {
+
+	for (;;) {
+		tSelf->cv.wait(*tLock);
+	}
+}
+
+/**
+ * @brief Checks if the caller can block (is the current task)
+ */
+static void check(const char* routine) {
+
+	if (tSelf == NULL || mCurrent != tSelf) {
+
+		printf("sim: %s called outside of a task\n", routine);
+		fflush(stdout);
+		abort();
+	}
+}
+
+/**
+ * @brief Deadline of timeout in ticks (aligned by ticks, as FreeRTOS)
+ */
+static uint64_t deadlineOfTicks(TickType_t ticks) {
+
+	if (ticks == portMAX_DELAY) {
+		return SIM_TIME_NEVER;
+	}
+
+	return (((simTime() / SIM_TICK_US) + ticks) * SIM_TICK_US);
+}
+
+/**
+ * @brief Removes a task of list
+ */
+static void removeTask(SimTask* task) {
+
+	for (uint32_t i = 0; i < mNumTasks; i++) {
+
+		if (mTasks[i] == task) {
+
+			mTasks[i] = mTasks[--mNumTasks];
+			break;
+		}
+	}
+}
+
+//////// End
@@ -0,0 +1,40 @@
+/*
+ * sim_kernel.h - internals of simulation kernel, to the shims (esp_timer, etc.) and the simulated links
+ * The caller must be a task (or a thread inside of simEnter/simLeave)
+ */
+
+#ifndef SIM_KERNEL_H_
+#define SIM_KERNEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////// Definitions
+
+#define SIM_TIME_NEVER 				UINT64_MAX
+
+////// Prototypes
+
+// Blocks the task until simWake(object) or the time of deadline - returns false on timeout
+
+bool simBlock(const void* object, uint64_t deadline);
+
+// Wakes the tasks blocked by this object (runs now, if have more priority than the caller)
+
+void simWake(const void* object);
+
+// Exit of simulation by firmware (ex: esp_restart)
+
+void simExit(const char* reason);
+
+// Not count the allocations in this scope (allocations of simulation, not of firmware)
+
+class SimHeapQuiet {
+public:
+	SimHeapQuiet();
+	~SimHeapQuiet();
+};
+
+#endif /* SIM_KERNEL_H_ */
+
+//////// End
@@ -0,0 +1,5 @@
+/*
+ * soc.h - registers of ESP32 (host simulation - not used)
+ */
+
+//////// End
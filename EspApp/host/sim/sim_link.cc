@@ -0,0 +1,304 @@
+/*
+ * sim_link.cc - simulated link of BLE (GATT) between a client and the loopback transport of BleServer
+ * The task of link runs the connection events (by a timer), as the task of BT stack
+ * The events is in times multiple of interval, but only when have data (empty events is not simulated)
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "ble_transport.h"
+
+#include "sim_link.h"
+
+////// Definitions
+
+#define SIM_LINK_PRIORITY 			19		// As the BT controller/host
+
+////// Types
+
+typedef struct {
+	uint16_t size;
+	char data[SIM_LINK_PACKET_MAX];
+} SimLinkPacket_t;
+
+////// Variables
+
+static SimLinkConfig_t mConfig;					// Configuration
+static SimLinkReceive_t mReceive = NULL;		// Callback of client
+static SimLinkStats_t mStats;					// Statistics
+
+static TaskHandle_t xTaskLinkHandle = NULL;		// Task of link
+static esp_timer_handle_t mTimer = NULL;		// Timer of connection events
+
+static bool mConnected = false;					// Connected ?
+static bool mScheduled = false;					// Connection event scheduled ?
+static bool mCongested = false;					// Congestion signaled to server ?
+
+static SimLinkPacket_t mBuffers[SIM_LINK_BUFFERS_MAX]; // Notifications in BT stack (circular)
+static uint8_t mBuffersHead = 0;
+static uint8_t mBuffersCount = 0;
+
+static char mWrites[2][SIM_LINK_WRITES_SIZE];	// Writes pending: [size][data]... (double buffer)
+static uint16_t mWritesSize = 0;
+static uint8_t mWritesIndex = 0;
+
+////// Prototypes
+
+static void link_Task(void* pvParameters);
+static void linkTimer(void* arg);
+static void linkNotification(const char* data, uint16_t size);
+static void connectionEvent();
+static void scheduleEvent();
+
+////// Routines
+
+/**
+ * @brief Start the link (the task and timer of connection events)
+ */
+void simLinkStart(const SimLinkConfig_t& config, SimLinkReceive_t receive) {
+
+	mConfig = config;
+	mReceive = receive;
+
+	if (mConfig.buffers > SIM_LINK_BUFFERS_MAX) {
+		mConfig.buffers = SIM_LINK_BUFFERS_MAX;
+	}
+	if (mConfig.mtu > SIM_LINK_PACKET_MAX) {
+		mConfig.mtu = SIM_LINK_PACKET_MAX;
+	}
+
+	memset(&mStats, 0, sizeof(mStats));
+
+	ble_loopback_SetCallbackClient(linkNotification);
+
+	xTaskCreatePinnedToCore(&link_Task, "simLink", 4096, NULL, SIM_LINK_PRIORITY, &xTaskLinkHandle, 0);
+
+	esp_timer_create_args_t timerArgs;
+
+	timerArgs.callback = linkTimer;
+	timerArgs.arg = NULL;
+	timerArgs.dispatch_method = ESP_TIMER_TASK;
+	timerArgs.name = "simLink";
+
+	esp_timer_create(&timerArgs, &mTimer);
+}
+
+/**
+ * @brief Client connects
+ */
+void simLinkConnect() {
+
+	mBuffersHead = 0;
+	mBuffersCount = 0;
+	mWritesSize = 0;
+
+	mConnected = true;
+	mCongested = false;
+
+	ble_loopback_Connect(mConfig.mtu);
+}
+
+/**
+ * @brief Client disconnects (the pending data is lost)
+ */
+void simLinkDisconnect() {
+
+	mConnected = false;
+	mCongested = false; // Cleared by disconnection
+
+	ble_loopback_Disconnect();
+
+	mBuffersCount = 0;
+	mWritesSize = 0;
+
+	if (mScheduled) {
+		esp_timer_stop(mTimer);
+		mScheduled = false;
+	}
+}
+
+/**
+ * @brief Connected ?
+ */
+bool simLinkConnected() {
+
+	return mConnected;
+}
+
+/**
+ * @brief Write of client - delivered to server in next connection event
+ */
+bool simLinkWrite(const char* data, uint16_t size) {
+
+	if (!mConnected || (mWritesSize + sizeof(uint16_t) + size) > SIM_LINK_WRITES_SIZE) {
+		mStats.writesLost++;
+		return false;
+	}
+
+	char* writes = mWrites[mWritesIndex];
+
+	memcpy(writes + mWritesSize, &size, sizeof(uint16_t));
+	memcpy(writes + mWritesSize + sizeof(uint16_t), data, size);
+
+	mWritesSize += (sizeof(uint16_t) + size);
+
+	mStats.writes++;
+
+	scheduleEvent();
+
+	return true;
+}
+
+/**
+ * @brief Statistics
+ */
+const SimLinkStats_t& simLinkStats() {
+
+	return mStats;
+}
+
+////// Private
+
+/**
+ * @brief Task of link - runs the connection events
+ */
+static void link_Task(void* pvParameters) {
+
+	for (;;) {
+
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		if (mConnected) {
+			connectionEvent();
+		}
+	}
+}
+
+/**
+ * @brief Timer of connection events
+ */
+static void linkTimer(void* arg) {
+
+	mScheduled = false;
+
+	xTaskNotifyGive(xTaskLinkHandle);
+}
+
+/**
+ * @brief Connection event - writes of client to server, and notifications of server to client
+ */
+static void connectionEvent() {
+
+	mStats.events++;
+
+	// Writes (the server callback runs here, as in task of BT stack)
+	// Note: double buffer, the client can write in callbacks
+
+	char* writes = mWrites[mWritesIndex];
+	uint16_t writesSize = mWritesSize;
+
+	mWritesIndex ^= 1;
+	mWritesSize = 0;
+
+	for (uint16_t pos = 0; pos < writesSize && mConnected; ) {
+
+		uint16_t size;
+
+		memcpy(&size, writes + pos, sizeof(uint16_t));
+
+		ble_loopback_Write(writes + pos + sizeof(uint16_t), size);
+
+		pos += (sizeof(uint16_t) + size);
+	}
+
+	// Notifications
+
+	for (uint8_t i = 0; i < mConfig.packets && mBuffersCount > 0 && mConnected; i++) {
+
+		SimLinkPacket_t& packet = mBuffers[mBuffersHead];
+
+		mBuffersHead = (mBuffersHead + 1) % SIM_LINK_BUFFERS_MAX;
+		mBuffersCount--;
+
+		mStats.notifications++;
+		mStats.bytes += packet.size;
+
+		if (mReceive != NULL) {
+			mReceive(packet.data, packet.size);
+		}
+	}
+
+	// Buffers freed - end of congestion (the server sends again)
+
+	if (mCongested && mBuffersCount < mConfig.buffers && mConnected) {
+
+		mCongested = false;
+
+		ble_loopback_SetCongested(false);
+	}
+
+	// More data ?
+
+	if (mWritesSize > 0 || mBuffersCount > 0) {
+		scheduleEvent();
+	}
+}
+
+/**
+ * @brief Schedule the next connection event (in time multiple of interval)
+ */
+static void scheduleEvent() {
+
+	if (mScheduled || !mConnected) {
+		return;
+	}
+
+	uint64_t now = esp_timer_get_time();
+	uint64_t next = ((now / mConfig.interval) + 1) * mConfig.interval;
+
+	mScheduled = true;
+
+	esp_timer_start_once(mTimer, (next - now));
+}
+
+/**
+ * @brief Notification sended by server - to buffers of BT stack
+ */
+static void linkNotification(const char* data, uint16_t size) {
+
+	if (mBuffersCount >= mConfig.buffers) {
+		mStats.lost++;
+		return;
+	}
+
+	SimLinkPacket_t& packet = mBuffers[(mBuffersHead + mBuffersCount) % SIM_LINK_BUFFERS_MAX];
+
+	packet.size = (size > SIM_LINK_PACKET_MAX) ? SIM_LINK_PACKET_MAX : size;
+	memcpy(packet.data, data, packet.size);
+
+	mBuffersCount++;
+
+	if (mBuffersCount > mStats.bufferedMax) {
+		mStats.bufferedMax = mBuffersCount;
+	}
+
+	// Buffers full - congested (the server waits to send more)
+
+	if (mBuffersCount >= mConfig.buffers && !mCongested) {
+
+		mCongested = true;
+		mStats.congestions++;
+
+		ble_loopback_SetCongested(true);
+	}
+
+	scheduleEvent();
+}
+
+//////// End
@@ -0,0 +1,60 @@
+/*
+ * sim_link.h - simulated link of BLE (GATT) between a client and the loopback transport of BleServer
+ * The connection events is periodic (interval of connection): in each event, the writes of client
+ * is delivered to server, and up to N notifications of server is delivered to client
+ * The others notifications waits in the buffers of BT stack (simulated)
+ * When the buffers is full, the link is congested (as ESP_GATTS_CONGEST_EVT), until a connection event frees it
+ */
+
+#ifndef SIM_LINK_H_
+#define SIM_LINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////// Definitions
+
+#define SIM_LINK_BUFFERS_MAX 		64		// Maximum of buffers of notifications
+#define SIM_LINK_PACKET_MAX 		256		// Maximum size of packet (MTU)
+#define SIM_LINK_WRITES_SIZE 		8192	// Size of writes of client pending
+
+////// Types
+
+// Configuration
+
+typedef struct {
+	uint16_t mtu;				// MTU of data
+	uint32_t interval;			// Interval of connection (micros)
+	uint8_t packets;			// Notifications delivered per connection event
+	uint8_t buffers;			// Buffers of notifications in BT stack
+} SimLinkConfig_t;
+
+// Statistics
+
+typedef struct {
+	uint32_t events;			// Connection events
+	uint32_t writes;			// Writes of client
+	uint32_t notifications;		// Notifications delivered to client
+	uint32_t bytes;				// Bytes of notifications
+	uint32_t lost;				// Notifications lost (buffers full)
+	uint32_t writesLost;		// Writes lost (not connected or full)
+	uint32_t congestions;		// Congestions signaled to server (buffers full)
+	uint8_t bufferedMax;		// Maximum of buffers in use
+} SimLinkStats_t;
+
+// Notification received by client (runs in task of link)
+
+typedef void (*SimLinkReceive_t)(const char* data, uint16_t size);
+
+////// Prototypes
+
+void simLinkStart(const SimLinkConfig_t& config, SimLinkReceive_t receive);
+void simLinkConnect();
+void simLinkDisconnect();
+bool simLinkConnected();
+bool simLinkWrite(const char* data, uint16_t size);
+const SimLinkStats_t& simLinkStats();
+
+#endif /* SIM_LINK_H_ */
+
+//////// End
@@ -0,0 +1,122 @@
+/*
+ * frame_reader.h - reader of binary frames in client side (text and values - see util/ble_frame.h)
+ * Used by tests and benchmarks, as the mobile app do it
+ */
+
+#ifndef TEST_FRAME_READER_H_
+#define TEST_FRAME_READER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "util/ble_frame.h"
+
+////// Types
+
+// Frame read
+
+typedef struct {
+	uint8_t code;				// Code of message (without the bit of values)
+	bool values;				// Frame of values ?
+	const uint8_t* payload;		// Payload (in data)
+	uint16_t size;				// Size of payload
+} TestFrame_t;
+
+////// Routines
+
+/**
+ * @brief Read a frame in begin of data - returns the size of frame (0 if not complete)
+ * Sets valid to false if the CRC is wrong
+ */
+inline uint16_t testFrameRead(const uint8_t* data, uint16_t size, bool crc, TestFrame_t& frame, bool& valid) {
+
+	valid = true;
+
+	if (size < 2) {
+		return 0;
+	}
+
+	// Code and length (varint)
+
+	frame.code = (data[0] == BLE_FRAME_CODE_ERROR) ? data[0] : (data[0] & ~BLE_FRAME_VALUES);
+	frame.values = (data[0] != BLE_FRAME_CODE_ERROR && (data[0] & BLE_FRAME_VALUES) != 0);
+
+	uint16_t pos = 1;
+	uint32_t length = 0;
+	uint8_t shift = 0;
+
+	for (;;) {
+
+		if (pos >= size) {
+			return 0;
+		}
+
+		uint8_t byte = data[pos++];
+
+		length |= ((uint32_t) (byte & 0x7F) << shift);
+		shift += 7;
+
+		if ((byte & 0x80) == 0) {
+			break;
+		}
+	}
+
+	uint32_t total = pos + length + ((crc) ? BLE_FRAME_CRC_SIZE : 0);
+
+	if (total > size) {
+		return 0;
+	}
+
+	frame.payload = data + pos;
+	frame.size = length;
+
+	if (crc) {
+
+		uint16_t value = bleFrameCrc16(0xFFFF, data, pos + length);
+
+		valid = (data[pos + length] == (value >> 8) && data[pos + length + 1] == (value & 0xFF));
+	}
+
+	return total;
+}
+
+/**
+ * @brief Values of a frame of values - returns the number of values (prefix is copied with terminator)
+ */
+inline uint8_t testFrameValues(const TestFrame_t& frame, char* prefix, uint8_t prefixMax,
+									uint32_t* values, uint8_t max) {
+
+	if (!frame.values || frame.size == 0 || frame.payload[0] >= prefixMax || frame.payload[0] >= frame.size) {
+		prefix[0] = '\0';
+		return 0;
+	}
+
+	uint8_t sizePrefix = frame.payload[0];
+
+	memcpy(prefix, frame.payload + 1, sizePrefix);
+	prefix[sizePrefix] = '\0';
+
+	uint8_t count = 0;
+	uint16_t pos = 1 + sizePrefix;
+
+	while (pos < frame.size && count < max) {
+
+		uint32_t value = 0;
+		uint8_t shift = 0;
+		uint8_t byte;
+
+		do {
+			byte = frame.payload[pos++];
+			value |= ((uint32_t) (byte & 0x7F) << shift);
+			shift += 7;
+		} while ((byte & 0x80) != 0 && pos < frame.size);
+
+		values[count++] = value;
+	}
+
+	return count;
+}
+
+#endif /* TEST_FRAME_READER_H_ */
+
+//////// End
@@ -0,0 +1,144 @@
+/*
+ * test.h - checks and reports of the tests in host
+ */
+
+#ifndef TEST_TEST_H_
+#define TEST_TEST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+////// Checks
+
+#define TEST_CHECK(condition) testCheck((condition), #condition, __FILE__, __LINE__)
+
+/**
+ * @brief Number of checks failed
+ */
+inline uint32_t& testFailures() {
+
+	static uint32_t failures = 0;
+
+	return failures;
+}
+
+/**
+ * @brief Check a condition (shows it if fails)
+ */
+inline bool testCheck(bool condition, const char* text, const char* file, int line) {
+
+	if (!condition) {
+
+		printf("%s:%d: check failed: %s\n", file, line, text);
+		fflush(stdout);
+
+		testFailures()++;
+	}
+
+	return condition;
+}
+
+/**
+ * @brief Result of test (exit code)
+ */
+inline int testResult(const char* name) {
+
+	if (testFailures() > 0) {
+		printf("%s: FAILED (%u checks)\n", name, testFailures());
+		return 1;
+	}
+
+	printf("%s: OK\n", name);
+	return 0;
+}
+
+////// Latency (round trip)
+
+// Histogram of latency, linear (buckets of TEST_LATENCY_STEP micros), without heap
+
+#define TEST_LATENCY_STEP 			100u
+#define TEST_LATENCY_BUCKETS 		50000u		// Up to 5 seconds
+
+class TestLatency {
+public:
+
+	TestLatency() {
+
+		reset();
+	}
+
+	void reset() {
+
+		memset(_buckets, 0, sizeof(_buckets));
+		_count = 0;
+		_max = 0;
+		_total = 0;
+	}
+
+	void add(uint64_t value) {
+
+		uint32_t index = (uint32_t) (value / TEST_LATENCY_STEP);
+
+		_buckets[(index < TEST_LATENCY_BUCKETS) ? index : (TEST_LATENCY_BUCKETS - 1)]++;
+		_count++;
+		_total += value;
+
+		if (value > _max) {
+			_max = value;
+		}
+	}
+
+	uint32_t count() const {
+
+		return _count;
+	}
+
+	uint64_t max() const {
+
+		return _max;
+	}
+
+	uint64_t average() const {
+
+		return (_count > 0) ? (_total / _count) : 0;
+	}
+
+	/**
+	 * @brief Percentile (upper value of bucket) - percent in tenths (ex: 999 is 99.9%)
+	 */
+	uint64_t percentile(uint16_t tenths) const {
+
+		if (_count == 0) {
+			return 0;
+		}
+
+		uint64_t target = ((uint64_t) _count * tenths + 999) / 1000;
+		uint64_t sum = 0;
+
+		for (uint32_t i = 0; i < TEST_LATENCY_BUCKETS; i++) {
+
+			sum += _buckets[i];
+
+			if (sum >= target) {
+
+				uint64_t upper = ((uint64_t) (i + 1) * TEST_LATENCY_STEP);
+
+				return (upper < _max) ? upper : _max;
+			}
+		}
+
+		return _max;
+	}
+
+private:
+
+	uint32_t _buckets[TEST_LATENCY_BUCKETS];
+	uint32_t _count;
+	uint64_t _max;
+	uint64_t _total;
+};
+
+#endif /* TEST_TEST_H_ */
+
+//////// End
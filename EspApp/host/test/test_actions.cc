@@ -0,0 +1,151 @@
+/*
+ * test_actions.cc - actions of main_Task notified by ISRs and tasks at same time (firmware with battery)
+ * An ISR (task of priority above main_Task) notifies each action twice in a row (the second is coalesced),
+ * and a task (priority below main_Task) notifies the same actions, in the same ticks
+ * No notification can be lost: all are processed, and the runs and coalesced add up (mainActionStats)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+
+#include "main.h"
+
+#include "test.h"
+
+////// Firmware
+
+extern "C" void app_main();
+
+////// Definitions
+
+#define ACTIONS_ROUNDS 				500
+
+////// Variables
+
+// Actions notified (not standby)
+
+static const uint32_t mActions[] = { MAIN_TASK_ACTION_RESET_TIMER, MAIN_TASK_ACTION_SEN_VEXT };
+
+#define ACTIONS_COUNT 				(sizeof(mActions) / sizeof(mActions[0]))
+
+static uint32_t mFired[ACTIONS_COUNT];			// Notifications by action
+static uint8_t mDone = 0;						// Tasks done
+
+////// Routines
+
+/**
+ * @brief Task as ISR (priority above main_Task) - each action twice in a row
+ */
+static void isrTask(void* arg) {
+
+	for (uint32_t round = 0; round < ACTIONS_ROUNDS; round++) {
+
+		uint8_t index = (round % ACTIONS_COUNT);
+
+		notifyMainTask(mActions[index], true);
+		notifyMainTask(mActions[index], true);
+
+		mFired[index] += 2;
+
+		vTaskDelay(1);
+	}
+
+	mDone++;
+
+	vTaskDelete(NULL);
+}
+
+/**
+ * @brief Task (priority below main_Task) - the actions in reverse order of ISR, in the same ticks
+ */
+static void notifierTask(void* arg) {
+
+	for (uint32_t round = 0; round < ACTIONS_ROUNDS; round++) {
+
+		uint8_t index = ((round + 1) % ACTIONS_COUNT);
+
+		notifyMainTask(mActions[index]);
+
+		mFired[index]++;
+
+		vTaskDelay(1);
+	}
+
+	mDone++;
+
+	vTaskDelete(NULL);
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void actionsMain(void* arg) {
+
+	app_main();
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	MainActionStats_t before[ACTIONS_COUNT];
+
+	for (uint8_t i = 0; i < ACTIONS_COUNT; i++) {
+		before[i] = mainActionStats(mActions[i]);
+	}
+
+	xTaskCreatePinnedToCore(&isrTask, "isr", 4096, NULL, TASK_PRIOR_HIGH + 5, NULL, 0);
+	xTaskCreatePinnedToCore(&notifierTask, "notifier", 4096, NULL, 1, NULL, 0);
+
+	for (uint16_t i = 0; i < 100 && mDone < 2; i++) {
+		vTaskDelay(pdMS_TO_TICKS(100));
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	TEST_CHECK(mDone == 2);
+
+	for (uint8_t i = 0; i < ACTIONS_COUNT; i++) {
+
+		MainActionStats_t stats = mainActionStats(mActions[i]);
+
+		uint32_t notified = (stats.notified - before[i].notified);
+		uint32_t processed = (stats.processed - before[i].processed);
+		uint32_t runs = (stats.runs - before[i].runs);
+		uint32_t coalesced = (stats.coalesced - before[i].coalesced);
+
+		printf("test_actions: action %u - fired %u, notified %u, processed %u, runs %u, coalesced %u\n",
+					mActions[i], mFired[i], notified, processed, runs, coalesced);
+
+		TEST_CHECK(notified == mFired[i]);
+		TEST_CHECK(processed == notified);
+		TEST_CHECK((runs + coalesced) == processed);
+		TEST_CHECK(runs > 0 && coalesced > 0);
+	}
+
+	// Invalid action
+
+	MainActionStats_t none = mainActionStats(MAIN_TASK_ACTION_NONE);
+
+	TEST_CHECK(none.notified == 0 && none.runs == 0);
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simLogLevel(ESP_LOG_ERROR);
+
+	simRun(actionsMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_actions");
+}
+
+//////// End
@@ -0,0 +1,193 @@
+/*
+ * test_adc.cc - the readings of ADC and the chain of filters of VBAT (firmware with battery)
+ * Built twice: readings in adcRead (default) and sampling in background (ADC_SAMPLING_RATE - test_adc_sampling)
+ * Synthetic samples injected by adcSetSource: the rate of sampling, the value constant, spikes (removed by
+ * median), noise smaller than the hysteresis (value not oscillate), a step (EMA converges) and the snapshot
+ * (not published before the channels have values)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+
+#include "peripherals.h"
+
+#include "test.h"
+
+////// Firmware
+
+extern "C" void app_main();
+
+////// Definitions
+
+#define ADC_VALUE_LOW 				2000
+#define ADC_VALUE_HIGH 				3000
+#define ADC_VALUE_SPIKE 			4095
+
+// Samples by second - bursts of timer, or a burst by adcRead (each second, by main_Task)
+
+#ifdef ADC_SAMPLING_RATE
+	#define ADC_TEST_RATE 			(ADC_SAMPLING_RATE * ADC_SAMPLING_BURST)
+	#define ADC_TEST_BURST 			ADC_SAMPLING_BURST
+#else
+	#define ADC_TEST_RATE 			ADC_READINGS
+	#define ADC_TEST_BURST 			ADC_READINGS
+#endif
+
+#define ADC_TEST_SETTLE 			((100000 / ADC_TEST_RATE) + 1000)	// Time to EMA converges (about 100 samples)
+
+////// Variables
+
+static uint16_t mInput = ADC_VALUE_LOW;			// Value of samples
+static uint8_t mSpikeEach = 0;					// A spike each n samples (0 - none)
+static uint8_t mNoise = 0;						// Noise (+- value, alternated)
+
+static uint32_t mSamples = 0;					// Samples readed (by timer of sampling)
+static uint32_t mOtherChannels = 0;				// Samples of another channel
+
+////// Routines
+
+/**
+ * @brief Source of samples (runs in task of esp_timer)
+ */
+static uint16_t adcSource(adc1_channel_t channel) {
+
+	if (channel != ADC_SENSOR_VBAT) {
+		mOtherChannels++;
+		return 0;
+	}
+
+	mSamples++;
+
+	if (mSpikeEach > 0 && (mSamples % mSpikeEach) == 0) {
+		return ADC_VALUE_SPIKE;
+	}
+
+	if (mNoise > 0) {
+		return (mSamples & 1) ? (mInput + mNoise) : (mInput - mNoise);
+	}
+
+	return mInput;
+}
+
+/**
+ * @brief Wait (virtual time) and returns the samples readed in this time
+ */
+static uint32_t wait(uint32_t millis) {
+
+	uint32_t samples = mSamples;
+
+	vTaskDelay(pdMS_TO_TICKS(millis));
+
+	return (mSamples - samples);
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void adcMain(void* arg) {
+
+	adcSetSource(adcSource);
+
+	app_main();
+
+	// No values before the first output of chains (snapshot not published)
+
+	AdcValues_t values;
+
+	adcValues(values);
+
+	TEST_CHECK(values.time == 0 && values.values[ADC_INDEX_VBAT] == 0);
+
+	// Value constant - the rate of sampling and the value
+
+	uint32_t samples = wait(5000);
+
+	if (!TEST_CHECK(samples >= (5 * ADC_TEST_RATE) - ADC_TEST_BURST && samples <= (5 * ADC_TEST_RATE) + ADC_TEST_BURST)) {
+		printf("test_adc: samples in 5 seconds %u\n", samples);
+	}
+
+	TEST_CHECK(mOtherChannels == 0);
+	TEST_CHECK(adcValue(ADC_INDEX_VBAT) == ADC_VALUE_LOW);
+
+	adcValues(values);
+
+	TEST_CHECK(values.values[ADC_INDEX_VBAT] == ADC_VALUE_LOW);
+	TEST_CHECK(values.time > 0 && ((uint32_t) (simTime() / 1000) - values.time) <= 1000);
+
+	// Spikes (less than half of window of median) - removed
+
+	mSpikeEach = 5;
+
+	wait(5000);
+
+	TEST_CHECK(adcValue(ADC_INDEX_VBAT) == ADC_VALUE_LOW);
+
+	mSpikeEach = 0;
+
+	// Noise smaller than the hysteresis - the value not oscillate
+
+	mNoise = 2;
+
+	uint32_t changes = 0;
+	uint16_t last = adcValue(ADC_INDEX_VBAT);
+
+	for (uint8_t i = 0; i < 20; i++) {
+
+		wait(500);
+
+		uint16_t value = adcValue(ADC_INDEX_VBAT);
+
+		changes += (value != last);
+		last = value;
+	}
+
+	TEST_CHECK(changes == 0 && last == ADC_VALUE_LOW);
+
+	mNoise = 0;
+
+	// Step - the EMA converges to the new value
+
+	mInput = ADC_VALUE_HIGH;
+
+	wait(2000);
+
+	uint16_t middle = adcValue(ADC_INDEX_VBAT);
+
+	TEST_CHECK(middle > ADC_VALUE_LOW && middle < ADC_VALUE_HIGH);
+
+	wait(ADC_TEST_SETTLE);
+
+	uint16_t value = adcValue(ADC_INDEX_VBAT);
+
+	if (!TEST_CHECK(value <= ADC_VALUE_HIGH && (ADC_VALUE_HIGH - value) <= 10)) {
+		printf("test_adc: value after step %u (2 seconds: %u)\n", value, middle);
+	}
+
+	// Invalid index
+
+	TEST_CHECK(adcValue(ADC_CHANNELS) == 0);
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simLogLevel(ESP_LOG_ERROR);
+
+	simRun(adcMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_adc");
+}
+
+//////// End
@@ -0,0 +1,242 @@
+/*
+ * test_coalescing.cc - simulation of coalescing of messages sended (BleServer::setCoalescing)
+ * The same workload (bursts of small messages, as 80:, 10:EXT and errors) is sended without and with
+ * coalescing, by the simulated link. The urgent messages (70:) is flushed
+ * Reports the packets (notifications) saved and the latency of messages (send -> client) of each mode
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+#include "sim_link.h"
+
+#include "util/ble_server.h"
+
+#include "test.h"
+
+////// Definitions
+
+#define COALESCING_DEADLINE 		20			// Maximum time to wait more messages (millis)
+#define COALESCING_BURSTS 			300			// Bursts of messages
+#define COALESCING_MESSAGES_MAX 	(COALESCING_BURSTS * 6)
+
+////// Types
+
+typedef struct {
+	uint32_t notifications;		// Notifications received by client
+	uint32_t messages;			// Messages (lines) received
+	uint32_t coalesced;			// Parts joined (statistics of server)
+	uint32_t coalescedDelay;	// Maximum delay added (statistics of server)
+	TestLatency latency;		// Send -> received by client (micros)
+	TestLatency urgent;			// The same, only of urgent messages (flushed)
+} CoalescingResult_t;
+
+////// Variables
+
+static uint64_t mSent[COALESCING_MESSAGES_MAX];	// Time of sending of each message (by sequence)
+static bool mUrgent[COALESCING_MESSAGES_MAX];	// Is urgent ?
+
+static CoalescingResult_t mResults[2];			// Without and with coalescing
+static CoalescingResult_t* mResult = NULL;		// Actual
+
+static char mLine[128];							// Line received (joined)
+static uint16_t mLineSize = 0;
+
+static uint32_t mInvalid = 0;					// Lines invalid
+
+////// Server
+
+class TestCallbacks: public BleServerCallbacks {
+
+	void onConnect() {}
+	void onDisconnect() {}
+	void onReceive(const char* message, uint16_t size) {}
+};
+
+static BleServer mServer;
+static TestCallbacks mCallbacks;
+
+////// Routines
+
+/**
+ * @brief Data received by client - the sequence is the last field of message
+ */
+static void clientReceive(const char* data, uint16_t size) {
+
+	mResult->notifications++;
+
+	for (uint16_t i = 0; i < size; i++) {
+
+		if (data[i] != '\n') {
+
+			if (mLineSize < (sizeof(mLine) - 1)) {
+				mLine[mLineSize++] = data[i];
+			}
+			continue;
+		}
+
+		mLine[mLineSize] = '\0';
+
+		const char* field = strrchr(mLine, ':');
+		uint32_t seq = (field != NULL) ? atoi(field + 1) : COALESCING_MESSAGES_MAX;
+
+		if (seq < COALESCING_MESSAGES_MAX) {
+
+			uint64_t latency = simTime() - mSent[seq];
+
+			mResult->latency.add(latency);
+
+			if (mUrgent[seq]) {
+				mResult->urgent.add(latency);
+			}
+
+			mResult->messages++;
+
+		} else {
+
+			mInvalid++;
+		}
+
+		mLineSize = 0;
+	}
+}
+
+/**
+ * @brief Send a message (with the sequence in last field)
+ */
+static void send(const char* format, uint32_t& seq, bool urgent) {
+
+	char message[64];
+
+	snprintf(message, sizeof(message), format, seq);
+
+	mSent[seq] = simTime();
+	mUrgent[seq] = urgent;
+
+	mServer.send(message, strlen(message), urgent);
+
+	seq++;
+}
+
+/**
+ * @brief Workload - bursts of small messages (some of them is urgent)
+ */
+static void workload(uint8_t mode) {
+
+	mResult = &mResults[mode];
+
+	mServer.setCoalescing((mode == 1) ? COALESCING_DEADLINE : 0);
+
+	BleSendStats_t start = mServer.getSendStats();
+
+	uint32_t seq = 0;
+
+	for (uint16_t burst = 0; burst < COALESCING_BURSTS; burst++) {
+
+		send("80:%u", seq, false);
+		send("10:EXT:Y:1234:%u", seq, false);
+
+		if ((burst % 3) == 0) {
+			send("-1:Invalid message code:%u", seq, false);
+		}
+
+		if ((burst % 5) == 0) {
+			send("70:echo:%u", seq, true); // Urgent - flush
+		}
+
+		// A message some time after (in the deadline, or not)
+
+		vTaskDelay(pdMS_TO_TICKS(10 * (burst % 4)));
+
+		send("11:FMEM:187432:%u", seq, false);
+
+		// Next burst
+
+		vTaskDelay(pdMS_TO_TICKS(200));
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	BleSendStats_t stats = mServer.getSendStats();
+
+	mResult->coalesced = (stats.coalesced - start.coalesced);
+	mResult->coalescedDelay = stats.coalescedDelay;
+
+	TEST_CHECK(mResult->messages == seq);
+}
+
+/**
+ * @brief Main of simulation
+ */
+static void coalescingMain(void* arg) {
+
+	mServer.setTransport(&bleTransportLoopback);
+	mServer.initialize("test", &mCallbacks);
+
+	SimLinkConfig_t config = { 100, 30000, 6, SIM_LINK_BUFFERS_MAX };
+
+	simLinkStart(config, clientReceive);
+
+	simLinkConnect();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	workload(0);
+	workload(1);
+
+	simLinkDisconnect();
+
+	vTaskDelay(pdMS_TO_TICKS(100));
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simRun(coalescingMain, NULL, true);
+
+	static const char* names[2] = { "without", "with" };
+
+	for (uint8_t mode = 0; mode < 2; mode++) {
+
+		const CoalescingResult_t& result = mResults[mode];
+
+		printf("test_coalescing: %-7s messages %u notifications %u coalesced %u (max delay %u ms), " \
+					"latency (us) p50 %llu p99 %llu max %llu, urgent p50 %llu max %llu\n",
+					names[mode], result.messages, result.notifications, result.coalesced, result.coalescedDelay,
+					(unsigned long long) result.latency.percentile(500), (unsigned long long) result.latency.percentile(990),
+					(unsigned long long) result.latency.max(),
+					(unsigned long long) result.urgent.percentile(500), (unsigned long long) result.urgent.max());
+	}
+
+	const CoalescingResult_t& without = mResults[0];
+	const CoalescingResult_t& with = mResults[1];
+
+	printf("test_coalescing: packets saved %u (%.0f%%), latency added (us) p50 %lld p99 %lld\n",
+				without.notifications - with.notifications,
+				100.0 * (without.notifications - with.notifications) / without.notifications,
+				(long long) with.latency.percentile(500) - (long long) without.latency.percentile(500),
+				(long long) with.latency.percentile(990) - (long long) without.latency.percentile(990));
+
+	// Checks
+
+	TEST_CHECK(simExitReason() == NULL);
+	TEST_CHECK(mInvalid == 0);
+	TEST_CHECK(without.coalesced == 0 && without.notifications == without.messages);
+	TEST_CHECK(with.coalesced > 0 && with.notifications == (with.messages - with.coalesced));
+	TEST_CHECK(with.coalescedDelay <= COALESCING_DEADLINE + 10);
+	TEST_CHECK(with.latency.max() <= without.latency.max() + (COALESCING_DEADLINE + 10) * 1000u);
+	TEST_CHECK(with.urgent.max() <= without.urgent.max() + (COALESCING_DEADLINE + 10) * 1000u);
+
+	return testResult("test_coalescing");
+}
+
+//////// End
@@ -0,0 +1,151 @@
+/*
+ * test_congestion.cc - congestion of BLE stack, signaled by the simulated link (buffers full)
+ * With few buffers of notifications, the link is congested many times: the send task of BleServer
+ * must wait (not lose notifications), and continue when the buffers is freed by connection events
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+#include "sim_link.h"
+
+#include "ble_server.h"
+
+#include "test.h"
+
+////// Firmware
+
+extern "C" void app_main();
+
+extern void bleSendData(const char* data, uint16_t size);
+extern BleSendStats_t bleSendStats();
+
+////// Definitions
+
+#define CONGESTION_MESSAGES 		100
+#define CONGESTION_SIZE 			50				// Size of messages (3 packets of MTU 20, with new line)
+
+////// Variables
+
+static uint32_t mBytes = 0;						// Bytes received by client
+static uint32_t mLines = 0;						// Lines received by client
+static uint32_t mMismatches = 0;				// Lines wrong
+
+static char mLine[128];
+static uint16_t mLineSize = 0;
+
+////// Routines
+
+/**
+ * @brief Message of sequence
+ */
+static void message(uint32_t seq, char* data) {
+
+	uint16_t size = snprintf(data, CONGESTION_SIZE + 1, "70:%05u:", seq);
+
+	for (uint16_t i = size; i < CONGESTION_SIZE; i++) {
+		data[i] = 'a' + ((seq + i) % 26);
+	}
+}
+
+/**
+ * @brief Data received by client - the lines must be in sequence and intact
+ */
+static void clientReceive(const char* data, uint16_t size) {
+
+	mBytes += size;
+
+	for (uint16_t i = 0; i < size; i++) {
+
+		if (data[i] != '\n') {
+			if (mLineSize < sizeof(mLine)) {
+				mLine[mLineSize++] = data[i];
+			}
+			continue;
+		}
+
+		char expected[CONGESTION_SIZE + 1];
+
+		message(mLines, expected);
+
+		if (mLineSize != CONGESTION_SIZE || memcmp(mLine, expected, CONGESTION_SIZE) != 0) {
+			mMismatches++;
+		}
+
+		mLines++;
+		mLineSize = 0;
+	}
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void congestionMain(void* arg) {
+
+	app_main();
+
+	// Link: MTU of 20, only 4 buffers of notifications, 2 by connection event
+
+	SimLinkConfig_t config = { 20, 30000, 2, 4 };
+
+	simLinkStart(config, clientReceive);
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	simLinkConnect();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	BleSendStats_t before = bleSendStats();
+
+	char data[CONGESTION_SIZE + 1];
+
+	for (uint32_t seq = 0; seq < CONGESTION_MESSAGES; seq++) {
+
+		message(seq, data);
+
+		bleSendData(data, CONGESTION_SIZE);
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(10000));
+
+	BleSendStats_t after = bleSendStats();
+
+	const SimLinkStats_t& link = simLinkStats();
+
+	printf("test_congestion: lines %u, bytes %u, link congestions %u, lost %u, server congestions %u (%u ms), dropped %u\n",
+				mLines, mBytes, link.congestions, link.lost,
+				after.congestions - before.congestions, after.congestedTime - before.congestedTime,
+				after.dropped - before.dropped);
+
+	TEST_CHECK(link.congestions > 0);
+	TEST_CHECK(link.lost == 0);
+	TEST_CHECK((after.congestions - before.congestions) == link.congestions);
+	TEST_CHECK((after.dropped - before.dropped) == 0);
+	TEST_CHECK(mLines == CONGESTION_MESSAGES);
+	TEST_CHECK(mMismatches == 0);
+
+	simLinkDisconnect();
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simLogLevel(ESP_LOG_ERROR);
+
+	simRun(congestionMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_congestion");
+}
+
+//////// End
@@ -0,0 +1,195 @@
+/*
+ * test_events.cc - events of connection and MTU of BleServer, with the queue of events idle and full of lines
+ * The changes of state is never lost (kept in flags, with a slot reserved in queue): the callbacks of
+ * connection alternates, the last is the state of transport, and the lines received before is processed before
+ * Reports the latency of events (from the callback of transport to the callback of server)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+
+#include "util/ble_server.h"
+
+#include "test.h"
+
+////// Definitions
+
+#define EVENTS_HANDLER_TIME 		100			// Time of handler of lines (millis)
+#define EVENTS_CYCLES 				4			// Cycles of disconnection and connection (queue full)
+#define EVENTS_MAX 					32
+
+////// Variables
+
+static char mEvents[EVENTS_MAX + 1];			// Callbacks of connection, in order (C - connect, D - disconnect)
+static uint8_t mEventsCount = 0;
+
+static uint64_t mEventTime = 0;					// Time of last callback of connection (micros)
+
+static uint32_t mLines = 0;						// Lines processed
+static uint32_t mLinesAtEvent = 0;				// Lines processed before the first callback of connection
+
+////// Server
+
+class TestCallbacks: public BleServerCallbacks {
+
+	void onConnect() {
+		event('C');
+	}
+
+	void onDisconnect() {
+		event('D');
+	}
+
+	void onReceive(const char* message, uint16_t size) {
+
+		mLines++;
+
+		vTaskDelay(pdMS_TO_TICKS(EVENTS_HANDLER_TIME));
+	}
+
+	void event(char type) {
+
+		if (mEventsCount == 0) {
+			mLinesAtEvent = mLines;
+		}
+
+		if (mEventsCount < EVENTS_MAX) {
+			mEvents[mEventsCount++] = type;
+		}
+
+		mEventTime = simTime();
+	}
+};
+
+static BleServer mServer;
+static TestCallbacks mCallbacks;
+
+////// Routines
+
+/**
+ * @brief Clear the callbacks recorded
+ */
+static void clearEvents() {
+
+	memset(mEvents, 0, sizeof(mEvents));
+	mEventsCount = 0;
+}
+
+/**
+ * @brief Callbacks alternated (never two equal in sequence), starting with first
+ */
+static bool alternated(char first) {
+
+	for (uint8_t i = 0; i < mEventsCount; i++) {
+		if (mEvents[i] != (((i % 2) == 0) ? first : ((first == 'C') ? 'D' : 'C'))) {
+			return false;
+		}
+	}
+
+	return (mEventsCount > 0);
+}
+
+/**
+ * @brief Main of simulation
+ */
+static void eventsMain(void* arg) {
+
+	mServer.setTransport(&bleTransportLoopback);
+	mServer.initialize("test", &mCallbacks);
+
+	vTaskDelay(pdMS_TO_TICKS(100));
+
+	// Idle - connection
+
+	clearEvents();
+
+	uint64_t start = simTime();
+
+	ble_loopback_Connect(100);
+
+	vTaskDelay(pdMS_TO_TICKS(100));
+
+	uint64_t idle = (mEventTime - start);
+
+	TEST_CHECK(mServer.connected());
+	TEST_CHECK(strcmp(mEvents, "C") == 0);
+
+	// Queue full of lines - cycles of disconnection and connection (with MTU), more than the space in queue
+
+	clearEvents();
+
+	mLines = 0;
+
+	for (uint8_t i = 0; i < BLE_SIZE_QUEUE_RECV; i++) {
+
+		char line[16];
+
+		uint16_t size = snprintf(line, sizeof(line), "43:%u\n", i);
+
+		TEST_CHECK(ble_loopback_Write(line, size) == ESP_OK);
+	}
+
+	for (uint8_t i = 0; i < EVENTS_CYCLES; i++) {
+		ble_loopback_Disconnect();
+		ble_loopback_Connect(100);
+	}
+
+	ble_loopback_Disconnect();
+
+	start = simTime();
+
+	vTaskDelay(pdMS_TO_TICKS((BLE_SIZE_QUEUE_RECV + 2) * EVENTS_HANDLER_TIME));
+
+	uint64_t loaded = (mEventTime - start);
+
+	printf("test_events: idle - latency %llu us, queue full - latency %llu us, lines %u (before the events %u), events %s\n",
+				(unsigned long long) idle, (unsigned long long) loaded, mLines, mLinesAtEvent, mEvents);
+
+	printf("{\"test\":\"events\",\"idle_us\":%llu,\"loaded_us\":%llu,\"events\":%u}\n",
+				(unsigned long long) idle, (unsigned long long) loaded, mEventsCount);
+
+	// Not lost - alternated, and the last is the state of transport (disconnected)
+
+	TEST_CHECK(alternated('D') && mEvents[mEventsCount - 1] == 'D');
+	TEST_CHECK(!mServer.connected());
+
+	// Order - the lines received before is processed before
+
+	TEST_CHECK(mLines == BLE_SIZE_QUEUE_RECV && mLinesAtEvent == BLE_SIZE_QUEUE_RECV);
+
+	// Idle - connection again
+
+	clearEvents();
+
+	ble_loopback_Connect(100);
+
+	vTaskDelay(pdMS_TO_TICKS(100));
+
+	TEST_CHECK(mServer.connected());
+	TEST_CHECK(strcmp(mEvents, "C") == 0);
+
+	ble_loopback_Disconnect();
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simLogLevel(ESP_LOG_ERROR);
+
+	simRun(eventsMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_events");
+}
+
+//////// End
@@ -0,0 +1,210 @@
+/*
+ * test_fields.cc - FieldsView and Fields parsed by several threads at same time (each instance have your storage)
+ * Each thread parses your messages (with the thread and sequence in fields) and checks all fields,
+ * no result can be lost or mixed with the messages of another thread
+ * The Fields of a message is kept while the thread yields and parses the next one (other instance),
+ * so a storage shared by instances (as the static vector of Fields 0.1.0) is detected
+ * Unit: empty fields, more fields than FIELDS_MAX (parse failure) and Fields (copy of string)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "util/fields.h"
+
+#include "test.h"
+
+using namespace std;
+
+////// Definitions
+
+#define FIELDS_THREADS 				8
+#define FIELDS_MESSAGES 			50000
+
+////// Variables
+
+static std::atomic<uint32_t> mParsed(0);		// Messages parsed ok
+static std::atomic<uint32_t> mErrors(0);		// Messages with wrong fields
+static std::atomic<uint32_t> mErrorsCopy(0);	// Messages with wrong fields (Fields)
+
+////// Routines
+
+/**
+ * @brief Message of thread and sequence - code, thread, sequence, char, float and a text (the size changes)
+ */
+static uint16_t message(char* buffer, uint16_t size, uint32_t thread, uint32_t seq) {
+
+	return snprintf(buffer, size, "70:%u:%u:%c:%u.5:%.*s",
+						thread, seq, 'A' + (seq % 26), seq % 1000,
+						(int) (seq % 40), "abcdefghijklmnopqrstuvwxyz0123456789ABCD");
+}
+
+/**
+ * @brief Fields of a message is of thread and sequence ?
+ */
+static bool checkFields(Fields& fields, uint32_t thread, uint32_t seq) {
+
+	return (fields.valid() &&
+			fields.size() == ((seq % 40) ? 6 : 5) &&
+			fields.getInt(1) == 70 &&
+			fields.getInt(2) == (int32_t) thread &&
+			fields.getInt(3) == (int32_t) seq &&
+			fields.getChar(4) == (char) ('A' + (seq % 26)) &&
+			fields.getFloat(5) == (float) (seq % 1000) + 0.5f &&
+			fields.getString(6).size() == (seq % 40));
+}
+
+/**
+ * @brief Thread - parses the messages of this thread by Fields, each one kept until the next is parsed
+ */
+static void parserCopy(uint32_t thread) {
+
+	char buffer[96];
+
+	message(buffer, sizeof(buffer), thread, 0);
+
+	Fields* previous = new Fields(buffer);
+
+	for (uint32_t seq = 1; seq < FIELDS_MESSAGES; seq++) {
+
+		message(buffer, sizeof(buffer), thread, seq);
+
+		Fields* fields = new Fields(buffer);
+
+		memset(buffer, 0, sizeof(buffer)); // Fields have your copy
+
+		std::this_thread::yield(); // Other threads parses in this time
+
+		// The previous is not changed by this parsing, or of other threads
+
+		mErrorsCopy += !checkFields(*previous, thread, seq - 1);
+		mErrorsCopy += !checkFields(*fields, thread, seq);
+
+		delete previous;
+		previous = fields;
+	}
+
+	delete previous;
+}
+
+/**
+ * @brief Thread - parses messages of this thread
+ */
+static void parser(uint32_t thread) {
+
+	char message[96];
+
+	for (uint32_t seq = 0; seq < FIELDS_MESSAGES; seq++) {
+
+		uint16_t size = ::message(message, sizeof(message), thread, seq);
+
+		FieldsView fields(message, size, ':');
+
+		// Yield sometimes, to mix the parsing of threads
+
+		if ((seq % 64) == 0) {
+			std::this_thread::yield();
+		}
+
+		bool ok = (fields.size() == ((seq % 40) ? 6 : 5)) &&
+					fields.getInt(1) == 70 &&
+					fields.getInt(2) == (int32_t) thread &&
+					fields.getInt(3) == (int32_t) seq &&
+					fields.getChar(4) == (char) ('A' + (seq % 26)) &&
+					fields.getFloat(5) == (float) (seq % 1000) + 0.5f &&
+					fields.getString(6).size() == (seq % 40);
+
+		if (ok) {
+			mParsed++;
+		} else {
+			mErrors++;
+		}
+	}
+}
+
+////// Main
+
+int main() {
+
+	std::thread threads[FIELDS_THREADS];
+
+	for (uint32_t i = 0; i < FIELDS_THREADS; i++) {
+		threads[i] = std::thread(parser, i);
+	}
+
+	for (uint32_t i = 0; i < FIELDS_THREADS; i++) {
+		threads[i].join();
+	}
+
+	printf("test_fields: %u threads, %u messages parsed, %u errors\n",
+				FIELDS_THREADS, (uint32_t) mParsed, (uint32_t) mErrors);
+
+	TEST_CHECK(mErrors == 0);
+	TEST_CHECK(mParsed == (FIELDS_THREADS * FIELDS_MESSAGES));
+
+	// Fields (copy of string) by several threads
+
+	for (uint32_t i = 0; i < FIELDS_THREADS; i++) {
+		threads[i] = std::thread(parserCopy, i);
+	}
+
+	for (uint32_t i = 0; i < FIELDS_THREADS; i++) {
+		threads[i].join();
+	}
+
+	printf("test_fields: %u threads, Fields - %u errors\n", FIELDS_THREADS, (uint32_t) mErrorsCopy);
+
+	TEST_CHECK(mErrorsCopy == 0);
+
+	// Empty fields are ignored, and the maximum of fields
+
+	const char* empty = "11::BLE::";
+	FieldsView fieldsEmpty(empty, strlen(empty), ':');
+
+	TEST_CHECK(fieldsEmpty.size() == 2);
+	TEST_CHECK(fieldsEmpty.getString(2) == "BLE");
+	TEST_CHECK(fieldsEmpty.getString(3).empty());
+
+	// More fields than FIELDS_MAX - parse failure (valid), and FIELDS_MAX is valid
+
+	string line = "70";
+
+	for (uint8_t i = 1; i < FIELDS_MAX; i++) {
+		line += ":" + to_string(i);
+	}
+
+	FieldsView fieldsMax(line.c_str(), line.size(), ':');
+
+	TEST_CHECK(fieldsMax.valid() && fieldsMax.size() == FIELDS_MAX);
+
+	line += ":98";
+
+	FieldsView fieldsOver(line.c_str(), line.size(), ':');
+
+	TEST_CHECK(!fieldsOver.valid() && fieldsOver.size() == FIELDS_MAX);
+
+	// Fields (copy of string) - the same of FieldsView, and valid after the string is changed
+
+	string text = "70:42:x:1.5:abc";
+
+	Fields fields(text);
+
+	text = "changed";
+
+	TEST_CHECK(fields.valid() && fields.size() == 5);
+	TEST_CHECK(fields.getInt(2) == 42 && fields.getChar(3) == 'x' && fields.getFloat(4) == 1.5f);
+	TEST_CHECK(fields.getString(5) == "abc" && fields.getString(6) == "" && !fields.isNum(5));
+
+	Fields fieldsOverCopy(line);
+
+	TEST_CHECK(!fieldsOverCopy.valid());
+
+	return testResult("test_fields");
+}
+
+//////// End
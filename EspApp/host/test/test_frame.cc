@@ -0,0 +1,449 @@
+/*
+ * test_frame.cc - unit tests of binary frames (util/ble_frame) - encoder and decoder
+ * Frames of text splitted in any parts, CRC, frames larger than buffer, frames of values,
+ * and the binary mode of firmware by the simulated link (01:BINC, and 11 responses as frames of values)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+
+#include "sim.h"
+#include "sim_link.h"
+
+#include "util/ble_frame.h"
+
+#include "frame_reader.h"
+#include "test.h"
+
+////// Firmware
+
+extern "C" void app_main();
+
+////// Definitions
+
+#define FRAME_BUFFER_SIZE 			1024
+
+////// Variables
+
+// Client of simulated link
+
+static bool mClientBinary = false;				// Binary mode (after response of 01)
+
+static uint8_t mClientData[FRAME_BUFFER_SIZE];	// Data received (not processed)
+static uint16_t mClientSize = 0;
+
+static char mClientLine[200];					// Response of 01 (text)
+
+static uint32_t mValuesBle = 0;					// Frames of values received (11:BLE, 11:FMEM)
+static uint32_t mValuesFmem = 0;
+static uint32_t mEchoes = 0;					// Echo received (text in frame)
+static uint32_t mInvalid = 0;					// Frames invalid or not expected
+
+////// Unit tests
+
+/**
+ * @brief Decode a data by parts of size (returns the number of frames decoded, message is the last)
+ */
+static uint8_t decodeParts(BleFrameDecoder& decoder, const uint8_t* data, uint16_t size, uint16_t part,
+							char* message, uint16_t& sizeMessage) {
+
+	uint8_t frames = 0;
+
+	for (uint16_t pos = 0; pos < size; pos += part) {
+
+		uint16_t sizePart = ((size - pos) < part) ? (size - pos) : part;
+
+		const uint8_t* next = data + pos;
+
+		while (sizePart > 0) {
+
+			bool complete;
+
+			uint16_t used = decoder.feed(next, sizePart, complete);
+
+			if (complete) {
+				memcpy(message, decoder.message(), decoder.messageSize() + 1);
+				sizeMessage = decoder.messageSize();
+				frames++;
+			}
+
+			next += used;
+			sizePart -= used;
+		}
+	}
+
+	return frames;
+}
+
+/**
+ * @brief Frames of text - encode and decode, in all sizes of parts, with and without CRC
+ */
+static void testText() {
+
+	static const char* lines[] = {
+		"01:BINC",
+		"80:",
+		"-1:Invalid message code",
+		"70:42:The quick brown fox jumps over the lazy dog, the quick brown fox jumps over the lazy dog " \
+			"the quick brown fox jumps over the lazy dog - payload with 2 bytes of length (varint)",
+	};
+
+	for (uint8_t crc = 0; crc < 2; crc++) {
+
+		for (uint8_t i = 0; i < (sizeof(lines) / sizeof(lines[0])); i++) {
+
+			uint8_t frame[BLE_FRAME_MSG_MAX_SIZE + BLE_FRAME_OVERHEAD_MAX];
+
+			uint16_t size = bleFrameEncodeLine(lines[i], strlen(lines[i]), crc, frame, sizeof(frame));
+
+			TEST_CHECK(size > 0);
+			TEST_CHECK(size == strlen(lines[i]) - 3 + 1 + ((strlen(lines[i]) - 3) < 128 ? 1 : 2) + ((crc) ? 2 : 0));
+
+			for (uint16_t part = 1; part <= size; part++) {
+
+				BleFrameDecoder decoder;
+
+				decoder.setCrc(crc);
+
+				char message[BLE_FRAME_MSG_MAX_SIZE + 1];
+				uint16_t sizeMessage = 0;
+
+				TEST_CHECK(decodeParts(decoder, frame, size, part, message, sizeMessage) == 1);
+				TEST_CHECK(sizeMessage == strlen(lines[i]) && strcmp(message, lines[i]) == 0);
+				TEST_CHECK(decoder.errors() == 0 && !decoder.pending());
+			}
+		}
+	}
+
+	// Invalid lines to encode
+
+	uint8_t frame[64];
+
+	TEST_CHECK(bleFrameEncodeLine("abc", 3, false, frame, sizeof(frame)) == 0);
+	TEST_CHECK(bleFrameEncodeLine("00:x", 4, false, frame, sizeof(frame)) == 0);
+	TEST_CHECK(bleFrameEncodeLine("100:x", 5, false, frame, sizeof(frame)) == 0);
+	TEST_CHECK(bleFrameEncodeLine("70:0123456789", 13, false, frame, 10) == 0); // No space
+}
+
+/**
+ * @brief Payload of a frame rejected - looks like frames (98: - restart), that must not be decoded
+ */
+static uint16_t rejectedPayload(uint8_t* data, uint16_t size) {
+
+	for (uint16_t i = 0; i < size; i++) {
+		data[i] = ((i & 1) == 0) ? 98 : 0x00;
+	}
+
+	return size;
+}
+
+/**
+ * @brief Errors - CRC wrong, length larger than buffer, invalid codes (the next frame must be decoded)
+ * The frames rejected by length are sended complete, with payloads that looks like frames
+ */
+static void testErrors() {
+
+	uint8_t data[BLE_FRAME_MSG_MAX_SIZE + 64];
+	uint16_t size = 0;
+
+	// CRC wrong
+
+	size += bleFrameEncodeLine("80:", 3, true, data + size, sizeof(data) - size);
+	data[size - 1] ^= 0x01;
+
+	// Length larger than buffer (header, payload and CRC)
+
+	data[size++] = 70;
+	data[size++] = 0x80 | ((BLE_FRAME_MSG_MAX_SIZE) & 0x7F);
+	data[size++] = ((BLE_FRAME_MSG_MAX_SIZE) >> 7);
+
+	size += rejectedPayload(data + size, BLE_FRAME_MSG_MAX_SIZE);
+
+	data[size++] = 98;
+	data[size++] = 0x00;
+
+	// Invalid codes (0 and frame of values)
+
+	data[size++] = 0;
+	data[size++] = (11 | BLE_FRAME_VALUES);
+
+	// Varint too long (length of 4 in 4 bytes), with payload and CRC
+
+	data[size++] = 70;
+	data[size++] = 0x84;
+	data[size++] = 0x80;
+	data[size++] = 0x80;
+	data[size++] = 0x00;
+
+	size += rejectedPayload(data + size, 4);
+
+	data[size++] = 98;
+	data[size++] = 0x00;
+
+	// Not a varint (no end in 32 bits) - nothing to discard
+
+	data[size++] = 70;
+
+	for (uint8_t i = 0; i < BLE_FRAME_VARINT_MAX; i++) {
+		data[size++] = 0x80;
+	}
+
+	// Valid
+
+	size += bleFrameEncodeLine("11:BLE", 6, true, data + size, sizeof(data) - size);
+
+	// Only the valid frame is decoded, in all sizes of parts
+
+	char message[BLE_FRAME_MSG_MAX_SIZE + 1];
+	uint16_t sizeMessage = 0;
+
+	uint32_t failures = 0;
+
+	for (uint16_t part = 1; part <= size; part++) {
+
+		BleFrameDecoder decoder;
+
+		decoder.setCrc(true);
+
+		failures += (decodeParts(decoder, data, size, part, message, sizeMessage) != 1);
+		failures += (strcmp(message, "11:BLE") != 0);
+		failures += (decoder.errors() != 6);
+		failures += decoder.pending();
+	}
+
+	TEST_CHECK(failures == 0);
+
+	// Without CRC - the frame larger than buffer is discarded too
+
+	size = 0;
+
+	data[size++] = 70;
+	data[size++] = 0x80 | ((BLE_FRAME_MSG_MAX_SIZE) & 0x7F);
+	data[size++] = ((BLE_FRAME_MSG_MAX_SIZE) >> 7);
+
+	size += rejectedPayload(data + size, BLE_FRAME_MSG_MAX_SIZE);
+	size += bleFrameEncodeLine("80:", 3, false, data + size, sizeof(data) - size);
+
+	BleFrameDecoder decoderNoCrc;
+
+	TEST_CHECK(decodeParts(decoderNoCrc, data, size, 20, message, sizeMessage) == 1);
+	TEST_CHECK(strcmp(message, "80:") == 0 && decoderNoCrc.errors() == 1);
+
+	// Largest frame that fits in buffer
+
+	char line[BLE_FRAME_MSG_MAX_SIZE + 1];
+
+	memcpy(line, "70:", 3);
+	memset(line + 3, 'x', BLE_FRAME_MSG_MAX_SIZE - 3);
+
+	uint8_t frame[BLE_FRAME_MSG_MAX_SIZE + BLE_FRAME_OVERHEAD_MAX];
+
+	size = bleFrameEncodeLine(line, BLE_FRAME_MSG_MAX_SIZE, false, frame, sizeof(frame));
+
+	BleFrameDecoder decoderMax;
+
+	TEST_CHECK(decodeParts(decoderMax, frame, size, 7, message, sizeMessage) == 1);
+	TEST_CHECK(sizeMessage == BLE_FRAME_MSG_MAX_SIZE && decoderMax.errors() == 0);
+}
+
+/**
+ * @brief Frames of values - encode and read it (as client)
+ */
+static void testValues() {
+
+	const uint32_t values[] = { 0, 1, 127, 128, 16383, 16384, 350000, 0xFFFFFFFFu };
+	const uint8_t count = sizeof(values) / sizeof(values[0]);
+
+	for (uint8_t crc = 0; crc < 2; crc++) {
+
+		uint8_t frame[64];
+
+		uint16_t size = bleFrameEncodeValues(11, "BLE", values, count, crc, frame, sizeof(frame));
+
+		// Varints: 1 + 1 + 1 + 2 + 2 + 3 + 3 + 5, prefix 1 + 3, header 2
+
+		TEST_CHECK(size == (2 + 4 + 18 + ((crc) ? 2 : 0)));
+		TEST_CHECK(frame[0] == (11 | BLE_FRAME_VALUES));
+
+		TestFrame_t read;
+		bool valid;
+
+		TEST_CHECK(testFrameRead(frame, size, crc, read, valid) == size);
+		TEST_CHECK(valid && read.values && read.code == 11);
+		TEST_CHECK(testFrameRead(frame, size - 1, crc, read, valid) == 0); // Not complete
+
+		char prefix[8];
+		uint32_t decoded[16];
+
+		TEST_CHECK(testFrameValues(read, prefix, sizeof(prefix), decoded, 16) == count);
+		TEST_CHECK(strcmp(prefix, "BLE") == 0);
+		TEST_CHECK(memcmp(decoded, values, sizeof(values)) == 0);
+	}
+
+	// Without prefix and values, invalid code and no space
+
+	uint8_t frame[16];
+
+	TEST_CHECK(bleFrameEncodeValues(72, "", NULL, 0, false, frame, sizeof(frame)) == 3);
+	TEST_CHECK(bleFrameEncodeValues(0, "", values, 1, false, frame, sizeof(frame)) == 0);
+	TEST_CHECK(bleFrameEncodeValues(100, "", values, 1, false, frame, sizeof(frame)) == 0);
+	TEST_CHECK(bleFrameEncodeValues(11, "BLE", values, count, false, frame, sizeof(frame)) == 0);
+}
+
+////// Firmware in binary mode (simulated link)
+
+/**
+ * @brief Data received by client - the response of 01 is text, after it is frames
+ */
+static void clientReceive(const char* data, uint16_t size) {
+
+	if (!mClientBinary) {
+
+		const char* end = (const char*) memchr(data, '\n', size);
+
+		if (end == NULL || (end - data) >= (int) sizeof(mClientLine)) {
+			mInvalid++;
+			return;
+		}
+
+		memcpy(mClientLine, data, (end - data));
+		mClientLine[end - data] = '\0';
+
+		mClientBinary = true;
+		return;
+	}
+
+	if ((mClientSize + size) > FRAME_BUFFER_SIZE) {
+		mInvalid++;
+		return;
+	}
+
+	memcpy(mClientData + mClientSize, data, size);
+	mClientSize += size;
+
+	// Frames complete
+
+	for (;;) {
+
+		TestFrame_t frame;
+		bool valid;
+
+		uint16_t sizeFrame = testFrameRead(mClientData, mClientSize, true, frame, valid);
+
+		if (sizeFrame == 0) {
+			break;
+		}
+
+		char prefix[16];
+		uint32_t values[16];
+
+		uint8_t count = testFrameValues(frame, prefix, sizeof(prefix), values, 16);
+
+		if (!valid) {
+
+			mInvalid++;
+
+		} else if (frame.values && frame.code == 11 && strcmp(prefix, "BLE") == 0 && count == 8) {
+
+			mValuesBle++;
+
+		} else if (frame.values && frame.code == 11 && strcmp(prefix, "FMEM") == 0 && count == 1 &&
+					values[0] > 0 && values[0] <= esp_get_free_heap_size() + 1000) {
+
+			mValuesFmem++;
+
+		} else if (!frame.values && frame.code == 70 && frame.size == 6 && memcmp(frame.payload, "frames", 6) == 0) {
+
+			mEchoes++;
+
+		} else {
+
+			printf("test_frame: frame not expected: code %u values %u size %u\n", frame.code, frame.values, frame.size);
+			mInvalid++;
+		}
+
+		mClientSize -= sizeFrame;
+		memmove(mClientData, mClientData + sizeFrame, mClientSize);
+	}
+}
+
+/**
+ * @brief Send a line as frame (with CRC)
+ */
+static void clientSend(const char* line) {
+
+	uint8_t frame[128];
+
+	uint16_t size = bleFrameEncodeLine(line, strlen(line), true, frame, sizeof(frame));
+
+	TEST_CHECK(size > 0 && simLinkWrite((const char*) frame, size));
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void frameMain(void* arg) {
+
+	app_main();
+
+	SimLinkConfig_t config = { 100, 30000, 6, SIM_LINK_BUFFERS_MAX };
+
+	simLinkStart(config, clientReceive);
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	simLinkConnect();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	// Binary mode with CRC (the response is in text)
+
+	TEST_CHECK(simLinkWrite("01:BINC\n", 8));
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	// Frames (the bytes of each write is splitted in frames by decoder)
+
+	clientSend("11:BLE");
+	clientSend("70:frames");
+	clientSend("11:FMEM");
+	clientSend("11:BLE");
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	simLinkDisconnect();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	testText();
+	testErrors();
+	testValues();
+
+	simRun(frameMain, NULL, true);
+
+	printf("test_frame: response of 01 '%s', values BLE %u FMEM %u, echoes %u, invalid %u\n",
+				mClientLine, mValuesBle, mValuesFmem, mEchoes, mInvalid);
+
+	TEST_CHECK(simExitReason() == NULL);
+	TEST_CHECK(strncmp(mClientLine, "01:", 3) == 0 && strstr(mClientLine, ":BINC") != NULL);
+	TEST_CHECK(mValuesBle == 2);
+	TEST_CHECK(mValuesFmem == 1);
+	TEST_CHECK(mEchoes == 1);
+	TEST_CHECK(mInvalid == 0);
+
+	return testResult("test_frame");
+}
+
+//////// End
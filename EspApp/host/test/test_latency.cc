@@ -0,0 +1,386 @@
+/*
+ * test_latency.cc - histogram of latencies (util/latency_histogram.h) and the latencies of messages
+ * Unit: the bucket of each value (error < 25%, monotonic), the percentiles against the exact ones
+ * (of values sorted), saturation of counts and overflow of values
+ * Firmware: echoes and feedbacks by the simulated link (congested, few buffers), the histograms
+ * by code and stage, the slots taken by codes (the others in slot 0), the report of message 11:LAT
+ * and the reset (11:LAT:R)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+#include "sim_link.h"
+
+#include "latency_histogram.h"
+#include "ble_server.h"
+
+#include "test.h"
+
+using namespace std;
+
+////// Firmware
+
+extern "C" void app_main();
+
+extern LatencyHistogram bleLatency(uint8_t slot, uint8_t stage);
+extern uint8_t bleLatencyCode(uint8_t slot);
+
+////// Definitions
+
+#define LATENCY_VALUES 				100000
+#define LATENCY_ECHOES 				200
+
+////// Variables
+
+static uint32_t mRandom = 20171026;				// Random (deterministic)
+
+static char mLine[512];							// Line received by client (joined)
+static uint16_t mLineSize = 0;
+
+static uint32_t mLines = 0;						// Lines received
+static uint32_t mReportCount70 = 0;				// Count of 70 (TOTAL) in report 11:LAT
+static uint32_t mReportLines = 0;				// Lines of report 11:LAT (without reset)
+static bool mReportReset = false;				// Response of reset
+
+////// Routines
+
+/**
+ * @brief Random number (0 to max - 1)
+ */
+static uint32_t random(uint32_t max) {
+
+	mRandom = (mRandom * 1103515245u) + 12345u;
+
+	return ((mRandom >> 8) % max);
+}
+
+/**
+ * @brief Value in bucket of histogram - the lower of bucket is the value, or less than 25% below it
+ */
+static bool checkValue(uint32_t value) {
+
+	LatencyHistogram histogram;
+
+	histogram.add(value);
+
+	uint32_t lower = histogram.percentile(500);
+
+	if (value < 4) {
+		return (lower == value);
+	}
+
+	return (lower <= value && (value - lower) <= (value / 4));
+}
+
+////// Tests (unit)
+
+/**
+ * @brief Buckets - values small (linear), the powers of 2 and around them
+ */
+static void testBuckets() {
+
+	uint32_t failures = 0;
+
+	for (uint32_t value = 0; value < 4096; value++) {
+		failures += !checkValue(value);
+	}
+
+	for (uint8_t bit = 2; bit <= LATENCY_MAX_BIT; bit++) {
+
+		uint32_t power = (1u << bit);
+
+		failures += !checkValue(power - 1);
+		failures += !checkValue(power);
+		failures += !checkValue(power + 1);
+		failures += !checkValue(power + (power / 2));
+	}
+
+	TEST_CHECK(failures == 0);
+
+	// Lower of buckets is increasing (monotonic)
+
+	bool increasing = true;
+
+	for (uint16_t i = 1; i < LATENCY_BUCKETS; i++) {
+		increasing &= (LatencyHistogram::lower(i) > LatencyHistogram::lower(i - 1));
+	}
+
+	TEST_CHECK(increasing);
+}
+
+/**
+ * @brief Percentiles against the exact (of values sorted) - distribution with a long tail
+ */
+static void testPercentiles() {
+
+	LatencyHistogram histogram;
+
+	vector<uint32_t> values;
+
+	for (uint32_t i = 0; i < LATENCY_VALUES; i++) {
+
+		// Most around 2 ms, some of 10 to 50 ms, and few of 0.5 to 2 seconds
+
+		uint32_t choice = random(1000);
+		uint32_t value = (choice < 950) ? (1500 + random(1000)) :
+						 (choice < 998) ? (10000 + random(40000)) : (500000 + random(1500000));
+
+		histogram.add(value);
+		values.push_back(value);
+	}
+
+	sort(values.begin(), values.end());
+
+	static const uint16_t tenths[] = { 500, 900, 990, 999 };
+
+	for (uint8_t i = 0; i < sizeof(tenths) / sizeof(tenths[0]); i++) {
+
+		uint32_t exact = values[((uint64_t) values.size() * tenths[i] + 999) / 1000 - 1];
+		uint32_t estimated = histogram.percentile(tenths[i]);
+
+		if (!TEST_CHECK(estimated <= exact && (exact - estimated) <= (exact / 4))) {
+			printf("test_latency: percentile %u, exact %u, histogram %u\n", tenths[i], exact, estimated);
+		}
+	}
+
+	TEST_CHECK(histogram.count() == LATENCY_VALUES);
+	TEST_CHECK(histogram.max() == values.back());
+	TEST_CHECK(histogram.percentile(1000) <= values.back());
+
+	// Empty
+
+	histogram.reset();
+
+	TEST_CHECK(histogram.count() == 0 && histogram.percentile(500) == 0 && histogram.max() == 0);
+}
+
+/**
+ * @brief Saturation of counts (16 bits) and overflow of values (last bucket)
+ */
+static void testLimits() {
+
+	LatencyHistogram histogram;
+
+	for (uint32_t i = 0; i < 70000; i++) {
+		histogram.add(1000);
+	}
+
+	uint16_t full = 0;
+
+	for (uint16_t i = 0; i < LATENCY_BUCKETS; i++) {
+		if (histogram.countOf(i) > 0) {
+			full = histogram.countOf(i);
+		}
+	}
+
+	TEST_CHECK(full == 0xFFFF);
+	TEST_CHECK(histogram.count() == 70000);
+	TEST_CHECK(histogram.percentile(999) <= 1000 && histogram.percentile(500) >= 750);
+
+	histogram.add(1u << 30);
+
+	TEST_CHECK(histogram.countOf(LATENCY_BUCKETS - 1) == 1);
+	TEST_CHECK(histogram.max() == (1u << 30));
+}
+
+////// Test (firmware)
+
+/**
+ * @brief Line received by client - report of latencies
+ */
+static void receiveLine(const char* line, uint16_t size) {
+
+	mLines++;
+
+	if (size >= 7 && memcmp(line, "11:LAT:", 7) == 0) {
+
+		if (strncmp(line, "11:LAT:R", size) == 0) {
+			mReportReset = true;
+			return;
+		}
+
+		mReportLines++;
+
+		unsigned count = 0;
+
+		if (sscanf(line, "11:LAT:70:TOTAL:%u:", &count) == 1) {
+			mReportCount70 = count;
+		}
+	}
+}
+
+/**
+ * @brief Data received by client (notifications) - joins the lines
+ */
+static void clientReceive(const char* data, uint16_t size) {
+
+	for (uint16_t i = 0; i < size; i++) {
+
+		if (data[i] == '\n') {
+
+			receiveLine(mLine, mLineSize);
+			mLineSize = 0;
+
+		} else if (mLineSize < sizeof(mLine)) {
+
+			mLine[mLineSize++] = data[i];
+		}
+	}
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void latencyMain(void* arg) {
+
+	app_main();
+
+	// Link: MTU of 20, 2 buffers and 1 notification by event (the responses waits congestion)
+
+	SimLinkConfig_t config = { 20, 30000, 1, 2 };
+
+	simLinkStart(config, clientReceive);
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	simLinkConnect();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	simLinkWrite("01:\n71:N\n", 9);
+
+	vTaskDelay(pdMS_TO_TICKS(2000));
+
+	// Echoes (with payload, 4 packets by response) and feedbacks, in groups of 2
+
+	uint32_t lines = mLines;
+
+	for (uint16_t i = 0; i < LATENCY_ECHOES; i++) {
+
+		char echo[80];
+		uint16_t size = snprintf(echo, sizeof(echo), "70:%03u:abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\n80:\n", i);
+
+		simLinkWrite(echo, size);
+
+		vTaskDelay(pdMS_TO_TICKS(500));
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(3000));
+
+	TEST_CHECK((mLines - lines) == (LATENCY_ECHOES * 2));
+
+	// Histograms by code and stage
+
+	uint8_t slot70 = 0;
+	uint8_t slot80 = 0;
+
+	for (uint8_t slot = 1; slot < BLE_LATENCY_SLOTS; slot++) {
+		if (bleLatencyCode(slot) == 70) {
+			slot70 = slot;
+		} else if (bleLatencyCode(slot) == 80) {
+			slot80 = slot;
+		}
+	}
+
+	TEST_CHECK(slot70 > 0 && slot80 > 0);
+
+	LatencyHistogram total70 = bleLatency(slot70, BLE_LATENCY_STAGE_TOTAL);
+	LatencyHistogram send70 = bleLatency(slot70, BLE_LATENCY_STAGE_SEND);
+	LatencyHistogram total80 = bleLatency(slot80, BLE_LATENCY_STAGE_TOTAL);
+
+	TEST_CHECK(total70.count() == LATENCY_ECHOES);
+	TEST_CHECK(total80.count() == LATENCY_ECHOES);
+
+	for (uint8_t stage = 0; stage < BLE_LATENCY_STAGE_TOTAL; stage++) {
+		TEST_CHECK(bleLatency(slot70, stage).count() == LATENCY_ECHOES);
+		TEST_CHECK(bleLatency(slot70, stage).max() <= total70.max());
+	}
+
+	// The feedback waits the echo before it (congested) - more latency
+
+	TEST_CHECK(send70.max() > 0);
+	TEST_CHECK(total80.percentile(500) > total70.percentile(500));
+
+	printf("test_latency: 70 total p50 %u p99 %u max %u, send max %u; 80 total p50 %u p99 %u max %u (us)\n",
+				total70.percentile(500), total70.percentile(990), total70.max(), send70.max(),
+				total80.percentile(500), total80.percentile(990), total80.max());
+
+	// Codes without handler (responses of error) - each one takes a slot, until all are taken (after in slot 0)
+
+	uint32_t others = bleLatency(0, BLE_LATENCY_STAGE_TOTAL).count();
+
+	for (uint8_t code = 20; code < (20 + BLE_LATENCY_SLOTS); code++) {
+
+		char line[8];
+		uint16_t size = snprintf(line, sizeof(line), "%02u:\n", code);
+
+		simLinkWrite(line, size);
+
+		vTaskDelay(pdMS_TO_TICKS(500));
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(2000));
+
+	bool distinct = true;
+
+	for (uint8_t slot = 1; slot < BLE_LATENCY_SLOTS; slot++) {
+		for (uint8_t other = slot + 1; other < BLE_LATENCY_SLOTS; other++) {
+			distinct &= (bleLatencyCode(slot) != bleLatencyCode(other));
+		}
+		distinct &= (bleLatencyCode(slot) != 0); // Taken (a message without response takes it too, as 71)
+	}
+
+	TEST_CHECK(distinct);
+	TEST_CHECK(bleLatency(0, BLE_LATENCY_STAGE_TOTAL).count() > others);
+
+	// Report and reset
+
+	simLinkWrite("11:LAT\n", 7);
+
+	vTaskDelay(pdMS_TO_TICKS(5000));
+
+	TEST_CHECK(mReportLines > 0);
+	TEST_CHECK(mReportCount70 == LATENCY_ECHOES);
+
+	simLinkWrite("11:LAT:R\n", 9);
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	TEST_CHECK(mReportReset);
+	TEST_CHECK(bleLatency(slot70, BLE_LATENCY_STAGE_TOTAL).count() == 0);
+	TEST_CHECK(bleLatency(slot80, BLE_LATENCY_STAGE_TOTAL).count() == 0);
+	TEST_CHECK(bleLatencyCode(slot70) == 70); // Keeps the slot
+
+	simLinkDisconnect();
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	testBuckets();
+	testPercentiles();
+	testLimits();
+
+	simLogLevel(ESP_LOG_ERROR);
+
+	simRun(latencyMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_latency");
+}
+
+//////// End
@@ -0,0 +1,328 @@
+/*
+ * test_median.cc - unit tests of the median filters (util/median_filter.h)
+ * Sorting networks: all inputs of 0 and 1 (by the 0-1 principle, a network that sorts them sorts any input)
+ * to windows up to MEDIAN_NETWORK_EXHAUSTIVE, random inputs to the larger ones (up to MEDIAN_NETWORK_TESTED)
+ * MedianFilter: median and average of central samples, by selection (large windows) or sort (small), against
+ * std::sort (and the median against std::nth_element) - inputs random, repeated, sorted, reversed and all
+ * equal (and the maximum values, to the sum)
+ * RunningMedian: median and average of central samples against a window sorted (exact), for streams
+ * random (with repeated values too), the window filling and the reset; and the MedianStage of filter chain
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "util/median_filter.h"
+#include "util/filter_chain.h"
+
+#include "test.h"
+
+using namespace std;
+
+////// Definitions
+
+#define MEDIAN_SAMPLES 				5000
+#define MEDIAN_NETWORK_EXHAUSTIVE 	20			// Maximum size of network tested with all inputs of 0-1
+#define MEDIAN_NETWORK_RANDOM 		20000		// Random inputs to larger networks
+#define MEDIAN_NETWORK_TESTED 		32			// Maximum size of network tested (generic, beyond MEDIAN_NETWORK_MAX)
+#define MEDIAN_SELECT_ROUNDS 		2000		// Inputs to each window of MedianFilter
+
+////// Variables
+
+static uint32_t mRandom = 20171026;				// Random (deterministic)
+
+////// Routines
+
+/**
+ * @brief Random number (0 to max - 1)
+ */
+static uint32_t random(uint32_t max) {
+
+	mRandom = (mRandom * 1103515245u) + 12345u;
+
+	return ((mRandom >> 8) % max);
+}
+
+/**
+ * @brief Average of the central samples of a window sorted (exact)
+ */
+template<typename T>
+static T exactAverage(const vector<T>& sorted, unsigned int samples) {
+
+	if (samples > sorted.size()) {
+		samples = sorted.size();
+	}
+
+	unsigned int start = (sorted.size() - samples) / 2;
+
+	typename MedianSum<T>::type sum = 0;
+
+	for (unsigned int i = start; i < start + samples; i++) {
+		sum += sorted[i];
+	}
+
+	return (T) (sum / samples);
+}
+
+////// Tests
+
+/**
+ * @brief Sorting network of _size - all inputs of 0 and 1 (or random inputs, if too large)
+ * Recursive, to test all sizes (from _size to 2)
+ */
+template<unsigned int _size>
+struct TestNetwork {
+
+	static void run() {
+
+		uint32_t failures = 0;
+
+		if (_size <= MEDIAN_NETWORK_EXHAUSTIVE) {
+
+			// All inputs of 0-1 - the output is the zeros and after the ones
+
+			uint8_t a[_size];
+
+			for (uint64_t bits = 0; bits < (1ull << _size); bits++) {
+
+				unsigned int ones = 0;
+
+				for (unsigned int i = 0; i < _size; i++) {
+					a[i] = ((bits >> i) & 1);
+					ones += a[i];
+				}
+
+				MedianNetwork<uint8_t, _size>::sort(a);
+
+				for (unsigned int i = 0; i < _size; i++) {
+					failures += (a[i] != (i >= (_size - ones)));
+				}
+			}
+
+		} else {
+
+			// Random inputs (with repeated values) against the sort
+
+			uint16_t a[_size];
+			uint16_t b[_size];
+
+			for (uint32_t n = 0; n < MEDIAN_NETWORK_RANDOM; n++) {
+
+				uint32_t range = (n & 1) ? 4 : 65536;
+
+				for (unsigned int i = 0; i < _size; i++) {
+					a[i] = b[i] = random(range);
+				}
+
+				MedianNetwork<uint16_t, _size>::sort(a);
+				sort(b, b + _size);
+
+				failures += (memcmp(a, b, sizeof(a)) != 0);
+			}
+		}
+
+		if (!TEST_CHECK(failures == 0)) {
+			printf("test_median: sorting network of %u - %u failures\n", _size, failures);
+		}
+
+		TestNetwork<_size - 1>::run();
+	}
+};
+
+template<>
+struct TestNetwork<1> {
+
+	static void run() {
+	}
+};
+
+/**
+ * @brief MedianFilter against the sort - median and averages, in each kind of input
+ */
+template<typename T, unsigned int _size>
+static void testFilter(uint32_t range) {
+
+	MedianFilter<T, _size> filter;
+
+	uint32_t failures = 0;
+
+	for (uint32_t round = 0; round < MEDIAN_SELECT_ROUNDS; round++) {
+
+		// Input (kind by round): random, repeated (few values), sorted, reversed, all equal
+
+		vector<T> samples(_size);
+
+		uint8_t kind = (round % 5);
+
+		for (unsigned int i = 0; i < _size; i++) {
+			samples[i] = (T) random((kind == 1) ? 3 : range);
+		}
+
+		if (kind == 2) {
+			sort(samples.begin(), samples.end());
+		} else if (kind == 3) {
+			sort(samples.rbegin(), samples.rend());
+		} else if (kind == 4) {
+			fill(samples.begin(), samples.end(), (round & 8) ? (T) (range - 1) : samples[0]);
+		}
+
+		vector<T> sorted(samples);
+
+		sort(sorted.begin(), sorted.end());
+
+		// Median, and averages of 1, 3, some, all and more than all (the samples are set again each one)
+
+		const unsigned int averages[] = { 1, 3, (_size / 3) + 1, _size, _size + 5 };
+
+		T value;
+
+		for (unsigned int i = 0; i < _size; i++) {
+			filter.set(i, samples[i]);
+		}
+
+		failures += (!filter.getMedian(value) || value != sorted[_size / 2]);
+
+		// Median against the selection of std (nth_element)
+
+		vector<T> nth(samples);
+
+		nth_element(nth.begin(), nth.begin() + (_size / 2), nth.end());
+
+		failures += (value != nth[_size / 2]);
+
+		for (uint8_t n = 0; n < sizeof(averages) / sizeof(averages[0]); n++) {
+
+			for (unsigned int i = 0; i < _size; i++) {
+				filter.set(i, samples[i]);
+			}
+
+			failures += (!filter.getAverage(averages[n], value) || value != exactAverage(sorted, averages[n]));
+		}
+
+		failures += filter.getAverage(0, value);
+	}
+
+	if (!TEST_CHECK(failures == 0)) {
+		printf("test_median: filter of %u, range %u - %u failures\n", _size, range, failures);
+	}
+}
+
+/**
+ * @brief Running median against the window sorted - stream of values up to range
+ */
+template<typename T, unsigned int _size>
+static void testRunning(uint32_t range) {
+
+	RunningMedian<T, _size> median;
+	deque<T> window;
+
+	uint32_t failures = 0;
+
+	T value;
+
+	TEST_CHECK(!median.getMedian(value) && !median.getAverage(1, value));
+
+	for (uint32_t i = 0; i < MEDIAN_SAMPLES; i++) {
+
+		// Reset in the middle (the window fills again)
+
+		if (i == (MEDIAN_SAMPLES / 2)) {
+
+			median.reset();
+			window.clear();
+
+			failures += (median.count() != 0 || median.getMedian(value));
+		}
+
+		T sample = (T) random(range);
+
+		median.push(sample);
+		window.push_back(sample);
+
+		if (window.size() > _size) {
+			window.pop_front();
+		}
+
+		vector<T> sorted(window.begin(), window.end());
+
+		sort(sorted.begin(), sorted.end());
+
+		// Median and averages (of 1, 3 and all samples)
+
+		failures += (median.count() != sorted.size());
+		failures += (!median.getMedian(value) || value != sorted[sorted.size() / 2]);
+		failures += (!median.getAverage(1, value) || value != exactAverage(sorted, 1));
+		failures += (!median.getAverage(3, value) || value != exactAverage(sorted, 3));
+		failures += (!median.getAverage(_size, value) || value != exactAverage(sorted, _size));
+	}
+
+	if (!TEST_CHECK(failures == 0)) {
+		printf("test_median: window %u, range %u - %u failures\n", _size, range, failures);
+	}
+}
+
+/**
+ * @brief Stage of median in a chain - the same of running median
+ */
+static void testStage() {
+
+	FilterChain<uint16_t, MedianStage<uint16_t, 7> > chain;
+	RunningMedian<uint16_t, 7> median;
+
+	uint32_t failures = 0;
+
+	for (uint32_t i = 0; i < MEDIAN_SAMPLES; i++) {
+
+		uint16_t sample = random(4096);
+		uint16_t out = 0;
+		uint16_t expected = 0;
+
+		median.push(sample);
+
+		failures += (!chain.process(sample, out) || !median.getMedian(expected) || out != expected);
+	}
+
+	TEST_CHECK(failures == 0);
+}
+
+////// Main
+
+int main() {
+
+	// Sorting networks (all sizes used by MedianFilter, and the generic to larger ones)
+
+	TestNetwork<MEDIAN_NETWORK_TESTED>::run();
+
+	// MedianFilter - by sort (network) and by selection (larger than MEDIAN_NETWORK_MAX)
+
+	testFilter<uint16_t, 5>(4096);
+	testFilter<uint16_t, 7>(4096);
+	testFilter<uint16_t, 8>(4096);
+	testFilter<uint16_t, 32>(4096);
+	testFilter<uint16_t, 33>(4096);
+	testFilter<uint16_t, 64>(65536);
+	testFilter<int32_t, 101>(1000000);
+	testFilter<uint8_t, 255>(256);
+
+	// RunningMedian - windows of sizes odd and even, values distinct (mostly) and repeated
+
+	testRunning<uint16_t, 1>(4096);
+	testRunning<uint16_t, 2>(4096);
+	testRunning<uint16_t, 7>(4096);
+	testRunning<uint16_t, 7>(3);
+	testRunning<uint16_t, 16>(4096);
+	testRunning<uint16_t, 33>(8);
+	testRunning<int32_t, 9>(1000000);
+	testRunning<uint8_t, 64>(256);
+
+	testStage();
+
+	return testResult("test_median");
+}
+
+//////// End
@@ -0,0 +1,132 @@
+/*
+ * test_reassembler.cc - unit tests of LineReassembler (util/line_reassembler.h)
+ * Lines splitted in all positions, CRs in any place, empty lines and lines larger than the buffer
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "util/line_reassembler.h"
+
+#include "test.h"
+
+using namespace std;
+
+////// Definitions
+
+#define REASSEMBLER_SIZE 			64
+
+////// Routines
+
+/**
+ * @brief Feed the data in parts of size - returns the lines (joined by '|')
+ */
+static string feedParts(LineReassembler<REASSEMBLER_SIZE>& reassembler, const char* data, uint16_t size, uint16_t part) {
+
+	string lines;
+
+	for (uint16_t pos = 0; pos < size; pos += part) {
+
+		const char* next = data + pos;
+		uint16_t sizePart = ((size - pos) < part) ? (size - pos) : part;
+
+		while (sizePart > 0) {
+
+			const char* line;
+			uint16_t sizeLine;
+
+			uint16_t used = reassembler.feed(next, sizePart, line, sizeLine);
+
+			if (line != NULL) {
+				lines.append(line, sizeLine);
+				lines.append(1u, '|');
+			}
+
+			next += used;
+			sizePart -= used;
+		}
+	}
+
+	return lines;
+}
+
+////// Main
+
+int main() {
+
+	// Lines, with CRs (in end and middle), empty lines
+
+	const char* data = "01:\n70:1:abc\r\n\r\n\n80:\r\n11:B\rLE\r\r\n70:2:" \
+						"0123456789012345678901234567890123456789012345678901\n";
+	const char* expected = "01:|70:1:abc|80:|11:BLE|70:2:0123456789012345678901234567890123456789012345678901|";
+
+	uint16_t size = strlen(data);
+
+	for (uint16_t part = 1; part <= size; part++) {
+
+		LineReassembler<REASSEMBLER_SIZE> reassembler;
+
+		string lines = feedParts(reassembler, data, size, part);
+
+		if (!TEST_CHECK(lines == expected)) {
+			printf("test_reassembler: part %u -> %s\n", part, lines.c_str());
+		}
+
+		TEST_CHECK(!reassembler.pending());
+		TEST_CHECK(reassembler.overflows() == 0);
+	}
+
+	// Line complete in data, without CR - not copied
+
+	LineReassembler<REASSEMBLER_SIZE> reassembler;
+
+	const char* line;
+	uint16_t sizeLine;
+
+	TEST_CHECK(reassembler.feed(data, size, line, sizeLine) == 4);
+	TEST_CHECK(line == data && sizeLine == 3);
+
+	// Lines larger than buffer - truncated if splitted (or with CR), complete in data is not truncated
+
+	char large[REASSEMBLER_SIZE * 2 + 2];
+
+	memset(large, 'x', sizeof(large) - 2);
+	large[sizeof(large) - 2] = '\n';
+	large[sizeof(large) - 1] = '\0';
+
+	uint16_t sizeLarge = strlen(large);
+
+	LineReassembler<REASSEMBLER_SIZE> reassemblerLarge;
+
+	string lines = feedParts(reassemblerLarge, large, sizeLarge, sizeLarge);
+
+	TEST_CHECK(lines.size() == (sizeLarge - 1 + 1) && reassemblerLarge.overflows() == 0);
+
+	lines = feedParts(reassemblerLarge, large, sizeLarge, 20);
+
+	TEST_CHECK(lines.size() == (REASSEMBLER_SIZE + 1) && reassemblerLarge.overflows() == 1);
+
+	large[10] = '\r';
+
+	lines = feedParts(reassemblerLarge, large, sizeLarge, sizeLarge);
+
+	TEST_CHECK(lines.size() == (REASSEMBLER_SIZE + 1) && reassemblerLarge.overflows() == 2);
+
+	// Part pending, and reset (timeout of line)
+
+	feedParts(reassemblerLarge, "70:abandoned", 12, 12);
+
+	TEST_CHECK(reassemblerLarge.pending());
+
+	reassemblerLarge.reset();
+
+	TEST_CHECK(!reassemblerLarge.pending());
+	TEST_CHECK(feedParts(reassemblerLarge, "80:\n", 4, 2) == "80:|");
+
+	return testResult("test_reassembler");
+}
+
+//////// End
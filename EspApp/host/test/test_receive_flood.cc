@@ -0,0 +1,159 @@
+/*
+ * test_receive_flood.cc - flood of the queue to receive, with a slow handler of messages
+ * The callback of data received (runs in task of BT stack) must never block, with the queue full
+ * the lines is dropped by the policy (drop the newest or the oldest), and it is counted
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+
+#include "util/ble_server.h"
+#include "util/msg_table.h"
+
+#include "test.h"
+
+////// Firmware
+
+extern "C" void app_main();
+
+////// Definitions
+
+#define FLOOD_LINES 				20			// Lines of flood
+#define FLOOD_HANDLER_TIME 			500			// Time of slow handler (millis), as 98/99
+
+////// Variables
+
+static int32_t mProcessed[FLOOD_LINES];			// Sequences processed (in order)
+static uint8_t mProcessedCount = 0;
+
+static uint64_t mBlocked = 0;					// Time blocked in writes (micros)
+
+////// Slow message (as a module of App)
+
+static void msgSlow(const char* message, uint16_t size, FieldsView& fields, string& response) {
+
+	if (mProcessedCount < FLOOD_LINES) {
+		mProcessed[mProcessedCount++] = fields.getInt(2);
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(FLOOD_HANDLER_TIME));
+}
+
+static MsgRegister mMsgSlow(43, msgSlow, NULL, MSG_FLAG_NONE);
+
+////// Routines
+
+/**
+ * @brief Flood of lines (each write is a BLE packet) - the callback runs in this task
+ */
+static BleReceiveStats_t flood(uint8_t policy) {
+
+	BleServer server; // Only to set the policy and get the statistics
+
+	server.setReceivePolicy(policy);
+
+	mProcessedCount = 0;
+
+	BleReceiveStats_t start = server.getReceiveStats();
+
+	for (uint8_t seq = 0; seq < FLOOD_LINES; seq++) {
+
+		char line[16];
+
+		uint16_t size = snprintf(line, sizeof(line), "43:%u\n", seq);
+
+		uint64_t before = simTime();
+
+		TEST_CHECK(ble_loopback_Write(line, size) == ESP_OK);
+
+		mBlocked += (simTime() - before);
+	}
+
+	// Wait the processing of lines queued
+
+	vTaskDelay(pdMS_TO_TICKS((BLE_SIZE_QUEUE_RECV + 2) * FLOOD_HANDLER_TIME));
+
+	BleReceiveStats_t stats = server.getReceiveStats();
+
+	stats.received -= start.received;
+	stats.processed -= start.processed;
+	stats.dropped -= start.dropped;
+
+	printf("test_receive_flood: policy %u received %u processed %u dropped %u high water %u, processed:",
+				policy, stats.received, stats.processed, stats.dropped, stats.highWater);
+
+	for (uint8_t i = 0; i < mProcessedCount; i++) {
+		printf(" %d", mProcessed[i]);
+	}
+
+	printf("\n");
+
+	return stats;
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void floodMain(void* arg) {
+
+	app_main();
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	ble_loopback_Connect(100);
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	// Drop the newest - the first lines is processed
+
+	BleReceiveStats_t stats = flood(BLE_RECV_POLICY_DROP_NEWEST);
+
+	TEST_CHECK(stats.received == FLOOD_LINES);
+	TEST_CHECK(stats.dropped > 0 && (stats.processed + stats.dropped) == FLOOD_LINES);
+	TEST_CHECK(stats.highWater == BLE_SIZE_QUEUE_RECV);
+	TEST_CHECK(mProcessedCount == stats.processed && mProcessed[0] == 0 &&
+				mProcessed[mProcessedCount - 1] == (int32_t) (mProcessedCount - 1));
+
+	// Drop the oldest - the last lines is processed
+
+	stats = flood(BLE_RECV_POLICY_DROP_OLDEST);
+
+	TEST_CHECK(stats.received == FLOOD_LINES);
+	TEST_CHECK(stats.dropped > 0 && (stats.processed + stats.dropped) == FLOOD_LINES);
+	TEST_CHECK(mProcessedCount == stats.processed && mProcessed[mProcessedCount - 1] == (FLOOD_LINES - 1));
+
+	for (uint8_t i = 1; i < mProcessedCount; i++) {
+		TEST_CHECK(mProcessed[i] > mProcessed[i - 1]);
+	}
+
+	// The callback never blocked
+
+	printf("test_receive_flood: time blocked in callback %llu us\n", (unsigned long long) mBlocked);
+
+	TEST_CHECK(mBlocked == 0);
+
+	ble_loopback_Disconnect();
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simLogLevel(ESP_LOG_ERROR); // Without the warnings of lines dropped
+
+	simRun(floodMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_receive_flood");
+}
+
+//////// End
@@ -0,0 +1,182 @@
+/*
+ * test_receive_pool.cc - queue of lines received deeper than the pool of buffers (BLE_SIZE_POOL_RECV)
+ * Short lines not use the pool: the queue is filled until its depth, without drops
+ * Large lines share the pool: when exhausted, the callback waits the task frees a buffer (backpressure,
+ * until BLE_TIMEOUT_POOL_RECV), after the policy is applied (drop the newest or the oldest)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+
+#include "util/ble_server.h"
+#include "util/msg_table.h"
+
+#include "test.h"
+
+////// Firmware
+
+extern "C" void app_main();
+
+////// Definitions
+
+#define POOL_LINES_MAX 				20			// Lines of burst (maximum)
+#define POOL_HANDLER_SLOW 			500			// Time of handler slower than BLE_TIMEOUT_POOL_RECV (millis)
+#define POOL_HANDLER_FAST 			(BLE_TIMEOUT_POOL_RECV / 4)
+
+////// Variables
+
+static int32_t mProcessed[POOL_LINES_MAX];		// Sequences processed (in order)
+static uint8_t mProcessedCount = 0;
+
+static uint32_t mHandlerTime = 0;				// Time of handler (millis)
+
+static uint64_t mBlocked = 0;					// Time blocked in writes (micros)
+
+////// Message (as a module of App)
+
+static void msgPool(const char* message, uint16_t size, FieldsView& fields, string& response) {
+
+	if (mProcessedCount < POOL_LINES_MAX) {
+		mProcessed[mProcessedCount++] = fields.getInt(2);
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(mHandlerTime));
+}
+
+static MsgRegister mMsgPool(43, msgPool, NULL, MSG_FLAG_NONE);
+
+////// Routines
+
+/**
+ * @brief Burst of lines (each write is a BLE packet), short or large (uses the pool)
+ */
+static BleReceiveStats_t burst(uint8_t policy, uint8_t lines, bool large, uint32_t handlerTime) {
+
+	BleServer server; // Only to set the policy and get the statistics
+
+	server.setReceivePolicy(policy);
+
+	mProcessedCount = 0;
+	mHandlerTime = handlerTime;
+	mBlocked = 0;
+
+	BleReceiveStats_t start = server.getReceiveStats();
+
+	for (uint8_t seq = 0; seq < lines; seq++) {
+
+		char line[BLE_RECV_SHORT_SIZE * 2];
+
+		uint16_t size = snprintf(line, sizeof(line), "43:%u:", seq);
+
+		// Large - padded to more than a short line
+
+		while (large && size <= BLE_RECV_SHORT_SIZE) {
+			line[size++] = 'a' + (seq % 26);
+		}
+
+		line[size++] = '\n';
+
+		uint64_t before = simTime();
+
+		TEST_CHECK(ble_loopback_Write(line, size) == ESP_OK);
+
+		mBlocked += (simTime() - before);
+	}
+
+	// Wait the processing of lines queued
+
+	vTaskDelay(pdMS_TO_TICKS((lines + 2) * handlerTime));
+
+	BleReceiveStats_t stats = server.getReceiveStats();
+
+	stats.received -= start.received;
+	stats.processed -= start.processed;
+	stats.dropped -= start.dropped;
+	stats.poolFull -= start.poolFull;
+
+	printf("test_receive_pool: policy %u %s received %u processed %u dropped %u pool full %u high water %u, blocked %llu us\n",
+				policy, (large) ? "large" : "short", stats.received, stats.processed, stats.dropped,
+				stats.poolFull, stats.highWater, (unsigned long long) mBlocked);
+
+	TEST_CHECK(stats.received == lines && (stats.processed + stats.dropped) == lines);
+	TEST_CHECK(mProcessedCount == stats.processed);
+
+	for (uint8_t i = 1; i < mProcessedCount; i++) {
+		TEST_CHECK(mProcessed[i] > mProcessed[i - 1]);
+	}
+
+	return stats;
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void poolMain(void* arg) {
+
+	app_main();
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	ble_loopback_Connect(100);
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	TEST_CHECK(BLE_SIZE_QUEUE_RECV > BLE_SIZE_POOL_RECV);
+
+	// Short lines - all queue (deeper than pool), no drops and no blocking
+
+	BleReceiveStats_t stats = burst(BLE_RECV_POLICY_DROP_NEWEST, BLE_SIZE_QUEUE_RECV, false, POOL_HANDLER_SLOW);
+
+	TEST_CHECK(stats.dropped == 0 && stats.poolFull == 0);
+	TEST_CHECK(stats.highWater == BLE_SIZE_QUEUE_RECV);
+	TEST_CHECK(mBlocked == 0);
+
+	// Large lines, handler fast - the backpressure waits the buffers, no drops
+
+	stats = burst(BLE_RECV_POLICY_DROP_NEWEST, BLE_SIZE_QUEUE_RECV + 4, true, POOL_HANDLER_FAST);
+
+	TEST_CHECK(stats.dropped == 0 && stats.poolFull > 0);
+	TEST_CHECK(mBlocked > 0);
+
+	// Large lines, handler slow - waits (bounded), after drop the newest
+
+	uint8_t extra = 3;
+
+	stats = burst(BLE_RECV_POLICY_DROP_NEWEST, BLE_SIZE_POOL_RECV + extra, true, POOL_HANDLER_SLOW);
+
+	TEST_CHECK(stats.processed == BLE_SIZE_POOL_RECV && stats.dropped == extra && stats.poolFull == extra);
+	TEST_CHECK(mProcessed[0] == 0 && mProcessed[mProcessedCount - 1] == (BLE_SIZE_POOL_RECV - 1));
+	TEST_CHECK(mBlocked >= (extra * BLE_TIMEOUT_POOL_RECV * 1000ull) && mBlocked <= ((extra + 1) * BLE_TIMEOUT_POOL_RECV * 1000ull));
+
+	// Large lines, handler slow - waits (bounded), after drop the oldest (the last line is processed)
+
+	stats = burst(BLE_RECV_POLICY_DROP_OLDEST, BLE_SIZE_POOL_RECV + extra, true, POOL_HANDLER_SLOW);
+
+	TEST_CHECK(stats.dropped == extra && stats.poolFull == extra);
+	TEST_CHECK(mProcessed[mProcessedCount - 1] == (BLE_SIZE_POOL_RECV + extra - 1));
+
+	ble_loopback_Disconnect();
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simLogLevel(ESP_LOG_ERROR); // Without the warnings of lines dropped
+
+	simRun(poolMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_receive_pool");
+}
+
+//////// End
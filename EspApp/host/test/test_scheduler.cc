@@ -0,0 +1,338 @@
+/*
+ * test_scheduler.cc - the timer wheel (util/scheduler) by a virtual clock (millis of the test)
+ * The loop sleeps exactly the time returned by run (as main_Task), or less (wakes by notifications)
+ * Checks the time of each call of jobs: one-shot, periodic without drift, restart after a long sleep,
+ * cancel, jobs in same slot (deadlines after some turns of wheel), the overflow of millis and a run after
+ * a very long sleep (the run jumps to the deadlines, the periodic is called for each one)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "util/scheduler.h"
+
+#include "test.h"
+
+////// Definitions
+
+#define TEST_CALLS_MAX 			64				// Times of calls saved by job
+
+////// Types
+
+typedef struct {
+	uint32_t calls;							// Number of calls
+	uint32_t times[TEST_CALLS_MAX];			// Time (millis) of first calls
+} TestJob_t;
+
+////// Variables
+
+static uint32_t mNow = 0;					// Virtual clock (millis)
+
+static Scheduler mScheduler;
+
+////// Routines
+
+/**
+ * @brief Job - save the time of call
+ */
+static void job(void* arg) {
+
+	TestJob_t* test = (TestJob_t*) arg;
+
+	if (test->calls < TEST_CALLS_MAX) {
+		test->times[test->calls] = mNow;
+	}
+
+	test->calls++;
+}
+
+/**
+ * @brief Job - cancel other (the argument is the id)
+ */
+static void jobCancel(void* arg) {
+
+	mScheduler.cancel(*(int8_t*) arg);
+}
+
+/**
+ * @brief Run the scheduler until a time, sleeping exactly until each deadline (or max of sleep)
+ */
+static void runUntil(uint32_t end, uint32_t sleepMax = 0xFFFFFFFF) {
+
+	uint32_t wait = mScheduler.run(mNow);
+
+	while ((int32_t)(end - mNow) > 0) {
+
+		if (wait > sleepMax) {
+			wait = sleepMax;
+		}
+		if (wait > (end - mNow)) {
+			wait = (end - mNow);
+		}
+
+		mNow += wait;
+
+		wait = mScheduler.run(mNow);
+	}
+}
+
+/**
+ * @brief Begin the scheduler in a time (removes the jobs of previous test)
+ */
+static void begin(uint32_t now) {
+
+	mScheduler = Scheduler();
+
+	mNow = now;
+
+	mScheduler.begin(mNow);
+}
+
+////// Tests
+
+/**
+ * @brief One-shot - called once, in deadline, and is not active after it
+ */
+static void testOneShot() {
+
+	begin(0);
+
+	TestJob_t test = {};
+
+	int8_t id = mScheduler.add(mNow, job, 1000u, 0, &test);
+
+	TEST_CHECK(id != SCHEDULER_NONE);
+	TEST_CHECK(mScheduler.next(mNow) == 1000u);
+
+	runUntil(5000u);
+
+	TEST_CHECK(test.calls == 1);
+	TEST_CHECK(test.times[0] == 1000u);
+	TEST_CHECK(!mScheduler.active(id));
+	TEST_CHECK(mScheduler.next(mNow) == SCHEDULER_NO_DEADLINE);
+}
+
+/**
+ * @brief Periodic - no drift, also waking before the deadline (as notifications of task)
+ */
+static void testPeriodic() {
+
+	begin(0);
+
+	TestJob_t test = {};
+
+	mScheduler.add(mNow, job, 1000u, 1000u, &test);
+
+	runUntil(3600000u, 370u); // One hour, waking each 370 ms (at most)
+
+	TEST_CHECK(test.calls == 3600);
+
+	bool exact = true;
+
+	for (uint32_t i = 0; i < TEST_CALLS_MAX; i++) {
+		exact &= (test.times[i] == ((i + 1) * 1000u));
+	}
+
+	TEST_CHECK(exact);
+}
+
+/**
+ * @brief Restart after a long sleep of task - the deadline is from the time of restart,
+ * not from the last run (it was run immediately before)
+ */
+static void testRestartAfterSleep() {
+
+	begin(0);
+
+	TestJob_t test = {};
+
+	int8_t id = mScheduler.add(mNow, job, 60000u, 0, &test);
+
+	mScheduler.run(mNow);
+
+	// Task sleeps 50 seconds (no deadline), and is waked by a message, that restarts the job
+
+	mNow = 50000u;
+
+	TEST_CHECK(mScheduler.restart(mNow, id, 1000u));
+
+	TEST_CHECK(mScheduler.next(mNow) == 1000u);
+
+	mScheduler.run(mNow);
+
+	TEST_CHECK(test.calls == 0);
+
+	runUntil(120000u);
+
+	TEST_CHECK(test.calls == 1);
+	TEST_CHECK(test.times[0] == 51000u);
+
+	// Add after a long sleep too
+
+	TestJob_t other = {};
+
+	mNow += 30000u;
+
+	mScheduler.add(mNow, job, 500u, 0, &other);
+
+	uint32_t added = mNow;
+
+	runUntil(mNow + 10000u);
+
+	TEST_CHECK(other.calls == 1);
+	TEST_CHECK(other.times[0] == (added + 500u));
+}
+
+/**
+ * @brief Restart by a job late (run after a long sleep) - the deadline is from the time of restart too
+ */
+static TestJob_t mLate = {};
+
+static void jobLate(void* arg) {
+
+	job(&mLate);
+
+	if (mLate.calls == 1) {
+		mScheduler.add(mNow, job, 100u, 0, arg);
+	}
+}
+
+static void testRestartByJob() {
+
+	begin(0);
+
+	TestJob_t test = {};
+
+	mScheduler.add(mNow, jobLate, 1000u, 0, &test);
+
+	// Run late (5 seconds after the deadline)
+
+	mNow = 6000u;
+
+	runUntil(10000u);
+
+	TEST_CHECK(mLate.calls == 1);
+	TEST_CHECK(test.calls == 1);
+	TEST_CHECK(test.times[0] == 6100u);
+}
+
+/**
+ * @brief Cancel - by caller and by other job in same tick
+ */
+static void testCancel() {
+
+	begin(0);
+
+	TestJob_t first = {};
+	TestJob_t second = {};
+
+	int8_t id = mScheduler.add(mNow, job, 1000u, 0, &first);
+
+	mScheduler.cancel(id);
+
+	TEST_CHECK(!mScheduler.active(id));
+	TEST_CHECK(!mScheduler.restart(mNow, id, 1000u));
+
+	// Same tick - the last added is called first (head of slot), so it cancels the other, already due
+
+	int8_t victim = mScheduler.add(mNow, job, 2000u, 0, &second);
+
+	mScheduler.add(mNow, jobCancel, 2000u, 0, &victim);
+
+	runUntil(10000u);
+
+	TEST_CHECK(first.calls == 0);
+	TEST_CHECK(second.calls == 0);
+}
+
+/**
+ * @brief Jobs in same slot (deadlines in different turns of wheel), and maximum of jobs
+ */
+static void testSlots() {
+
+	begin(0);
+
+	const uint32_t turn = (SCHEDULER_SLOTS * SCHEDULER_TICK_MS);
+
+	TestJob_t tests[SCHEDULER_JOBS_MAX] = {};
+
+	for (uint8_t i = 0; i < SCHEDULER_JOBS_MAX; i++) {
+		TEST_CHECK(mScheduler.add(mNow, job, 100u + (i * turn), 0, &tests[i]) != SCHEDULER_NONE);
+	}
+
+	TEST_CHECK(mScheduler.add(mNow, job, 100u) == SCHEDULER_NONE);
+
+	runUntil(100u + (SCHEDULER_JOBS_MAX * turn));
+
+	for (uint8_t i = 0; i < SCHEDULER_JOBS_MAX; i++) {
+		TEST_CHECK(tests[i].calls == 1);
+		TEST_CHECK(tests[i].times[0] == 100u + (i * turn));
+	}
+}
+
+/**
+ * @brief Overflow of millis (about 49 days)
+ */
+static void testOverflow() {
+
+	begin(0xFFFFFFFFu - 2500u);
+
+	uint32_t start = mNow;
+
+	TestJob_t test = {};
+
+	mScheduler.add(mNow, job, 1000u, 1000u, &test);
+
+	runUntil(start + 10000u);
+
+	TEST_CHECK(test.calls == 10);
+	TEST_CHECK(test.times[2] == start + 3000u);
+	TEST_CHECK(test.times[9] == start + 10000u);
+}
+
+/**
+ * @brief Run after a very long sleep (one day) - the periodic is called for each deadline elapsed
+ */
+static void testLongSleep() {
+
+	begin(0);
+
+	TestJob_t periodic = {};
+	TestJob_t later = {};
+
+	const uint32_t hour = 3600000u;
+
+	mScheduler.add(mNow, job, hour, hour, &periodic);
+	mScheduler.add(mNow, job, 25u * hour, 0, &later);
+
+	mNow = (24u * hour) + 5u;
+
+	uint32_t wait = mScheduler.run(mNow);
+
+	TEST_CHECK(periodic.calls == 24);
+	TEST_CHECK(later.calls == 0);
+	TEST_CHECK(wait == (hour - 5u));
+
+	runUntil(26u * hour);
+
+	TEST_CHECK(periodic.calls == 26 && periodic.times[25] == (26u * hour));
+	TEST_CHECK(later.calls == 1 && later.times[0] == (25u * hour));
+}
+
+////// Main
+
+int main() {
+
+	testOneShot();
+	testPeriodic();
+	testRestartAfterSleep();
+	testRestartByJob();
+	testCancel();
+	testSlots();
+	testOverflow();
+	testLongSleep();
+
+	return testResult("scheduler");
+}
+
+//////// End
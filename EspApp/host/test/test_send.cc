@@ -0,0 +1,337 @@
+/*
+ * test_send.cc - queue to send of BleServer against a stand-in of GATT layer, that simulates the congestion
+ * The stand-in have few buffers of notifications, drained in each connection event (by a timer),
+ * it signals the congestion when the buffers is full, and the end when half of them is free
+ * Checks the policies of queue (block, drop and overwrite), the order of data and the statistics,
+ * and the pool of buffers to send after a disconnection with data in queue (all buffers returns)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sim.h"
+
+#include "util/ble_server.h"
+
+#include "test.h"
+
+////// Definitions
+
+#define GATT_BUFFERS 				8			// Buffers of notifications
+#define GATT_PACKETS 				4			// Notifications by connection event
+#define GATT_INTERVAL 				30000		// Interval of connection events (micros)
+#define GATT_MTU 					100
+
+#define SEND_MESSAGES 				300			// Messages sended by phase
+
+////// Variables
+
+// Stand-in of GATT
+
+static void (*mCallbackConnection)() = NULL;
+static void (*mCallbackMTU)() = NULL;
+static void (*mCallbackCongestion)(bool congested) = NULL;
+
+static bool mGattConnected = false;
+static bool mGattCongested = false;
+static uint8_t mGattBuffered = 0;				// Notifications in buffers (not delivered)
+static uint32_t mGattLost = 0;					// Sended with buffers full (not waited the congestion)
+static char mGattData[GATT_BUFFERS][GATT_MTU];	// Data of buffers (circular)
+static uint8_t mGattHead = 0;
+
+static esp_timer_handle_t mTimer = NULL;		// Connection events
+
+// Client
+
+static uint32_t mReceived = 0;					// Messages received
+static int32_t mLastSeq = -1;					// Last sequence received
+static uint32_t mOutOfOrder = 0;				// Sequences not increasing
+
+////// Stand-in of GATT (transport)
+
+static esp_err_t gattInitialize(const char* deviceName) {
+
+	return ESP_OK;
+}
+
+static esp_err_t gattFinalize() {
+
+	return ESP_OK;
+}
+
+static void gattSetCallbackConnection(void (*callbackConnection)(), void (*callbackMTU)()) {
+
+	mCallbackConnection = callbackConnection;
+	mCallbackMTU = callbackMTU;
+}
+
+static void gattSetCallbackReceiveData(void (*callbackReceived)(char* data, uint16_t size)) {
+}
+
+static void gattSetCallbackCongestion(void (*callbackCongestion)(bool congested)) {
+
+	mCallbackCongestion = callbackCongestion;
+}
+
+static bool gattClientConnected() {
+
+	return mGattConnected;
+}
+
+/**
+ * @brief Notification - to buffers, congested when it is full
+ */
+static esp_err_t gattSendData(const char* data, uint16_t size) {
+
+	if (!mGattConnected) {
+		return ESP_FAIL;
+	}
+
+	if (mGattBuffered == GATT_BUFFERS) {
+		mGattLost++;
+		return ESP_FAIL;
+	}
+
+	char* buffer = mGattData[(mGattHead + mGattBuffered) % GATT_BUFFERS];
+
+	memcpy(buffer, data, (size < GATT_MTU) ? size : GATT_MTU - 1);
+	buffer[(size < GATT_MTU) ? size : GATT_MTU - 1] = '\0';
+
+	mGattBuffered++;
+
+	if (mGattBuffered == GATT_BUFFERS && !mGattCongested) {
+		mGattCongested = true;
+		mCallbackCongestion(true);
+	}
+
+	return ESP_OK;
+}
+
+static uint16_t gattMTU() {
+
+	return GATT_MTU;
+}
+
+static const uint8_t* gattMacAddress() {
+
+	static const uint8_t mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+	return mac;
+}
+
+static const BleTransport_t mGatt = {
+	"gatt stand-in",
+	gattInitialize,
+	gattFinalize,
+	gattSetCallbackConnection,
+	gattSetCallbackReceiveData,
+	gattSetCallbackCongestion,
+	gattClientConnected,
+	gattSendData,
+	gattMTU,
+	gattMacAddress
+};
+
+/**
+ * @brief Connection event - delivers notifications to client, and ends the congestion
+ */
+static void gattEvent(void* arg) {
+
+	for (uint8_t i = 0; i < GATT_PACKETS && mGattBuffered > 0; i++) {
+
+		const char* data = mGattData[mGattHead];
+
+		mGattHead = (mGattHead + 1) % GATT_BUFFERS;
+		mGattBuffered--;
+
+		// Client - 70:seq
+
+		int32_t seq = atoi(data + 3);
+
+		if (seq <= mLastSeq) {
+			mOutOfOrder++;
+		}
+
+		mLastSeq = seq;
+		mReceived++;
+	}
+
+	if (mGattCongested && mGattBuffered <= (GATT_BUFFERS / 2)) {
+		mGattCongested = false;
+		mCallbackCongestion(false);
+	}
+}
+
+////// Server
+
+class TestCallbacks: public BleServerCallbacks {
+
+	void onConnect() {}
+	void onDisconnect() {}
+	void onReceive(const char* message, uint16_t size) {}
+};
+
+static BleServer mServer;
+static TestCallbacks mCallbacks;
+
+/**
+ * @brief Send the messages (burst) - waits until all is sended or dropped
+ */
+static BleSendStats_t sendMessages(uint8_t policy) {
+
+	mServer.setSendPolicy(policy);
+
+	mReceived = 0;
+	mLastSeq = -1;
+	mOutOfOrder = 0;
+
+	BleSendStats_t start = mServer.getSendStats();
+
+	for (uint32_t seq = 0; seq < SEND_MESSAGES; seq++) {
+
+		char line[20];
+
+		snprintf(line, sizeof(line), "70:%05u", seq);
+
+		mServer.send(line);
+	}
+
+	// Wait the queue and buffers
+
+	for (uint16_t i = 0; i < 500; i++) {
+
+		BleSendStats_t stats = mServer.getSendStats();
+
+		if ((stats.sent + stats.dropped + stats.failed) == stats.queued && mGattBuffered == 0) {
+			break;
+		}
+
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+
+	BleSendStats_t stats = mServer.getSendStats();
+
+	stats.queued -= start.queued;
+	stats.sent -= start.sent;
+	stats.dropped -= start.dropped;
+	stats.failed -= start.failed;
+	stats.congestions -= start.congestions;
+	stats.congestedTime -= start.congestedTime;
+
+	printf("test_send: policy %u queued %u sent %u dropped %u failed %u congestions %u congested %u ms, " \
+				"received %u last %d out of order %u lost %u\n",
+				policy, stats.queued, stats.sent, stats.dropped, stats.failed,
+				stats.congestions, stats.congestedTime, mReceived, mLastSeq, mOutOfOrder, mGattLost);
+
+	return stats;
+}
+
+/**
+ * @brief Main of simulation
+ */
+static void sendMain(void* arg) {
+
+	mServer.setTransport(&mGatt);
+	mServer.initialize("test", &mCallbacks);
+
+	esp_timer_create_args_t timerArgs;
+
+	timerArgs.callback = gattEvent;
+	timerArgs.arg = NULL;
+	timerArgs.dispatch_method = ESP_TIMER_TASK;
+	timerArgs.name = "gattEvent";
+
+	esp_timer_create(&timerArgs, &mTimer);
+	esp_timer_start_periodic(mTimer, GATT_INTERVAL);
+
+	// Connection
+
+	mGattConnected = true;
+	mCallbackConnection();
+	mCallbackMTU();
+
+	vTaskDelay(pdMS_TO_TICKS(100));
+
+	TEST_CHECK(mServer.connected());
+
+	// Block - waits the congestion, nothing is lost
+
+	BleSendStats_t stats = sendMessages(BLE_SEND_POLICY_BLOCK);
+
+	TEST_CHECK(stats.queued == SEND_MESSAGES);
+	TEST_CHECK(stats.sent == SEND_MESSAGES && stats.dropped == 0 && stats.failed == 0);
+	TEST_CHECK(stats.congestions > 0 && stats.congestedTime > 0);
+	TEST_CHECK(mReceived == SEND_MESSAGES && mLastSeq == (SEND_MESSAGES - 1) && mOutOfOrder == 0);
+
+	// Drop the new - the oldest is sended
+
+	stats = sendMessages(BLE_SEND_POLICY_DROP);
+
+	uint32_t sentDrop = stats.sent;
+
+	TEST_CHECK(stats.dropped > 0 && (stats.sent + stats.dropped) == SEND_MESSAGES);
+	TEST_CHECK(mReceived == stats.sent && mOutOfOrder == 0);
+	TEST_CHECK(mLastSeq < (SEND_MESSAGES - 1));
+
+	// Overwrite the oldest - the last is sended
+
+	stats = sendMessages(BLE_SEND_POLICY_OVERWRITE);
+
+	TEST_CHECK(stats.dropped > 0 && (stats.sent + stats.dropped) == SEND_MESSAGES);
+	TEST_CHECK(mReceived == stats.sent && mOutOfOrder == 0);
+	TEST_CHECK(mLastSeq == (SEND_MESSAGES - 1));
+
+	// Never sended with the buffers full (the task waits the end of congestion)
+
+	TEST_CHECK(mGattLost == 0);
+
+	// Disconnection with data in queue (dropped) - the buffers returns to pool
+
+	mServer.setSendPolicy(BLE_SEND_POLICY_DROP);
+
+	for (uint32_t seq = 0; seq < (BLE_SIZE_QUEUE_SEND * 2); seq++) {
+		mServer.send("70:99999");
+	}
+
+	mGattConnected = false;
+	mCallbackConnection();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	TEST_CHECK(!mServer.connected());
+
+	mGattConnected = true;
+	mCallbackConnection();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	// All buffers - the same sended by the burst with drop of new
+
+	stats = sendMessages(BLE_SEND_POLICY_DROP);
+
+	TEST_CHECK(stats.sent == sentDrop && (stats.sent + stats.dropped) == SEND_MESSAGES);
+	TEST_CHECK(mReceived == stats.sent && mOutOfOrder == 0);
+
+	esp_timer_stop(mTimer);
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simRun(sendMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_send");
+}
+
+//////// End
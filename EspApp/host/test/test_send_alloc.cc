@@ -0,0 +1,146 @@
+/*
+ * test_send_alloc.cc - allocations and copies of the path to send (bleSendData -> BleServer -> transport)
+ * Counts the allocations of heap by sending (must be zero), checks that the data of caller is not changed
+ * (the new line is added without change it), and that the data with NULs is not truncated
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+#include "sim_link.h"
+
+#include "test.h"
+
+using namespace std;
+
+////// Firmware
+
+extern "C" void app_main();
+
+extern void bleSendData(const char* data);
+extern void bleSendData(const string& data);
+extern void bleSendData(const char* data, uint16_t size);
+
+////// Definitions
+
+#define SEND_ROUNDS 				200
+
+////// Variables
+
+static char mReceived[4096];					// Data received by client (by round)
+static uint16_t mReceivedSize = 0;
+static uint32_t mNotifications = 0;
+
+////// Routines
+
+/**
+ * @brief Data received by client
+ */
+static void clientReceive(const char* data, uint16_t size) {
+
+	if ((mReceivedSize + size) <= sizeof(mReceived)) {
+		memcpy(mReceived + mReceivedSize, data, size);
+		mReceivedSize += size;
+	}
+
+	mNotifications++;
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void allocMain(void* arg) {
+
+	app_main();
+
+	SimLinkConfig_t config = { 100, 30000, 6, SIM_LINK_BUFFERS_MAX };
+
+	simLinkStart(config, clientReceive);
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	simLinkConnect();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	// Data: small, with NULs and larger than MTU (splitted in parts), and a string
+
+	char small[] = "80:";
+	char withNul[] = { '7', '0', ':', 'a', '\0', 'b', '\0', 'c' };
+
+	char large[260];
+	memcpy(large, "70:", 3);
+	for (uint16_t i = 3; i < sizeof(large); i++) {
+		large[i] = 'a' + (i % 26);
+	}
+
+	const string message = "11:FMEM:187432";
+
+	// Expected by client (with the new lines)
+
+	string expected;
+
+	expected.append(small).append(1u, '\n');
+	expected.append(withNul, sizeof(withNul)).append(1u, '\n');
+	expected.append(large, sizeof(large)).append(1u, '\n');
+	expected.append(message).append(1u, '\n');
+
+	char copyLarge[sizeof(large)];
+	memcpy(copyLarge, large, sizeof(large));
+
+	uint64_t allocations = 0;
+	uint32_t mismatches = 0;
+
+	for (uint16_t round = 0; round < SEND_ROUNDS; round++) {
+
+		mReceivedSize = 0;
+
+		uint64_t before = simAllocations();
+
+		bleSendData(small);
+		bleSendData(withNul, sizeof(withNul));
+		bleSendData(large, sizeof(large));
+		bleSendData(message);
+
+		allocations += (simAllocations() - before);
+
+		vTaskDelay(pdMS_TO_TICKS(500));
+
+		if (mReceivedSize != expected.size() || memcmp(mReceived, expected.data(), mReceivedSize) != 0) {
+			mismatches++;
+		}
+	}
+
+	printf("test_send_alloc: %u sends, %llu allocations (%.3f by send), notifications %u, mismatches %u\n",
+				SEND_ROUNDS * 4, (unsigned long long) allocations, (double) allocations / (SEND_ROUNDS * 4),
+				mNotifications, mismatches);
+
+	TEST_CHECK(allocations == 0);
+	TEST_CHECK(mismatches == 0);
+	TEST_CHECK(memcmp(large, copyLarge, sizeof(large)) == 0 && strcmp(small, "80:") == 0); // Not changed
+	TEST_CHECK(simLinkStats().lost == 0);
+
+	simLinkDisconnect();
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simRun(allocMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_send_alloc");
+}
+
+//////// End
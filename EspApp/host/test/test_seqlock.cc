@@ -0,0 +1,168 @@
+/*
+ * test_seqlock.cc - snapshot by sequence lock (util/seqlock.h) with the writer preempted in the middle of write
+ * The writer (low priority) stops in the middle of copy of value (sequence odd), and the reader (high
+ * priority) runs in this time: it must not spin forever (sleeps to the writer finish), and never see a
+ * value half written
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+
+#include "util/seqlock.h"
+
+#include "test.h"
+
+////// Definitions
+
+#define SEQLOCK_WRITES 				200
+#define SEQLOCK_ITEMS 				8
+
+////// Types
+
+// Value - the copy by writer stops in the middle (as preempted)
+
+struct Value {
+
+	uint32_t items[SEQLOCK_ITEMS];
+
+	Value& operator=(const Value& other);
+};
+
+////// Variables
+
+static TaskHandle_t mWriter = NULL;
+
+static SeqSnapshot <Value> mSnapshot;
+
+static volatile bool mWriting = false;			// Writer stopped in the middle of write ?
+static volatile bool mDone = false;				// Writer done ?
+
+static uint32_t mReads = 0;						// Reads
+static uint32_t mReadsPreempted = 0;			// Reads with the writer stopped in the middle
+static uint32_t mTorn = 0;						// Reads of a value half written
+static uint32_t mBackwards = 0;					// Reads of a value older than the previous
+
+////// Routines
+
+/**
+ * @brief Copy of value - the writer stops in the middle (a tick), the others copy all
+ */
+Value& Value::operator=(const Value& other) {
+
+	memcpy(items, other.items, sizeof(items) / 2);
+
+	if (xTaskGetCurrentTaskHandle() == mWriter) {
+
+		mWriting = true;
+		vTaskDelay(1);
+		mWriting = false;
+	}
+
+	memcpy(items + (SEQLOCK_ITEMS / 2), other.items + (SEQLOCK_ITEMS / 2), sizeof(items) / 2);
+
+	return *this;
+}
+
+/**
+ * @brief Task writer (low priority)
+ */
+static void writerTask(void* arg) {
+
+	Value value;
+
+	for (uint32_t write = 1; write <= SEQLOCK_WRITES; write++) {
+
+		for (uint8_t i = 0; i < SEQLOCK_ITEMS; i++) {
+			value.items[i] = write;
+		}
+
+		mSnapshot.write(value);
+
+		vTaskDelay(1);
+	}
+
+	mDone = true;
+
+	vTaskDelete(NULL);
+}
+
+/**
+ * @brief Task reader (high priority) - reads each tick, until the writer is done
+ */
+static void readerTask(void* arg) {
+
+	uint32_t last = 0;
+
+	while (!mDone) {
+
+		mReadsPreempted += mWriting;
+
+		Value value;
+
+		mSnapshot.read(value);
+
+		mReads++;
+
+		for (uint8_t i = 1; i < SEQLOCK_ITEMS; i++) {
+			if (value.items[i] != value.items[0]) {
+				mTorn++;
+				break;
+			}
+		}
+
+		mBackwards += (value.items[0] < last);
+		last = value.items[0];
+
+		vTaskDelay(1);
+	}
+
+	vTaskDelete(NULL);
+}
+
+/**
+ * @brief Main of simulation
+ */
+static void seqlockMain(void* arg) {
+
+	xTaskCreatePinnedToCore(&writerTask, "writer", 4096, NULL, 2, &mWriter, 0);
+	xTaskCreatePinnedToCore(&readerTask, "reader", 4096, NULL, 10, NULL, 0);
+
+	for (uint16_t i = 0; i < 1000 && !mDone; i++) {
+		vTaskDelay(pdMS_TO_TICKS(100));
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(100));
+
+	Value value;
+
+	mSnapshot.read(value);
+
+	printf("test_seqlock: %u writes, %u reads (%u with the writer preempted), torn %u, backwards %u\n",
+				mSnapshot.writes(), mReads, mReadsPreempted, mTorn, mBackwards);
+
+	TEST_CHECK(mDone);
+	TEST_CHECK(mSnapshot.writes() == SEQLOCK_WRITES && value.items[0] == SEQLOCK_WRITES);
+	TEST_CHECK(mReads > 0 && mReadsPreempted > 0);
+	TEST_CHECK(mTorn == 0 && mBackwards == 0);
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simRun(seqlockMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_seqlock");
+}
+
+//////// End
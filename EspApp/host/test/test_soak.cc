@@ -0,0 +1,391 @@
+/*
+ * test_soak.cc - soak test: 24 hours (virtual clock) of the firmware - main_Task (jobs by scheduler),
+ * processBleMessage and the reassembler of lines, with a client by the simulated link
+ * Sessions of one hour (reconnections), messages splitted in packets or joined in writes,
+ * and lines abandoned (timeout of reassembler)
+ * Reports the throughput and the latency (round trip) - fails if a response is lost or wrong
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sim.h"
+#include "sim_link.h"
+
+#include "test.h"
+
+////// Firmware
+
+extern "C" void app_main();
+extern uint32_t timeSeconds();
+
+
+////// Definitions
+
+#define SOAK_SESSIONS 				24				// Sessions of one hour (24 hours)
+#define SOAK_SESSION_TIME 			3600000000ull	// Time of session (micros)
+#define SOAK_MESSAGES_TIME 			3590000000ull	// Time of messages in session (micros)
+#define SOAK_PENDING_MAX 			64				// Responses pending
+
+#define SOAK_SECOND 				1000000ull
+
+////// Types
+
+typedef struct {
+	char line[200];				// Response expected
+	uint16_t size;
+	bool prefix;				// Only the prefix ?
+	uint64_t sent;				// Time of request
+} SoakExpected_t;
+
+////// Variables
+
+static SoakExpected_t mExpected[SOAK_PENDING_MAX];	// Responses expected (FIFO)
+static uint8_t mExpectedHead = 0;
+static uint8_t mExpectedCount = 0;
+
+static char mLine[512];							// Line received by client (joined)
+static uint16_t mLineSize = 0;
+
+static TestLatency mLatency;					// Round trip
+
+static uint32_t mRequests = 0;					// Messages sended
+static uint32_t mResponses = 0;					// Responses received
+static uint32_t mMismatches = 0;				// Responses wrong
+static uint32_t mUnexpected = 0;				// Responses not expected
+static uint32_t mMoreLines = 0;					// Lines of responses more than one (11:ALL)
+static uint32_t mAbandoned = 0;					// Lines abandoned
+static uint64_t mBytesUp = 0;					// Bytes sended by client
+static uint64_t mBytesDown = 0;					// Bytes received by client
+
+static uint64_t mTimeInitial = 0;				// Time of response of 01 (reset of time)
+static uint64_t mAllocations = 0;				// Allocations in soak
+
+static uint32_t mRandom = 20171026;				// Random (deterministic)
+
+////// Routines
+
+/**
+ * @brief Random number (0 to max - 1)
+ */
+static uint32_t random(uint32_t max) {
+
+	mRandom = (mRandom * 1103515245u) + 12345u;
+
+	return ((mRandom >> 8) % max);
+}
+
+/**
+ * @brief Expect a response
+ */
+static void expect(const char* line, uint16_t size, bool prefix) {
+
+	TEST_CHECK(mExpectedCount < SOAK_PENDING_MAX);
+
+	SoakExpected_t& expected = mExpected[(mExpectedHead + mExpectedCount) % SOAK_PENDING_MAX];
+
+	memcpy(expected.line, line, size);
+	expected.size = size;
+	expected.prefix = prefix;
+	expected.sent = simTime();
+
+	mExpectedCount++;
+}
+
+/**
+ * @brief Send data (lines) - writes in parts of random sizes (as a client of BLE)
+ */
+static void send(const char* data, uint16_t size) {
+
+	for (uint16_t pos = 0; pos < size; ) {
+
+		uint16_t part = 1 + random(40);
+
+		if (part > (size - pos)) {
+			part = (size - pos);
+		}
+
+		TEST_CHECK(simLinkWrite(data + pos, part));
+
+		pos += part;
+	}
+
+	mBytesUp += size;
+}
+
+/**
+ * @brief Append a request (line) to buffer of send
+ */
+static void request(char* buffer, uint16_t& size, const char* line, const char* response, bool prefix) {
+
+	uint16_t sizeLine = strlen(line);
+
+	memcpy(buffer + size, line, sizeLine);
+	size += sizeLine;
+	buffer[size++] = '\n';
+
+	if (response != NULL) {
+		expect(response, strlen(response), prefix);
+	}
+
+	mRequests++;
+}
+
+/**
+ * @brief Line received by client
+ */
+static void receiveLine(const char* line, uint16_t size) {
+
+	if (mExpectedCount == 0) {
+
+		if (mUnexpected++ < 5) {
+			printf("soak: unexpected line: %.*s\n", size, line);
+		}
+		return;
+	}
+
+	SoakExpected_t& expected = mExpected[mExpectedHead];
+
+	bool match = (expected.prefix) ?
+					(size >= expected.size && memcmp(line, expected.line, expected.size) == 0) :
+					(size == expected.size && memcmp(line, expected.line, size) == 0);
+
+	if (!match && mMismatches++ < 5) {
+		printf("soak: expected %.*s, received %.*s\n", expected.size, expected.line, size, line);
+	}
+
+	if (memcmp(line, "01:", 3) == 0) {
+		mTimeInitial = simTime();
+	}
+
+	mLatency.add(simTime() - expected.sent);
+	mResponses++;
+
+	mExpectedHead = (mExpectedHead + 1) % SOAK_PENDING_MAX;
+	mExpectedCount--;
+}
+
+/**
+ * @brief Data received by client (notifications) - joins the lines
+ */
+static void clientReceive(const char* data, uint16_t size) {
+
+	mBytesDown += size;
+
+	for (uint16_t i = 0; i < size; i++) {
+
+		if (data[i] == '\n') {
+
+			receiveLine(mLine, mLineSize);
+			mLineSize = 0;
+
+		} else if (mLineSize < sizeof(mLine)) {
+
+			mLine[mLineSize++] = data[i];
+		}
+	}
+}
+
+/**
+ * @brief Wait the responses pending (until a timeout)
+ */
+static void waitResponses() {
+
+	for (uint8_t i = 0; i < 100 && mExpectedCount > 0; i++) {
+		vTaskDelay(pdMS_TO_TICKS(20));
+	}
+
+	TEST_CHECK(mExpectedCount == 0);
+
+	mExpectedCount = 0;
+}
+
+/**
+ * @brief Session of client (one hour) - connection, initial message and the messages by time
+ */
+static void session() {
+
+	char buffer[1024];
+	uint16_t size = 0;
+
+	uint64_t begin = simTime();
+
+	simLinkConnect();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	// Initial and logging deactivated (as the App in production)
+
+	request(buffer, size, "01:", "01:", true);
+	request(buffer, size, "71:N", NULL, false);
+	send(buffer, size);
+
+	waitResponses();
+
+	uint64_t start = simTime();
+	uint32_t second = 0;
+
+	// Messages (until some seconds before the end of session)
+
+	while ((simTime() - start) < SOAK_MESSAGES_TIME) {
+
+		second++;
+		size = 0;
+
+		// Feedback, each 10 seconds
+
+		if ((second % 10) == 0) {
+			request(buffer, size, "80:", "80:", false);
+		}
+
+		// Statistics, each minute
+
+		if ((second % 60) == 30) {
+			request(buffer, size, "11:BLE", "11:BLE:", true);
+		}
+
+		// All informations, each 10 minutes - the lines in order (ESP32 first)
+
+		if ((second % 600) == 200) {
+
+			request(buffer, size, "11:ALL", "11:ESP32:", true);
+
+			expect("11:FMEM:", 8, true);
+			expect("11:VDD33:", 9, true);
+			expect("11:BLE:", 7, true);
+			expect("11:BLERX:", 9, true);
+
+			mMoreLines += 4;
+		}
+
+		// Echo with random payload, each second
+
+		char echo[160];
+		uint16_t sizeEcho = snprintf(echo, sizeof(echo), "70:%u:", second);
+		uint16_t payload = 1 + random(120);
+
+		for (uint16_t i = 0; i < payload; i++) {
+			echo[sizeEcho++] = 'a' + ((second + i) % 26);
+		}
+		echo[sizeEcho] = '\0';
+
+		request(buffer, size, echo, echo, false);
+
+		send(buffer, size);
+
+		// Line abandoned (the rest is never sended), each 10 minutes - the reassembler must discard it
+
+		if ((second % 600) == 300) {
+
+			vTaskDelay(pdMS_TO_TICKS(200));
+
+			send("70:abandoned", 12);
+			mAbandoned++;
+
+			vTaskDelay(pdMS_TO_TICKS(2000));
+		}
+
+		// Next (with jitter)
+
+		vTaskDelay(pdMS_TO_TICKS(900 + random(200)));
+	}
+
+	waitResponses();
+
+	// The time of main_Task (jobs by scheduler) is counted since the initial message
+
+	uint32_t elapsed = (uint32_t) ((simTime() - mTimeInitial) / SOAK_SECOND);
+	uint32_t seconds = timeSeconds();
+
+	if (!TEST_CHECK(seconds + 1 >= elapsed && seconds <= elapsed + 1)) {
+		printf("soak: time of main_Task %u seconds, elapsed %u seconds\n", seconds, elapsed);
+	}
+
+	simLinkDisconnect();
+
+	// Disconnected until the end of session
+
+	uint64_t end = begin + SOAK_SESSION_TIME;
+
+	if (simTime() < end) {
+		vTaskDelay(pdMS_TO_TICKS((end - simTime()) / 1000u));
+	}
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void soakMain(void* arg) {
+
+	app_main();
+
+	// Link: MTU, interval of connection, notifications by event and buffers
+
+	SimLinkConfig_t config = { 100, 30000, 6, SIM_LINK_BUFFERS_MAX };
+
+	simLinkStart(config, clientReceive);
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	uint64_t allocations = simAllocations();
+
+	for (uint8_t i = 0; i < SOAK_SESSIONS; i++) {
+		session();
+	}
+
+	mAllocations = (simAllocations() - allocations);
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	simRun(soakMain, NULL, true);
+
+	double real = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double simulated = (double) simTime() / SOAK_SECOND;
+
+	const SimLinkStats_t& link = simLinkStats();
+
+	// Report
+
+	printf("soak: simulated %.1f hours in %.2f seconds (%.0fx)\n", simulated / 3600.0, real, simulated / real);
+	printf("soak: messages %u, responses %u, abandoned lines %u, mismatches %u, unexpected %u\n",
+				mRequests, mResponses, mAbandoned, mMismatches, mUnexpected);
+	printf("soak: throughput %.0f messages/s (real), %.1f messages/s (simulated)\n",
+				mRequests / real, mRequests / simulated);
+	printf("soak: bytes up %llu, down %llu, notifications %u, lost %u, connection events %u\n",
+				(unsigned long long) mBytesUp, (unsigned long long) mBytesDown,
+				link.notifications, link.lost, link.events);
+	printf("soak: round trip (us) avg %llu p50 %llu p99 %llu p999 %llu max %llu\n",
+				(unsigned long long) mLatency.average(), (unsigned long long) mLatency.percentile(500),
+				(unsigned long long) mLatency.percentile(990), (unsigned long long) mLatency.percentile(999),
+				(unsigned long long) mLatency.max());
+	printf("soak: allocations %llu (%.2f by message)\n",
+				(unsigned long long) mAllocations, (double) mAllocations / mRequests);
+
+	// Checks
+
+	TEST_CHECK(simExitReason() == NULL);
+	TEST_CHECK(simulated >= (SOAK_SESSIONS * 3600.0));
+	TEST_CHECK(mMismatches == 0);
+	TEST_CHECK(mUnexpected == 0);
+	TEST_CHECK(link.lost == 0);
+	TEST_CHECK(mResponses == (mRequests - SOAK_SESSIONS + mMoreLines)); // 71 not have response
+
+	return testResult("soak");
+}
+
+//////// End
@@ -0,0 +1,193 @@
+/*
+ * test_socket.cc - the transport by TCP socket of the host tool (tools/ble_socket), with the real clock
+ * A client (thread outside of simulation) connects, sends messages in one write (joined) and checks
+ * the responses; echoes larger than the MTU (in groups), and the disconnection
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+
+#include "ble_socket.h"
+
+#include "test.h"
+
+using namespace std;
+
+////// Firmware
+
+extern "C" void app_main();
+
+extern void bleSetTransport(const BleTransport_t* transport);
+extern bool bleConnected();
+
+////// Definitions
+
+#define SOCKET_ECHOES 				100
+#define SOCKET_TIMEOUT 				5000			// Timeout of responses (millis)
+
+////// Variables
+
+static std::atomic<int> mStep(0);				// Step of client (1 - connected, 2 - done, 3 - checked, 4 - closed)
+static string mExpected;						// Responses expected
+static string mReceived;						// Responses received
+
+////// Routines
+
+/**
+ * @brief Read the responses, until the size expected (or timeout)
+ */
+static void clientRead(int fd, size_t size) {
+
+	char buffer[1024];
+
+	while (mReceived.size() < size) {
+
+		struct pollfd pfd = { fd, POLLIN, 0 };
+
+		if (poll(&pfd, 1, SOCKET_TIMEOUT) <= 0) {
+			break;
+		}
+
+		ssize_t count = read(fd, buffer, sizeof(buffer));
+
+		if (count <= 0) {
+			break;
+		}
+
+		mReceived.append(buffer, count);
+	}
+}
+
+/**
+ * @brief Client (thread outside of simulation)
+ */
+static void client() {
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	struct sockaddr_in address;
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(bleSocketPort());
+
+	if (!TEST_CHECK(connect(fd, (struct sockaddr*) &address, sizeof(address)) == 0)) {
+		mStep = 4;
+		return;
+	}
+
+	mStep = 1;
+
+	// Messages joined in one write
+
+	mExpected = "80:\n";
+
+	string request = "80:\n71:N\n";
+
+	TEST_CHECK(write(fd, request.data(), request.size()) == (ssize_t) request.size());
+
+	clientRead(fd, mExpected.size());
+
+	// Echoes larger than MTU, in groups (as the App, waiting the responses)
+
+	for (uint16_t i = 0; i < SOCKET_ECHOES; i++) {
+
+		string echo = "70:" + to_string(i) + ":" + string(100 + (i % 50), 'a' + (i % 26));
+
+		request = echo + "\n";
+		mExpected += request;
+
+		TEST_CHECK(write(fd, request.data(), request.size()) == (ssize_t) request.size());
+
+		if ((i % 5) == 4) {
+			clientRead(fd, mExpected.size());
+		}
+	}
+
+	clientRead(fd, mExpected.size());
+
+	mStep = 2;
+
+	// Wait the check of connection
+
+	while (mStep == 2) {
+		usleep(10000);
+	}
+
+	close(fd);
+
+	mStep = 4;
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void socketMain(void* arg) {
+
+	bleSocketConfig(0, false, 100); // Any free port
+
+	bleSetTransport(&bleTransportSocket);
+
+	app_main();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	std::thread thread(client);
+
+	thread.detach();
+
+	// Wait the client
+
+	for (uint16_t i = 0; i < 1000 && mStep < 2; i++) {
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+
+	TEST_CHECK(bleConnected());
+
+	mStep = 3;
+
+	for (uint16_t i = 0; i < 1000 && mStep < 4; i++) {
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+
+	vTaskDelay(pdMS_TO_TICKS(200));
+
+	TEST_CHECK(!bleConnected());
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simLogLevel(ESP_LOG_ERROR);
+
+	simRun(socketMain, NULL, false);
+
+	printf("test_socket: expected %u bytes, received %u bytes\n",
+				(unsigned) mExpected.size(), (unsigned) mReceived.size());
+
+	TEST_CHECK(simExitReason() == NULL);
+	TEST_CHECK(mReceived == mExpected);
+
+	return testResult("test_socket");
+}
+
+//////// End
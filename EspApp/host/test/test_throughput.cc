@@ -0,0 +1,396 @@
+/*
+ * test_throughput.cc - the test of throughput (message 72) by the simulated link (congested, few buffers)
+ * Firmware with THROUGHPUT_TEST (it is off by default - see throughput.h)
+ * The client validates the integrity of stream: sequence without gaps, data of each line, the size
+ * of lines and one line by notification of MTU size (in binary mode, the frame of line); the statistics
+ * of end (72:E) against the lines and bytes received
+ * Streams: by bytes (complete), by seconds (above the limit, clamped to THROUGHPUT_TIME_MAX), stopped
+ * and by bytes in binary mode (without and with CRC)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim.h"
+#include "sim_link.h"
+
+#include "util/ble_frame.h"
+
+#include "throughput.h"
+
+#include "frame_reader.h"
+#include "test.h"
+
+////// Firmware
+
+extern "C" void app_main();
+
+////// Definitions
+
+#define STREAM_MTU 					100
+#define STREAM_BYTES 				20000
+#define STREAM_BYTES_BINARY 		20400		// Lines complete in binary mode (102 and 100 bytes)
+
+////// Types
+
+// Stream received by client
+
+typedef struct {
+	bool started;				// Received 72:S
+	uint32_t startBytes;		// Values of 72:S
+	uint32_t startMtu;
+	uint32_t startLine;
+	uint32_t lines;				// Lines of data received
+	uint32_t bytes;				// Bytes of data received (with the new line)
+	uint32_t sent;				// Bytes of notifications of data (in binary mode, the frames)
+	uint32_t notifications;		// Notifications of data
+	uint32_t partial;			// Notifications of data not of MTU size or not one line (frame)
+	uint32_t errors;			// Lines with sequence, data or size wrong
+	bool ended;					// Received 72:E
+	uint32_t end[8];			// Values of 72:E (lines, bytes, elapsed, bytesPerSec, congestions, congestedTime, failed, dropped)
+} Stream_t;
+
+////// Variables
+
+static char mLine[512];							// Line received by client (joined)
+static uint16_t mLineSize = 0;
+
+static Stream_t mStream;						// Stream in test
+
+static bool mBinary = false;					// Binary mode (after response of 01:BIN or 01:BINC)
+static bool mBinaryCrc = false;
+static bool mBinaryNext = false;				// Binary mode requested (after response of 01)
+static bool mBinaryCrcNext = false;
+
+////// Routines
+
+/**
+ * @brief Line of data (72:D:seq:data) - validates the sequence, the data and the size
+ */
+static void receiveData(const char* line, uint16_t size) {
+
+	uint32_t seq = strtoul(line + 5, NULL, 10);
+
+	bool valid = (size >= THROUGHPUT_HEADER_SIZE && line[THROUGHPUT_HEADER_SIZE - 1] == ':' && seq == mStream.lines);
+
+	// Data is the char 'a' + (seq % 26) repeated
+
+	for (uint16_t i = THROUGHPUT_HEADER_SIZE; valid && i < size; i++) {
+		valid = (line[i] == ('a' + (seq % 26)));
+	}
+
+	// Size of line is of 72:S (with new line), except the last one
+
+	if (valid && (size + 1u) != mStream.startLine) {
+		valid = ((mStream.bytes + size + 1u) >= mStream.startBytes);
+	}
+
+	if (!valid) {
+		if (mStream.errors == 0) {
+			printf("test_throughput: invalid line (expected seq %u): %.*s\n", mStream.lines, size, line);
+		}
+		mStream.errors++;
+	}
+
+	mStream.lines++;
+	mStream.bytes += (size + 1u);
+}
+
+/**
+ * @brief Line received by client - messages of stream
+ */
+static void receiveLine(const char* line, uint16_t size) {
+
+	mLine[size] = '\0';
+
+	if (size > 5 && memcmp(line, "72:D:", 5) == 0) {
+
+		receiveData(line, size);
+
+	} else if (size > 5 && memcmp(line, "72:S:", 5) == 0) {
+
+		unsigned bytes = 0, mtu = 0, sizeLine = 0;
+
+		if (sscanf(line, "72:S:%u:%u:%u", &bytes, &mtu, &sizeLine) == 3) {
+			mStream.started = true;
+			mStream.startBytes = bytes;
+			mStream.startMtu = mtu;
+			mStream.startLine = sizeLine;
+		}
+
+	} else if (size > 5 && memcmp(line, "72:E:", 5) == 0) {
+
+		unsigned v[8];
+
+		if (sscanf(line, "72:E:%u:%u:%u:%u:%u:%u:%u:%u", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) == 8) {
+			for (uint8_t i = 0; i < 8; i++) {
+				mStream.end[i] = v[i];
+			}
+			mStream.ended = true;
+		}
+
+	} else if (size >= 3 && memcmp(line, "01:", 3) == 0) { // Initial - the mode after it
+
+		mBinary = mBinaryNext;
+		mBinaryCrc = mBinaryCrcNext;
+	}
+}
+
+/**
+ * @brief Notification of data (72:D) - one line (frame) of MTU size, except the last one
+ */
+static void receiveNotification(uint16_t size, bool oneLine) {
+
+	mStream.notifications++;
+	mStream.sent += size;
+
+	if (!oneLine || size != STREAM_MTU) {
+		mStream.partial++;
+	}
+}
+
+/**
+ * @brief Notification in binary mode - frames (text as lines, values of 72:S and 72:E as text too)
+ */
+static void clientReceiveFrames(const char* data, uint16_t size) {
+
+	const uint8_t* next = (const uint8_t*) data;
+	uint16_t remain = size;
+
+	bool first = true;
+
+	while (remain > 0) {
+
+		TestFrame_t frame;
+		bool valid;
+
+		uint16_t sizeFrame = testFrameRead(next, remain, mBinaryCrc, frame, valid);
+
+		if (sizeFrame == 0 || !valid) { // The test not splits frames (each notification have frames complete)
+			mStream.errors++;
+			return;
+		}
+
+		// As a line of text (nn:payload)
+
+		char line[512];
+		uint16_t sizeLine = snprintf(line, sizeof(line), "%02u:", frame.code);
+
+		if (frame.values) {
+
+			char prefix[8];
+			uint32_t values[16];
+
+			uint8_t count = testFrameValues(frame, prefix, sizeof(prefix), values, 16);
+
+			sizeLine += snprintf(line + sizeLine, sizeof(line) - sizeLine, "%s", prefix);
+
+			for (uint8_t i = 0; i < count; i++) {
+				sizeLine += snprintf(line + sizeLine, sizeof(line) - sizeLine, ":%u", values[i]);
+			}
+
+		} else {
+
+			memcpy(line + sizeLine, frame.payload, frame.size);
+			sizeLine += frame.size;
+		}
+
+		if (first && !frame.values && frame.code == THROUGHPUT_CODE && frame.size > 0 && frame.payload[0] == 'D') {
+			receiveNotification(size, (sizeFrame == size));
+		}
+
+		receiveLine(line, sizeLine);
+
+		first = false;
+		next += sizeFrame;
+		remain -= sizeFrame;
+	}
+}
+
+/**
+ * @brief Data received by client (notifications) - joins the lines
+ */
+static void clientReceive(const char* data, uint16_t size) {
+
+	if (mBinary) {
+		clientReceiveFrames(data, size);
+		return;
+	}
+
+	// Notification of data (lines of stream not joined by coalescing, the MTU is of lines)
+
+	if (mLineSize == 0 && size > 5 && memcmp(data, "72:D:", 5) == 0) {
+		receiveNotification(size, (memchr(data, '\n', size) == data + size - 1));
+	}
+
+	for (uint16_t i = 0; i < size; i++) {
+
+		if (data[i] == '\n') {
+
+			receiveLine(mLine, mLineSize);
+			mLineSize = 0;
+
+		} else if (mLineSize < (sizeof(mLine) - 1)) {
+
+			mLine[mLineSize++] = data[i];
+		}
+	}
+}
+
+/**
+ * @brief Send a line to server (in binary mode, a frame)
+ */
+static void clientSend(const char* line) {
+
+	if (!mBinary) {
+		simLinkWrite(line, strlen(line));
+		return;
+	}
+
+	uint8_t frame[128];
+
+	uint16_t size = bleFrameEncodeLine(line, strlen(line) - 1, mBinaryCrc, frame, sizeof(frame)); // Without new line
+
+	TEST_CHECK(size > 0 && simLinkWrite((const char*) frame, size));
+}
+
+/**
+ * @brief Run a stream - request it, (stop it after a time) and wait the end (virtual time)
+ */
+static void runStream(const char* request, uint32_t stopAfter, uint32_t timeout) {
+
+	memset(&mStream, 0, sizeof(mStream));
+
+	clientSend(request);
+
+	uint32_t elapsed = 0;
+
+	while (!mStream.ended && elapsed < timeout) {
+
+		vTaskDelay(pdMS_TO_TICKS(100));
+		elapsed += 100;
+
+		if (stopAfter > 0 && elapsed == stopAfter) {
+			clientSend("72:STOP\n");
+		}
+	}
+
+	printf("test_throughput: %-22.*s %s lines %u (of %u bytes) bytes %u elapsed %u ms, %u bytes/s, congestions %u, errors %u\n",
+				(int) (strlen(request) - 1), request, (mBinary) ? ((mBinaryCrc) ? "BINC" : "BIN ") : "TEXT",
+				mStream.end[0], mStream.startLine, mStream.end[1], mStream.end[2],
+				mStream.end[3], mStream.end[4], mStream.errors);
+
+	// Integrity and statistics of end against the received
+
+	TEST_CHECK(mStream.started && mStream.ended);
+	TEST_CHECK(mStream.startMtu == STREAM_MTU);
+	TEST_CHECK(mStream.errors == 0);
+	TEST_CHECK(mStream.end[0] == mStream.lines);
+	TEST_CHECK(mStream.end[1] == mStream.sent);
+	TEST_CHECK(mStream.notifications == mStream.lines && mStream.partial <= 1); // Only the last one
+	TEST_CHECK(mStream.end[6] == 0 && mStream.end[7] == 0);
+	TEST_CHECK(mStream.end[2] > 0 && mStream.end[3] == (uint32_t) (((uint64_t) mStream.sent * 1000u) / mStream.end[2]));
+}
+
+/**
+ * @brief Main of simulation (as app_main)
+ */
+static void throughputMain(void* arg) {
+
+	app_main();
+
+	// Link: MTU of 100, 8 buffers and 4 notifications by event (the stream is congested)
+
+	SimLinkConfig_t config = { STREAM_MTU, 30000, 4, 8 };
+
+	simLinkStart(config, clientReceive);
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	simLinkConnect();
+
+	vTaskDelay(pdMS_TO_TICKS(500));
+
+	simLinkWrite("01:\n71:N\n", 9);
+
+	vTaskDelay(pdMS_TO_TICKS(2000));
+
+	// Stream by bytes - complete
+
+	runStream("72:20000\n", 0, 30000);
+
+	TEST_CHECK(mStream.bytes == STREAM_BYTES);
+	TEST_CHECK(mStream.end[4] > 0);
+
+	// Stream by seconds, above the limit - clamped to THROUGHPUT_TIME_MAX
+
+	runStream("72:1000000000:100000\n", 0, (THROUGHPUT_TIME_MAX * 1000u) + THROUGHPUT_TIME_DRAIN + 5000);
+
+	TEST_CHECK(mStream.end[2] >= (THROUGHPUT_TIME_MAX * 1000u));
+	TEST_CHECK(mStream.end[2] <= (THROUGHPUT_TIME_MAX * 1000u) + THROUGHPUT_TIME_DRAIN);
+
+	// Stream stopped
+
+	runStream("72:1000000000\n", 2000, 10000);
+
+	TEST_CHECK(mStream.end[2] < 5000);
+
+	// Binary mode - the frame of each line is one notification (lines smaller than MTU, without CRC)
+
+	mBinaryNext = true;
+	mBinaryCrcNext = false;
+
+	clientSend("01:BIN\n");
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	TEST_CHECK(mBinary);
+
+	runStream("72:20400\n", 0, 30000);
+
+	TEST_CHECK(mStream.bytes == STREAM_BYTES_BINARY);
+	TEST_CHECK(mStream.startLine == (STREAM_MTU + 2)); // Frame: code, size (1 byte) and the line less "nn:" and new line
+
+	// With CRC
+
+	mBinaryCrcNext = true;
+
+	clientSend("01:BINC\n");
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	TEST_CHECK(mBinary && mBinaryCrc);
+
+	runStream("72:20400\n", 0, 30000);
+
+	TEST_CHECK(mStream.bytes == STREAM_BYTES_BINARY);
+	TEST_CHECK(mStream.startLine == STREAM_MTU); // With CRC (2 bytes), the same of text
+
+	// No notifications lost (the server waits the congestion)
+
+	TEST_CHECK(simLinkStats().lost == 0);
+
+	simLinkDisconnect();
+
+	simStop();
+}
+
+////// Main
+
+int main() {
+
+	simLogLevel(ESP_LOG_ERROR);
+
+	simRun(throughputMain, NULL, true);
+
+	TEST_CHECK(simExitReason() == NULL);
+
+	return testResult("test_throughput");
+}
+
+//////// End
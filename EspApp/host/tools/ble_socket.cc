@@ -0,0 +1,581 @@
+/*
+ * ble_socket.cc - transport of BleServer by a TCP socket or a PTY (see ble_socket.h)
+ * The thread of socket runs outside of simulation, and enters in it (simEnter) only to call the
+ * callbacks of BleServer (connection, MTU, data received and end of congestion), as the task of BT stack
+ * The sending runs in the task of send of BleServer (inside the simulation), without blocking:
+ * the data that not fits in socket is pending, and the thread sends it when the socket is writable
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "esp_err.h"
+
+#include "sim.h"
+#include "sim_kernel.h"
+
+#include "ble_socket.h"
+
+////// Variables
+
+static uint16_t mPort = BLE_SOCKET_PORT;			// Configuration
+static bool mPty = false;
+static uint16_t mMTU = BLE_SOCKET_MTU;
+
+static char mPtyName[64] = "";						// Name of PTY (slave)
+
+static int mListen = -1;							// Socket listening (TCP)
+static int mClient = -1;							// Socket of client or master of PTY
+static int mPtySlave = -1;							// Slave of PTY (opened, so the master not fails without client)
+static int mWake[2] = { -1, -1 };					// Pipe to wake the thread (data pending or finalize)
+
+static std::thread* mThread = NULL;					// Thread of socket (outside of simulation)
+static std::atomic<bool> mRunning(false);
+
+static void (*mCallbackConnection)();								// Callback for connection/disconnection
+static void (*mCallbackMTU)();										// Callback for MTU change detect
+static void (*mCallbackReceivedData) (char *data, uint16_t size); 	// Callback for receive data
+static void (*mCallbackCongestion) (bool congested); 				// Callback for congestion change
+
+static bool mConnected = false;						// Connected ? (changed only inside of simulation)
+static bool mCongested = false;						// Congested ? (changed only inside of simulation)
+
+static std::mutex mPendingMutex;					// Data pending to send (socket full)
+static char mPending[BLE_SOCKET_PENDING];
+static uint16_t mPendingSize = 0;
+
+static const uint8_t mMacAddress[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 }; // Mac address (local)
+
+////// Prototypes
+
+static void socketThread();
+static void socketConnect();
+static void socketDisconnect();
+static void socketReceive(const char* data, uint16_t size);
+static bool socketFlush();
+static ssize_t socketWrite(const char* data, uint16_t size);
+
+////// Configuration
+
+/**
+ * @brief Configure the transport (call it before initialize)
+ */
+void bleSocketConfig(uint16_t port, bool pty, uint16_t mtu) {
+
+	mPort = port;
+	mPty = pty;
+	mMTU = (mtu >= 20) ? mtu : 20;
+}
+
+/**
+ * @brief Port listening (the actual, if it is configured with 0)
+ */
+uint16_t bleSocketPort() {
+
+	return mPort;
+}
+
+/**
+ * @brief Name of PTY (to the client open it)
+ */
+const char* bleSocketPtyName() {
+
+	return mPtyName;
+}
+
+////// Routines of transport
+
+/**
+ * @brief Initialize - opens the socket (or PTY) and starts the thread
+ */
+static esp_err_t socket_Initialize(const char* device_name) {
+
+	SimHeapQuiet quiet;
+
+	mConnected = false;
+	mCongested = false;
+	mPendingSize = 0;
+
+	if (pipe(mWake) != 0) {
+		return ESP_FAIL;
+	}
+
+	if (mPty) {
+
+		// PTY - the client opens the slave (ex: screen, minicom or a serial port of a bridge)
+
+		mClient = posix_openpt(O_RDWR | O_NOCTTY);
+
+		if (mClient < 0 || grantpt(mClient) != 0 || unlockpt(mClient) != 0 ||
+			ptsname_r(mClient, mPtyName, sizeof(mPtyName)) != 0) {
+
+			printf("ble_socket: error on open the PTY: %s\n", strerror(errno));
+			return ESP_FAIL;
+		}
+
+		mPtySlave = open(mPtyName, O_RDWR | O_NOCTTY);
+
+		// Raw (no echo, no translation of new lines)
+
+		struct termios tio;
+
+		if (tcgetattr(mPtySlave, &tio) == 0) {
+			cfmakeraw(&tio);
+			tcsetattr(mPtySlave, TCSANOW, &tio);
+		}
+
+		fcntl(mClient, F_SETFL, fcntl(mClient, F_GETFL) | O_NONBLOCK);
+
+		printf("ble_socket: PTY %s, MTU %u\n", mPtyName, mMTU);
+
+	} else {
+
+		// TCP - only in localhost
+
+		mListen = socket(AF_INET, SOCK_STREAM, 0);
+
+		int reuse = 1;
+		setsockopt(mListen, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+		struct sockaddr_in address;
+
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(mPort);
+
+		socklen_t size = sizeof(address);
+
+		if (mListen < 0 || bind(mListen, (struct sockaddr*) &address, sizeof(address)) != 0 ||
+			listen(mListen, 1) != 0 || getsockname(mListen, (struct sockaddr*) &address, &size) != 0) {
+
+			printf("ble_socket: error on listen in port %u: %s\n", mPort, strerror(errno));
+			return ESP_FAIL;
+		}
+
+		mPort = ntohs(address.sin_port);
+
+		printf("ble_socket: listening in 127.0.0.1:%u, MTU %u\n", mPort, mMTU);
+	}
+
+	fflush(stdout);
+
+	// Thread of socket
+
+	mRunning = true;
+
+	mThread = new std::thread(socketThread);
+
+	return ESP_OK;
+}
+
+/**
+ * @brief Finalize - stops the thread and closes the socket
+ */
+static esp_err_t socket_Finalize() {
+
+	mRunning = false;
+
+	if (mWake[1] >= 0 && write(mWake[1], "", 1) < 0) {
+		// Nothing to do (the thread is stopped)
+	}
+
+	if (mThread != NULL) {
+		mThread->detach(); // It can wait to enter in simulation (it leaves when see the stop)
+		mThread = NULL;
+	}
+
+	mConnected = false;
+
+	return ESP_OK;
+}
+
+/**
+ * @brief Set callbacks of connection and MTU
+ */
+static void socket_SetCallbackConnection(void (*callbackConnection)(), void (*callbackMTU)()) {
+
+	mCallbackConnection = callbackConnection;
+	mCallbackMTU = callbackMTU;
+}
+
+/**
+ * @brief Set callback of data received
+ */
+static void socket_SetCallbackReceiveData(void (*callbackReceived)(char* data, uint16_t size)) {
+
+	mCallbackReceivedData = callbackReceived;
+}
+
+/**
+ * @brief Set callback of congestion
+ */
+static void socket_SetCallbackCongestion(void (*callbackCongestion)(bool congested)) {
+
+	mCallbackCongestion = callbackCongestion;
+}
+
+/**
+ * @brief Client connected ?
+ */
+static bool socket_ClientConnected() {
+
+	return mConnected;
+}
+
+/**
+ * @brief Send data to client (runs in task of send of BleServer - not blocks)
+ * If the socket is full, the rest is pending and the transport is congested, until it is sent
+ */
+static esp_err_t socket_SendData(const char* data, uint16_t size) {
+
+	if (!mConnected) {
+		return ESP_FAIL;
+	}
+
+	if (size > mMTU) {
+		size = mMTU;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mPendingMutex);
+
+		uint16_t sent = 0;
+
+		if (mPendingSize == 0) { // Directly, if nothing is pending (the order is kept)
+
+			ssize_t written = socketWrite(data, size);
+
+			if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+				return ESP_FAIL;
+			}
+
+			sent = (written > 0) ? (uint16_t) written : 0;
+
+			if (sent == size) {
+				return ESP_OK;
+			}
+		}
+
+		// The rest is pending
+
+		if ((mPendingSize + (size - sent)) > sizeof(mPending)) {
+			return ESP_FAIL; // Lost (as the BT stack without buffers)
+		}
+
+		memcpy(mPending + mPendingSize, data + sent, (size - sent));
+		mPendingSize += (size - sent);
+	}
+
+	// Congested - the thread sends the pending when the socket is writable
+
+	if (write(mWake[1], "", 1) < 0) {
+		// The thread is stopped
+	}
+
+	if (!mCongested) {
+
+		mCongested = true;
+
+		if (mCallbackCongestion != NULL) {
+			mCallbackCongestion(true);
+		}
+	}
+
+	return ESP_OK;
+}
+
+/**
+ * @brief Actual MTU
+ */
+static uint16_t socket_MTU() {
+
+	return mMTU;
+}
+
+/**
+ * @brief Mac address
+ */
+static const uint8_t* socket_MacAddress() {
+
+	return mMacAddress;
+}
+
+////// Transport
+
+const BleTransport_t bleTransportSocket = {
+	"socket",
+	socket_Initialize,
+	socket_Finalize,
+	socket_SetCallbackConnection,
+	socket_SetCallbackReceiveData,
+	socket_SetCallbackCongestion,
+	socket_ClientConnected,
+	socket_SendData,
+	socket_MTU,
+	socket_MacAddress
+};
+
+////// Private
+
+/**
+ * @brief Thread of socket (outside of simulation) - connections, data received and data pending
+ */
+static void socketThread() {
+
+	char buffer[1024];
+
+	while (mRunning) {
+
+		struct pollfd fds[2];
+		nfds_t count = 0;
+
+		fds[count].fd = mWake[0];
+		fds[count].events = POLLIN;
+		count++;
+
+		if (mClient >= 0) {
+
+			fds[count].fd = mClient;
+			fds[count].events = POLLIN;
+
+			std::lock_guard<std::mutex> lock(mPendingMutex);
+
+			if (mPendingSize > 0) {
+				fds[count].events |= POLLOUT;
+			}
+
+			count++;
+
+		} else if (mListen >= 0) {
+
+			fds[count].fd = mListen;
+			fds[count].events = POLLIN;
+			count++;
+		}
+
+		if (poll(fds, count, -1) < 0) {
+			continue;
+		}
+
+		if (!mRunning) {
+			break;
+		}
+
+		if ((fds[0].revents & POLLIN) != 0 && read(mWake[0], buffer, sizeof(buffer)) < 0) {
+			continue;
+		}
+
+		if (count < 2 || fds[1].revents == 0) {
+			continue;
+		}
+
+		// New connection (TCP)
+
+		if (fds[1].fd == mListen) {
+
+			int client = accept(mListen, NULL, NULL);
+
+			if (client >= 0) {
+
+				int noDelay = 1;
+				setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+				fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+
+				mClient = client;
+
+				socketConnect();
+			}
+
+			continue;
+		}
+
+		// Data pending can be sent
+
+		if ((fds[1].revents & POLLOUT) != 0 && socketFlush()) {
+
+			// End of congestion
+
+			if (!simEnter()) {
+				break;
+			}
+
+			if (mCongested) {
+
+				mCongested = false;
+
+				if (mCallbackCongestion != NULL) {
+					mCallbackCongestion(false);
+				}
+			}
+
+			simLeave();
+		}
+
+		// Data received (or close)
+
+		if ((fds[1].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+
+			ssize_t size = read(mClient, buffer, sizeof(buffer));
+
+			if (size > 0) {
+
+				if (!mConnected) { // PTY - connected by first data
+					socketConnect();
+				}
+
+				socketReceive(buffer, (uint16_t) size);
+
+			} else if (size == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+
+				if (mPty) { // Not closed (the slave is opened here)
+					continue;
+				}
+
+				socketDisconnect();
+			}
+		}
+	}
+
+	// Finalize
+
+	if (mClient >= 0) {
+		close(mClient);
+		mClient = -1;
+	}
+	if (mListen >= 0) {
+		close(mListen);
+		mListen = -1;
+	}
+	if (mPtySlave >= 0) {
+		close(mPtySlave);
+		mPtySlave = -1;
+	}
+}
+
+/**
+ * @brief Client connected - callbacks of connection and MTU (as the BT stack)
+ */
+static void socketConnect() {
+
+	if (!simEnter()) {
+		return;
+	}
+
+	mConnected = true;
+	mCongested = false;
+
+	if (mCallbackConnection != NULL) {
+		mCallbackConnection();
+	}
+
+	if (mCallbackMTU != NULL) {
+		mCallbackMTU();
+	}
+
+	simLeave();
+}
+
+/**
+ * @brief Client disconnected - the data pending is lost
+ */
+static void socketDisconnect() {
+
+	if (simEnter()) {
+
+		mConnected = false;
+		mCongested = false; // Cleared by disconnection
+
+		{
+			std::lock_guard<std::mutex> lock(mPendingMutex);
+
+			mPendingSize = 0;
+		}
+
+		if (mCallbackConnection != NULL) {
+			mCallbackConnection();
+		}
+
+		simLeave();
+	}
+
+	close(mClient);
+	mClient = -1;
+}
+
+/**
+ * @brief Data received - delivered to server in parts of MTU size (as BLE packets)
+ */
+static void socketReceive(const char* data, uint16_t size) {
+
+	if (!simEnter()) {
+		return;
+	}
+
+	char packet[mMTU];
+
+	for (uint16_t pos = 0; pos < size && mCallbackReceivedData != NULL; pos += mMTU) {
+
+		uint16_t sizePacket = ((size - pos) > mMTU) ? mMTU : (size - pos);
+
+		memcpy(packet, data + pos, sizePacket);
+
+		mCallbackReceivedData(packet, sizePacket);
+	}
+
+	simLeave();
+}
+
+/**
+ * @brief Send the data pending - returns true if all is sent
+ */
+static bool socketFlush() {
+
+	std::lock_guard<std::mutex> lock(mPendingMutex);
+
+	if (mPendingSize == 0) {
+		return true;
+	}
+
+	ssize_t written = socketWrite(mPending, mPendingSize);
+
+	if (written <= 0) {
+		return false;
+	}
+
+	mPendingSize -= written;
+
+	memmove(mPending, mPending + written, mPendingSize);
+
+	return (mPendingSize == 0);
+}
+
+/**
+ * @brief Write in socket or PTY (not blocks, not signals if the client closed)
+ */
+static ssize_t socketWrite(const char* data, uint16_t size) {
+
+	if (mPty) {
+		return write(mClient, data, size);
+	}
+
+	return send(mClient, data, size, MSG_NOSIGNAL);
+}
+
+//////// End
@@ -0,0 +1,38 @@
+/*
+ * ble_socket.h - transport of BleServer by a TCP socket or a PTY, to run the firmware in a Linux process
+ * The client (ex: nc, socat, a bridge to mobile App or a script) is the central of BLE:
+ *   - TCP: a connection is the BLE connection, the close is the disconnection (one client at a time)
+ *   - PTY: connected with the first data received (the PTY not have connections)
+ * Data of client is delivered in parts of MTU size (as BLE packets), by a thread outside of simulation
+ * When the socket cannot send more (buffers of kernel full), the transport is congested,
+ * as ESP_GATTS_CONGEST_EVT of BT stack, until the data pending is sent
+ * Note: set it with bleSetTransport, before the initialize of firmware (app_main)
+ */
+
+#ifndef TOOLS_BLE_SOCKET_H_
+#define TOOLS_BLE_SOCKET_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ble_transport.h"
+
+////// Definitions
+
+#define BLE_SOCKET_PORT 			7000		// TCP port (default) - listen only in localhost
+#define BLE_SOCKET_MTU 				100			// MTU of data (default)
+#define BLE_SOCKET_PENDING 			4096		// Data pending to send (when socket is full)
+
+////// Transport
+
+extern const BleTransport_t bleTransportSocket;
+
+////// Prototypes
+
+void bleSocketConfig(uint16_t port, bool pty, uint16_t mtu);	// Port 0 - any free port (see bleSocketPort)
+uint16_t bleSocketPort();										// Port listening (after initialize)
+const char* bleSocketPtyName();									// Name of PTY (after initialize)
+
+#endif /* TOOLS_BLE_SOCKET_H_ */
+
+//////// End
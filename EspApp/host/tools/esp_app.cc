@@ -0,0 +1,81 @@
+/*
+ * esp_app.cc - the firmware in a Linux process (real clock), with the transport by a TCP socket or a PTY
+ * To develop and debug the mobile App (or scripts) without the board, ex:
+ *
+ *   esp_app                 - listen in 127.0.0.1:7000, connect with: nc 127.0.0.1 7000
+ *   esp_app --pty           - creates a PTY (the name is shown), open it as a serial port
+ *   esp_app --mtu 185       - MTU of data (as negotiated by the mobile)
+ *
+ * The logging level is of environment ESPSIM_LOG (ex: ESPSIM_LOG=3 to info)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+#include "ble_socket.h"
+
+////// Firmware
+
+extern "C" void app_main();
+
+extern void bleSetTransport(const BleTransport_t* transport);
+
+////// Routines
+
+/**
+ * @brief Main of simulation - the firmware with the transport by socket
+ */
+static void appMain(void* arg) {
+
+	bleSetTransport(&bleTransportSocket);
+
+	app_main();
+}
+
+/**
+ * @brief Usage
+ */
+static int usage(const char* name) {
+
+	printf("usage: %s [--port N | --pty] [--mtu N]\n", name);
+
+	return 2;
+}
+
+////// Main
+
+int main(int argc, char** argv) {
+
+	uint16_t port = BLE_SOCKET_PORT;
+	uint16_t mtu = BLE_SOCKET_MTU;
+	bool pty = false;
+
+	for (int i = 1; i < argc; i++) {
+
+		if (strcmp(argv[i], "--port") == 0 && (i + 1) < argc) {
+			port = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--mtu") == 0 && (i + 1) < argc) {
+			mtu = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--pty") == 0) {
+			pty = true;
+		} else {
+			return usage(argv[0]);
+		}
+	}
+
+	bleSocketConfig(port, pty, mtu);
+
+	simRun(appMain, NULL, false);
+
+	// Stopped by firmware (ex: restart or deep sleep)
+
+	printf("esp_app: stopped (%s)\n", (simExitReason() != NULL) ? simExitReason() : "-");
+
+	return 0;
+}
+
+//////// End
@@ -0,0 +1,619 @@
+/*
+ * loadgen.cc - load generator of messages, of clients by the simulated link (BLE GATT) to the firmware
+ * Each client is a task, that sends a mix of messages (01, 11, 70, 71 and 80), in fragments (writes),
+ * and waits the response of each one (round trip), with a time between messages (rate)
+ * The clients shares the connection (as screens of the App), the responses is in order of requests:
+ * a response of a code is of the oldest request of this code pending, the requests before it without
+ * response is lost (lines dropped by firmware, when the queue to receive is full)
+ * Reports in JSON (one line): latency (p50/p99/p999), throughput, mix, rates, fragmentation,
+ * sizes of payloads and the allocations of heap by message (counter of operator new)
+ *
+ *   loadgen [--clients N] [--messages N] [--interval ms] [--fragment bytes] [--payload min:max]
+ *           [--mtu N] [--mix w01,w11,w70,w71,w80] [--link-interval us] [--real]
+ *
+ * Returns 1 if a response is wrong or not expected (to use in scripts of regression)
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "sim.h"
+#include "sim_link.h"
+
+#include "ble_server.h"
+
+#include "test.h"
+
+////// Firmware
+
+extern "C" void app_main();
+
+extern bool bleConnected();
+extern const BleReceiveStats_t& bleReceiveStats();
+
+////// Definitions
+
+#define LOADGEN_CLIENTS_MAX 		16
+#define LOADGEN_CODES_NUM 			5
+#define LOADGEN_PENDING_MAX 		64				// Responses pending (FIFO)
+#define LOADGEN_TIMEOUT 			2000			// Timeout of response (millis)
+#define LOADGEN_MESSAGE_MAX 		300				// Size of message (line)
+
+////// Types
+
+// Configuration of load
+
+typedef struct {
+	uint8_t clients;						// Number of clients
+	uint32_t messages;						// Messages by client
+	uint16_t interval;						// Time between messages of client (millis) - 0 is the maximum rate
+	uint16_t fragment;						// Size of each write (0 - message in one write)
+	uint16_t payloadMin;					// Size of payload of echo (random between min and max)
+	uint16_t payloadMax;
+	uint16_t mtu;							// MTU of link
+	uint32_t linkInterval;					// Interval of connection (micros)
+	uint8_t mix[LOADGEN_CODES_NUM];			// Weights of messages (see mCodes)
+	bool real;								// Real clock ?
+} LoadGenConfig_t;
+
+// Response expected
+
+typedef struct {
+	uint8_t code;							// Code of message (0 - cancelled, by timeout)
+	uint8_t client;							// Client
+	uint32_t seq;							// Sequence of message of client
+	uint64_t sent;							// Time of request (micros)
+} LoadGenPending_t;
+
+// Client
+
+typedef struct {
+	TaskHandle_t task;						// Task
+	uint32_t random;						// Random (deterministic, by client)
+	uint32_t sent;							// Messages sended
+	uint32_t answered;						// Responses received
+	uint32_t lost;							// Requests without response (dropped or timeout)
+} LoadGenClient_t;
+
+////// Variables
+
+static const uint8_t mCodes[LOADGEN_CODES_NUM] = { 1, 11, 70, 71, 80 };
+
+static LoadGenConfig_t mConfig = { 4, 2500, 0, 0, 8, 120, 180, 30000, { 1, 10, 70, 5, 14 }, false };
+
+static LoadGenClient_t mClients[LOADGEN_CLIENTS_MAX];
+static volatile uint8_t mClientsDone = 0;
+
+static QueueHandle_t xQueueWrite = NULL;		// Token of writes (the fragments of a message is not mixed with others)
+
+static LoadGenPending_t mPending[LOADGEN_PENDING_MAX];	// Responses expected (FIFO)
+static uint8_t mPendingHead = 0;
+static uint8_t mPendingCount = 0;
+
+static char mLine[LOADGEN_MESSAGE_MAX];			// Line received (joined)
+static uint16_t mLineSize = 0;
+
+static TestLatency mLatency;					// Round trip (all clients)
+
+static uint32_t mSentCodes[LOADGEN_CODES_NUM];	// Mix sended
+static uint32_t mWrites = 0;					// Writes of clients (fragments)
+static uint64_t mBytesUp = 0;					// Bytes sended by clients
+static uint64_t mBytesDown = 0;					// Bytes received by clients
+static uint32_t mPayloads = 0;					// Payloads of echo: number, total, minimum and maximum
+static uint64_t mPayloadTotal = 0;
+static uint16_t mPayloadMin = 0xFFFF;
+static uint16_t mPayloadMax = 0;
+
+static uint32_t mMismatches = 0;				// Responses wrong
+static uint32_t mUnexpected = 0;				// Responses not expected
+static uint32_t mTimeouts = 0;					// Responses not received (in time)
+
+static uint64_t mAllocations = 0;				// Allocations in load
+static uint64_t mTimeLoad = 0;					// Time of load (micros, simulated)
+
+static BleReceiveStats_t mReceiveStats;			// Statistics of firmware (lines received)
+
+////// Prototypes
+
+static void client_Task(void* pvParameters);
+
+////// Routines
+
+/**
+ * @brief Random number (0 to max - 1)
+ */
+static uint32_t random(uint32_t& state, uint32_t max) {
+
+	state = (state * 1103515245u) + 12345u;
+
+	return ((state >> 8) % max);
+}
+
+/**
+ * @brief Line received - response of the oldest request of this code (the firmware responds in order),
+ * or of this client and sequence (echo). The requests before it, without response, is lost (lines dropped)
+ */
+static void receiveLine(const char* line, uint16_t size) {
+
+	uint8_t code = (size >= 3 && line[2] == ':') ? (uint8_t) (((line[0] - '0') * 10) + (line[1] - '0')) : 0;
+
+	unsigned client = 0;
+	unsigned seq = 0;
+	int sizePrefix = 0;
+
+	if (code == 70 && sscanf(line, "70:%u:%u:%n", &client, &seq, &sizePrefix) != 2) {
+		code = 0;
+	}
+
+	// Request of this response
+
+	uint8_t found = 0;
+
+	for (found = 0; found < mPendingCount; found++) {
+
+		const LoadGenPending_t& pending = mPending[(mPendingHead + found) % LOADGEN_PENDING_MAX];
+
+		if (pending.code == code && (code != 70 || (pending.client == client && pending.seq == seq))) {
+			break;
+		}
+	}
+
+	if (code == 0 || found == mPendingCount) {
+
+		if (mUnexpected++ < 5) {
+			printf("loadgen: unexpected line: %.*s\n", size, line);
+		}
+		return;
+	}
+
+	// The requests before it is lost
+
+	for (uint8_t i = 0; i <= found; i++) {
+
+		LoadGenPending_t& pending = mPending[mPendingHead];
+
+		mPendingHead = (mPendingHead + 1) % LOADGEN_PENDING_MAX;
+		mPendingCount--;
+
+		if (pending.code == 0) { // Cancelled
+			continue;
+		}
+
+		if (i < found) {
+			mClients[pending.client].lost++;
+		} else {
+			mClients[pending.client].answered++;
+			mLatency.add(simTime() - pending.sent);
+		}
+
+		xTaskNotifyGive(mClients[pending.client].task);
+	}
+
+	// Echo - the payload must be the same
+
+	for (uint16_t i = sizePrefix; code == 70 && i < size; i++) {
+
+		if (line[i] != ('a' + ((seq + i - sizePrefix) % 26))) {
+
+			if (mMismatches++ < 5) {
+				printf("loadgen: echo with payload wrong: %.*s\n", size, line);
+			}
+			break;
+		}
+	}
+}
+
+/**
+ * @brief Cancel the request pending of a client (timeout)
+ */
+static void cancel(uint8_t index) {
+
+	for (uint8_t i = 0; i < mPendingCount; i++) {
+
+		LoadGenPending_t& pending = mPending[(mPendingHead + i) % LOADGEN_PENDING_MAX];
+
+		if (pending.client == index) {
+			pending.code = 0;
+		}
+	}
+}
+
+/**
+ * @brief Data received by clients (notifications) - joins the lines
+ */
+static void clientReceive(const char* data, uint16_t size) {
+
+	mBytesDown += size;
+
+	for (uint16_t i = 0; i < size; i++) {
+
+		if (data[i] == '\n') {
+
+			receiveLine(mLine, mLineSize);
+			mLineSize = 0;
+
+		} else if (mLineSize < sizeof(mLine)) {
+
+			mLine[mLineSize++] = data[i];
+		}
+	}
+}
+
+/**
+ * @brief Message of code - returns the size (with new line)
+ */
+static uint16_t message(LoadGenClient_t& client, uint8_t index, uint8_t code, char* buffer) {
+
+	uint16_t size = 0;
+
+	switch (code) {
+
+		case 11: // Info - free memory
+
+			size = snprintf(buffer, LOADGEN_MESSAGE_MAX, "11:FMEM");
+			break;
+
+		case 70: // Echo - with payload (identified by client and sequence)
+			{
+				size = snprintf(buffer, LOADGEN_MESSAGE_MAX, "70:%u:%u:", index, client.sent);
+
+				uint16_t payload = mConfig.payloadMin + random(client.random, (mConfig.payloadMax - mConfig.payloadMin + 1));
+
+				if (payload > (LOADGEN_MESSAGE_MAX - size - 1)) {
+					payload = (LOADGEN_MESSAGE_MAX - size - 1);
+				}
+
+				for (uint16_t i = 0; i < payload; i++) {
+					buffer[size++] = 'a' + ((client.sent + i) % 26);
+				}
+
+				mPayloads++;
+				mPayloadTotal += payload;
+
+				if (payload < mPayloadMin) {
+					mPayloadMin = payload;
+				}
+				if (payload > mPayloadMax) {
+					mPayloadMax = payload;
+				}
+			}
+			break;
+
+		case 71: // Logging - deactivated (no response)
+
+			size = snprintf(buffer, LOADGEN_MESSAGE_MAX, "71:N");
+			break;
+
+		default: // Others - no payload (01, 80)
+
+			size = snprintf(buffer, LOADGEN_MESSAGE_MAX, "%02u:", code);
+			break;
+	}
+
+	buffer[size++] = '\n';
+
+	return size;
+}
+
+/**
+ * @brief Send a message, in fragments - all writes in sequence (the fragments of clients is not mixed)
+ * If it has a response, it is expected (before the writes, to the order of FIFO)
+ */
+static bool send(uint8_t index, uint8_t code, const char* buffer, uint16_t size) {
+
+	uint8_t token;
+
+	xQueueReceive(xQueueWrite, &token, portMAX_DELAY);
+
+	if (code != 71) {
+
+		if (mPendingCount >= LOADGEN_PENDING_MAX) {
+			xQueueSend(xQueueWrite, &token, 0);
+			return false;
+		}
+
+		LoadGenPending_t& pending = mPending[(mPendingHead + mPendingCount) % LOADGEN_PENDING_MAX];
+
+		pending.code = code;
+		pending.client = index;
+		pending.seq = mClients[index].sent;
+		pending.sent = simTime();
+
+		mPendingCount++;
+	}
+
+	uint16_t fragment = (mConfig.fragment > 0) ? mConfig.fragment : size;
+
+	for (uint16_t pos = 0; pos < size; pos += fragment) {
+
+		uint16_t sizeWrite = ((size - pos) > fragment) ? fragment : (size - pos);
+
+		if (!simLinkWrite(buffer + pos, sizeWrite)) {
+			xQueueSend(xQueueWrite, &token, 0);
+			return false;
+		}
+
+		mWrites++;
+	}
+
+	mBytesUp += size;
+
+	xQueueSend(xQueueWrite, &token, 0);
+
+	return true;
+}
+
+/**
+ * @brief Task of client - the mix of messages, waiting the response of each one
+ */
+static void client_Task(void* pvParameters) {
+
+	uint8_t index = (uint8_t) (uintptr_t) pvParameters;
+
+	LoadGenClient_t& client = mClients[index];
+
+	char buffer[LOADGEN_MESSAGE_MAX];
+
+	uint16_t total = 0;
+
+	for (uint8_t c = 0; c < LOADGEN_CODES_NUM; c++) {
+		total += mConfig.mix[c];
+	}
+
+	for (uint32_t i = 0; i < mConfig.messages; i++) {
+
+		// Code of message (by weights of mix)
+
+		uint16_t choice = random(client.random, total);
+		uint8_t code = mCodes[0];
+		uint8_t codeIndex = 0;
+
+		for (uint8_t c = 0; c < LOADGEN_CODES_NUM; c++) {
+			if (choice < mConfig.mix[c]) {
+				code = mCodes[c];
+				codeIndex = c;
+				break;
+			}
+			choice -= mConfig.mix[c];
+		}
+
+		// Send it and wait the response
+
+		uint16_t size = message(client, index, code, buffer);
+
+		if (!send(index, code, buffer, size)) {
+			break;
+		}
+
+		client.sent++;
+		mSentCodes[codeIndex]++;
+
+		if (code != 71 && ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOADGEN_TIMEOUT)) == 0) {
+
+			cancel(index); // The last request of client is lost (no other response after it)
+
+			client.lost++;
+			mTimeouts++;
+		}
+
+		// Rate
+
+		if (mConfig.interval > 0) {
+			vTaskDelay(pdMS_TO_TICKS(mConfig.interval));
+		}
+	}
+
+	mClientsDone++;
+
+	vTaskDelete(NULL);
+}
+
+/**
+ * @brief Main of simulation - connection, initial message and the clients
+ */
+static void loadgenMain(void* arg) {
+
+	app_main();
+
+	uint8_t token = 0;
+
+	xQueueWrite = xQueueCreate(1, sizeof(uint8_t));
+	xQueueSend(xQueueWrite, &token, 0);
+
+	SimLinkConfig_t config = { mConfig.mtu, mConfig.linkInterval, 6, SIM_LINK_BUFFERS_MAX };
+
+	simLinkStart(config, clientReceive);
+
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+	// Connect, and wait the event of connection be processed (not a fixed delay)
+
+	simLinkConnect();
+
+	for (uint16_t i = 0; i < 500 && !bleConnected(); i++) {
+		vTaskDelay(1);
+	}
+
+	// Initial message and logging deactivated (as the App)
+
+	mClients[0].task = xTaskGetCurrentTaskHandle();
+
+	send(0, 1, "01:\n", 4);
+	send(0, 71, "71:N\n", 5);
+
+	if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOADGEN_TIMEOUT)) == 0) {
+		mTimeouts++;
+	}
+
+	mLatency.reset();
+	memset(mSentCodes, 0, sizeof(mSentCodes));
+	mWrites = 0;
+	mBytesUp = 0;
+	mBytesDown = 0;
+
+	// Clients
+
+	uint64_t start = simTime();
+	uint64_t allocations = simAllocations();
+
+	for (uint8_t i = 0; i < mConfig.clients && mTimeouts == 0; i++) {
+
+		mClients[i].random = 20171026u + i;
+		mClients[i].sent = 0;
+		mClients[i].answered = 0;
+		mClients[i].lost = 0;
+
+		xTaskCreatePinnedToCore(&client_Task, "loadgen", 4096, (void*) (uintptr_t) i, 5, &mClients[i].task, 1);
+	}
+
+	uint8_t clients = (mTimeouts == 0) ? mConfig.clients : 0;
+
+	while (mClientsDone < clients) {
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+
+	mTimeLoad = (simTime() - start);
+	mAllocations = (simAllocations() - allocations);
+
+	mReceiveStats = bleReceiveStats();
+
+	simLinkDisconnect();
+
+	simStop();
+}
+
+/**
+ * @brief Options of command line
+ */
+static bool options(int argc, char** argv) {
+
+	for (int i = 1; i < argc; i++) {
+
+		const char* value = ((i + 1) < argc) ? argv[i + 1] : NULL;
+
+		if (strcmp(argv[i], "--real") == 0) {
+			mConfig.real = true;
+			continue;
+		}
+
+		if (value == NULL) {
+			return false;
+		}
+
+		i++;
+
+		if (strcmp(argv[i - 1], "--clients") == 0) {
+			mConfig.clients = atoi(value);
+		} else if (strcmp(argv[i - 1], "--messages") == 0) {
+			mConfig.messages = atoi(value);
+		} else if (strcmp(argv[i - 1], "--interval") == 0) {
+			mConfig.interval = atoi(value);
+		} else if (strcmp(argv[i - 1], "--fragment") == 0) {
+			mConfig.fragment = atoi(value);
+		} else if (strcmp(argv[i - 1], "--mtu") == 0) {
+			mConfig.mtu = atoi(value);
+		} else if (strcmp(argv[i - 1], "--link-interval") == 0) {
+			mConfig.linkInterval = atoi(value);
+		} else if (strcmp(argv[i - 1], "--payload") == 0) {
+			unsigned min = 0;
+			unsigned max = 0;
+			int count = sscanf(value, "%u:%u", &min, &max);
+			mConfig.payloadMin = min;
+			mConfig.payloadMax = (count == 2) ? max : min;
+		} else if (strcmp(argv[i - 1], "--mix") == 0) {
+			unsigned mix[LOADGEN_CODES_NUM] = { 0 };
+			if (sscanf(value, "%u,%u,%u,%u,%u", &mix[0], &mix[1], &mix[2], &mix[3], &mix[4]) != LOADGEN_CODES_NUM) {
+				return false;
+			}
+			for (uint8_t c = 0; c < LOADGEN_CODES_NUM; c++) {
+				mConfig.mix[c] = mix[c];
+			}
+		} else {
+			return false;
+		}
+	}
+
+	uint16_t total = 0;
+
+	for (uint8_t c = 0; c < LOADGEN_CODES_NUM; c++) {
+		total += mConfig.mix[c];
+	}
+
+	return (mConfig.clients > 0 && mConfig.clients <= LOADGEN_CLIENTS_MAX && total > 0 &&
+			mConfig.payloadMin <= mConfig.payloadMax && mConfig.mtu >= 20 && mConfig.linkInterval > 0);
+}
+
+////// Main
+
+int main(int argc, char** argv) {
+
+	if (!options(argc, argv)) {
+		printf("usage: %s [--clients N] [--messages N] [--interval ms] [--fragment bytes] [--payload min:max]\n"
+				"\t[--mtu N] [--mix w01,w11,w70,w71,w80] [--link-interval us] [--real]\n", argv[0]);
+		return 2;
+	}
+
+	simLogLevel(ESP_LOG_ERROR);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	simRun(loadgenMain, NULL, !mConfig.real);
+
+	double real = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double simulated = (double) mTimeLoad / 1000000.0;
+
+	// Totals
+
+	uint32_t sent = 0;
+	uint32_t answered = 0;
+	uint32_t lost = 0;
+
+	for (uint8_t i = 0; i < mConfig.clients; i++) {
+		sent += mClients[i].sent;
+		answered += mClients[i].answered;
+		lost += mClients[i].lost;
+	}
+
+	const SimLinkStats_t& link = simLinkStats();
+
+	// Report in JSON (one line)
+
+	printf("{\"loadgen\":{\"clients\":%u,\"messages\":%u,\"answered\":%u,\"lost\":%u,\"timeouts\":%u,"
+			"\"mismatches\":%u,\"unexpected\":%u,\"firmware\":{\"dropped\":%u,\"highWater\":%u},"
+			"\"latencyUs\":{\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu,\"avg\":%llu},"
+			"\"throughput\":{\"seconds\":%.3f,\"msgPerSec\":%.1f,\"realSeconds\":%.3f,\"realMsgPerSec\":%.0f,"
+			"\"bytesUp\":%llu,\"bytesDown\":%llu},"
+			"\"mix\":{\"01\":%u,\"11\":%u,\"70\":%u,\"71\":%u,\"80\":%u},"
+			"\"rates\":{\"intervalMs\":%u,\"offeredMsgPerSec\":%.1f,\"linkIntervalUs\":%u,\"mtu\":%u},"
+			"\"fragmentation\":{\"fragment\":%u,\"writes\":%u,\"writesPerMsg\":%.2f,\"notifications\":%u,\"events\":%u},"
+			"\"payload\":{\"min\":%u,\"max\":%u,\"avg\":%.1f,\"echoes\":%u},"
+			"\"allocations\":{\"total\":%llu,\"perMsg\":%.3f},\"clock\":\"%s\"}}\n",
+			mConfig.clients, sent, answered, lost, mTimeouts, mMismatches, mUnexpected,
+			mReceiveStats.dropped, mReceiveStats.highWater,
+			(unsigned long long) mLatency.percentile(500), (unsigned long long) mLatency.percentile(990),
+			(unsigned long long) mLatency.percentile(999), (unsigned long long) mLatency.max(),
+			(unsigned long long) mLatency.average(),
+			simulated, (simulated > 0) ? sent / simulated : 0.0, real, (real > 0) ? sent / real : 0.0,
+			(unsigned long long) mBytesUp, (unsigned long long) mBytesDown,
+			mSentCodes[0], mSentCodes[1], mSentCodes[2], mSentCodes[3], mSentCodes[4],
+			mConfig.interval, (mConfig.interval > 0) ? (mConfig.clients * 1000.0 / mConfig.interval) : 0.0,
+			mConfig.linkInterval, mConfig.mtu,
+			mConfig.fragment, mWrites, (sent > 0) ? (double) mWrites / sent : 0.0, link.notifications, link.events,
+			(mPayloads > 0) ? mPayloadMin : 0, mPayloadMax, (mPayloads > 0) ? (double) mPayloadTotal / mPayloads : 0.0,
+			mPayloads,
+			(unsigned long long) mAllocations, (sent > 0) ? (double) mAllocations / sent : 0.0,
+			(mConfig.real) ? "real" : "virtual");
+
+	return (simExitReason() == NULL && mMismatches == 0 && mUnexpected == 0 &&
+			sent == (mConfig.clients * mConfig.messages)) ? 0 : 1;
+}
+
+//////// End
@@ -6,6 +6,9 @@
  * Versions  :
  * ------- 	-------- 	-------------------------
  * 0.1.0 	01/08/18 	First version
+ * 0.3.1 	17/10/26 	Messages of values (bleSendValues) - frames of values in binary mode
+ * 						Statistics of sending returned by copy
+ * 						Transport set by bleSetTransport (ex: socket in host)
  */
 
 ///// Includes
@@ -15,6 +18,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include <string.h>
+
 // C++
 
 #include <string>
@@ -34,6 +39,7 @@ using namespace std;
 #include "main.h"
 
 #include "ble.h"
+#include "throughput.h"
 
 ///// Variables
 
@@ -45,10 +51,23 @@ static const char* TAG = "ble-server";
 
 static BleServer mBleServer;
 
+// Transport (if NULL, the default - BLE UART server or loopback)
+
+static const BleTransport_t* mBleTransport = NULL;
+
 // Utility class - uncomment if you need
 
 //static Esp_Util& mUtil = Esp_Util::getInstance(); // @suppress("Unused variable declaration in file scope")
 
+#ifdef BLE_COALESCING_DEADLINE
+
+// Codes of messages that needs low latency - sent immediately (no coalescing)
+// (response of initial message, echoes - used to measure latency - and errors)
+
+static const char* mUrgentCodes[] = { "01:", "70:", "-1:", NULL }; // TODO: see it!
+
+#endif
+
 /**
  * @brief Class MyBleServerCalllbacks - based on code of Kolban
  */
@@ -67,6 +86,10 @@ class MyBleServerCallbacks: public BleServerCallbacks {
 
 		mAppConnected = false;
 
+		// Start the jobs of main_Task stopped while idle
+
+		notifyMainTask(MAIN_TASK_ACTION_WAKE_JOBS);
+
 	}
 
 	/**
@@ -82,6 +105,12 @@ class MyBleServerCallbacks: public BleServerCallbacks {
 
 		mAppConnected = false;
 
+#ifdef THROUGHPUT_TEST
+		// Stop the test of throughput, if running
+
+		throughputStop();
+#endif
+
 		// Initializes app (main.cc)
 
 		appInitialize(true);
@@ -91,15 +120,15 @@ class MyBleServerCallbacks: public BleServerCallbacks {
 	/**
 	 * @brief OnConnect - for receive data 
 	 */
-	void onReceive(const char *message) {
+	void onReceive(const char *message, uint16_t size) {
 
 		// Received data via BLE server - by callback
 
-		//logV("BLE recv: [%u] %s", strlen(message), message);
+		//logV("BLE recv: [%u] %.*s", size, size, message);
 
 		// Process the message (main.cc)
 
-		processBleMessage(message);
+		processBleMessage(message, size);
 	}
 };
 
@@ -110,13 +139,43 @@ class MyBleServerCallbacks: public BleServerCallbacks {
  */
 void bleInitialize() {
 
+	// Transport
+
+	if (mBleTransport != NULL) {
+
+		mBleServer.setTransport(mBleTransport);
+
+	} else {
+
+#ifdef BLE_TRANSPORT_LOOPBACK
+		// Transport loopback (without BLE)
+
+		mBleServer.setTransport(&bleTransportLoopback);
+#endif
+	}
+
 	mBleServer.initialize(BLE_DEVICE_NAME, new MyBleServerCallbacks());
 
+#ifdef BLE_COALESCING_DEADLINE
+	// Coalescing of messages sent
+
+	mBleServer.setCoalescing(BLE_COALESCING_DEADLINE);
+#endif
+
 	// Debug
 
 	logI("BLE Server initialized!");
 }
 
+/**
+ * @brief Set the transport of BLE server (call it before bleInitialize)
+ * Note: to run the firmware with other transport (ex: socket or PTY in host), NULL is the default
+ */
+void bleSetTransport(const BleTransport_t* transport) {
+
+	mBleTransport = transport;
+}
+
 /**
  * @brief Finish BLE
  */
@@ -141,13 +200,24 @@ bool bleConnected() {
  * Note: char* wrapper
  */
 void bleSendData(const char* data) {
-	string aux = data;
-	bleSendData(aux);
+
+	bleSendData(data, strlen(data));
+}
+
+/**
+ * @brief Send data to mobile app (via BLE)
+ * Note: string wrapper
+ */
+void bleSendData(const string& data) {
+
+	bleSendData(data.c_str(), data.size());
 }
+
 /**
  * @brief Send data to mobile app (via BLE)
+ * Note: the data is not copied or changed here
  */
-void bleSendData(string& data) {
+void bleSendData(const char* data, uint16_t size) {
 
 	if (!mBleServer.connected()) {
 		logE("BLE not connected");
@@ -156,16 +226,135 @@ void bleSendData(string& data) {
 
 	// Considers the message sent as feedback as well
 
-	mLastTimeFeedback = mTimeSeconds;
+	mLastTimeFeedback = timeSeconds();
 
 	// Debug
 
-	//logD("data [%u] -> %s", data.size(), Util.strExpand(data).c_str());
+	//logD("data [%u] -> %.*s", size, size, data);
 
 	// Send by Ble Server
 
-	mBleServer.send(data);
+#ifdef BLE_COALESCING_DEADLINE
+	// Message that needs low latency ? (flush it)
+
+	bool flush = false;
+
+	for (uint8_t i = 0; mUrgentCodes[i] != NULL; i++) {
+		if (size >= 3 && strncmp(data, mUrgentCodes[i], 3) == 0) {
+			flush = true;
+			break;
+		}
+	}
+
+	mBleServer.send(data, size, flush);
+#else
+	mBleServer.send(data, size);
+#endif
+}
+
+/**
+ * @brief Send a message of values (numbers) to mobile app - nn:prefix:value:value...
+ * In binary mode, is sended as a frame of values (no conversion of numbers to text)
+ */
+void bleSendValues(uint8_t code, const char* prefix, const uint32_t* values, uint8_t count) {
+
+	if (!mBleServer.connected()) {
+		logE("BLE not connected");
+		return;
+	}
+
+	// Considers the message sent as feedback as well
+
+	mLastTimeFeedback = timeSeconds();
+
+	// Send by Ble Server
+
+#ifdef BLE_COALESCING_DEADLINE
+	// Message that needs low latency ? (flush it)
+
+	char codeStr[4];
+
+	snprintf(codeStr, sizeof(codeStr), "%02u:", code);
+
+	bool flush = false;
+
+	for (uint8_t i = 0; mUrgentCodes[i] != NULL; i++) {
+		if (strncmp(codeStr, mUrgentCodes[i], 3) == 0) {
+			flush = true;
+			break;
+		}
+	}
+
+	mBleServer.sendValues(code, prefix, values, count, flush);
+#else
+	mBleServer.sendValues(code, prefix, values, count);
+#endif
+}
+
+/**
+ * @brief Set the binary frames mode (see util/ble_frame.h) or text mode (binary = false)
+ */
+void bleSetBinaryMode(bool binary, bool crc) {
+
+	mBleServer.setBinaryMode(binary, crc);
+}
+
+/**
+ * @brief Statistics of sending by BLE (a copy, it is updated by others tasks)
+ */
+BleSendStats_t bleSendStats() {
+
+	return mBleServer.getSendStats();
+}
+
+/**
+ * @brief Statistics of receiving by BLE
+ */
+const BleReceiveStats_t& bleReceiveStats() {
+
+	return mBleServer.getReceiveStats();
+}
+
+/**
+ * @brief Histogram of latency of messages (by slot of code and stage - see BLE_LATENCY_* in util/ble_server.h)
+ * Note: a copy, it is updated by others tasks
+ */
+LatencyHistogram bleLatency(uint8_t slot, uint8_t stage) {
+
+	return mBleServer.getLatency(slot, stage);
+}
+
+/**
+ * @brief Code of message of a slot of latency (0 - the others or slot free)
+ */
+uint8_t bleLatencyCode(uint8_t slot) {
+
+	return mBleServer.getLatencyCode(slot);
+}
+
+/**
+ * @brief Clear the histograms of latency
+ */
+void bleLatencyReset() {
+
+	mBleServer.resetLatency();
+}
+
+/**
+ * @brief Return the maximum size of data of each sending (current MTU)
+ */
+uint16_t bleMTU() {
+
+	return mBleServer.getMTU();
+}
+
+/**
+ * @brief Return the maximum size of a line (with the new line) sended in one notification
+ * In binary mode, it is by the size of frame (see util/ble_frame.h)
+ */
+uint16_t bleLineMax() {
 
+	return mBleServer.getLineMax();
 }
 
 /**
@@ -18,19 +18,47 @@
 #include <string>
 using namespace std;
 
+// BLE server
+
+#include "util/ble_server.h"
+
 /////// Definitions
 
 #define BLE_DEVICE_NAME "Esp32_Device_" // Device name //TODO: see it!
                                         // Tip: is it ends with _, 
                                         // last two of the mac address is appended to name
+
+// Coalescing of messages sent (join small messages in same BLE packet, up to MTU)
+// Uncomment to enable it, the value is the maximum time to wait for more messages (ms)
+// Messages that needs low latency is sent immediately (see mUrgentCodes in ble.cc)
+
+//#define BLE_COALESCING_DEADLINE 20 	// TODO: see it!
+
+// Transport - uncomment to use the loopback (in memory, without BLE) instead of BLE UART server
+// Note: the client side is ble_loopback_* routines (see util/ble_transport.h)
+// Other transport can be set by bleSetTransport (before bleInitialize)
+
+//#define BLE_TRANSPORT_LOOPBACK true
+
 ////// Prototypes
 
 extern void bleInitialize();
+extern void bleSetTransport(const BleTransport_t* transport);
 extern void bleFinalize();
 extern void bleSendData(const char* data);
-extern void bleSendData(string& data);
+extern void bleSendData(const string& data);
+extern void bleSendData(const char* data, uint16_t size);
+extern void bleSendValues(uint8_t code, const char* prefix, const uint32_t* values, uint8_t count);
 extern bool bleConnected();
 extern const uint8_t* bleMacAddress();
+extern uint16_t bleMTU();
+extern uint16_t bleLineMax();
+extern void bleSetBinaryMode(bool binary, bool crc);
+extern BleSendStats_t bleSendStats();
+extern const BleReceiveStats_t& bleReceiveStats();
+extern LatencyHistogram bleLatency(uint8_t slot, uint8_t stage);
+extern uint8_t bleLatencyCode(uint8_t slot);
+extern void bleLatencyReset();
 
 #endif /* MAIN_BLE_H_ */
 
@@ -11,6 +11,17 @@
  * 						BLE has a queue now to receive data
  * 						Need when have more 1 message, to avoid empty string on event
  * 						Changed name of github repos to Esp-App-Mobile-Apps-*
+ * 0.3.1	17/10/26	Messages processed by table of handlers (msg_table), no more switch
+ * 						Actions of main_Task by bits of notification (not lost if more than one)
+ * 						main_Task by jobs of a scheduler (timer wheel), no more polling each second
+ * 						Histograms of latency of messages (11:LAT)
+ * 						Test of throughput (message 72)
+ * 						Values of ADC by snapshot of channels (11:ADC), no more mAdcBattery
+ * 						Messages with more fields than FIELDS_MAX are rejected
+ * 						Statistics of actions of main_Task (mainActionStats) - notified, runs and coalesced
+ * 						Jobs of status (each second) and debug stops while idle (no wakeup of main_Task),
+ * 						started again by BLE connection or logging activated (MAIN_TASK_ACTION_WAKE_JOBS)
+ * 						Time in seconds by millis (timeSeconds), no more counted by main_Task
  **/
 
 /**
@@ -20,16 +31,21 @@
  * (where nn is code of message and payload is content, can be delimited too)
  * -----------------------------
  * Messages codes:
- * 01 Initial
+ * 01 Initial (01:BIN or 01:BINC to use binary frames, with CRC for BINC - see util/ble_frame.h)
  * 10 Energy status(External or Battery?)
- * 11 Informations about ESP32 device
+ * 11 Informations about ESP32 device (11:type, type = ESP32, FMEM, VDD33, BLE, BLERX, LAT, ADC, VBAT, VEXT or ALL)
+ *    LAT is the histograms of latency of messages (11:LAT:R to clear it) - not in ALL
+ *    ADC is the filtered values of channels of ADC (see peripherals.h) - not in ALL
+ *    FMEM, VDD33, BLE, BLERX and ADC are messages of values (in binary mode, frames of values without text)
  * 70 Echo debug
  * 71 Logging (to activate or not)
+ * 72 Test of throughput (72:bytes[:seconds] or 72:STOP - see throughput.h)
  * 80 Feedback
  * 98 Restart (reset the ESP32)
  * 99 Standby (enter in deep sleep)
  *
  * // TODO: see it! please remove that you not use and keep it updated
+ * // Note: the handlers is registered in table of messages (see MsgRegister)
  **/
 
 /*
@@ -71,6 +87,8 @@ extern "C" {
 #include "util/log.h"
 #include "util/esp_util.h"
 #include "util/fields.h"
+#include "util/msg_table.h"
+#include "util/scheduler.h"
 
 // Do projeto
 
@@ -83,7 +101,37 @@ extern "C" {
 static void main_Task(void *pvParameters) ;
 static void standby(const char*	cause, bool sendBLEMsg) ;
 static void debugInitial();
-static void sendInfo(Fields& fields);
+static void sendInfo(FieldsView& fields);
+
+// Handlers of messages
+
+static void msgInitial(const char* message, uint16_t size, FieldsView& fields, string& response);
+static void msgInitialAfter();
+static void msgInfo(const char* message, uint16_t size, FieldsView& fields, string& response);
+static void msgEcho(const char* message, uint16_t size, FieldsView& fields, string& response);
+static void msgLogging(const char* message, uint16_t size, FieldsView& fields, string& response);
+static void msgFeedback(const char* message, uint16_t size, FieldsView& fields, string& response);
+static void msgRestart(const char* message, uint16_t size, FieldsView& fields, string& response);
+static void msgRestartAfter();
+static void msgStandby(const char* message, uint16_t size, FieldsView& fields, string& response);
+static void msgStandbyAfter();
+
+ // Jobs of main_Task (by scheduler)
+
+static void jobSeconds(void* arg);
+static void jobDebug(void* arg);
+#if defined MAX_TIME_INACTIVE && defined HAVE_S
+static void jobInactive(void* arg);
+#endif
+#ifdef MAX_TIME_WITHOUT_FB
+static void jobFeedback(void* arg);
+#endif
+#ifdef HAVE_BATTERY
+static void jobEnergy(void* arg);
+#endif
+static void resetJobs();
+static void startJobs();
+static bool idle();
 
 #ifdef HAVE_BATTERY
 static void checkEnergyVoltage (bool sendingStatus);
@@ -101,7 +149,7 @@ static Esp_Util& mUtil = Esp_Util::getInstance();
 
 // Times and intervals 
 
-uint32_t mTimeSeconds = 0; 			// Current time in seconds (for timeouts calculations)
+static uint32_t mTimeStart = 0; 	// Time (millis) of start of seconds (see timeSeconds)
 
 uint32_t mLastTimeFeedback = 0; 	// Indicates the time of the last feedback message
 
@@ -116,12 +164,48 @@ bool mLogActiveSaved = false;
 
 bool mAppConnected = false; // Indicates connection when receiving message 01: 
 
+// Mode of messages requested in message 01 (binary frames or text) 
+
+static bool mBinaryMode = false;
+static bool mBinaryCrc = false;
+
+////// Messages - table of handlers by code (processed in processBleMessage)
+// TODO: see it! Please put here custom messages, or register it in your module, with MsgRegister
+
+static MsgRegister mMsgInitial	(1, msgInitial, msgInitialAfter, MSG_FLAG_FEEDBACK | MSG_FLAG_ENERGY);
+#ifdef HAVE_BATTERY
+static MsgRegister mMsgEnergy	(10, NULL, NULL, MSG_FLAG_FEEDBACK | MSG_FLAG_ENERGY); // Status of energy: battery or external (USB or power supply)
+#endif
+static MsgRegister mMsgInfo		(11, msgInfo);
+static MsgRegister mMsgEcho		(70, msgEcho);
+static MsgRegister mMsgLogging	(71, msgLogging);
+static MsgRegister mMsgFeedback	(80, msgFeedback);
+static MsgRegister mMsgRestart	(98, msgRestart, msgRestartAfter);
+static MsgRegister mMsgStandby	(99, msgStandby, msgStandbyAfter);
+
 ////// FreeRTOS
 
 // Task main
 
 static TaskHandle_t xTaskMainHandler = NULL;
 
+// Actions notified to main task - counts to know how many notifications is coalesced
+// (the same action notified again before main_Task process it)
+
+static MainActionStats_t mActionStats[MAIN_TASK_ACTION_MAX + 1];
+
+static portMUX_TYPE mActionMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Scheduler of jobs of main_Task (the task sleeps until the next deadline)
+
+static Scheduler mScheduler;
+
+static int8_t mJobSeconds = SCHEDULER_NONE;		// Each second - led, sensors (stopped while idle)
+static int8_t mJobDebug = SCHEDULER_NONE;		// Debug each 5 seconds (stopped while not debugging)
+static int8_t mJobInactive = SCHEDULER_NONE;	// Timeout of inactivity
+static int8_t mJobFeedback = SCHEDULER_NONE;	// Timeout without feedback
+static int8_t mJobEnergy = SCHEDULER_NONE;		// Check energy each minute
+
 ////// Main
 
 extern "C" {
@@ -166,7 +250,9 @@ void app_main()
 
 /**
  * @brief Main Task - main processing 
- * Is a second timer to process, adquiry data, send responses to mobile App, control timeouts, etc.
+ * Process the jobs (by scheduler): adquiry data, control timeouts, etc.
+ * and actions notified (to process here, not in ISR or callbacks)
+ * Note: it sleeps until the next deadline of jobs (no polling each second)
  */
 static void main_Task (void * pvParameters) { 
 
@@ -176,7 +262,7 @@ static void main_Task (void * pvParameters) {
 
 	// Init the time 
 	
-	mTimeSeconds = 0; 
+	mTimeStart = millis(); 
 
 	/////// Initializations 
 
@@ -184,19 +270,25 @@ static void main_Task (void * pvParameters) {
 
 	appInitialize (false);
 
-	// Sensors values
+	////// Jobs 
 
-#if defined HAVE_BATTERY && defined PIN_SENSOR_CHARGING
-	// Use this to verify changes on this sensor
-	// Due debounce logic
-	bool lastChgBattery = mGpioChgBattery; 
-#endif
+	uint32_t now = millis();
 
-	////// FreeRTOS 
+	mScheduler.begin(now);
 
-	// Timeout - task - 1 second
+	startJobs();
 
-	const TickType_t xTicks = (1000u / portTICK_RATE_MS);
+#if defined MAX_TIME_INACTIVE && defined HAVE_S
+	mJobInactive = mScheduler.add(now, jobInactive, (MAX_TIME_INACTIVE * 1000u));
+#endif
+#ifdef MAX_TIME_WITHOUT_FB
+	mJobFeedback = mScheduler.add(now, jobFeedback, (MAX_TIME_WITHOUT_FB * 1000u));
+#endif
+#ifdef HAVE_BATTERY
+	mJobEnergy = mScheduler.add(now, jobEnergy, 60000u, 60000u);
+#endif
+
+	// TODO: see it! Put here your custom jobs (see util/scheduler.h)
 
 	////// Loop 
 
@@ -204,200 +296,338 @@ static void main_Task (void * pvParameters) {
 
 	for (;;) {
 
-		// Wait for the time or something notified (seen in the FreeRTOS example) 
+		// Run the jobs with deadline reached, and get the time to the next
+
+		uint32_t wait = mScheduler.run(millis());
+
+		// Wait for the next deadline or something notified (seen in the FreeRTOS example) 
+
+		TickType_t xTicks = (wait == SCHEDULER_NO_DEADLINE) ? portMAX_DELAY :
+								((wait + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
 
 		if (xTaskNotifyWait (0, 0xffffffff, &notification, xTicks) == pdPASS) { 
 
-			// Action by task notification
+			// Actions by task notification (bits) - process all pending
 
-			logD ("Notification received -> %u", notification); 
+			logD ("Notification received -> 0x%x", notification); 
 
 			bool reset_timer = false;
 
-			switch (notification) {
+			for (uint32_t action = 1; action <= MAIN_TASK_ACTION_MAX; action++) {
+
+				if ((notification & MAIN_TASK_ACTION_BIT(action)) == 0) {
+					continue;
+				}
+
+				// Coalesced ? (notified more than once before this wakeup)
+
+				portENTER_CRITICAL(&mActionMux);
+
+				MainActionStats_t& stats = mActionStats[action];
+
+				uint32_t coalesced = (stats.notified - stats.processed);
+
+				if (coalesced > 0) { // Else, the notifications was processed in the last run
+					stats.processed = stats.notified;
+					stats.runs++;
+					stats.coalesced += (coalesced - 1);
+				}
+
+				portEXIT_CRITICAL(&mActionMux);
+
+				if (coalesced > 1) {
+					logD ("Action %u notified %u times", action, coalesced);
+				}
 
-				case MAIN_TASK_ACTION_RESET_TIMER: 	// Reset timer
-					reset_timer = true;
-					break;
+				switch (action) {
 
-				case MAIN_TASK_ACTION_STANDBY_BTN: 	// Enter in standby - to deep sleep not run in ISR
-					standby("Pressed button standby", true);
-					break;
+					case MAIN_TASK_ACTION_RESET_TIMER: 	// Reset timer
+						reset_timer = true;
+						break;
 
-				case MAIN_TASK_ACTION_STANDBY_MSG: 	// Enter in standby - to deep sleep not run in ISR
-					standby ("99 code msg - standby", false);
-					break;
+					case MAIN_TASK_ACTION_STANDBY_BTN: 	// Enter in standby - to deep sleep not run in ISR
+						standby("Pressed button standby", true);
+						break;
+
+					case MAIN_TASK_ACTION_STANDBY_MSG: 	// Enter in standby - to deep sleep not run in ISR
+						standby ("99 code msg - standby", false);
+						break;
 #ifdef HAVE_BATTERY
-				case MAIN_TASK_ACTION_SEN_VEXT: 	// Sensor of Powered by external voltage (USB or power supply) is changed - to not do it in ISR
+					case MAIN_TASK_ACTION_SEN_VEXT: 	// Sensor of Powered by external voltage (USB or power supply) is changed - to not do it in ISR
 
-					checkEnergyVoltage(true);			
-					break;
+						checkEnergyVoltage(true);			
+						break;
 
 	#ifdef MAIN_TASK_ACTION_SEN_CHGR
-				case MAIN_TASK_ACTION_SEN_CHGR: 	// Sensor of battery charging is changed - to not do it in ISR
+					case MAIN_TASK_ACTION_SEN_CHGR: 	// Sensor of battery charging is changed - to not do it in ISR
 
-					checkEnergyVoltage(true);			
-					break;
+						checkEnergyVoltage(true);			
+						break;
 	#endif
 #endif
-				// TODO: see it! If need put here your custom notifications
+					case MAIN_TASK_ACTION_WAKE_JOBS: 	// BLE connected or logging activated - start the jobs stopped while idle
+						startJobs();
+						break;
+
+					// TODO: see it! If need put here your custom notifications
 
-				default:
-					break;
+					default:
+						break;
+				}
 			}
 
-			// Resets the time variables and returns to the beginning of the loop ?
+			// Resets the time variables and the jobs ?
 			// Usefull to initialize the time (for example, after App connection)
 
 			if (reset_timer) {
 
 				// Clear variables
 
-				mTimeSeconds = 0;
+				mTimeStart = millis();
 				mLastTimeFeedback = 0;
 				mLastTimeReceivedData = 0;
 
+				// Restart the jobs
+
+				resetJobs();
+
 				// TODO: see it! put here custom reset timer code 
 
 				// Debug
 
 				logD("Reseted time");
-
-				continue; // Returns to loop begin
-
 			}
 		}
+	} 
+
+	////// End 
+
+	// Delete this task 
+
+	vTaskDelete (NULL); 
+	xTaskMainHandler = NULL;
 
-		////// Processes every second 
+}
 
-		// Time counter 
+////// Jobs of main_Task (by scheduler)
 
-		mTimeSeconds++; 
+/**
+ * @brief Job - each second, only while not idle (BLE connected or debugging)
+ * While idle, it stops (no wakeup of main_Task each second), the led of status keeps your level
+ * and the samples of ADC is not filtered (the values is only used with BLE connected)
+ */
+static void jobSeconds(void* arg) {
+
+	// Idle ? stop it (started again by MAIN_TASK_ACTION_WAKE_JOBS)
+
+	if (idle()) {
+
+		mScheduler.cancel(mJobSeconds);
+		mJobSeconds = SCHEDULER_NONE;
+		return;
+	}
 
 #ifdef PIN_LED_STATUS
-		// Blink the led of status (board led of Esp32 or external)
+	// Blink the led of status (board led of Esp32 or external)
 
-		gpioBlinkLedStatus();
+	gpioBlinkLedStatus();
 #endif
 
-		// Sensors readings by ADC
+	// Sensors readings by ADC
+
+	adcRead();
+
+	// TODO: see it! Put here your custom code to run every second
+
+	// Debug
+
+	if (mLogActive) {
+
+		//TODO: see it! put here that you want see each second
+		// If have, please add our variables and uncomment it
+		// logV("* Time seconds=%d", timeSeconds());
+	}
+
+#if defined HAVE_BATTERY && defined PIN_SENSOR_CHARGING
+
+	// Check the voltage of battery/charging, if it is changed (due debounce logic when no battery plugged)
+	// Only if BLE is connected
 
-		adcRead();
+	static bool lastChgBattery = mGpioChgBattery; 
 
-		// TODO: see it! Put here your custom code to run every second
+	if (bleConnected()) {
 
-		// Debug
+		if (mGpioChgBattery != lastChgBattery) {
+			checkEnergyVoltage(true);
+		}
 
-		if (mLogActive) {
+		lastChgBattery = mGpioChgBattery; 
+	}
+#endif
 
-			if (mTimeSeconds % 5 == 0) { // Debug each 5 secs
+	// TODO: see it! put here custom routines for when BLE is connected		
+}
+
+/**
+ * @brief Job - debug each 5 seconds
+ */
+static void jobDebug(void* arg) {
+
+	if (!mLogActive) { // Stop it (started again by MAIN_TASK_ACTION_WAKE_JOBS)
+
+		mScheduler.cancel(mJobDebug);
+		mJobDebug = SCHEDULER_NONE;
+		return;
+	}
 
 #ifdef HAVE_BATTERY
-				logD("* Secs=%d | sensors: vext=%c charging=%c vbat=%d | mem=%d",
-							mTimeSeconds,
-							((mGpioVEXT)?'Y':'N'), 
-							((mGpioChgBattery)?'Y':'N'), 
-							mAdcBattery,
-							esp_get_free_heap_size());
+	logD("* Secs=%d | sensors: vext=%c charging=%c vbat=%d | mem=%d",
+				timeSeconds(),
+				((mGpioVEXT)?'Y':'N'), 
+				((mGpioChgBattery)?'Y':'N'), 
+				adcValue(ADC_INDEX_VBAT),
+				esp_get_free_heap_size());
 #else
-				logD("* Time seconds=%d", mTimeSeconds);
+	logD("* Time seconds=%d", timeSeconds());
 #endif
-			} else { // Verbose //TODO: see it! put here that you want see each second
-							    // If have, please add our variables and uncomment it
-				// logV("* Time seconds=%d", mTimeSeconds);
-
-			}
-		}
+}
 
 #if defined MAX_TIME_INACTIVE && defined HAVE_S
 
-		////// Auto power off (standby) 
-		// If it has been inactive for the maximum time allowed, it goes into standby (soft off) 
+/**
+ * @brief Job - timeout of inactivity - auto power off (standby) 
+ * If it has been inactive for the maximum time allowed, it goes into standby (soft off) 
+ * Else schedule it again to the remaining time (the time of last data received is changed)
+ */
+static void jobInactive(void* arg) {
+
+	uint32_t seconds = timeSeconds();
+
+	uint32_t elapsed = (bleConnected()) ? (seconds - mLastTimeReceivedData) : seconds;
 
 #ifdef HAVE_BATTERY
-		bool verifyInactive = !mGpioVEXT; // Only if it is not powered by external voltage (USB or power supply) - to not abort debuggings;
+	bool verifyInactive = !mGpioVEXT; // Only if it is not powered by external voltage (USB or power supply) - to not abort debuggings;
 #else
-		bool verifyInactive = true;
+	bool verifyInactive = true;
 #endif
-		if (verifyInactive) { // Verify it ?
 
-			bool inactive = false;
+	if (verifyInactive && elapsed >= MAX_TIME_INACTIVE) { 
 
-			if (bleConnected ()) { 
-				inactive = ((mTimeSeconds - mLastTimeReceivedData) >= MAX_TIME_INACTIVE);
-			} else { 
-				inactive = (mTimeSeconds >= MAX_TIME_INACTIVE);
-			} 
+		// Set to standby (soft off) 
 
-			if (inactive) { 
+		standby ("Attained maximum time of inactivity", true); 
+		return; 
+	} 
 
-				// Set to standby (soft off) 
+	// Schedule it again
 
-				standby ("Attained maximum time of inactivity", true); 
-				return; 
+	uint32_t remain = (elapsed < MAX_TIME_INACTIVE) ? (MAX_TIME_INACTIVE - elapsed) : MAX_TIME_INACTIVE;
 
-			} 
-		} 
+	mJobInactive = mScheduler.add(millis(), jobInactive, (remain * 1000u));
+}
 #endif
-		/////// BLE connected ?
 
-		if (!bleConnected()) {
-			continue;
-		}
+#ifdef MAX_TIME_WITHOUT_FB
 
-		/////// Routines with only if BLE is connected
+/**
+ * @brief Job - timeout without feedback messages (only if BLE is connected)
+ * Else schedule it again to the remaining time
+ */
+static void jobFeedback(void* arg) {
 
-#if HAVE_BATTERY
+	uint32_t elapsed = (timeSeconds() - mLastTimeFeedback);
 
-		// Check the voltage of battery/charging
+	if (bleConnected() && !mLogActive) { // Only if it is not debugging
 
-		#ifdef PIN_SENSOR_CHARGING
-				// Verify if it is changed (due debounce logic when no battery plugged)
-				if (mGpioChgBattery != lastChgBattery) {
-					checkEnergyVoltage(true);
-				}
-		#endif
+		if (elapsed >= MAX_TIME_WITHOUT_FB) {
 
-		if ((mTimeSeconds % 60) == 0) { // Each minute
+			// Enter in standby (soft off)
 
-			checkEnergyVoltage(false);
-		}
-#endif
+			standby ("No feedback received in time", true);
+			return;
+		} 
+	}
 
-#ifdef MAX_TIME_WITHOUT_FB
-		// If not received feedback message more than the allowed time
+	// Schedule it again
 
-		if (!mLogActive) { // Only if it is not debugging
+	uint32_t remain = (elapsed < MAX_TIME_WITHOUT_FB) ? (MAX_TIME_WITHOUT_FB - elapsed) : MAX_TIME_WITHOUT_FB;
 
-			if ((mTimeSeconds - mLastTimeFeedback) >= MAX_TIME_WITHOUT_FB) {
+	mJobFeedback = mScheduler.add(millis(), jobFeedback, (remain * 1000u));
+}
+#endif
 
-				// Enter in standby (soft off)
+#ifdef HAVE_BATTERY
 
-				standby ("No feedback received in time");
-				return;
+/**
+ * @brief Job - check the voltage of battery/charging each minute (only if BLE is connected)
+ */
+static void jobEnergy(void* arg) {
 
-			} 
-		}
+	if (bleConnected()) {
+		checkEnergyVoltage(false);
+	}
+}
 #endif
 
-		// Sensors values saving
+/**
+ * @brief Restart the jobs (after reset of time)
+ */
+static void resetJobs() {
+
+	// Jobs stopped while idle - again from now
 
-#if defined HAVE_BATTERY && defined PIN_SENSOR_CHARGING
+	mScheduler.cancel(mJobSeconds);
+	mScheduler.cancel(mJobDebug);
 
-		lastChgBattery = mGpioChgBattery; 
+	mJobSeconds = SCHEDULER_NONE;
+	mJobDebug = SCHEDULER_NONE;
+
+	startJobs();
+
+	// Others
+
+#if defined MAX_TIME_INACTIVE && defined HAVE_S
+	mScheduler.restart(millis(), mJobInactive, (MAX_TIME_INACTIVE * 1000u));
+#endif
+#ifdef MAX_TIME_WITHOUT_FB
+	mScheduler.restart(millis(), mJobFeedback, (MAX_TIME_WITHOUT_FB * 1000u));
+#endif
+#ifdef HAVE_BATTERY
+	mScheduler.restart(millis(), mJobEnergy, 60000u);
 #endif
+}
 
-		// TODO: see it! put here custom routines for when BLE is connected		
+/**
+ * @brief Start the jobs stopped while idle (if not running)
+ */
+static void startJobs() {
 
-	} 
+	uint32_t now = millis();
 
-	////// End 
+	if (!mScheduler.active(mJobSeconds) && !idle()) {
+		mJobSeconds = mScheduler.add(now, jobSeconds, 1000u, 1000u);
+	}
 
-	// Delete this task 
+	if (!mScheduler.active(mJobDebug) && mLogActive) {
+		mJobDebug = mScheduler.add(now, jobDebug, 5000u, 5000u);
+	}
+}
 
-	vTaskDelete (NULL); 
-	xTaskMainHandler = NULL;
+/**
+ * @brief Idle ? (BLE not connected and not debugging)
+ */
+static bool idle() {
 
+	return (!bleConnected() && !mLogActive);
+}
+
+/**
+ * @brief Time in seconds (since the start or reset of time)
+ * Note: by millis, so it is right even while main_Task is sleeping
+ */
+uint32_t timeSeconds() {
+
+	return ((millis() - mTimeStart) / 1000u);
 }
 
 /**
@@ -431,27 +661,42 @@ void appInitialize(bool resetTimerSeconds) {
 /**
  * @brief Process the message received from BLE
  * Note: this routine is in main.cc due major resources is here
+ *       each code of message is processed by your handler, in table of messages (msg_table)
  */
-void processBleMessage (const string& message) {
+void processBleMessage (const char* message, uint16_t size) {
 
 	// This is to process ASCII (text) messagens - not binary ones
 
-	string response = ""; // Return response to mobile app
+	// Return response to mobile app
+	// Static and reserved once, to not allocate for each message (only the task of BLE events calls it)
+
+	static string response;
+
+	if (response.capacity() < BLE_LINE_MAX_SIZE) {
+		response.reserve(BLE_LINE_MAX_SIZE);
+	}
+
+	response.clear();
 
 	// --- Process the received line 
 
 	// Check the message
 
-	if (message.length () < 2 ) {
+	if (size < 2 ) {
 
 		error("Message length must have 2 or more characters");
 		return; 
 
 	} 
 
-	// Process fields of the message 
+	// Process fields of the message (without copy of message)
+
+	FieldsView fields(message, size, ':');
 
-	Fields fields(message, ":");
+	if (!fields.valid()) { // More fields than FIELDS_MAX - not act on a part of message
+		error ("Too many fields in message");
+		return;
+	}
 
 	// Code of the message 
 
@@ -469,270 +714,310 @@ void processBleMessage (const string& message) {
 		return; 
 	} 
 
-	logV("Code -> %u Message -> %s", code, mUtil.strExpand (message).c_str());
+	logV("Code -> %u Message -> %.*s", code, size, message);
+
+	// Handler of this code (direct in table)
+
+	const MsgEntry_t* entry = msgLookup(code);
+
+	if (entry == NULL) {
+		string errorMsg = "Code of message invalid: ";
+		errorMsg.append(mUtil.intToStr(code)); 
+		error (errorMsg.c_str()); 
+		return;
+	}
+
+	// Only with App connected ?
+
+	if ((entry->flags & MSG_FLAG_NEED_APP) && !mAppConnected) {
+		error ("App not connected"); 
+		return;
+	}
 
 	// Considers the message received as feedback also 
 
-	mLastTimeFeedback = mTimeSeconds;
+	if (entry->flags & MSG_FLAG_FEEDBACK) {
+		mLastTimeFeedback = timeSeconds();
+	}
 
 	// Process the message 
 
+	if (entry->handler != NULL) {
+		entry->handler(message, size, fields, response);
+	}
+
+	// return 
+
+	if (response.size() > 0) {
+
+		// Return -> Send message response
+
+		if (bleConnected ()) { 
+			bleSendData(response);
+		} 
+	} 
+
 #ifdef HAVE_BATTERY
-	bool sendEnergy = false; // Send response with the energy situation too? 
+	// Return energy situation too? 
+
+	if (entry->flags & MSG_FLAG_ENERGY) { 
+
+		checkEnergyVoltage (true);
+
+	} 
 #endif
 
-	switch (code) { // Note: the '{' and '}' in cases, is to allow to create local variables, else give an error cross definition ... 
+	// Mark the time (seconds) of the receipt 
 
-	// --- Initial messages 
+	mLastTimeReceivedData = timeSeconds();
 
-	case 1: // Start 
-		{
-			// Initial message sent by the mobile application, to indicate start of the connection
+	// Here is processed messages that have actions to do after response sended
 
-			if (mLogActive) { 
-				debugInitial();
-			}
+	if (entry->postAction != NULL) {
+		entry->postAction();
+	}
+
+} 
+
+////// Handlers of messages (see table in Variables)
+
+/**
+ * @brief Message 01 - Initial
+ */
+static void msgInitial(const char* message, uint16_t size, FieldsView& fields, string& response) {
+
+	// Initial message sent by the mobile application, to indicate start of the connection
+
+	if (mLogActive) { 
+		debugInitial();
+	}
 
-			// Reinicialize the app - include timer of seconds
+	// Reinicialize the app - include timer of seconds
 
-			appInitialize(true);
+	appInitialize(true);
 
-			// Indicates connection initiated by the application 
+	// Indicates connection initiated by the application 
 
-			mAppConnected = true;
+	mAppConnected = true;
 
-			// Inform to mobile app, if this device is battery powered and sensors 
-			// Note: this is important to App works with differents versions or models of device
+	// Inform to mobile app, if this device is battery powered and sensors 
+	// Note: this is important to App works with differents versions or models of device
+	// Note: the energy status is sended after it (flag MSG_FLAG_ENERGY)
 
 #ifdef HAVE_BATTERY
 
-			// Yes, is a battery powered device
+	// Yes, is a battery powered device
 
-			string haveBattery = "Y";
-			
+	string haveBattery = "Y";
+	
 #ifdef PIN_SENSOR_CHARGING
 
-			// Yes, have a sensor of charging
-			string sensorCharging = "Y";
+	// Yes, have a sensor of charging
+	string sensorCharging = "Y";
 
 #else
-			// No have a sensor of charging
-			string sensorCharging = "N";
+	// No have a sensor of charging
+	string sensorCharging = "N";
 #endif
-			// Send energy status (also if this project not have battery, to mobile app know it)
-
-			sendEnergy = true;
 
 #else
 
-			// No, no is a battery powered device
+	// No, no is a battery powered device
 
-			string haveBattery = "N";
-			string sensorCharging = "N";
+	string haveBattery = "N";
+	string sensorCharging = "N";
 
 #endif
-			// Debug
+	// Debug
 
-			bool turnOnDebug = false;
+	bool turnOnDebug = false;
 
 #ifdef HAVE_BATTERY
 
-			// Turn on the debugging (if the USB is connected)
+	// Turn on the debugging (if the USB is connected)
 
-			if (mGpioVEXT && !mLogActive) {
-				turnOnDebug = true; 
-			} 
+	if (mGpioVEXT && !mLogActive) {
+		turnOnDebug = true; 
+	} 
 #else
 
-			// Turn on debugging
+	// Turn on debugging
 
-			turnOnDebug = !mLogActive;
+	turnOnDebug = !mLogActive;
 
 #endif
 
-			// Turn on the debugging (if the USB cable is connected)
+	// Turn on the debugging (if the USB cable is connected)
 
-			if (turnOnDebug) {
+	if (turnOnDebug) {
 
-				mLogActive = true; 
-				debugInitial();
-			} 
+		mLogActive = true; 
+		debugInitial();
+	} 
 
-			// Reset the time in main_Task
+	// Reset the time in main_Task
 
-			notifyMainTask(MAIN_TASK_ACTION_RESET_TIMER);
+	notifyMainTask(MAIN_TASK_ACTION_RESET_TIMER);
 
-			// Returns status of device, this firware version and if is a battery powered device
+	// Binary frames mode requested ? (it is changed after the response, in msgInitialAfter)
 
-			response = "01:";
-			response.append(FW_VERSION);
-			response.append(1u, ':');
-			response.append(haveBattery);
-			response.append(1u, ':');
-			response.append(sensorCharging);
-			
-		}
-		break; 
-	
-#ifdef HAVE_BATTERY
-	case 10: // Status of energy: battery or external (USB or power supply)
-		{
-			sendEnergy = true;
-		}
-		break; 
-#endif
-	
-	case 11: // Request of ESP32 informations
-		{
-			// Example of passing fields class to routine process
+	StrView mode = fields.getString(2);
 
-			sendInfo(fields);
+	mBinaryMode = (mode == "BIN" || mode == "BINC");
+	mBinaryCrc = (mode == "BINC");
 
-		}
-		break;
+	// Returns status of device, this firware version and if is a battery powered device
+	// And the binary mode, if accepted
 
-	// TODO: see it! Please put here custom messages
+	response = "01:";
+	response.append(FW_VERSION);
+	response.append(1u, ':');
+	response.append(haveBattery);
+	response.append(1u, ':');
+	response.append(sensorCharging);
 
-	case 70: // Echo (for test purpose)
-		{
-			response = message;
-		}
-		break; 
+	if (mBinaryMode) {
+		response.append(1u, ':');
+		response.append(mode.data(), mode.size());
+	}
+}
 
-	case 71: // Logging - activate or desactivate debug logging - save state to use after
-		{
-			switch (fields.getChar(2)) // Process options
-			{
-				case 'Y': // Yes
+/**
+ * @brief Message 01 - after response - change the mode of messages (binary frames or text)
+ */
+static void msgInitialAfter() {
 
-					mLogActiveSaved = mLogActive; // Save state
-					mLogActive = true; // Activate it
+	bleSetBinaryMode(mBinaryMode, mBinaryCrc);
+}
 
-					logV("Logging activated now");
-					break;
+/**
+ * @brief Message 11 - Request of ESP32 informations
+ */
+static void msgInfo(const char* message, uint16_t size, FieldsView& fields, string& response) {
 
-				case 'N': // No
+	// Example of passing fields class to routine process
 
-					logV("Logging deactivated now");
+	sendInfo(fields);
+}
 
-					mLogActiveSaved = mLogActive; // Save state
-					mLogActive = false; // Deactivate it
-					break;
+/**
+ * @brief Message 70 - Echo (for test purpose)
+ */
+static void msgEcho(const char* message, uint16_t size, FieldsView& fields, string& response) {
 
-				case 'R': // Restore
+	response.assign(message, size);
+}
 
-					mLogActive = mLogActiveSaved; // Restore state
-					logV("Logging state restored now");
-					break;
-			}
-		}
-		break; 
+/**
+ * @brief Message 71 - Logging - activate or desactivate debug logging - save state to use after
+ */
+static void msgLogging(const char* message, uint16_t size, FieldsView& fields, string& response) {
 
-	case 80: // Feedback 
-		{
-			// Message sent by the application periodically, for connection verification
+	switch (fields.getChar(2)) // Process options
+	{
+		case 'Y': // Yes
 
-			logV("Feedback recebido");
+			mLogActiveSaved = mLogActive; // Save state
+			mLogActive = true; // Activate it
 
-			// Response it (put here any information that needs)
+			notifyMainTask(MAIN_TASK_ACTION_WAKE_JOBS); // Debug job
 
-			response = "80:"; 
-		}
-		break; 
+			logV("Logging activated now");
+			break;
 
-	case 98: // Reinicialize the app
-		{
-			logI ("Reinitialize");
+		case 'N': // No
 
-			// End code placed at the end of this routine to send OK before 
-		}
-		break; 
+			logV("Logging deactivated now");
 
-	case 99: // Enter in standby
-		{
-			logI ("Entering in standby");
+			mLogActiveSaved = mLogActive; // Save state
+			mLogActive = false; // Deactivate it
+			break;
 
-			// End code placed at the end of this routine to send OK before 
-		}
-		break; 
+		case 'R': // Restore
 
-	default: 
-		{
-			string errorMsg = "Code of message invalid: ";
-			errorMsg.append(mUtil.intToStr(code)); 
-			error (errorMsg.c_str()); 
-			return;
-		}
-	}
+			mLogActive = mLogActiveSaved; // Restore state
 
-	// return 
+			notifyMainTask(MAIN_TASK_ACTION_WAKE_JOBS);
 
-	if (response.size() > 0) {
+			logV("Logging state restored now");
+			break;
+	}
+}
 
-		// Return -> Send message response
+/**
+ * @brief Message 80 - Feedback
+ */
+static void msgFeedback(const char* message, uint16_t size, FieldsView& fields, string& response) {
 
-		if (bleConnected ()) { 
-			bleSendData(response);
-		} 
-	} 
+	// Message sent by the application periodically, for connection verification
 
-#ifdef HAVE_BATTERY
-	// Return energy situation too? 
+	logV("Feedback recebido");
 
-	if (sendEnergy) { 
+	// Response it (put here any information that needs)
 
-		checkEnergyVoltage (true);
+	response = "80:"; 
+}
 
-	} 
-#endif
+/**
+ * @brief Message 98 - Reinicialize the app
+ */
+static void msgRestart(const char* message, uint16_t size, FieldsView& fields, string& response) {
 
-	// Mark the mTimeSeconds of the receipt 
+	logI ("Reinitialize");
 
-	mLastTimeReceivedData = mTimeSeconds;
+	// End code placed in msgRestartAfter, to send OK before 
+}
 
-	// Here is processed messages that have actions to do after response sended
+/**
+ * @brief Message 98 - after response - restart the Esp32
+ */
+static void msgRestartAfter() {
 
-	switch (code) {
+	// Wait 500 ms, to give mobile app time to quit 
 
-	case 98: // Restart the Esp32
+	if (mAppConnected) {
+		delay (500); 
+	}
 
-		// Wait 500 ms, to give mobile app time to quit 
+	restartESP32();
+}
 
-		if (mAppConnected) {
-			delay (500); 
-		}
+/**
+ * @brief Message 99 - Enter in standby
+ */
+static void msgStandby(const char* message, uint16_t size, FieldsView& fields, string& response) {
 
-		restartESP32();
-		break; 
+	logI ("Entering in standby");
 
-	case 99: // Standby - enter in deep sleep
+	// End code placed in msgStandbyAfter, to send OK before 
+}
+
+/**
+ * @brief Message 99 - after response - standby - enter in deep sleep
+ */
+static void msgStandbyAfter() {
 
 #ifdef HAVE_STANDBY
 
-		// Wait 500 ms, to give mobile app time to quit 
+	// Wait 500 ms, to give mobile app time to quit 
 
-		if (mAppConnected) {
-			delay (500); 
-		}
+	if (mAppConnected) {
+		delay (500); 
+	}
 
-		// Soft Off - enter in standby by main task to not crash or hang on finalize BLE
-		// Notify main_Task to enter standby
-			
-		notifyMainTask(MAIN_TASK_ACTION_STANDBY_MSG);
+	// Soft Off - enter in standby by main task to not crash or hang on finalize BLE
+	// Notify main_Task to enter standby
+		
+	notifyMainTask(MAIN_TASK_ACTION_STANDBY_MSG);
 
 #else
 
-		// No have standby - restart
+	// No have standby - restart
 
-		restartESP32();
+	restartESP32();
 
 #endif
-
-		break; 
-
-	} 
-
-} 
+}
 
 #ifdef HAVE_BATTERY
 /**
@@ -747,7 +1032,7 @@ static void checkEnergyVoltage (bool sendingStatus) {
 	// Volts in the power supply (battery) of the ESP32 via the ADC pin 
 	// There is one resistive divider
 
-	uint16_t readVBAT = mAdcBattery; // Read in adc.cc
+	uint16_t readVBAT = adcValue(ADC_INDEX_VBAT); // Filtered in peripherals.cc (snapshot)
 
 	// Send the status to the application 
 
@@ -919,15 +1204,15 @@ void restartESP32 () {
 /**
  * @brief Process informations request
  */
-static void sendInfo(Fields& fields) {
+static void sendInfo(FieldsView& fields) {
 
 	// Note: the field 1 is a code of message
 
-	// Type 
+	// Type (view of message, no copy)
 
-	string type = fields.getString(2);
+	StrView type = fields.getString(2);
 
-	logV("type=%s", type.c_str());
+	logV("type=%.*s", type.size(), type.data());
 
 	// Note: this is a example of send large message 
 
@@ -991,16 +1276,19 @@ static void sendInfo(Fields& fields) {
 									macAddr[4], macAddr[5] \
 									); 
 
-		response.append(info);
+		// Sended now - the messages of values (below) is sended on each one, so the lines of 11:ALL
+		// keeps the order: ESP32, FMEM, VDD33, BLE, BLERX ...
+
+		bleSendData(info);
 	}
 
 	if (type == "FMEM" || type == "ALL") {
 
-		// Free memory of ESP32 
-		
-		snprintf(info, MAX_INFO, "11:FMEM:%u\n", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+		// Free memory of ESP32 (message of values - in binary mode, is not converted to text)
+
+		uint32_t values[1] = { (uint32_t) heap_caps_get_free_size(MALLOC_CAP_8BIT) };
 
-		response.append(info);
+		bleSendValues(11, "FMEM", values, 1);
 
 	}
 
@@ -1011,11 +1299,125 @@ static void sendInfo(Fields& fields) {
 		int read = rom_phy_get_vdd33();
 		logV("rom_phy_get_vdd33=%d", read);
 
-		snprintf(info, MAX_INFO, "11:VDD33:%d\n", read);
+		uint32_t values[1] = { (uint32_t) read };
+
+		bleSendValues(11, "VDD33", values, 1);
+
+	}
+
+	if (type == "BLE" || type == "ALL") {
+
+		// Statistics of sending by BLE (parts of messages)
+
+		BleSendStats_t stats = bleSendStats();
+
+		uint32_t values[] = { stats.queued, stats.sent,
+								stats.dropped, stats.failed,
+								stats.congestions, stats.congestedTime,
+								stats.coalesced, stats.coalescedDelay };
+
+		bleSendValues(11, "BLE", values, sizeof(values) / sizeof(values[0]));
+
+	}
+
+	if (type == "BLERX" || type == "ALL") {
+
+		// Statistics of receiving by BLE (lines)
+
+		const BleReceiveStats_t& stats = bleReceiveStats();
+
+		uint32_t latencyAvg = (stats.processed > 0) ? (stats.latencyTotal / stats.processed) : 0;
+
+		uint32_t values[] = { stats.received, stats.processed,
+								stats.dropped, stats.highWater,
+								latencyAvg, stats.latencyMax,
+								stats.overflows };
+
+		bleSendValues(11, "BLERX", values, sizeof(values) / sizeof(values[0]));
+
+	}
+
+	if (type == "LAT") {
+
+		// Histograms of latency of messages (micros), by code of message and stage
+		// Format: 11:LAT:code:stage:count:p50:p99:p999:max:lower=count;... (only buckets with values)
+		// Note: each code have its histograms (taken on first message of code), code 0 is the others codes
+
+		if (fields.getString(3) == "R") { // Reset
+
+			bleLatencyReset();
+
+			response.append("11:LAT:R\n");
+
+		} else {
+
+			static const char* stages[BLE_LATENCY_STAGES] = { "RECV", "QUEUE", "PROCESS", "SEND", "TOTAL" };
+
+			for (uint8_t slot = 0; slot < BLE_LATENCY_SLOTS; slot++) {
+
+				for (uint8_t stage = 0; stage < BLE_LATENCY_STAGES; stage++) {
+
+					LatencyHistogram histogram = bleLatency(slot, stage); // A copy (updated by others tasks)
+
+					if (histogram.count() == 0) {
+						continue;
+					}
+
+					snprintf(info, MAX_INFO, "11:LAT:%u:%s:%u:%u:%u:%u:%u:",
+												bleLatencyCode(slot), stages[stage],
+												histogram.count(),
+												histogram.percentile(500), histogram.percentile(990),
+												histogram.percentile(999), histogram.max());
 
-		response.append(info);
+					string line = info;
 
+					// Buckets (the line must fit in BLE_LINE_MAX_SIZE, for binary mode)
+
+					for (uint16_t i = 0; i < LATENCY_BUCKETS; i++) {
+
+						if (histogram.countOf(i) == 0) {
+							continue;
+						}
+
+						if ((line.size() + 20) >= BLE_LINE_MAX_SIZE) {
+							break;
+						}
+
+						snprintf(info, MAX_INFO, "%u=%u;", LatencyHistogram::lower(i), histogram.countOf(i));
+
+						line.append(info);
+					}
+
+					line.append(1u, '\n');
+
+					response.append(line);
+				}
+			}
+		}
+	}
+
+#ifdef ADC_CHANNELS
+
+	if (type == "ADC") {
+
+		// Filtered values of channels of ADC (snapshot)
+		// Format: 11:ADC:time:value0:value1:... (by index of channel - ADC_INDEX_*)
+
+		AdcValues_t adc;
+
+		adcValues(adc);
+
+		uint32_t values[1 + ADC_CHANNELS];
+
+		values[0] = adc.time;
+
+		for (uint8_t index = 0; index < ADC_CHANNELS; index++) {
+			values[1 + index] = adc.values[index];
+		}
+
+		bleSendValues(11, "ADC", values, (1 + ADC_CHANNELS));
 	}
+#endif
 
 #ifdef HAVE_BATTERY
 
@@ -1030,9 +1432,11 @@ static void sendInfo(Fields& fields) {
 
 //	logV("response -> %s", response.c_str());
 
-	// Send
+	// Send (the informations of ESP32 and the messages of values is already sended)
 
-	bleSendData(response);
+	if (response.size() > 0) {
+		bleSendData(response);
+	}
 
 }
 
@@ -1049,6 +1453,7 @@ static void debugInitial () {
 
 /**
  * @brief Cause an action on main_Task by task notification
+ * Note: the action is a bit in notification value, so not overwrite others actions pending
  */
 void IRAM_ATTR notifyMainTask(uint32_t action, bool fromISR) {
 
@@ -1064,15 +1469,54 @@ void IRAM_ATTR notifyMainTask(uint32_t action, bool fromISR) {
 		logD ("action=%u", action);
 	} 
 
-	// Notify the main task
+	if (action == MAIN_TASK_ACTION_NONE || action > MAIN_TASK_ACTION_MAX) {
+		return;
+	}
+
+	// Notify the main task (set the bit of action)
 
 	if (fromISR) {// From ISR
-		BaseType_t xHigherPriorityTaskWoken;
-		xTaskNotifyFromISR (xTaskMainHandler, action, eSetValueWithOverwrite, &xHigherPriorityTaskWoken);
+
+		portENTER_CRITICAL_ISR(&mActionMux);
+		mActionStats[action].notified++;
+		portEXIT_CRITICAL_ISR(&mActionMux);
+
+		BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+		xTaskNotifyFromISR (xTaskMainHandler, MAIN_TASK_ACTION_BIT(action), eSetBits, &xHigherPriorityTaskWoken);
+
+		if (xHigherPriorityTaskWoken == pdTRUE) {
+			portYIELD_FROM_ISR();
+		}
+
 	} else {
-		xTaskNotify (xTaskMainHandler, action, eSetValueWithOverwrite);
+
+		portENTER_CRITICAL(&mActionMux);
+		mActionStats[action].notified++;
+		portEXIT_CRITICAL(&mActionMux);
+
+		xTaskNotify (xTaskMainHandler, MAIN_TASK_ACTION_BIT(action), eSetBits);
 	}
 
 }
 
+/**
+ * @brief Statistics of an action of main_Task - notifications, runs and coalesced (copy)
+ */
+MainActionStats_t mainActionStats(uint32_t action) {
+
+	MainActionStats_t stats;
+
+	memset(&stats, 0, sizeof(stats));
+
+	if (action == MAIN_TASK_ACTION_NONE || action > MAIN_TASK_ACTION_MAX) {
+		return stats;
+	}
+
+	portENTER_CRITICAL(&mActionMux);
+	stats = mActionStats[action];
+	portEXIT_CRITICAL(&mActionMux);
+
+	return stats;
+}
+
 //////// End
@@ -76,6 +76,8 @@ using namespace std;
 //#define MAX_TIME_WITHOUT_FB 120 // Maximum time without receive feedback messages comment if want it disabled)
 
 // Actions of main_Task - by task notifications
+// Each action is a bit in notification value (MAIN_TASK_ACTION_BIT), so actions notified
+// at same time is not lost, all pending actions is processed on each wakeup of main_Task
 
 #define MAIN_TASK_ACTION_NONE 			0	// No action
 #define MAIN_TASK_ACTION_RESET_TIMER 	1	// To reset the seconds timer (for example, after a app connection)
@@ -88,11 +90,30 @@ using namespace std;
                                             // this notification not used more - this is done in main_Task
 #endif
 
+#define MAIN_TASK_ACTION_WAKE_JOBS 		6	// BLE connected or logging activated - start the jobs stopped while idle
+
+#define MAIN_TASK_ACTION_MAX 			6	// Maximum of actions (up to 31)
+
+#define MAIN_TASK_ACTION_BIT(action) 	(1u << (action))
+
+////// Types
+
+// Statistics of an action of main_Task (see mainActionStats)
+
+typedef struct {
+	uint32_t notified;			// Notifications (by tasks and ISRs)
+	uint32_t processed;			// Notifications processed by main_Task
+	uint32_t runs;				// Runs of action (with notifications)
+	uint32_t coalesced;			// Notifications joined in a run (notified again before main_Task process it)
+} MainActionStats_t;			// Note: processed = runs + coalesced
+
 ////// Prototypes of main
 
 extern void appInitialize(bool resetTimerSeconds);
 extern void notifyMainTask(uint32_t action, bool fromISR=false);
-extern void processBleMessage(const string& message);
+extern MainActionStats_t mainActionStats(uint32_t action);
+extern uint32_t timeSeconds();
+extern void processBleMessage(const char* message, uint16_t size);
 extern void error(const char* message, bool fatal=false);
 extern void restartESP32();
 
@@ -108,7 +129,6 @@ extern bool mAppConnected;
  
 // Times
 
-extern uint32_t mTimeSeconds;
 extern uint32_t mLastTimeFeedback;
 extern uint32_t mLastTimeReceivedData;
 
@@ -5,6 +5,13 @@
  * Versions  :
  * ------- 	-------- 	------------------------- 
  * 0.1.0 	01/08/18 	First version 
+ * 0.3.1 	17/10/26 	Sampling of ADC in background (by timer), to a ring buffer
+ * 						Channels of ADC by a table, each one with a chain of filters
+ * 						Filtered values published by a snapshot (seqlock)
+ * 						Number of GPIO of ISR by uintptr_t (no loss of precision in 64 bits - host)
+ * 						Snapshot published only after all channels have a value
+ * 0.3.2 	17/10/26 	Sampling of ADC in background is optional (off by default), by bursts of samples
+ * 						Samples of a channel read in burst - the pin of sensor powered once by burst
  */
 
 /////// Includes
@@ -15,6 +22,7 @@
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "driver/adc.h"
+#include "esp_timer.h"
 
 // From the project
 
@@ -27,8 +35,13 @@
 #include "util/log.h"
 #include "util/esp_util.h"
 
-#ifdef MEDIAN_FILTER_READINGS
-	#include "util/median_filter.h"
+#ifdef ADC_CHANNELS
+	#include "util/filter_chain.h"
+	#include "util/seqlock.h"
+#endif
+
+#ifdef ADC_SAMPLING_RATE
+	#include "util/sample_ring.h"
 #endif
 
 /////// Variables
@@ -43,10 +56,84 @@ static const char* TAG = "peripherals";
 static bool mLedStatusOn = false; 
 #endif
 
-// ADC reading average
+#ifdef ADC_CHANNELS
+
+// Chains of filters of channels (the stages is composed in compile time, no virtual calls)
+// TODO: see it! put here the chains of your channels
+
+#ifdef ADC_INDEX_VBAT
+// VBAT: median (spikes) -> decimation -> EMA (noise) -> hysteresis (to value not oscillate)
+
+typedef FilterChain <uint16_t,
+	#ifdef MEDIAN_FILTER_READINGS
+						MedianStage <uint16_t, MEDIAN_FILTER_READINGS>,
+	#endif
+						DecimateStage <uint16_t, 5>,
+						EmaStage <uint16_t, 2>,
+						HysteresisStage <uint16_t, 3> > AdcChainVbat_t;
+
+static AdcChainVbat_t mAdcChainVbat;
+#endif
+
+// Channels
+
+typedef struct {
+	adc1_channel_t channel;						// Channel of ADC1
+	adc_atten_t atten;							// Attenuation
+	uint8_t rate;								// Bursts per second (only if sampling in background)
+	int8_t pinPower;							// Pin to power (or ground) the sensor only in readings (-1 - none)
+	uint8_t levelOn;							// Level of this pin in readings
+	uint8_t levelOff;							// Level of this pin after readings
+	bool (*filter)(uint16_t in, uint16_t& out);	// Chain of filters (returns false if no output)
+} AdcChannel_t;
+
+// Table of channels - in order of indexes (ADC_INDEX_*)
+// TODO: see it! put here your channels
+
+static const AdcChannel_t mAdcChannels[ADC_CHANNELS] = {
+
+#ifdef ADC_INDEX_VBAT
+	// VBAT sensor - to identify the current battery voltage (VBAT)
+	{ ADC_SENSOR_VBAT, ADC_ATTEN_11db, 2,
+	#ifdef PIN_GROUND_VBAT
+		PIN_GROUND_VBAT, GPIO_LEVEL_READ_VBAT_ON, GPIO_LEVEL_READ_VBAT_OFF,
+	#else
+		-1, 0, 0,
+	#endif
+		filterChainProcess <AdcChainVbat_t, &mAdcChainVbat, uint16_t> },
+#endif
+};
+
+// Filtered values - changed only by adcRead and published by snapshot (to read by any task)
+
+static AdcValues_t mAdcValues;
+
+static SeqSnapshot <AdcValues_t> mAdcSnapshot;
+
+// Channels without value yet (the snapshot is published only after all have it)
+
+static bool mAdcHasValue[ADC_CHANNELS];
+static uint8_t mAdcMissing = ADC_CHANNELS;
 
-#ifdef MEDIAN_FILTER_READINGS
-static MedianFilter <uint16_t, MEDIAN_FILTER_READINGS> Filter;
+#endif
+
+#ifdef ADC_SAMPLING_RATE
+// Sampling in background - the timer puts the samples in ring, adcRead gets it
+
+typedef struct {
+	uint8_t index;		// Index of channel
+	uint16_t value;		// Value readed
+} AdcSample_t;
+
+static SampleRing <AdcSample_t, ADC_SAMPLING_RING> mAdcRing;
+
+static uint8_t mAdcTicks[ADC_CHANNELS];	// Ticks of timer by channel (to rate of each one)
+
+static esp_timer_handle_t mAdcTimer = NULL;
+#endif
+
+#ifdef ADC_CHANNELS
+static AdcSource_t mAdcSource = NULL;	// Source of samples (NULL - ADC)
 #endif
 
 /// Sensors
@@ -54,7 +141,6 @@ static MedianFilter <uint16_t, MEDIAN_FILTER_READINGS> Filter;
 #ifdef HAVE_BATTERY
 bool mGpioVEXT = false;			// Powered by external voltage (USB or power supply)
 bool mGpioChgBattery = false;	// Charging battery ?
-int16_t mAdcBattery = 0;		// voltage of battery readed by ADC
 #endif
 
 /////// Prototype - Private
@@ -67,7 +153,16 @@ static void IRAM_ATTR gpio_isr_handler (void * arg);
 #endif
 
 static void adcInitialize();
-static uint16_t adcReadMedian (adc1_channel_t channelADC1);
+
+#ifdef ADC_CHANNELS
+static void adcSamples(const AdcChannel_t& channel, uint16_t* values, uint8_t count);
+static bool adcProcess(uint8_t index, uint16_t value);
+#endif
+
+#ifdef ADC_SAMPLING_RATE
+static void adcFinalize();
+static void adcSampleTimer(void* arg);
+#endif
 
 ////// Methods
 
@@ -107,7 +202,9 @@ void peripheralsFinalize() {
 
 	// ADC
 
-	//adcFinalize(); // ADC not needs finalize
+#ifdef ADC_SAMPLING_RATE
+	adcFinalize(); // Stop the sampling
+#endif
 
 	// Debug
 	
@@ -304,7 +401,7 @@ void gpioBlinkLedStatus() {
  */
 static void IRAM_ATTR gpio_isr_handler (void * arg) {
 
-	uint32_t gpioNum = (uint32_t) arg;
+	uint32_t gpioNum = (uint32_t) (uintptr_t) arg;
 
 	// Debounce events 
 
@@ -406,13 +503,35 @@ static void adcInitialize() {
 
 	// ADC input pins (sensors)
 
-#ifdef ADC_SENSOR_VBAT
-	
-	// Sensor VBAT 
-	
+#ifdef ADC_CHANNELS
+
 	adc1_config_width(ADC_WIDTH_12Bit);
 
-	adc1_config_channel_atten (ADC_SENSOR_VBAT, ADC_ATTEN_11db); // VBAT sensor - to identify the current battery voltage (VBAT)
+	// Attenuation of each channel
+
+	for (uint8_t index = 0; index < ADC_CHANNELS; index++) {
+
+		adc1_config_channel_atten (mAdcChannels[index].channel, mAdcChannels[index].atten);
+	}
+#endif
+
+#ifdef ADC_SAMPLING_RATE
+
+	// Sampling in background, by a periodic timer
+
+	esp_timer_create_args_t timerArgs;
+
+	timerArgs.callback = adcSampleTimer;
+	timerArgs.arg = NULL;
+	timerArgs.dispatch_method = ESP_TIMER_TASK;
+	timerArgs.name = "adcSample";
+
+	if (esp_timer_create(&timerArgs, &mAdcTimer) != ESP_OK ||
+		esp_timer_start_periodic(mAdcTimer, (1000000u / ADC_SAMPLING_RATE)) != ESP_OK) {
+
+		logE("error on start the timer of sampling");
+	}
+
 #endif
 
 	// Debug
@@ -421,54 +540,196 @@ static void adcInitialize() {
 
 }
 
+#ifdef ADC_SAMPLING_RATE
+
+/**
+ * @brief Finalizes ADC - stop the sampling
+ */
+static void adcFinalize() {
+
+	if (mAdcTimer != NULL) {
+
+		esp_timer_stop(mAdcTimer);
+		esp_timer_delete(mAdcTimer);
+		mAdcTimer = NULL;
+	}
+}
+
+/**
+ * @brief Timer of sampling - read the channels (bursts) and put the samples in ring (runs in esp_timer task)
+ */
+static void adcSampleTimer(void* arg) {
+
+	for (uint8_t index = 0; index < ADC_CHANNELS; index++) {
+
+		const AdcChannel_t& channel = mAdcChannels[index];
+
+		// Rate of this channel (each n ticks of timer)
+
+		uint8_t ticks = (channel.rate > 0 && channel.rate < ADC_SAMPLING_RATE) ? (ADC_SAMPLING_RATE / channel.rate) : 1;
+
+		if (++mAdcTicks[index] < ticks) {
+			continue;
+		}
+
+		mAdcTicks[index] = 0;
+
+		// Read a burst
+
+		uint16_t values[ADC_SAMPLING_BURST];
+
+		adcSamples(channel, values, ADC_SAMPLING_BURST);
+
+		for (uint8_t i = 0; i < ADC_SAMPLING_BURST; i++) {
+
+			AdcSample_t sample;
+
+			sample.index = index;
+			sample.value = values[i];
+
+			mAdcRing.push(sample); // If full, it is dropped (the consumer is late)
+		}
+	}
+}
+
+#endif
+
 /**
  * @brief Reading the sensors by ADC
  */
 void adcRead() {
 
-	// Read sensors
+#ifdef ADC_CHANNELS
 
-#if defined HAVE_BATTERY && defined ADC_SENSOR_VBAT 
+	bool changed = false;
 
-	// VBAT voltage
-		
-	#ifdef PIN_GROUND_VBAT
+	#ifdef ADC_SAMPLING_RATE
 
-		// Pin to ground resistor divider to measure voltage of battery
-		// To turn ground only when reading ADC 
+	// Samples of the sampling in background (ring) to chains of filters
 
-		gpioSetLevel (PIN_GROUND_VBAT, GPIO_LEVEL_READ_VBAT_ON); // Ground this 
+	AdcSample_t sample;
 
-	#endif
+	while (mAdcRing.pop(sample)) {
+		changed |= adcProcess(sample.index, sample.value);
+	}
 
-	// Read ADC
+	#else
 
-	mAdcBattery = adcReadMedian (ADC_SENSOR_VBAT);
+	// Read the channels (blocking) - a burst of each one
+
+	for (uint8_t index = 0; index < ADC_CHANNELS; index++) {
+
+		uint16_t values[ADC_READINGS];
+
+		adcSamples(mAdcChannels[index], values, ADC_READINGS);
+
+		for (uint8_t i = 0; i < ADC_READINGS; i++) {
+			changed |= adcProcess(index, values[i]);
+		}
+	}
 
-	#ifdef PIN_GROUND_VBAT
-		gpioSetLevel (PIN_GROUND_VBAT, GPIO_LEVEL_READ_VBAT_OFF); // Not ground this - no consupmition of battery 
 	#endif
-	
+
+	// Publish the values (the readers not wait for this)
+	// Only after all channels have a value (no zeros of channels not filtered yet)
+
+	if (changed && mAdcMissing == 0) {
+
+		mAdcValues.time = millis();
+
+		mAdcSnapshot.write(mAdcValues);
+	}
+
 #endif
 
 }
 
+#ifdef ADC_CHANNELS
+
+/**
+ * @brief Set the source of samples - to inject synthetic samples (tests), NULL is the ADC
+ */
+void adcSetSource(AdcSource_t source) {
+
+	mAdcSource = source;
+}
+
+/**
+ * @brief Filtered values of all channels (snapshot, can be called by any task)
+ */
+void adcValues(AdcValues_t& values) {
+
+	mAdcSnapshot.read(values);
+}
+
+/**
+ * @brief Filtered value of a channel (by index - ADC_INDEX_*)
+ */
+uint16_t adcValue(uint8_t index) {
+
+	if (index >= ADC_CHANNELS) {
+		return 0;
+	}
+
+	AdcValues_t values;
+
+	mAdcSnapshot.read(values);
+
+	return values.values[index];
+}
+
+#endif
+
 ////// Private
 
+#ifdef ADC_CHANNELS
+
 /**
- * @brief Average reading - ADC
+ * @brief Read a burst of samples of channel
  */
- 
-static uint16_t adcReadMedian (adc1_channel_t channelADC1) {
+static void adcSamples(const AdcChannel_t& channel, uint16_t* values, uint8_t count) {
 
-	for (uint8_t i = 0; i <MEDIAN_FILTER_READINGS; i ++) {
+	// Pin to power (or ground) the sensor only when reading, to reduce consupmition
+	// Once for all samples of burst
+
+	if (channel.pinPower >= 0) {
+		gpioSetLevel ((gpio_num_t) channel.pinPower, channel.levelOn);
+	}
 
-		Filter.set(i, ::adc1_get_raw(channelADC1));
+	for (uint8_t i = 0; i < count; i++) {
+		values[i] = (mAdcSource != NULL) ? mAdcSource(channel.channel) : ::adc1_get_raw(channel.channel);
 	}
 
-	uint16_t median;
-	Filter.getMedian(median);
-	return median;
+	if (channel.pinPower >= 0) {
+		gpioSetLevel ((gpio_num_t) channel.pinPower, channel.levelOff);
+	}
+}
+
+/**
+ * @brief Process a sample by chain of filters of channel - returns true if the value is changed
+ */
+static bool adcProcess(uint8_t index, uint16_t value) {
+
+	if (index >= ADC_CHANNELS) {
+		return false;
+	}
+
+	uint16_t filtered;
+
+	if (!mAdcChannels[index].filter(value, filtered)) {
+		return false; // No output for this sample (ex: decimation)
+	}
+
+	mAdcValues.values[index] = filtered;
+
+	if (!mAdcHasValue[index]) {
+		mAdcHasValue[index] = true;
+		mAdcMissing--;
+	}
+
+	return true;
 }
 
+#endif
+
 ////////// End
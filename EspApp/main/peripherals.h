@@ -27,12 +27,44 @@
 
 #define MEDIAN_FILTER_READINGS 7
 
+// Sampling of ADC in background (by a periodic timer - esp_timer), to a ring buffer (util/sample_ring.h)
+// adcRead only moves the samples of ring to the chains of filters of channels, no more blocking readings
+// It is optional (off by default): the timer wakes up the CPU and powers the sensors even while the values
+// is not used (main_Task calls adcRead only while not idle), so it is only to sensors that needs a rate
+// Uncomment it (or define it in compiler, as the host build) to sampling in background
+// Each tick of timer reads a burst of samples of each channel (the pin of sensor powered once by burst)
+// TODO: see it!
+
+//#define ADC_SAMPLING_RATE 	2		// Rate of timer (ticks per second) - the maximum of rates of channels
+#define ADC_SAMPLING_BURST 		4		// Samples of each channel by tick
+#define ADC_SAMPLING_RING 		64		// Size of ring (power of 2) - must have the samples (of all channels) between 2 adcRead
+
+// Readings of each channel in adcRead (only if not sampling in background) - a burst (pin powered once)
+
+#define ADC_READINGS 			7
+
 // Sensor voltage Bettery - comment if your project not use it
 
 #ifdef HAVE_BATTERY 
 	#define ADC_SENSOR_VBAT ADC1_CHANNEL_7
 #endif
 
+// Channels of ADC (ADC1) - each one have attenuation, sample rate and a chain of filters
+// (see table mAdcChannels in peripherals.cc), the filtered values is in a snapshot (adcValues)
+// To add a channel: a index here, a chain and a line in table of peripherals.cc
+// TODO: see it!
+
+#ifdef ADC_SENSOR_VBAT
+	#define ADC_INDEX_VBAT 		0		// Index of VBAT in table
+	#define ADC_CHANNELS 		1		// Number of channels
+#endif
+
+// Without channels, no sampling
+
+#if !defined ADC_CHANNELS && defined ADC_SAMPLING_RATE
+	#undef ADC_SAMPLING_RATE
+#endif
+
 ///// Digital
 
 #ifdef HAVE_STANDBY
@@ -109,12 +141,31 @@ void gpioBlinkLedStatus();
 
 void adcRead();
 
+#ifdef ADC_CHANNELS
+// Filtered values of channels (snapshot - can be read by any task)
+
+typedef struct {
+	uint16_t values[ADC_CHANNELS];	// Value by index of channel (ADC_INDEX_*)
+	uint32_t time;					// Time of last update (millis) - 0 if no values yet
+} AdcValues_t;
+
+void adcValues(AdcValues_t& values);
+uint16_t adcValue(uint8_t index);
+#endif
+
+#ifdef ADC_CHANNELS
+// Source of samples - to inject synthetic samples (tests), NULL is the ADC
+
+typedef uint16_t (*AdcSource_t)(adc1_channel_t channel);
+
+void adcSetSource(AdcSource_t source);
+#endif
+
 //////// External variables
 
 #ifdef HAVE_BATTERY
 extern bool mGpioVEXT ;			// Powered by external voltage (USB or power supply) ?
 extern bool mGpioChgBattery ;	// Charging battery ?
-extern int16_t mAdcBattery;		// Voltage of battery by ADC
 #endif
 
 //////// Macros
@@ -0,0 +1,246 @@
+/* ***********
+ * Project   : Esp-Idf-App-Mobile - Esp-Idf - Firmware on the Esp32 board - Ble
+ * Programmer: Joao Lopes
+ * Module    : throughput - test of throughput of BLE (stream of data to mobile app)
+ * Comments  : Sends a stream of lines of one notification each one (MTU), with sequence numbers,
+ *             by a task (the BLE queue to send gives the back pressure), and reports the statistics
+ *             To tune MTU, connection interval and TX power (see throughput.h)
+ * Versions  :
+ * ------- 	-------- 	-------------------------
+ * 0.3.1 	17/10/26 	First version
+ * 0.3.2 	17/10/26 	Bytes and rate of the bytes sended (statistics of sending), seconds limited to THROUGHPUT_TIME_MAX
+ * 						Off by default (THROUGHPUT_TEST)
+ * 						Size of lines by bleLineMax - in binary mode, the frame of each line is one notification
+ */
+
+///// Includes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+
+// Util
+
+#include "util/log.h"
+#include "util/esp_util.h"
+#include "util/fields.h"
+#include "util/msg_table.h"
+
+// Maximum size of BLE messages (GATTS_CHAR_VAL_LEN_MAX)
+
+extern "C" {
+#include "util/ble_uart_server.h"
+}
+
+// From project
+
+#include "main.h"
+#include "ble.h"
+#include "throughput.h"
+
+#ifdef THROUGHPUT_TEST
+
+///// Variables
+
+// Log
+
+static const char* TAG = "throughput";
+
+// Stream requested
+
+static uint32_t mBytes = 0;				// Bytes to send
+static uint32_t mSeconds = 0;			// Maximum time (seconds)
+
+static volatile bool mStop = false;		// Stop requested ?
+
+// Task
+
+static TaskHandle_t xTaskThroughputHandle = NULL;
+
+////// Prototypes
+
+static void throughput_Task(void *pvParameters);
+static void msgThroughput(const char* message, uint16_t size, FieldsView& fields, string& response);
+
+////// Message (registered here, no need to edit main.cc)
+
+static MsgRegister mMsgThroughput (THROUGHPUT_CODE, msgThroughput, NULL, MSG_FLAG_FEEDBACK | MSG_FLAG_NEED_APP);
+
+////// Routines
+
+/**
+ * @brief Is the stream running ?
+ */
+bool throughputRunning() {
+
+	return (xTaskThroughputHandle != NULL);
+}
+
+/**
+ * @brief Stop the stream (the statistics is sended after)
+ */
+void throughputStop() {
+
+	mStop = true;
+}
+
+////// Privates
+
+/**
+ * @brief Message 72 - Start (72:bytes[:seconds]) or stop (72:STOP) the stream
+ */
+static void msgThroughput(const char* message, uint16_t size, FieldsView& fields, string& response) {
+
+	// Stop ?
+
+	if (fields.getString(2) == "STOP") {
+
+		throughputStop();
+		return;
+	}
+
+	// Parameters
+
+	if (!fields.isNum(2) || fields.getInt(2) <= 0) {
+		error("Invalid number of bytes");
+		return;
+	}
+
+	if (throughputRunning()) {
+		error("Stream is running");
+		return;
+	}
+
+	mBytes = fields.getInt(2);
+	mSeconds = (fields.isNum(3) && fields.getInt(3) > 0) ? fields.getInt(3) : THROUGHPUT_TIME_MAX;
+
+	if (mSeconds > THROUGHPUT_TIME_MAX) {
+		mSeconds = THROUGHPUT_TIME_MAX;
+	}
+
+	mStop = false;
+
+	// Task to send it (this handler runs in task of BLE events)
+
+	xTaskCreatePinnedToCore (&throughput_Task,
+				"throughput_Task", TASK_STACK_MEDIUM, NULL, TASK_PRIOR_MEDIUM, &xTaskThroughputHandle, TASK_CPU);
+
+	// Response - started (message of values)
+
+	uint32_t values[] = { mBytes, bleMTU(), bleLineMax() };
+
+	bleSendValues(THROUGHPUT_CODE, "S", values, 3);
+}
+
+/**
+ * @brief Task of stream
+ */
+static void throughput_Task(void *pvParameters) {
+
+	// Size of lines - each line is one notification (in binary mode, the frame of line)
+
+	uint16_t lineMax = bleLineMax();
+
+	logI("Starting stream - bytes=%u seconds=%u line=%u", mBytes, mSeconds, lineMax);
+
+	delay(10); // Let the response of message be sended before
+
+	// Statistics of sending (to get the values of this stream)
+
+	BleSendStats_t start = bleSendStats();
+
+	// Stream
+
+	char line[BLE_LINE_MAX_SIZE + 1];
+
+	if (lineMax > BLE_LINE_MAX_SIZE) {
+		lineMax = BLE_LINE_MAX_SIZE;
+	}
+
+	uint32_t seq = 0;
+	uint32_t generated = 0;
+
+	uint32_t timeStart = millis();
+	uint32_t timeMax = (mSeconds * 1000u);
+
+	while (generated < mBytes && !mStop && bleConnected() && (millis() - timeStart) < timeMax) {
+
+		// Size of this line (the last can be smaller, but with header)
+
+		uint16_t size = ((mBytes - generated) < lineMax) ? (mBytes - generated) : lineMax;
+
+		if (size <= THROUGHPUT_HEADER_SIZE) {
+			size = THROUGHPUT_HEADER_SIZE + 1;
+		}
+
+		// Line (data is a char by sequence, to validate it too)
+
+		snprintf(line, sizeof(line), "72:D:%08u:", seq);
+
+		memset(line + THROUGHPUT_HEADER_SIZE, ('a' + (seq % 26)), (size - THROUGHPUT_HEADER_SIZE - 1));
+
+		line[size - 1] = '\n';
+
+		// Send it (waits if the queue to send is full - see BLE_SEND_POLICY_BLOCK)
+
+		bleSendData(line, size);
+
+		seq++;
+		generated += size;
+	}
+
+	// Wait for the queue to send is empty (the parts are sended, failed or dropped)
+
+	uint32_t timeDrain = millis();
+
+	for (;;) {
+
+		BleSendStats_t stats = bleSendStats();
+
+		uint32_t queued = (stats.queued - start.queued);
+		uint32_t done = (stats.sent - start.sent) + (stats.failed - start.failed) +
+						(stats.dropped - start.dropped) + (stats.coalesced - start.coalesced);
+
+		if (done >= queued || (millis() - timeDrain) >= THROUGHPUT_TIME_DRAIN) {
+			break;
+		}
+
+		delay(10);
+	}
+
+	uint32_t elapsed = (millis() - timeStart);
+
+	// Statistics - the bytes really sended (not the generated, that can be dropped or failed)
+
+	BleSendStats_t stats = bleSendStats();
+
+	uint32_t bytes = (stats.bytes - start.bytes);
+	uint32_t perSecond = (elapsed > 0) ? (uint32_t)(((uint64_t) bytes * 1000u) / elapsed) : 0;
+
+	uint32_t values[] = { seq, bytes, elapsed, perSecond,
+							(stats.congestions - start.congestions),
+							(stats.congestedTime - start.congestedTime),
+							(stats.failed - start.failed),
+							(stats.dropped - start.dropped) };
+
+	logI("End of stream -> lines=%u bytes=%u elapsed=%u bytesPerSec=%u", seq, bytes, elapsed, perSecond);
+
+	if (bleConnected()) {
+		bleSendValues(THROUGHPUT_CODE, "E", values, sizeof(values) / sizeof(values[0]));
+	}
+
+	// Delete this task
+
+	xTaskThroughputHandle = NULL;
+	vTaskDelete(NULL);
+}
+
+#endif // THROUGHPUT_TEST
+
+//////// End
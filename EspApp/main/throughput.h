@@ -0,0 +1,48 @@
+/*
+ * throughput.h - test of throughput of BLE (stream of data to mobile app)
+ */
+
+#ifndef MAIN_THROUGHPUT_H_
+#define MAIN_THROUGHPUT_H_
+
+///// Includes
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/////// Definitions
+
+// Test of throughput - message 72 (registered in throughput.cc)
+// 72:bytes[:seconds] -> starts a stream of bytes, in lines of one notification each one (see bleLineMax)
+// 72:STOP 			  -> stops the stream
+// Lines sended:
+// 72:S:bytes:mtu:line -> started (response), line is the size of lines (the MTU, or in binary mode,
+//                        the MTU less the overhead of frame - so the frame of each line is one notification)
+// 72:D:seq:data 	  -> data, seq is the sequence number (8 digits), data is the char 'a' + (seq % 26) repeated
+// 72:E:lines:bytes:elapsed:bytesPerSec:congestions:congestedTime:failed:dropped -> end, with statistics
+// Note: the times is in millis, the statistics of sending is of this stream (see 11:BLE)
+// Note: bytes and bytesPerSec are of bytes sended (after BLE stack accept it), not of bytes generated
+// Note: 72:S and 72:E are messages of values (in binary mode, frames of values - see ble_frame.h)
+// Note: it is off by default (the message 72 is only to tune the BLE) - uncomment it (or define it in compiler,
+//       as the host build) to have this test // TODO: see it!
+
+//#define THROUGHPUT_TEST true
+
+#ifdef THROUGHPUT_TEST
+
+#define THROUGHPUT_CODE 		72			// Code of message
+#define THROUGHPUT_TIME_MAX 	60			// Maximum time of stream (seconds), if not informed (and the limit)
+#define THROUGHPUT_TIME_DRAIN 	5000		// Maximum time to wait the queue to send (millis), at end
+
+#define THROUGHPUT_HEADER_SIZE 	14			// Size of header of data lines (72:D:nnnnnnnn:)
+
+////// Prototypes
+
+extern bool throughputRunning();
+extern void throughputStop();
+
+#endif // THROUGHPUT_TEST
+
+#endif /* MAIN_THROUGHPUT_H_ */
+
+//////// End
@@ -0,0 +1,402 @@
+/*****************************************
+ * Project   : util - Utilities to esp-idf
+ * Programmer: Joao Lopes
+ * Module    : ble_frame - binary frames (length prefixed) to BLE messages
+ * Comments  : Optional mode, negotiated in message 01, text mode (lines) is the default
+ * Versions  :
+ * ------- 	-------- 	-------------------------
+ * 0.3.1 	17/10/26 	First version
+ * 0.3.2 	17/10/26 	Frames of values (numbers as varints), frame larger than buffer is rejected in length
+ * 						Frame rejected in length has the payload and CRC discarded (not decoded as frames)
+ */
+
+///// Includes
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// This
+
+#include "ble_frame.h"
+
+////// Variables
+
+// CRC-16/CCITT-FALSE table by nibble (small, to save flash)
+
+static const uint16_t mCrcTable[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+////// Prototypes
+
+static uint8_t varintPut(uint8_t* out, uint32_t value);
+static uint8_t varintSize(uint32_t value);
+
+////// Routines
+
+/**
+* @brief CRC-16/CCITT-FALSE (initial value is 0xFFFF)
+*/
+uint16_t bleFrameCrc16(uint16_t crc, const uint8_t* data, uint16_t size) {
+
+	for (uint16_t i = 0; i < size; i++) {
+		crc = (crc << 4) ^ mCrcTable[((crc >> 12) ^ (data[i] >> 4)) & 0x0F];
+		crc = (crc << 4) ^ mCrcTable[((crc >> 12) ^ (data[i] & 0x0F)) & 0x0F];
+	}
+
+	return crc;
+}
+
+/**
+* @brief Encode a frame - returns the size of frame (0 if no space in out)
+*/
+uint16_t bleFrameEncode(uint8_t code, const char* payload, uint16_t size,
+							bool crc, uint8_t* out, uint16_t outMax) {
+
+	if ((uint32_t) size + BLE_FRAME_OVERHEAD_MAX > outMax) {
+		return 0;
+	}
+
+	uint16_t pos = 0;
+
+	// Code
+
+	out[pos++] = code;
+
+	// Length (varint)
+
+	pos += varintPut(out + pos, size);
+
+	// Payload
+
+	memcpy(out + pos, payload, size);
+	pos += size;
+
+	// CRC
+
+	if (crc) {
+		uint16_t value = bleFrameCrc16(0xFFFF, out, pos);
+		out[pos++] = (value >> 8);
+		out[pos++] = (value & 0xFF);
+	}
+
+	return pos;
+}
+
+/**
+* @brief Encode a text line (nn:payload) in a frame - returns the size of frame (0 if invalid)
+*/
+uint16_t bleFrameEncodeLine(const char* line, uint16_t size,
+								bool crc, uint8_t* out, uint16_t outMax) {
+
+	// Code of message (until the first ':')
+
+	const char* end = (const char*) memchr(line, ':', size);
+
+	if (end == NULL || end == line) {
+		return 0;
+	}
+
+	uint16_t sizeCode = (end - line);
+	uint8_t code = 0;
+
+	if (sizeCode == 2 && line[0] == '-' && line[1] == '1') { // Error
+
+		code = BLE_FRAME_CODE_ERROR;
+
+	} else {
+
+		uint16_t value = 0;
+
+		for (uint16_t i = 0; i < sizeCode; i++) {
+			if (line[i] < '0' || line[i] > '9') {
+				return 0;
+			}
+			value = (value * 10) + (line[i] - '0');
+		}
+
+		if (value == 0 || value > 99) {
+			return 0;
+		}
+
+		code = value;
+	}
+
+	// Payload is after the ':'
+
+	sizeCode++;
+
+	return bleFrameEncode(code, line + sizeCode, size - sizeCode, crc, out, outMax);
+}
+
+/**
+* @brief Encode a frame of values (numbers as varints, no conversion to text)
+* The prefix is the text before the values (ex: "BLE" of 11:BLE:...), can be empty
+* Returns the size of frame (0 if no space in out)
+*/
+uint16_t bleFrameEncodeValues(uint8_t code, const char* prefix,
+									const uint32_t* values, uint8_t count,
+									bool crc, uint8_t* out, uint16_t outMax) {
+
+	uint8_t sizePrefix = (prefix != NULL) ? strlen(prefix) : 0;
+
+	// Size of payload
+
+	uint32_t size = 1 + sizePrefix;
+
+	for (uint8_t i = 0; i < count; i++) {
+		size += varintSize(values[i]);
+	}
+
+	if (code == 0 || code > 99 || size + BLE_FRAME_OVERHEAD_MAX > outMax) {
+		return 0;
+	}
+
+	uint16_t pos = 0;
+
+	// Code and length
+
+	out[pos++] = (code | BLE_FRAME_VALUES);
+
+	pos += varintPut(out + pos, size);
+
+	// Prefix
+
+	out[pos++] = sizePrefix;
+
+	memcpy(out + pos, prefix, sizePrefix);
+	pos += sizePrefix;
+
+	// Values
+
+	for (uint8_t i = 0; i < count; i++) {
+		pos += varintPut(out + pos, values[i]);
+	}
+
+	// CRC
+
+	if (crc) {
+		uint16_t value = bleFrameCrc16(0xFFFF, out, pos);
+		out[pos++] = (value >> 8);
+		out[pos++] = (value & 0xFF);
+	}
+
+	return pos;
+}
+
+////// Private
+
+/**
+* @brief Put a varint (7 bits per byte, LSB first) - returns the size
+*/
+static uint8_t varintPut(uint8_t* out, uint32_t value) {
+
+	uint8_t pos = 0;
+
+	do {
+		uint8_t byte = (value & 0x7F);
+		value >>= 7;
+		if (value > 0) {
+			byte |= 0x80;
+		}
+		out[pos++] = byte;
+	} while (value > 0);
+
+	return pos;
+}
+
+/**
+* @brief Size of a varint
+*/
+static uint8_t varintSize(uint32_t value) {
+
+	uint8_t size = 1;
+
+	while (value >= 0x80) {
+		value >>= 7;
+		size++;
+	}
+
+	return size;
+}
+
+////// Class BleFrameDecoder
+
+/**
+* @brief Reset the decoder (to wait a new frame)
+*/
+void BleFrameDecoder::reset() {
+
+	mState = STATE_CODE;
+	mMessageSize = 0;
+	mDiscard = 0;
+}
+
+/**
+* @brief Feed the decoder with received data
+* Returns the bytes processed, if one frame is complete, returns and set complete,
+* the message decoded is valid until the next feed
+*/
+uint16_t BleFrameDecoder::feed(const uint8_t* data, uint16_t size, bool& complete) {
+
+	complete = false;
+
+	uint16_t pos = 0;
+
+	while (pos < size && !complete) {
+
+		switch (mState) {
+
+			case STATE_CODE: // Code of message
+				{
+					mCode = data[pos++];
+
+					if (mCode == BLE_FRAME_CODE_ERROR) {
+
+						memcpy(mMessage, "-1:", 3);
+
+					} else if (mCode > 0 && mCode <= 99) {
+
+						mMessage[0] = '0' + (mCode / 10);
+						mMessage[1] = '0' + (mCode % 10);
+						mMessage[2] = ':';
+
+					} else { // Invalid - ignore it
+
+						mErrors++;
+						break;
+					}
+
+					mMessageSize = 3;
+					mLength = 0;
+					mLengthShift = 0;
+					mReceived = 0;
+					mCrcBytes = 0;
+					mCrcRecv = 0;
+					mCrcCalc = bleFrameCrc16(0xFFFF, &mCode, 1);
+
+					mState = STATE_LENGTH;
+				}
+				break;
+
+			case STATE_LENGTH: // Length - varint
+				{
+					uint8_t byte = data[pos++];
+
+					mCrcCalc = bleFrameCrc16(mCrcCalc, &byte, 1);
+
+					if (mLengthShift < 32) {
+						mLength |= ((uint32_t)(byte & 0x7F) << mLengthShift);
+					}
+					mLengthShift += 7;
+
+					if (byte & 0x80) { // More bytes
+
+						if (mLengthShift >= 7 * BLE_FRAME_VARINT_MAX) { // Not a length - nothing to discard
+							mErrors++;
+							reset();
+						}
+						break;
+					}
+
+					if (mLengthShift > 7 * (BLE_FRAME_HEADER_MAX - 1) ||		// Varint too long
+						(mMessageSize + mLength) > BLE_FRAME_MSG_MAX_SIZE) {	// Not fit in buffer
+
+						// Invalid - discard the payload and CRC (not decode it as frames)
+
+						mErrors++;
+						mMessageSize = 0;
+						mDiscard = mLength + ((mCrc) ? BLE_FRAME_CRC_SIZE : 0);
+						mState = (mDiscard > 0) ? STATE_DISCARD : STATE_CODE;
+						break;
+					}
+
+					if (mLength > 0) {
+						mState = STATE_PAYLOAD;
+					} else if (mCrc) {
+						mState = STATE_CRC;
+					} else {
+						complete = true;
+					}
+				}
+				break;
+
+			case STATE_PAYLOAD: // Payload - copy the maximum possible
+				{
+					uint16_t count = (size - pos);
+
+					if (count > (mLength - mReceived)) {
+						count = (mLength - mReceived);
+					}
+
+					if (mCrc) {
+						mCrcCalc = bleFrameCrc16(mCrcCalc, data + pos, count);
+					}
+
+					memcpy(mMessage + mMessageSize, data + pos, count);
+					mMessageSize += count;
+
+					mReceived += count;
+					pos += count;
+
+					if (mReceived == mLength) {
+						if (mCrc) {
+							mState = STATE_CRC;
+						} else {
+							complete = true;
+						}
+					}
+				}
+				break;
+
+			case STATE_CRC: // CRC (MSB first)
+				{
+					mCrcRecv = (mCrcRecv << 8) | data[pos++];
+					mCrcBytes++;
+
+					if (mCrcBytes == BLE_FRAME_CRC_SIZE) {
+
+						if (mCrcRecv == mCrcCalc) {
+							complete = true;
+						} else { // Invalid
+							mErrors++;
+							reset();
+						}
+					}
+				}
+				break;
+
+			case STATE_DISCARD: // Payload and CRC of frame rejected
+				{
+					uint16_t count = (size - pos);
+
+					if (count > mDiscard) {
+						count = mDiscard;
+					}
+
+					pos += count;
+					mDiscard -= count;
+
+					if (mDiscard == 0) {
+						reset();
+					}
+				}
+				break;
+		}
+	}
+
+	// Frame complete ?
+
+	if (complete) {
+
+		mState = STATE_CODE;
+
+		mMessage[mMessageSize] = '\0';
+	}
+
+	return pos;
+}
+
+//////// End
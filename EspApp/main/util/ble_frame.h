@@ -0,0 +1,104 @@
+/*
+ * ble_frame.h
+ */
+
+#ifndef UTIL_BLE_FRAME_H_
+#define UTIL_BLE_FRAME_H_
+
+///// Includes
+
+#include <stdint.h>
+#include <stdbool.h>
+
+////// Definitions
+
+// Binary frame format (optional, negotiated in message 01)
+// -----------------------------
+// [code: 1 byte][length: varint (7 bits per byte, LSB first)][payload: length bytes][crc16: 2 bytes, optional]
+// - code: code of message (1-99, or 0xFF for -1 - error)
+// - payload: content after "nn:" of text message
+// - crc16: CRC-16/CCITT-FALSE of code, length and payload (MSB first) - only if negotiated
+// Frame of values (only sended by device, numbers without conversion to text):
+// - code: code of message with the bit 0x80 (BLE_FRAME_VALUES)
+// - payload: [size of prefix: 1 byte][prefix: text, ex: "BLE"][values: varints, until the end of payload]
+// -----------------------------
+
+#define BLE_FRAME_CODE_ERROR 0xFF	// Code -1 (error messages)
+#define BLE_FRAME_VALUES 0x80		// Bit in code for frame of values
+
+// Maximum of header (code + varint of 3 bytes) and crc
+
+#define BLE_FRAME_HEADER_MAX 4
+#define BLE_FRAME_VARINT_MAX 5		// Maximum of bytes of varint (32 bits) - longer is not a length (no resync)
+#define BLE_FRAME_CRC_SIZE 2
+#define BLE_FRAME_OVERHEAD_MAX (BLE_FRAME_HEADER_MAX + BLE_FRAME_CRC_SIZE)
+
+// Maximum size of decoded message - nn:payload - (as line of text mode)
+
+#ifndef BLE_FRAME_MSG_MAX_SIZE
+#define BLE_FRAME_MSG_MAX_SIZE 350
+#endif
+
+////// Classes
+
+// Decoder of frames (stream, frames can be splitted in any parts)
+// The decoded frame is put in text format "nn:payload", to process as a text line
+// Note: the frames of values are only sended by device (received ones are invalid)
+// Note: a frame rejected by length (larger than buffer or varint too long) has the payload and CRC
+//       discarded, so its payload is never decoded as frames
+
+class BleFrameDecoder
+{
+	public:
+
+		BleFrameDecoder() { reset(); mCrc = false; mErrors = 0; }
+
+		void reset();
+		void setCrc(bool crc) { mCrc = crc; reset(); }
+		bool pending() const { return (mState != STATE_CODE); }
+
+		uint16_t feed(const uint8_t* data, uint16_t size, bool& complete);
+
+		const char* message() const { return mMessage; }
+		uint16_t messageSize() const { return mMessageSize; }
+		uint32_t errors() const { return mErrors; }
+
+	private:
+
+		enum {
+			STATE_CODE,
+			STATE_LENGTH,
+			STATE_PAYLOAD,
+			STATE_CRC,
+			STATE_DISCARD
+		} mState;
+
+		bool mCrc;					// With CRC ?
+		uint8_t mCode;				// Code of frame
+		uint32_t mLength;			// Length of payload
+		uint8_t mLengthShift;		// Shift of varint
+		uint32_t mReceived;			// Payload received
+		uint16_t mCrcCalc;			// CRC calculated
+		uint16_t mCrcRecv;			// CRC received
+		uint8_t mCrcBytes;			// Bytes of CRC received
+		uint32_t mDiscard;			// Bytes to discard (payload and CRC of frame rejected)
+		uint32_t mErrors;			// Errors (CRC, overflow, invalid code)
+
+		char mMessage[BLE_FRAME_MSG_MAX_SIZE + 1];	// Message decoded (nn:payload)
+		uint16_t mMessageSize;
+};
+
+////// Prototypes
+
+extern uint16_t bleFrameCrc16(uint16_t crc, const uint8_t* data, uint16_t size);
+extern uint16_t bleFrameEncode(uint8_t code, const char* payload, uint16_t size,
+									bool crc, uint8_t* out, uint16_t outMax);
+extern uint16_t bleFrameEncodeLine(const char* line, uint16_t size,
+									bool crc, uint8_t* out, uint16_t outMax);
+extern uint16_t bleFrameEncodeValues(uint8_t code, const char* prefix,
+									const uint32_t* values, uint8_t count,
+									bool crc, uint8_t* out, uint16_t outMax);
+
+#endif /* UTIL_BLE_FRAME_H_ */
+
+//////// End
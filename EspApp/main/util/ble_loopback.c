@@ -0,0 +1,231 @@
+/* ***********
+ * Project   : util - Utilities to esp-idf
+ * Programmer: Joao Lopes
+ * Module    : ble_loopback - transport in memory, to BleServer (instead of BLE UART server)
+ * Comments  : The client side is this module routines (ble_loopback_*)
+ *             Data written by client is delivered as BLE packets (parts of MTU size)
+ *             Data sended by server is delivered to callback of client
+ *             No dependencies of BT stack, to tests and profiling of the layers above
+ * Versions  :
+ * ------- 	-------- 	-------------------------
+ * 0.3.1  	17/10/26	First version
+ * 0.3.2  	17/10/26	Congestion set by client (as the BT stack, when the buffers is full)
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_err.h"
+
+#include "ble_transport.h"
+
+////// Variables
+
+static void (*mCallbackConnection)();								// Callback for connection/disconnection
+static void (*mCallbackMTU)();										// Callback for MTU change detect
+static void (*mCallbackReceivedData) (char *data, uint16_t size); 	// Callback for receive data
+static void (*mCallbackCongestion) (bool congested); 				// Callback for congestion change
+static void (*mCallbackClient) (const char *data, uint16_t size); 	// Callback of client (data sended by server)
+
+static bool mConnected = false;										// Connected ?
+static bool mCongested = false;										// Congested ? (set by client)
+static uint16_t mMTU = 20;											// MTU of data
+
+static const uint8_t mMacAddress[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 }; // Mac address (local)
+
+////// Routines of transport (server side)
+
+/**
+* @brief Initialize
+*/
+static esp_err_t loopback_Initialize(const char* device_name) {
+
+	mConnected = false;
+	mCongested = false;
+	mMTU = 20;
+
+	return ESP_OK;
+}
+
+/**
+* @brief Finalize
+*/
+static esp_err_t loopback_Finalize() {
+
+	mConnected = false;
+
+	return ESP_OK;
+}
+
+/**
+* @brief Set callbacks of connection and MTU
+*/
+static void loopback_SetCallbackConnection(void (*callbackConnection)(),
+		void (*callbackMTU)()) {
+
+	mCallbackConnection = callbackConnection;
+	mCallbackMTU = callbackMTU;
+}
+
+/**
+* @brief Set callback of data received
+*/
+static void loopback_SetCallbackReceiveData(
+		void (*callbackReceived)(char* data, uint16_t size)) {
+
+	mCallbackReceivedData = callbackReceived;
+}
+
+/**
+* @brief Set callback of congestion (see ble_loopback_SetCongested)
+*/
+static void loopback_SetCallbackCongestion(
+		void (*callbackCongestion)(bool congested)) {
+
+	mCallbackCongestion = callbackCongestion;
+}
+
+/**
+* @brief Client connected ?
+*/
+static bool loopback_ClientConnected() {
+
+	return mConnected;
+}
+
+/**
+* @brief Send data to client (by your callback)
+*/
+static esp_err_t loopback_SendData(const char* data, uint16_t size) {
+
+	if (!mConnected) {
+		return ESP_FAIL;
+	}
+
+	if (size > mMTU) {
+		size = mMTU;
+	}
+
+	if (mCallbackClient != NULL) {
+		mCallbackClient(data, size);
+	}
+
+	return ESP_OK;
+}
+
+/**
+* @brief Actual MTU
+*/
+static uint16_t loopback_MTU() {
+
+	return mMTU;
+}
+
+/**
+* @brief Mac address
+*/
+static const uint8_t* loopback_MacAddress() {
+
+	return mMacAddress;
+}
+
+////// Transport
+
+const BleTransport_t bleTransportLoopback = {
+	"loopback",
+	loopback_Initialize,
+	loopback_Finalize,
+	loopback_SetCallbackConnection,
+	loopback_SetCallbackReceiveData,
+	loopback_SetCallbackCongestion,
+	loopback_ClientConnected,
+	loopback_SendData,
+	loopback_MTU,
+	loopback_MacAddress
+};
+
+////// Routines of client
+
+/**
+* @brief Client connects (with this MTU)
+*/
+void ble_loopback_Connect(uint16_t mtu) {
+
+	mConnected = true;
+
+	if (mCallbackConnection != NULL) {
+		mCallbackConnection();
+	}
+
+	mMTU = mtu;
+
+	if (mCallbackMTU != NULL) {
+		mCallbackMTU();
+	}
+}
+
+/**
+* @brief Client disconnects
+*/
+void ble_loopback_Disconnect() {
+
+	mConnected = false;
+	mCongested = false;
+	mMTU = 20;
+
+	if (mCallbackConnection != NULL) {
+		mCallbackConnection();
+	}
+}
+
+/**
+* @brief Client writes data - delivered to server in parts of MTU size (as BLE packets)
+* Note: the callback of server runs in task of caller
+*/
+esp_err_t ble_loopback_Write(const char* data, uint16_t size) {
+
+	if (!mConnected || mCallbackReceivedData == NULL) {
+		return ESP_FAIL;
+	}
+
+	char packet[mMTU];
+
+	for (uint16_t pos = 0; pos < size; pos += mMTU) {
+
+		uint16_t sizePacket = ((size - pos) > mMTU) ? mMTU : (size - pos);
+
+		memcpy(packet, data + pos, sizePacket);
+
+		mCallbackReceivedData(packet, sizePacket);
+	}
+
+	return ESP_OK;
+}
+
+/**
+* @brief Client sets the congestion (true - the buffers is full, false - can send again)
+* Calls the callback of server only when it changes (as ESP_GATTS_CONGEST_EVT)
+*/
+void ble_loopback_SetCongested(bool congested) {
+
+	if (congested == mCongested || (congested && !mConnected)) {
+		return;
+	}
+
+	mCongested = congested;
+
+	if (mCallbackCongestion != NULL) {
+		mCallbackCongestion(congested);
+	}
+}
+
+/**
+* @brief Set callback of client (data sended by server)
+*/
+void ble_loopback_SetCallbackClient(void (*callbackClient)(const char* data, uint16_t size)) {
+
+	mCallbackClient = callbackClient;
+}
+
+//////// End
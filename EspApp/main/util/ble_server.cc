@@ -10,6 +10,24 @@
  * 0.3.0	23/08/18	Adjustments to allow sizes of BLE > 255
  * 						BLE has a Message now to receive data
  * 						Need when have more 1 message, to avoid empty string on event
+ * 0.3.1	17/10/26	Optional binary frames mode (ble_frame), negotiated in message 01
+ * 						Lines joined by LineReassembler (no more append of each char)
+ * 						Queue to send, by a task, waiting when BLE stack is congested
+ * 						Coalescing of messages in same packet (optional)
+ * 						Pool of buffers to receive, without block the BLE stack when full
+ * 						One task for all events (connection, MTU and lines), by a queue
+ * 						Transport by interface (ble_transport.h) - BLE UART server or loopback
+ * 						Histograms of latency of messages, by code and stage (latency_histogram.h)
+ * 0.3.2	17/10/26	Messages of values (sendValues) - frames of values in binary mode (no numbers as text)
+ * 						Statistics of sending protected by a mux (getSendStats returns a copy)
+ * 						Bytes sended in statistics of sending
+ * 						Pool of buffers to send, the queue to send have only indexes (no copy of parts by queue)
+ * 						Queue of lines received deeper than the pool of buffers (short lines not use the pool)
+ * 						Wait a buffer of pool to receive, if it is exhausted (backpressure to client)
+ * 						Changes of connection and MTU in flags, with a slot reserved in queue (never lost)
+ * 						Histograms of latency by any code of message (slot taken on first message of code)
+ * 						Latency protected by a mux (getLatency returns a copy)
+ * 						Maximum size of a line in one sending, by the mode (getLineMax)
  *
  **/
 
@@ -36,6 +54,8 @@ using std::string;
 
 #include "log.h"
 #include "esp_util.h"
+#include "ble_frame.h"
+#include "line_reassembler.h"
 
 // BLE UART SERVER in C (based in pbcreflux example)
 
@@ -53,7 +73,55 @@ static const char* TAG = "ble_server";	// Log tag
 
 static bool mConnected = false;			// Connected ?
 
-static string mLineBuffer = ""; 		// Line buffer of data received via communication 
+static const BleTransport_t* mTransport = &bleTransportUart; // Transport (BLE UART server is default)
+
+static LineReassembler<BLE_LINE_MAX_SIZE> mLineBuffer; // Line buffer of data received via communication 
+
+// Binary frames mode (see ble_frame.h) - text mode (lines) is the default
+
+static volatile bool mBinaryMode = false;	// Binary mode ?
+static volatile bool mBinaryCrc = false;	// With CRC ?
+
+static BleFrameDecoder mFrameDecoder;		// Decoder of frames received
+
+// Sending
+
+static uint8_t mSendPolicy = BLE_SEND_POLICY_BLOCK; // Policy when the queue to send is full
+
+static BleSendStats_t mSendStats;			// Statistics
+static portMUX_TYPE mSendStatsMux = portMUX_INITIALIZER_UNLOCKED; // Statistics are updated by tasks and callback of BT stack
+
+static volatile bool mCongested = false;	// BLE stack congested ?
+
+static uint32_t mCongestedStart = 0;		// Time of start of congestion
+
+static uint16_t mCoalescingDeadline = 0;	// Coalescing: maximum time to wait to join messages (0 - disabled)
+
+// Receiving
+
+static uint8_t mReceivePolicy = BLE_RECV_POLICY_DROP_NEWEST; // Policy when the queue to receive is full
+
+static BleReceiveStats_t mReceiveStats;		// Statistics
+
+// Latency of messages - times of stages (micros) of a message, until the response is sended
+
+typedef struct
+{
+	TaskHandle_t task;			// Task that process the message (NULL - not traced)
+	uint8_t slot;				// Slot of histograms (by code of message)
+	uint32_t received;			// Received by callback of BLE
+	uint32_t enqueued;			// Put in queue
+	uint32_t dequeued;			// Got by task
+	uint32_t dispatched;		// Response sended by the handler of message
+} BleLatencyTrace_t;
+
+static uint8_t mLatencyCodes[BLE_LATENCY_SLOTS];	// Code of each slot (0 - free, slot 0 is the others codes)
+
+static LatencyHistogram mLatency[BLE_LATENCY_SLOTS][BLE_LATENCY_STAGES]; // Histograms
+
+static BleLatencyTrace_t mLatencyTrace;		// Message in process (waiting the response)
+
+static portMUX_TYPE mLatencyMux = portMUX_INITIALIZER_UNLOCKED; // Latency is updated by task of events and task to send
 
 // Util
 
@@ -69,28 +137,85 @@ static BleServerCallbacks* mBleServerCallbacks;
 
 #ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
 
-	// Task FreeRTOS for events (for now only connection)
+	// Task FreeRTOS for events (connection, MTU and lines received) - one queue for all
 
 	static void event_Task(void *pvParameters);
 
 	static TaskHandle_t xTaskEventHandle = NULL;
 
-	// Task FreeRTOS for receive message - 23/08/18
+	static QueueHandle_t xQueueEvents = NULL;
+
+	typedef struct
+	{
+		uint8_t type;				// Type of event - BLE_EVENT_*
+		uint8_t index;				// Index of line (only for lines)
+	} BleEvent_t;
+
+	static bool sendEvent(uint8_t type, uint8_t index = 0);
+	static void sendState(bool connection, bool connected);
+	static void processEventState();
+	static bool receiveGet(bool large, uint8_t& index);
+	static void receiveFree(uint8_t index);
+	static bool dropOldestLine(uint8_t& index);
+
+	// Changes of state (connection and MTU) - kept in flags, with only one event in queue for them
+	// So it is never lost (the queue have space for all lines and this event), and the order is kept
 
-	static void receive_Task(void *pvParameters);
+	static portMUX_TYPE mStateMux = portMUX_INITIALIZER_UNLOCKED; // Updated by callback of BT stack
 
-	static TaskHandle_t xTaskReceiveHandle = NULL;
+	static bool mStateQueued = false;			// Event of state in queue
+	static bool mStateConnected = false;		// Connected (last change)
+	static uint8_t mStateChanges = 0;			// Changes of connection not processed
+	static bool mStateMtu = false;				// MTU changed (not processed)
 
 	// Event Message - 23/08/18
+	// Lines received, the queue of events have only the index of line
+	// (a line is written once, in the line if short, or in a buffer of pool, and processed in place by the task)
 
-	static QueueHandle_t xQueueReceiveMessage;
+	#define BLE_RECV_NO_BUFFER 0xff
+
+	static QueueHandle_t xQueueReceiveFree = NULL;		// Indexes of lines free
+	static QueueHandle_t xQueuePoolFree = NULL;			// Indexes of buffers of pool free
 
 	typedef struct
 	{
-		char message [BLE_LINE_MAX_SIZE + 1];
+		char message [BLE_RECV_SHORT_SIZE + 1];	// Short line
+		char* data;					// Data of line (the message or a buffer of pool)
+		uint8_t buffer;				// Index of buffer of pool (BLE_RECV_NO_BUFFER if short)
 		uint16_t size;
+		uint32_t received;			// Time of receive (micros)
+		uint32_t enqueued;			// Time of put in queue (micros)
 	} BleReceiveMessage_t;
 
+	static BleReceiveMessage_t mReceiveLines[BLE_SIZE_QUEUE_RECV];
+	static char mReceivePool[BLE_SIZE_POOL_RECV][BLE_LINE_MAX_SIZE + 1];
+
+	// Task FreeRTOS for send data (waits if the BLE stack is congested)
+
+	static void send_Task(void *pvParameters);
+
+	static TaskHandle_t xTaskSendHandle = NULL;
+
+	// Pool of buffers for data to send (parts with size of MTU), the queue have only the index of buffer
+	// (a part is written once in pool, and sended from there by the task)
+
+	static QueueHandle_t xQueueSendData = NULL;			// Indexes of buffers to send
+	static QueueHandle_t xQueueSendFree = NULL;			// Indexes of buffers free
+
+	typedef struct
+	{
+		char data [BLE_MSG_MAX_SIZE];
+		uint16_t size;
+		bool flush;					// Send it now (no wait to coalescing)
+		BleLatencyTrace_t trace;	// Latency of message (only the last part of response)
+	} BleSendData_t;
+
+	static BleSendData_t mSendPool[BLE_SIZE_QUEUE_SEND];
+
+	static bool sendPoolGet(uint8_t& index);
+	static void sendPoolClear();
+	static void sendCoalescing(BleSendData_t& packet);
+
 #endif
 
 // Callbacks for esp_uart_server
@@ -100,33 +225,77 @@ extern "C" {
 static void bleCallbackConnection();
 static void bleCallbackMTU();
 static void bleCallbackReceiveData(char* data, uint16_t size);
+static void bleCallbackCongestion(bool congested);
 
 } // extern "C"
 
+static void processLine(const char* line, uint16_t size, uint32_t received);
+static void processEventConnection(bool connected);
+static void processEventReceive(const char* data, uint16_t size);
+static void sendFrames(const char* data, uint16_t size, bool flush, const BleLatencyTrace_t* trace);
+static void sendFrame(const uint8_t* frame, uint16_t size, bool flush, const BleLatencyTrace_t* trace);
+static void sendPart(const char* data, uint16_t size, bool newLine, bool flush, const BleLatencyTrace_t* trace);
+static void sendBle(const char* data, uint16_t size);
+
+static void latencyStart(const char* line, uint16_t size, uint32_t received, uint32_t enqueued, uint32_t dequeued);
+static void latencyEnd();
+static bool latencyDispatch(BleLatencyTrace_t& trace);
+static void latencyRecord(const BleLatencyTrace_t& trace);
+
 //////// Methods
 
+/**
+* @brief Set the transport (call it before initialize)
+* The default is BLE UART server, loopback is to tests (see ble_transport.h)
+*/
+void BleServer::setTransport(const BleTransport_t* transport) {
+
+	mTransport = transport;
+}
+
 /**
 * @brief Initialize the BLE server
 */
 void BleServer::initialize(const char* deviceName, BleServerCallbacks* pBleServerCallbacks) {
 
-	logI("Initializing BLE Server - device name=%s", deviceName);
+	logI("Initializing BLE Server - device name=%s transport=%s", deviceName, mTransport->name);
 
 	// Set the callbacks
 
 	mBleServerCallbacks = pBleServerCallbacks;
 
-	// BLE routines in C based on pcbreflux example
+	// Transport - BLE routines in C based on pcbreflux example (default)
 
-	ble_uart_server_Initialize(deviceName);
+	mTransport->initialize(deviceName);
 
-	ble_uart_server_SetCallbackConnection(bleCallbackConnection,
+	mTransport->setCallbackConnection(bleCallbackConnection,
 			bleCallbackMTU);
-	ble_uart_server_SetCallbackReceiveData(bleCallbackReceiveData);
+	mTransport->setCallbackReceiveData(bleCallbackReceiveData);
+	mTransport->setCallbackCongestion(bleCallbackCongestion);
 
 #ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
 
-	// Create task for event in core 1
+	// Create queues of events and pool of buffers to receive
+
+	xQueueEvents = xQueueCreate(BLE_SIZE_QUEUE_EVENTS, sizeof(BleEvent_t));
+	xQueueReceiveFree = xQueueCreate(BLE_SIZE_QUEUE_RECV, sizeof(uint8_t));
+	xQueuePoolFree = xQueueCreate(BLE_SIZE_POOL_RECV, sizeof(uint8_t));
+
+	if (xQueueEvents == NULL || xQueueReceiveFree == NULL || xQueuePoolFree == NULL) {
+		logE("Error on create queue of events");
+	}
+
+	// All lines and buffers of pool is free
+
+	for (uint8_t i = 0; i < BLE_SIZE_QUEUE_RECV; i++) {
+		xQueueSend(xQueueReceiveFree, &i, 0);
+	}
+
+	for (uint8_t i = 0; i < BLE_SIZE_POOL_RECV; i++) {
+		xQueueSend(xQueuePoolFree, &i, 0);
+	}
+
+	// Create task for event in core 1 (connection and messages received)
 
 	xTaskCreatePinnedToCore(&event_Task, "bleEvent_Task", 5120, NULL,
 			BLE_EVENTS_TASK_PRIOR, &xTaskEventHandle,
@@ -134,19 +303,28 @@ void BleServer::initialize(const char* deviceName, BleServerCallbacks* pBleServe
 
 	logI("Task for event started");
 
-	// Create task for receive message in core 1
+	// Create queue, pool of buffers and task for send data in core 1
 
-	xTaskCreatePinnedToCore(&receive_Task, "bleRecv_Task", 5120, NULL,
-			BLE_EVENTS_TASK_PRIOR, &xTaskReceiveHandle,
-			BLE_EVENTS_TASK_CPU);
+	xQueueSendData = xQueueCreate(BLE_SIZE_QUEUE_SEND, sizeof(uint8_t));
+	xQueueSendFree = xQueueCreate(BLE_SIZE_QUEUE_SEND, sizeof(uint8_t));
+
+	if (xQueueSendData == NULL || xQueueSendFree == NULL) {
+		logE("Error on create queue to send");
+	}
 
-	logI("Task for receive message started");
+	// All buffers of pool is free
 
-#endif
+	for (uint8_t i = 0; i < BLE_SIZE_QUEUE_SEND; i++) {
+		xQueueSend(xQueueSendFree, &i, 0);
+	}
+
+	xTaskCreatePinnedToCore(&send_Task, "bleSend_Task", 4096, NULL,
+			BLE_EVENTS_TASK_PRIOR, &xTaskSendHandle,
+			BLE_EVENTS_TASK_CPU);
 
-	// Reserves the bytes for strings avoid fragmetaion
+	logI("Task for send data started");
 
-	mLineBuffer.reserve(BLE_LINE_MAX_SIZE); 
+#endif
 
 	// Debug 
 
@@ -169,20 +347,41 @@ void BleServer::finalize() {
 
 		logI("Task for event deleted");
 
-		if (xQueueReceiveMessage != NULL) {
-			vQueueDelete(xQueueReceiveMessage);
+		if (xQueueEvents != NULL) {
+			vQueueDelete(xQueueEvents);
+			xQueueEvents = NULL;
+		}
+
+		if (xQueueReceiveFree != NULL) {
+			vQueueDelete(xQueueReceiveFree);
+			xQueueReceiveFree = NULL;
 		}
 
-		vTaskDelete(xTaskReceiveHandle);
+		if (xQueuePoolFree != NULL) {
+			vQueueDelete(xQueuePoolFree);
+			xQueuePoolFree = NULL;
+		}
+
+		vTaskDelete(xTaskSendHandle);
+
+		if (xQueueSendData != NULL) {
+			vQueueDelete(xQueueSendData);
+			xQueueSendData = NULL;
+		}
 
-		logI("Task for receive deleted");
+		if (xQueueSendFree != NULL) {
+			vQueueDelete(xQueueSendFree);
+			xQueueSendFree = NULL;
+		}
+
+		logI("Task for send deleted");
 	}
 
 #endif
 
 	// Finalize it
 	
-	ble_uart_server_Finalize();
+	mTransport->finalize();
 
 	logI("Finalized Ble server");
 
@@ -201,16 +400,26 @@ bool BleServer::connected() {
 * @brief Send data to App mobile (by BLE UART Server)
 * Note: char* wrapper
 */
-void BleServer::send(const char* data) {
+void BleServer::send(const char* data, bool flush) {
+
+	send(data, strlen(data), flush);
+}
+
+/**
+* @brief Send data to App mobile (by BLE UART Server)
+* Note: string wrapper
+*/
+void BleServer::send(const string& data, bool flush) {
 
-	string aux = data;
-	send(aux);
+	send(data.c_str(), data.size(), flush);
 }
 
 /**
 * @brief Send data to App mobile (by BLE UART Server)
+* The data is not changed or copied, it is splitted in parts by pointers
+* Note: flush is to send it now, if coalescing is enabled (for messages that need low latency)
 */
-void BleServer::send(string& data) {
+void BleServer::send(const char* data, uint16_t size, bool flush) {
 
 	// Send data by UART BLE Server
 
@@ -219,22 +428,35 @@ void BleServer::send(string& data) {
 		return;
 	}
 
-	// Process data
+	if (size == 0) {
+		return;
+	}
 
-	uint16_t size = data.size();
+	// Latency - is the response of message in process (by this task) ?
 
-	// Add new line, if not have it (need when split large messages)
+	BleLatencyTrace_t trace;
+
+	bool traced = latencyDispatch(trace);
 
-	if (data[size-1] != '\n') {
-		data.append(1u, '\n');
-		size++;
+	// Binary mode ?
+
+	if (mBinaryMode) {
+		sendFrames(data, size, flush, (traced) ? &trace : NULL);
+		return;
 	}
 
-	logV("BLE message [%d] -> %s", size, mUtil.strExpand(data).c_str());
+	// Add new line, if not have it (need when split large messages)
+	// Note: it is added in the last part, the data of caller is not changed
+
+	bool newLine = (data[size-1] != '\n');
+
+	uint16_t total = size + ((newLine) ? 1 : 0);
+
+	logV("BLE message [%u] -> %.*s", total, size, data);
 
 	// Maximum of the sending (now it is by ble_uart_server current MTU)
 
-	uint16_t maximum = ble_uart_server_MTU();
+	uint16_t maximum = mTransport->mtu();
 
 	if (maximum > BLE_MSG_MAX_SIZE) {
 		maximum = BLE_MSG_MAX_SIZE;
@@ -242,351 +464,1332 @@ void BleServer::send(string& data) {
 
 	// Send data, respecting the maximum size, spliting if necessary
 
-	char send[maximum + 1];
+	for (uint16_t pos = 0; pos < total; pos += maximum) {
 
-	memset(send, 0, maximum + 1);
+		uint16_t sizeSend = ((total - pos) > maximum) ? maximum : (total - pos);
 
-	uint16_t posSend = 0;
-	
-	for (uint16_t i = 0; i < size; i++) {
+		bool last = ((pos + sizeSend) == total);
+
+		if (total > maximum) { // Only log if needing split
+			logV("BLE sending part [%u] [max=%u]", sizeSend, maximum);
+		}
 
-		send[posSend++] = data[i];
+		// Send it (by queue, if have it) - the new line is not in data
 
-		if (posSend == maximum || i == (size - 1)) {// Has it reached the maximum or the end?
+		sendPart(data + pos, (last && newLine) ? (sizeSend - 1) : sizeSend,
+					(last && newLine), flush, (last && traced) ? &trace : NULL);
+	}
+}
 
-			// Send the data
+/**
+* @brief Send a message of values (numbers) to App mobile - nn:prefix:value:value...
+* In binary mode is a frame of values (varints, no conversion to text), else is a text line
+*/
+void BleServer::sendValues(uint8_t code, const char* prefix, const uint32_t* values, uint8_t count, bool flush) {
 
-			if (size > maximum) { // Only log if needing split
-				logV("BLE sending part [%d] -> %s [max=%d]",
-						posSend, mUtil.strExpand(send).c_str(), maximum);
-			}
+	if (!mConnected) {
+		logE("not connected");
+		return;
+	}
 
-			// BLE routines in C based on pcbreflux example
+	// Text mode ?
 
-			ble_uart_server_SendData(send, posSend);
+	if (!mBinaryMode) {
 
-			// Next shipment
+		char line[BLE_LINE_MAX_SIZE];
 
-			posSend = 0;
+		uint16_t size = snprintf(line, sizeof(line), "%02u:%s", code, prefix);
 
-			memset(send, 0, maximum + 1);
+		for (uint8_t i = 0; i < count && size < sizeof(line); i++) {
+			size += snprintf(line + size, sizeof(line) - size, ":%u", values[i]);
+		}
 
+		if (size >= sizeof(line)) {
+			logE("message of values too large [%u]", size);
+			return;
 		}
+
+		send(line, size, flush);
+		return;
 	}
-}
 
-const uint8_t* BleServer::getMacAddress() {
+	// Frame of values
 
-	return ble_uart_server_MacAddress();
+	uint8_t frame[BLE_LINE_MAX_SIZE + BLE_FRAME_OVERHEAD_MAX];
 
-}
+	uint16_t sizeFrame = bleFrameEncodeValues(code, prefix, values, count, mBinaryCrc, frame, sizeof(frame));
 
-///// Privates 
+	if (sizeFrame == 0) {
+		logE("invalid message of values to frame [%u]", count);
+		return;
+	}
 
-/**
-* @brief Process event for connection/disconnection
-* This code is called or by event task (CPU 1) or direct (no event task) 
-*/
-void processEventConnection() {
+	// Latency - is the response of message in process (by this task) ?
 
-	if (ble_uart_server_ClientConnected()) { // Connected
+	BleLatencyTrace_t trace;
 
-		logI ("BLE client connected");
+	bool traced = latencyDispatch(trace);
 
-		mConnected = true;
+	sendFrame(frame, sizeFrame, flush, (traced) ? &trace : NULL);
+}
 
-		// Callback
+const uint8_t* BleServer::getMacAddress() {
 
-		if (mBleServerCallbacks) {
-			mBleServerCallbacks->onConnect();
-		}
+	return mTransport->macAddress();
 
-	} else { // Disconnected
+}
 
-		logI ("BLE client disconnected");
-		
-		mConnected = false;
+/**
+* @brief Maximum size of data of each sending (current MTU)
+*/
+uint16_t BleServer::getMTU() {
 
-		// Callback
+	uint16_t maximum = mTransport->mtu();
 
-		if (mBleServerCallbacks) {
-			mBleServerCallbacks->onDisconnect();
-		}
+	if (maximum > BLE_MSG_MAX_SIZE) {
+		maximum = BLE_MSG_MAX_SIZE;
 	}
+
+	return maximum;
 }
 
 /**
-* @brief Process event for receive messages (lines)
-* This code is called or by event task (CPU 1) or direct (no event task) 
+* @brief Maximum size of a line (nn:payload, with the new line) sended in one notification (current MTU)
+* In binary mode, the frame of line not have the "nn:" and the new line, but have the code (1 byte),
+* the size of payload (varint) and the CRC (if negotiated)
 */
-void processEventReceive(char* data) {
+uint16_t BleServer::getLineMax() {
 
-	// Warning for bug: empty data
+	uint16_t maximum = getMTU();
 
-	if (strlen(data) == 0) {
-		logW("empty message");
-		return;
+	if (!mBinaryMode) {
+		return maximum;
 	}
 
-	// Callback to data received
+	// Payload of frame - the MTU less the code, the varint (1 byte up to 127) and the CRC
 
-	if (mBleServerCallbacks) {
-		mBleServerCallbacks->onReceive(data);
+	uint16_t overhead = 1 + ((mBinaryCrc) ? BLE_FRAME_CRC_SIZE : 0);
+
+	uint16_t payload = (maximum - overhead - 1);
+
+	if (payload > 127) { // Varint of 2 bytes
+		payload = (maximum - overhead - 2);
 	}
-}
 
-#ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
+	uint16_t line = (payload + 4); // With the "nn:" and the new line
+
+	return (line > BLE_LINE_MAX_SIZE) ? BLE_LINE_MAX_SIZE : line;
+}
 
 /**
-* @brief Task for event to run callbacks in CPU 1
+* @brief Set the binary frames mode (or text mode if binary = false)
+* Note: is reseted to text mode on disconnection
 */
-static void event_Task(void *pvParameters) {
+void BleServer::setBinaryMode(bool binary, bool crc) {
 
-	// Initialize
+	logI("mode -> %s%s", ((binary)? "binary": "text"), ((binary && crc)? " with CRC": ""));
 
-	logI("Initializing ble event Task");
+	mBinaryCrc = crc;
+	mFrameDecoder.setCrc(crc);
 
-	// Notification variable 
+	mBinaryMode = binary;
+}
 
-	uint32_t notification; 
+/**
+* @brief Is in binary frames mode ?
+*/
+bool BleServer::binaryMode() {
 
-	// Task loop
+	return mBinaryMode;
+}
 
-	for (;;) {
+/**
+* @brief Set the policy when the queue to send is full (BLE_SEND_POLICY_*)
+*/
+void BleServer::setSendPolicy(uint8_t policy) {
 
-		// Wait something notified (seen in the FreeRTOS example) 
+	mSendPolicy = policy;
+}
 
-		if (xTaskNotifyWait (0, 0xffffffff, &notification, portMAX_DELAY) == pdPASS) { 
+/**
+* @brief Set the coalescing of messages - join messages in same packet (up to MTU)
+* deadline is the maximum time to wait for more messages (millis), 0 to disable it
+* Note: only with task to send (BLE_EVENTS_TASK_CPU)
+*/
+void BleServer::setCoalescing(uint16_t deadline) {
 
-			// Process event by task notification
+	mCoalescingDeadline = deadline;
+}
 
-			logD ("Event received -> %u", notification); 
+/**
+* @brief Statistics of sending (a copy, consistent - it is updated by others tasks)
+*/
+BleSendStats_t BleServer::getSendStats() {
 
-			switch (notification) { // (Only connection for now)
+	portENTER_CRITICAL(&mSendStatsMux);
+	BleSendStats_t stats = mSendStats;
+	portEXIT_CRITICAL(&mSendStatsMux);
 
-				case BLE_EVENT_CONNECTION: 	// Connection/disconection
+	return stats;
+}
 
-					// Process event
+/**
+* @brief Histogram of latency (micros) of a slot (code of message) and stage (BLE_LATENCY_STAGE_*)
+* Note: a copy, consistent - it is updated by others tasks
+*/
+LatencyHistogram BleServer::getLatency(uint8_t slot, uint8_t stage) {
 
-					processEventConnection();
-					break;	
-			}
-		}
+	if (slot >= BLE_LATENCY_SLOTS || stage >= BLE_LATENCY_STAGES) {
+		logE("invalid slot or stage of latency");
+		slot = 0;
+		stage = BLE_LATENCY_STAGE_TOTAL;
 	}
 
-	////// End
+	portENTER_CRITICAL(&mLatencyMux);
+	LatencyHistogram histogram = mLatency[slot][stage];
+	portEXIT_CRITICAL(&mLatencyMux);
 
-	// Delete this task
+	return histogram;
+}
 
-	vTaskDelete(NULL);
-	xTaskEventHandle = NULL;
+/**
+* @brief Code of message of a slot of latency (0 - the others codes or slot free)
+*/
+uint8_t BleServer::getLatencyCode(uint8_t slot) {
+
+	if (slot == 0 || slot >= BLE_LATENCY_SLOTS) {
+		return 0;
+	}
+
+	portENTER_CRITICAL(&mLatencyMux);
+	uint8_t code = mLatencyCodes[slot];
+	portEXIT_CRITICAL(&mLatencyMux);
+
+	return code;
 }
 
 /**
-* @brief Task for receive messages to run callbacks in CPU 1
+* @brief Clear the histograms of latency
+* Note: the codes keeps the slots (the messages in process can be recorded after it)
 */
-static void receive_Task(void *pvParameters) {
+void BleServer::resetLatency() {
 
-	// Initialize
+	for (uint8_t slot = 0; slot < BLE_LATENCY_SLOTS; slot++) {
 
-	logI("Initializing ble receive Task");
+		// By slot - not all histograms in one critical section
 
-    // Create Message to receive message 
+		portENTER_CRITICAL(&mLatencyMux);
 
-	xQueueReceiveMessage = xQueueCreate(BLE_SIZE_QUEUE_RECV, sizeof(BleReceiveMessage_t));
+		for (uint8_t stage = 0; stage < BLE_LATENCY_STAGES; stage++) {
+			mLatency[slot][stage].reset();
+		}
 
-	if (xQueueReceiveMessage == NULL) {
-		logE("Error on create Message");
+		portEXIT_CRITICAL(&mLatencyMux);
 	}
+}
 
-	// Message date
+/**
+* @brief Set the policy when the queue to receive is full (BLE_RECV_POLICY_*)
+*/
+void BleServer::setReceivePolicy(uint8_t policy) {
 
-	BleReceiveMessage_t queueMessage;
+	mReceivePolicy = policy;
+}
 
-	// Task loop
+/**
+* @brief Statistics of receiving
+*/
+const BleReceiveStats_t& BleServer::getReceiveStats() {
 
-	for (;;) {
+	return mReceiveStats;
+}
 
-		// Expect to receive something from the Message
-		// Adopted this logic to force processing on CPU 1
-		// BLE has a Message now to receive messages (line) - 23/08/17
-		// Need when have more 1 message, to avoid empty string on event
+///// Privates 
 
-		BaseType_t ret = xQueueReceive(xQueueReceiveMessage, &queueMessage, portMAX_DELAY);
+/**
+* @brief Send a part of data (with maximum of MTU size)
+* If have a task to send, put it in queue, respecting the policy when it is full
+* newLine is to add a new line after the data (the last part of text message)
+* trace is the latency of message, if this is the last part of response (or NULL)
+*/
+static void sendPart(const char* data, uint16_t size, bool newLine, bool flush, const BleLatencyTrace_t* trace) {
 
-		if(ret == pdPASS) {
+	portENTER_CRITICAL(&mSendStatsMux);
+	mSendStats.queued++;
+	portEXIT_CRITICAL(&mSendStatsMux);
 
-			// Verify Message
+#ifdef BLE_EVENTS_TASK_CPU // Task for send
 
-			if (queueMessage.size > 0) {
+	if (xQueueSendData != NULL) {
 
-				// Message received
+		// Get a buffer of pool, respecting the policy when it is full
+		// Note: the queue have space for all buffers of pool, so a part with buffer is always queued
 
-				if (mLogActive) {
-					logV("Message -> data extracted (free %d), do the callback", uxQueueSpacesAvailable(xQueueReceiveMessage));
-				}
+		uint8_t index;
 
-				// Callback
+		bool queued = sendPoolGet(index);
 
-				if (mBleServerCallbacks) {
-					mBleServerCallbacks->onReceive(queueMessage.message);
-				}
+		if (queued) {
 
-			} else {
+			// Copy the part to buffer (the only copy), and put its index in queue
 
-				// Warning
+			BleSendData_t& queueData = mSendPool[index];
 
-				logE("Message -> size 0!");
-			}
+			memcpy(queueData.data, data, size);
+			queueData.size = size;
+			queueData.flush = flush;
 
-		} else {
+			if (trace != NULL) {
+				queueData.trace = *trace;
+			} else {
+				queueData.trace.task = NULL;
+			}
 
-			// Warning
+			if (newLine) {
+				queueData.data[queueData.size++] = '\n';
+			}
 
-			logE("error on get Message!");
+			xQueueSend(xQueueSendData, &index, 0);
 		}
-	}
-
-	////// End
 
-	// Delete this task
+		if (!queued) {
+			portENTER_CRITICAL(&mSendStatsMux);
+			mSendStats.dropped++;
+			portEXIT_CRITICAL(&mSendStatsMux);
+			logW("queue to send is full - data dropped");
+		}
 
-	if (xQueueReceiveMessage != NULL) {
-		vQueueDelete(xQueueReceiveMessage);
+		return;
 	}
 
-	vTaskDelete(NULL);
-	xTaskEventHandle = NULL;
-}
-
 #endif
 
-////// BLE callbacks from ble_uart_server
-
-extern "C" {
-
-/**
-* @brief Callback for connection
-*/
-static void bleCallbackConnection() { // @suppress("Unused static function")
+	// Send it now
 
-	// Process this event
+	if (newLine) { // Only this part is copied, to add the new line
 
-#ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
+		char send[BLE_MSG_MAX_SIZE + 1];
 
-	// Notify taks
+		memcpy(send, data, size);
+		send[size++] = '\n';
 
-	xTaskNotify (xTaskEventHandle, BLE_EVENT_CONNECTION, eSetValueWithOverwrite);
+		sendBle(send, size);
 
-#else // CPU 0 -> callback right here
+	} else {
 
-	processEventConnection();
+		sendBle(data, size);
+	}
 
-#endif
+	// Latency
 
+	if (trace != NULL) {
+		latencyRecord(*trace);
+	}
 }
 
 /**
-* @brief Callback for MTU changed by BLE client (mobile APP)
+* @brief Send a part of data by BLE
 */
-static void bleCallbackMTU() { // @suppress("Unused static function")
+static void sendBle(const char* data, uint16_t size) {
+
+	// BLE routines in C based on pcbreflux example
+
+	bool sent = (mTransport->sendData(data, size) == ESP_OK);
+
+	portENTER_CRITICAL(&mSendStatsMux);
 
-	logI("BLE MTU changed to %d",ble_uart_server_MTU());
+	if (sent) {
+		mSendStats.sent++;
+		mSendStats.bytes += size;
+	} else {
+		mSendStats.failed++;
+	}
 
+	portEXIT_CRITICAL(&mSendStatsMux);
 }
 
 /**
-* @brief Received data via BLE notification
+* @brief Send data in binary frames mode (each line of data is a frame)
 */
-static void bleCallbackReceiveData(char *data, uint16_t size) { // @suppress("Unused static function")
+static void sendFrames(const char* data, uint16_t size, bool flush, const BleLatencyTrace_t* trace) {
 
-	static uint32_t lastTime=0;// To control timeout of receving messages (lines)
+	uint8_t frame[BLE_LINE_MAX_SIZE + BLE_FRAME_OVERHEAD_MAX];
 
-	// Verify time of last receipt, if line buffer is no empty
+	const char* line = data;
+	const char* end = data + size;
 
-	if (mLineBuffer.size() > 0 && 
-		(millis() - lastTime) >= BLE_TIMEOUT_RECV_LINE) {
+	while (line < end) {
 
-		// Timeout -> clear the buffer
+		// Line (message)
 
-		logI("timeout - clear buffer");
+		const char* next = (const char*) memchr(line, '\n', end - line);
 
-		mLineBuffer = "";
+		uint16_t sizeLine = (next != NULL) ? (next - line) : (end - line);
 
-	}
+		bool lastLine = (next == NULL || (next + 1) >= end);
 
-	// Mark this time 
+		if (sizeLine > 0) {
 
-	lastTime = millis();
+			// Encode it
 
-	// Received data via BLE server - by callback
+			uint16_t sizeFrame = bleFrameEncodeLine(line, sizeLine, mBinaryCrc, frame, sizeof(frame));
 
-	char aux[size + 1];
-	sprintf(aux, "%.*s", size, data);
+			if (sizeFrame == 0) {
 
-	logV("BLE received [%d] : %s", size, mUtil.strExpand(aux).c_str());
-	
-	// Process the received data
+				logE("invalid message to frame [%u]", sizeLine);
 
-	for (uint8_t i = 0; i < size; i++) {
+			} else {
 
-		char character = data[i];
+				sendFrame(frame, sizeFrame, flush, (lastLine) ? trace : NULL);
+			}
+		}
 
-		// Process the message upon receiving a new line
+		line += sizeLine + 1;
+	}
+}
 
-		if (character == '\n') { // New line
+/**
+* @brief Send a frame, respecting the maximum size (trace is recorded in the last part)
+*/
+static void sendFrame(const uint8_t* frame, uint16_t size, bool flush, const BleLatencyTrace_t* trace) {
 
-			if (mLineBuffer.length() > 0) { // Not empty ?
+	// Maximum of the sending (now it is by ble_uart_server current MTU)
 
-				logD("BLE line message received: %s", mLineBuffer.c_str());
+	uint16_t maximum = mTransport->mtu();
 
-				// Process this event
+	if (maximum > BLE_MSG_MAX_SIZE) {
+		maximum = BLE_MSG_MAX_SIZE;
+	}
 
-#ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
+	for (uint16_t pos = 0; pos < size; pos += maximum) {
 
-				// Add this to Message (necessary to task events not lose data) - 23/08/18
+		uint16_t sizeSend = ((size - pos) > maximum) ? maximum : (size - pos);
 
-				BleReceiveMessage_t queueMessage;
+		bool last = ((pos + sizeSend) == size);
 
-				queueMessage.size = mLineBuffer.size();
+		sendPart((const char*) frame + pos, sizeSend, false, flush, (last) ? trace : NULL);
+	}
+}
+
+/**
+* @brief Process event for connection/disconnection
+* This code is called or by event task (CPU 1) or direct (no event task) 
+*/
+static void processEventConnection(bool connected) {
+
+	if (connected) { // Connected
+
+		logI ("BLE client connected");
+
+		mConnected = true;
+
+		// Callback
+
+		if (mBleServerCallbacks) {
+			mBleServerCallbacks->onConnect();
+		}
+
+	} else { // Disconnected
+
+		logI ("BLE client disconnected");
+		
+		mConnected = false;
+
+		// Callback
+
+		if (mBleServerCallbacks) {
+			mBleServerCallbacks->onDisconnect();
+		}
+	}
+}
+
+/**
+* @brief Process event for receive messages (lines)
+* This code is called or by event task (CPU 1) or direct (no event task) 
+*/
+static void processEventReceive(const char* data, uint16_t size) {
+
+	// Warning for bug: empty data
+
+	if (size == 0) {
+		logW("empty message");
+		return;
+	}
+
+	// Callback to data received
+
+	if (mBleServerCallbacks) {
+		mBleServerCallbacks->onReceive(data, size);
+	}
+}
+
+#ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
+
+/**
+* @brief Task for events to run callbacks in CPU 1
+* One queue for all events (connection, MTU and lines), processed in order of arrival
+*/
+static void event_Task(void *pvParameters) {
+
+	// Initialize
+
+	logI("Initializing ble event Task");
+
+	// Event
+
+	BleEvent_t event;
+
+	// Task loop
 
-				if (queueMessage.size > BLE_LINE_MAX_SIZE) {
-					queueMessage.size = BLE_LINE_MAX_SIZE;
-					logW("size overflow");
+	for (;;) {
+
+		// Wait for a event
+		// Adopted this logic to force processing on CPU 1
+		// BLE has a Message now to receive messages (line) - 23/08/17
+
+		if (xQueueReceive(xQueueEvents, &event, portMAX_DELAY) != pdPASS) {
+
+			logE("error on get event!");
+			continue;
+		}
+
+		logD ("Event received -> %u", event.type);
+
+		switch (event.type) {
+
+			case BLE_EVENT_STATE: 		// Connection/disconection or MTU changed
+
+				processEventState();
+				break;
+
+			case BLE_EVENT_LINE:		// Line received
+				{
+					BleReceiveMessage_t& queueMessage = mReceiveLines[event.index];
+
+					// Latency (time in queue - millis)
+
+					uint32_t dequeued = micros();
+
+					uint32_t latency = ((dequeued - queueMessage.enqueued) / 1000);
+
+					mReceiveStats.latencyTotal += latency;
+
+					if (latency > mReceiveStats.latencyMax) {
+						mReceiveStats.latencyMax = latency;
+					}
+
+					mReceiveStats.processed++;
+
+					// Message received
+
+					if (mLogActive) {
+						logV("Message -> data extracted (free %d), do the callback", uxQueueMessagesWaiting(xQueueReceiveFree));
+					}
+
+					// Callback (the line is processed in place, in the line or in the buffer of pool)
+					// Latency of stages is traced until the response (see BleServer::send)
+
+					latencyStart(queueMessage.data, queueMessage.size,
+									queueMessage.received, queueMessage.enqueued, dequeued);
+
+					processEventReceive(queueMessage.data, queueMessage.size);
+
+					latencyEnd(); // No more traced (if not have response)
+
+					// Return the line (and its buffer) to pool
+
+					receiveFree(event.index);
 				}
+				break;
+		}
+	}
 
-				bzero (queueMessage.message, BLE_LINE_MAX_SIZE); 
-				strncpy(queueMessage.message, mLineBuffer.c_str(), queueMessage.size);
+	////// End
 
-				// Send message to queu, wait if it is full
+	// Delete this task
 
-				if (xQueueSend (xQueueReceiveMessage,  &queueMessage, portMAX_DELAY) == pdFAIL) {
+	vTaskDelete(NULL);
+	xTaskEventHandle = NULL;
+}
+
+/**
+* @brief Send a event to task (no wait, this is called by callbacks of BLE stack)
+*/
+static bool sendEvent(uint8_t type, uint8_t index) {
+
+	if (xQueueEvents == NULL) {
+		return false;
+	}
+
+	BleEvent_t event;
+
+	event.type = type;
+	event.index = index;
+
+	if (xQueueSend(xQueueEvents, &event, 0) != pdPASS) {
+		logE("Error to send event %u - queue full", type);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+* @brief Change of state (connection or MTU) - to flags, and a event to task, if not have one in queue
+* Note: called by callbacks of BLE stack
+*/
+static void sendState(bool connection, bool connected) {
+
+	portENTER_CRITICAL(&mStateMux);
+
+	if (connection) {
+		if (connected != mStateConnected) {
+			mStateConnected = connected;
+			if (mStateChanges < 0xff) {
+				mStateChanges++;
+			}
+		}
+	} else {
+		mStateMtu = true;
+	}
+
+	bool queue = !mStateQueued;
+
+	mStateQueued = true;
+
+	portEXIT_CRITICAL(&mStateMux);
+
+	// Event (the queue have a slot reserved to it)
+
+	if (queue && !sendEvent(BLE_EVENT_STATE)) {
+
+		portENTER_CRITICAL(&mStateMux);
+		mStateQueued = false; // The next change tries again
+		portEXIT_CRITICAL(&mStateMux);
+	}
+}
+
+/**
+* @brief Process the changes of state (after the lines received before them)
+* If the connection changed more than once (ex: disconnected and connected again), the callbacks
+* of last disconnection and connection are called, in order
+*/
+static void processEventState() {
 
-					logE("Error to send queue");
+	portENTER_CRITICAL(&mStateMux);
 
-				} else {
+	bool connected = mStateConnected;
+	uint8_t changes = mStateChanges;
+	bool mtu = mStateMtu;
 
-					logV("Message put on queue");
+	mStateChanges = 0;
+	mStateMtu = false;
+	mStateQueued = false;
+
+	portEXIT_CRITICAL(&mStateMux);
+
+	// Connection
+
+	if (changes > 0) {
+
+		if (connected == mConnected) { // Changed and returned - the previous too
+			processEventConnection(!connected);
+		}
+
+		processEventConnection(connected);
+	}
+
+	// MTU
+
+	if (mtu) {
+		logI("BLE MTU changed to %d", mTransport->mtu());
+	}
+}
+
+/**
+* @brief Coalescing - join the next data in queue to this packet
+* Waits for it until the deadline, stops if not fit in MTU or the data needs flush
+*/
+static void sendCoalescing(BleSendData_t& packet) {
+
+	// Maximum of the sending (now it is by ble_uart_server current MTU)
+
+	uint16_t maximum = mTransport->mtu();
+
+	if (maximum > BLE_MSG_MAX_SIZE) {
+		maximum = BLE_MSG_MAX_SIZE;
+	}
+
+	uint32_t start = millis();
+
+	uint8_t index;
+
+	while (packet.size < maximum) {
+
+		// Time to wait
+
+		uint32_t elapsed = (millis() - start);
+
+		if (elapsed >= mCoalescingDeadline) {
+			break;
+		}
+
+		// Next data
+
+		if (xQueuePeek(xQueueSendData, &index,
+				((mCoalescingDeadline - elapsed) / portTICK_PERIOD_MS)) != pdPASS) {
+			break; // Timeout
+		}
+
+		BleSendData_t& next = mSendPool[index];
+
+		if ((packet.size + next.size) > maximum) { // Not fit
+			break;
+		}
+
+		// Join it (and return its buffer to pool)
+
+		xQueueReceive(xQueueSendData, &index, 0);
+
+		memcpy(packet.data + packet.size, next.data, next.size);
+		packet.size += next.size;
+
+		if (packet.trace.task == NULL) { // Latency - only one by packet
+			packet.trace = next.trace;
+		}
+
+		bool flush = next.flush;
+
+		xQueueSend(xQueueSendFree, &index, 0);
+
+		portENTER_CRITICAL(&mSendStatsMux);
+		mSendStats.coalesced++;
+		portEXIT_CRITICAL(&mSendStatsMux);
+
+		if (flush) {
+			break;
+		}
+	}
+
+	// Delay added
+
+	uint32_t delay = (millis() - start);
+
+	if (delay > mSendStats.coalescedDelay) {
+		portENTER_CRITICAL(&mSendStatsMux);
+		mSendStats.coalescedDelay = delay;
+		portEXIT_CRITICAL(&mSendStatsMux);
+	}
+}
+
+/**
+* @brief Get a free buffer of pool to send, respecting the policy when all is in use
+*/
+static bool sendPoolGet(uint8_t& index) {
+
+	switch (mSendPolicy) {
+
+		case BLE_SEND_POLICY_DROP: // Drop the new data
+
+			return (xQueueReceive(xQueueSendFree, &index, 0) == pdPASS);
+
+		case BLE_SEND_POLICY_OVERWRITE: // Drop the oldest data (reuse its buffer)
+
+			for (;;) {
+
+				if (xQueueReceive(xQueueSendFree, &index, 0) == pdPASS) {
+					return true;
 				}
 
+				if (xQueueReceive(xQueueSendData, &index, 0) == pdPASS) {
+					portENTER_CRITICAL(&mSendStatsMux);
+					mSendStats.dropped++;
+					portEXIT_CRITICAL(&mSendStatsMux);
+					return true;
+				}
+
+				// All buffers in task to send - wait it returns one
+
+				if (xQueueReceive(xQueueSendFree, &index, 1) == pdPASS) {
+					return true;
+				}
+			}
+			break;
+
+		default: // Wait for space
+
+			return (xQueueReceive(xQueueSendFree, &index,
+								(BLE_TIMEOUT_QUEUE_SEND / portTICK_PERIOD_MS)) == pdPASS);
+	}
+
+	return false;
+}
+
+/**
+* @brief Clear the data to send (dropped) - the buffers in queue returns to pool
+*/
+static void sendPoolClear() {
+
+	if (xQueueSendData == NULL) {
+		return;
+	}
+
+	uint8_t index;
+
+	while (xQueueReceive(xQueueSendData, &index, 0) == pdPASS) {
+
+		xQueueSend(xQueueSendFree, &index, 0);
+
+		portENTER_CRITICAL(&mSendStatsMux);
+		mSendStats.dropped++;
+		portEXIT_CRITICAL(&mSendStatsMux);
+	}
+}
+
+/**
+* @brief Task for send data - waits if the BLE stack is congested
+*/
+static void send_Task(void *pvParameters) {
+
+	// Initialize
+
+	logI("Initializing ble send Task");
+
+	uint8_t index;
+
+	// Task loop
+
+	for (;;) {
+
+		// Wait for data to send (index of buffer of pool)
+
+		if (xQueueReceive(xQueueSendData, &index, portMAX_DELAY) != pdPASS) {
+			continue;
+		}
+
+		BleSendData_t& queueData = mSendPool[index];
+
+		// Coalescing - join the next data in same packet (while fit in MTU or until the deadline)
+
+		if (mCoalescingDeadline > 0 && !queueData.flush) {
+
+			sendCoalescing(queueData);
+		}
+
+		// Wait while the BLE stack is congested (notified by callback)
+
+		while (mCongested && mConnected) {
+
+			uint32_t notification;
+			xTaskNotifyWait(0, 0xffffffff, &notification, (100 / portTICK_PERIOD_MS));
+		}
+
+		// Send it
+
+		if (!mConnected) {
+			portENTER_CRITICAL(&mSendStatsMux);
+			mSendStats.failed++;
+			portEXIT_CRITICAL(&mSendStatsMux);
+			xQueueSend(xQueueSendFree, &index, 0);
+			continue;
+		}
+
+		sendBle(queueData.data, queueData.size);
+
+		// Latency (last part of a response)
+
+		if (queueData.trace.task != NULL) {
+			latencyRecord(queueData.trace);
+		}
+
+		// Return the buffer to pool
+
+		xQueueSend(xQueueSendFree, &index, 0);
+	}
+
+	////// End
+
+	// Delete this task
+
+	vTaskDelete(NULL);
+	xTaskSendHandle = NULL;
+}
+
+#endif
+
+#ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
+
+/**
+* @brief Remove the oldest line of queue of events, to reuse it (its buffer of pool returns to pool)
+* Only if the first event is a line (other events is never dropped)
+*/
+static bool dropOldestLine(uint8_t& index) {
+
+	BleEvent_t oldest;
+
+	if (xQueuePeek(xQueueEvents, &oldest, 0) != pdPASS || oldest.type != BLE_EVENT_LINE) {
+		return false;
+	}
+
+	if (xQueueReceive(xQueueEvents, &oldest, 0) != pdPASS) {
+		return false;
+	}
+
+	if (oldest.type != BLE_EVENT_LINE) { // Task got the line before - return this event
+		xQueueSendToFront(xQueueEvents, &oldest, 0);
+		return false;
+	}
+
+	index = oldest.index;
+
+	BleReceiveMessage_t& line = mReceiveLines[index];
+
+	if (line.buffer != BLE_RECV_NO_BUFFER) {
+		xQueueSend(xQueuePoolFree, &line.buffer, 0);
+		line.buffer = BLE_RECV_NO_BUFFER;
+	}
+
+	return true;
+}
+
+/**
+* @brief Get a line free to receive (and a buffer of pool, if large), respecting the policy when all is in use
+* Note: the lines dropped to get space is counted (but not the new line)
+*/
+static bool receiveGet(bool large, uint8_t& index) {
+
+	// Line
+
+	if (xQueueReceive(xQueueReceiveFree, &index, (BLE_TIMEOUT_QUEUE_RECV / portTICK_PERIOD_MS)) != pdPASS) {
+
+		if (mReceivePolicy != BLE_RECV_POLICY_DROP_OLDEST || !dropOldestLine(index)) {
+			return false;
+		}
+
+		mReceiveStats.dropped++;
+
+		logW("queue to receive is full - oldest line dropped");
+	}
+
+	BleReceiveMessage_t& line = mReceiveLines[index];
+
+	line.buffer = BLE_RECV_NO_BUFFER;
+	line.data = line.message;
+
+	if (!large) {
+		return true;
+	}
+
+	// Buffer of pool (shared by large lines) - if exhausted, waits the task frees one (backpressure)
+
+	uint8_t buffer;
+
+	if (xQueueReceive(xQueuePoolFree, &buffer, 0) != pdPASS) {
+
+		mReceiveStats.poolFull++;
+
+		bool got = (xQueueReceive(xQueuePoolFree, &buffer, (BLE_TIMEOUT_POOL_RECV / portTICK_PERIOD_MS)) == pdPASS);
+
+		// Drop the oldest lines, until a buffer is free
+
+		while (!got && mReceivePolicy == BLE_RECV_POLICY_DROP_OLDEST) {
+
+			uint8_t oldest;
+
+			if (!dropOldestLine(oldest)) {
+				break;
+			}
+
+			xQueueSend(xQueueReceiveFree, &oldest, 0);
+
+			mReceiveStats.dropped++;
+
+			logW("pool to receive is full - oldest line dropped");
+
+			got = (xQueueReceive(xQueuePoolFree, &buffer, 0) == pdPASS);
+		}
+
+		if (!got) {
+			xQueueSend(xQueueReceiveFree, &index, 0);
+			return false;
+		}
+	}
+
+	line.buffer = buffer;
+	line.data = mReceivePool[buffer];
+
+	return true;
+}
+
+/**
+* @brief Return a line (and its buffer of pool) - after processed
+*/
+static void receiveFree(uint8_t index) {
+
+	BleReceiveMessage_t& line = mReceiveLines[index];
+
+	if (line.buffer != BLE_RECV_NO_BUFFER) {
+		xQueueSend(xQueuePoolFree, &line.buffer, 0);
+		line.buffer = BLE_RECV_NO_BUFFER;
+	}
+
+	xQueueSend(xQueueReceiveFree, &index, 0);
+}
+
+#endif
+
+/**
+* @brief Process a line received (or frame decoded - in nn:payload format)
+*/
+static void processLine(const char* line, uint16_t size, uint32_t received) {
+
+#ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
+
+	// Add this to Message (necessary to task events not lose data) - 23/08/18
+	// Get a free buffer of pool, without block the BLE stack (this runs in its callback)
+
+	mReceiveStats.received++;
+
+	if (xQueueReceiveFree == NULL) {
+		logE("Message not created");
+		return;
+	}
+
+	if (size > BLE_LINE_MAX_SIZE) {
+		size = BLE_LINE_MAX_SIZE;
+		logW("size overflow");
+	}
+
+	// Get a line free (and a buffer of pool, if not is short) - or apply the policy
+
+	uint8_t index;
+
+	if (!receiveGet((size > BLE_RECV_SHORT_SIZE), index)) {
+
+		mReceiveStats.dropped++;
+
+		logW("queue to receive is full - line dropped");
+		return;
+	}
+
+	// High water mark (lines in use)
+
+	uint32_t inUse = (BLE_SIZE_QUEUE_RECV - uxQueueMessagesWaiting(xQueueReceiveFree));
+
+	if (inUse > mReceiveStats.highWater) {
+		mReceiveStats.highWater = inUse;
+	}
+
+	// Copy the line (only once)
+
+	BleReceiveMessage_t& queueMessage = mReceiveLines[index];
+
+	memcpy(queueMessage.data, line, size);
+	queueMessage.data[size] = '\0';
+	queueMessage.size = size;
+	queueMessage.received = received;
+	queueMessage.enqueued = micros();
+
+	// Send index of line to queue of events (have space for all lines)
+
+	if (!sendEvent(BLE_EVENT_LINE, index)) {
+
+		receiveFree(index);
+
+	} else {
+
+		logV("Message put on queue");
+	}
+
+#else // CPU 0 -> callback right here
+
+	mReceiveStats.received++;
+	mReceiveStats.processed++;
+
+	uint32_t now = micros();
+
+	latencyStart(line, size, received, now, now);
+
+	processEventReceive(line, size);
+
+	latencyEnd(); // No more traced (if not have response)
+#endif
+}
+
+/**
+* @brief Latency - start the trace of a message (before the callback)
+*/
+static void latencyStart(const char* line, uint16_t size, uint32_t received, uint32_t enqueued, uint32_t dequeued) {
+
+	// Code of message (nn:payload)
+
+	uint8_t code = 0;
+
+	if (size >= 2 && line[0] >= '0' && line[0] <= '9' && line[1] >= '0' && line[1] <= '9') {
+		code = ((line[0] - '0') * 10) + (line[1] - '0');
+	}
+
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+	portENTER_CRITICAL(&mLatencyMux);
+
+	// Slot of code, or a free slot (taken by this code), else the others (slot 0)
+
+	uint8_t slot = 0;
+
+	for (uint8_t i = 1; i < BLE_LATENCY_SLOTS && code > 0; i++) {
+
+		if (mLatencyCodes[i] == code) {
+			slot = i;
+			break;
+		}
+
+		if (mLatencyCodes[i] == 0) {
+			mLatencyCodes[i] = code;
+			slot = i;
+			break;
+		}
+	}
+
+	mLatencyTrace.slot = slot;
+	mLatencyTrace.received = received;
+	mLatencyTrace.enqueued = enqueued;
+	mLatencyTrace.dequeued = dequeued;
+	mLatencyTrace.task = task;
+
+	portEXIT_CRITICAL(&mLatencyMux);
+}
+
+/**
+* @brief Latency - end the trace of message (not have response or it is sended)
+*/
+static void latencyEnd() {
+
+	portENTER_CRITICAL(&mLatencyMux);
+	mLatencyTrace.task = NULL;
+	portEXIT_CRITICAL(&mLatencyMux);
+}
+
+/**
+* @brief Latency - the response of message in process is sended ?
+* Only the first sending of task that process it (the others are not responses)
+*/
+static bool latencyDispatch(BleLatencyTrace_t& trace) {
+
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	uint32_t now = micros();
+
+	bool traced = false;
+
+	portENTER_CRITICAL(&mLatencyMux);
+
+	if (mLatencyTrace.task != NULL && mLatencyTrace.task == task) {
+
+		trace = mLatencyTrace;
+		trace.dispatched = now;
+
+		mLatencyTrace.task = NULL;
+
+		traced = true;
+	}
+
+	portEXIT_CRITICAL(&mLatencyMux);
+
+	return traced;
+}
+
+/**
+* @brief Latency - add the times of stages of a message to histograms (the response is sended)
+*/
+static void latencyRecord(const BleLatencyTrace_t& trace) {
+
+	uint32_t sent = micros();
+
+	LatencyHistogram* histograms = mLatency[trace.slot];
+
+	portENTER_CRITICAL(&mLatencyMux);
+
+	histograms[BLE_LATENCY_STAGE_RECV].add(trace.enqueued - trace.received);
+	histograms[BLE_LATENCY_STAGE_QUEUE].add(trace.dequeued - trace.enqueued);
+	histograms[BLE_LATENCY_STAGE_PROCESS].add(trace.dispatched - trace.dequeued);
+	histograms[BLE_LATENCY_STAGE_SEND].add(sent - trace.dispatched);
+	histograms[BLE_LATENCY_STAGE_TOTAL].add(sent - trace.received);
+
+	portEXIT_CRITICAL(&mLatencyMux);
+}
+
+////// BLE callbacks from ble_uart_server
+
+extern "C" {
+
+/**
+* @brief Callback for connection
+*/
+static void bleCallbackConnection() { // @suppress("Unused static function")
+
+	// Disconnected -> returns to text mode (default)
+
+	if (!mTransport->clientConnected()) {
+
+		mBinaryMode = false;
+		mFrameDecoder.reset();
+
+		// Clear the data to send and the congestion
+		// (the data before, else the task to send wakes up and tries send all of it)
+
+#ifdef BLE_EVENTS_TASK_CPU
+		sendPoolClear();
+#endif
+
+		bleCallbackCongestion(false);
+	}
+
+	// Process this event
+
+#ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
+
+	// Send it to task (in queue of events, after lines already received)
+
+	sendState(true, mTransport->clientConnected());
+
 #else // CPU 0 -> callback right here
 
-				processEventReceive(mLineBuffer.c_str());
+	processEventConnection(mTransport->clientConnected());
+
 #endif
-				// Clear buffer
 
-				mLineBuffer = "";
+}
+
+/**
+* @brief Callback for congestion of BLE stack (true - congested, false - can send again)
+*/
+static void bleCallbackCongestion(bool congested) { // @suppress("Unused static function")
+
+	if (congested == mCongested) {
+		return;
+	}
+
+	mCongested = congested;
+
+	if (congested) { // Start
+
+		portENTER_CRITICAL(&mSendStatsMux);
+		mSendStats.congestions++;
+		portEXIT_CRITICAL(&mSendStatsMux);
+		mCongestedStart = millis();
+
+	} else { // End - notify the task to send the next data
+
+		uint32_t congestedTime = (millis() - mCongestedStart);
+
+		portENTER_CRITICAL(&mSendStatsMux);
+		mSendStats.congestedTime += congestedTime;
+		portEXIT_CRITICAL(&mSendStatsMux);
 
+#ifdef BLE_EVENTS_TASK_CPU
+		if (xTaskSendHandle != NULL) {
+			xTaskNotify (xTaskSendHandle, 1, eSetValueWithOverwrite);
+		}
+#endif
+	}
+}
+
+/**
+* @brief Callback for MTU changed by BLE client (mobile APP)
+*/
+static void bleCallbackMTU() { // @suppress("Unused static function")
+
+#ifdef BLE_EVENTS_TASK_CPU // Task for events on CPU 1
+
+	sendState(false, false);
+
+#else // CPU 0 -> right here
+
+	logI("BLE MTU changed to %d",mTransport->mtu());
+
+#endif
+
+}
+
+/**
+* @brief Received data via BLE notification
+*/
+static void bleCallbackReceiveData(char *data, uint16_t size) { // @suppress("Unused static function")
+
+	static uint32_t lastTime=0;// To control timeout of receving messages (lines)
+
+	uint32_t received = micros(); // Time of arrival (to latency of messages)
+
+	// Verify time of last receipt, if line buffer (or frame) is no empty
+
+	if ((mLineBuffer.pending() || mFrameDecoder.pending()) && 
+		(millis() - lastTime) >= BLE_TIMEOUT_RECV_LINE) {
+
+		// Timeout -> clear the buffer
+
+		logI("timeout - clear buffer");
+
+		mLineBuffer.reset();
+		mFrameDecoder.reset();
+
+	}
+
+	// Mark this time 
+
+	lastTime = millis();
+
+	// Binary mode -> decode frames (no search for new lines)
+
+	if (mBinaryMode) {
+
+		logV("BLE received [%d] (binary)", size);
+
+		const uint8_t* pos = (const uint8_t*) data;
+
+		while (size > 0) {
+
+			bool complete = false;
+
+			uint16_t processed = mFrameDecoder.feed(pos, size, complete);
+
+			pos += processed;
+			size -= processed;
+
+			if (complete) {
+				processLine(mFrameDecoder.message(), mFrameDecoder.messageSize(), received);
 			}
+		}
+
+		return;
+	}
 
-		} else if (character != '\r') { // Not for CR, for safe
+	// Received data via BLE server - by callback
 
-			// Concat character to buffer
+	logV("BLE received [%d] : %.*s", size, size, data);
+	
+	// Process the received data - lines (can be more than one, or a part of line)
 
-			mLineBuffer.append(1u, character);
+	while (size > 0) {
 
+		const char* line;
+		uint16_t sizeLine;
+
+		uint16_t processed = mLineBuffer.feed(data, size, line, sizeLine);
+
+		data += processed;
+		size -= processed;
+
+		if (line != NULL) { // Line complete
+
+			logD("BLE line message received: %.*s", sizeLine, line);
+
+			// Process this line
+
+			processLine(line, sizeLine, received);
 		}
 	}
+
+	mReceiveStats.overflows = mLineBuffer.overflows();
 }
 
 } // Extern "C"
@@ -20,6 +20,14 @@
 #include <string>
 using std::string;
 
+// Transports (BLE UART server or loopback)
+
+#include "ble_transport.h"
+
+// Histograms of latency
+
+#include "latency_histogram.h"
+
 ////// Defines
 
 //// BLE
@@ -51,17 +59,104 @@ using std::string;
 
 	#ifdef BLE_EVENTS_TASK_CPU
 
-		// Event (notifications) (for now only connection)
+		// Events to the task (one queue for all, so the order of events is kept)
+		// The changes of state (connection and MTU) is kept in flags, with only one event in queue for them
+		// (it is never lost - the queue have a slot reserved to it)
+
+		#define BLE_EVENT_STATE 		1	// State changed (connection or MTU)
+		#define BLE_EVENT_LINE 			4	// Line received (index of line)
+
+		// Lines received in queue (waiting or in process) - the queue have only indexes of lines
+		// Short lines (up to BLE_RECV_SHORT_SIZE) is kept in the line, the larger in a buffer of pool
+		// So the queue can be deeper than the pool, each buffer of pool uses BLE_LINE_MAX_SIZE bytes
+		// TODO: see it - change if you need
+
+		#define BLE_SIZE_QUEUE_RECV 8
+		#define BLE_SIZE_POOL_RECV 3
+		#define BLE_RECV_SHORT_SIZE 32
+
+		// Space in queue of events for the lines and the event of state (connection, MTU)
+
+		#define BLE_SIZE_QUEUE_EVENTS (BLE_SIZE_QUEUE_RECV + 1)
 
-		#define BLE_EVENT_CONNECTION 1
+		// Maximum time to wait a line free to receive (in millis)
+		// 0 is to not block the callback of BLE stack (runs in task of BT host)
 
-		// Queue to store data of receive messages
+		#define BLE_TIMEOUT_QUEUE_RECV 0
 
-		#define BLE_SIZE_QUEUE_RECV 3
+		// Maximum time to wait a buffer of pool free, if it is exhausted (in millis), before the policy
+		// It is a backpressure to client (the callback of BLE stack is blocked, while the task frees one)
+
+		#define BLE_TIMEOUT_POOL_RECV 100
+
+		// Pool of buffers to send (parts of messages, of MTU size), sended by a task
+		// The queue have only indexes of buffers (the part is copied once, to the buffer of pool)
+		// TODO: see it - change if you need
+
+		#define BLE_SIZE_QUEUE_SEND 10
+
+		// Maximum time to wait space in queue to send (policy BLE_SEND_POLICY_BLOCK) - in millis
+
+		#define BLE_TIMEOUT_QUEUE_SEND 1000
 
 	#endif
 #endif
 
+// Policies for queue to send full
+
+#define BLE_SEND_POLICY_DROP 		0	// Drop the new data
+#define BLE_SEND_POLICY_BLOCK		1	// Wait for space (until BLE_TIMEOUT_QUEUE_SEND), after drop the new data
+#define BLE_SEND_POLICY_OVERWRITE	2	// Drop the oldest data
+
+// Policies for queue to receive full (after BLE_TIMEOUT_QUEUE_RECV, or BLE_TIMEOUT_POOL_RECV to pool)
+
+#define BLE_RECV_POLICY_DROP_NEWEST	0	// Drop the new line
+#define BLE_RECV_POLICY_DROP_OLDEST	1	// Drop the oldest line not processed yet
+
+// Latency of messages - histograms by code of message and stage (micros)
+// Times: receive (callback of BLE) -> enqueue -> dequeue (task) -> dispatch (response sended by handler) -> send (BLE)
+// Note: only the message that have a response (in same task) is measured
+// Each code have its slot of histograms, taken on first message of code (slot 0 is the codes after all are taken)
+// TODO: see it - each slot have BLE_LATENCY_STAGES histograms (about 1 KB)
+
+#define BLE_LATENCY_SLOTS 			8
+
+#define BLE_LATENCY_STAGE_RECV 		0	// Receive -> enqueue (join of line or frame)
+#define BLE_LATENCY_STAGE_QUEUE 	1	// Enqueue -> dequeue (waiting the task)
+#define BLE_LATENCY_STAGE_PROCESS 	2	// Dequeue -> dispatch (handler of message)
+#define BLE_LATENCY_STAGE_SEND 		3	// Dispatch -> send (queue to send, congestion and parts)
+#define BLE_LATENCY_STAGE_TOTAL 	4	// Receive -> send
+#define BLE_LATENCY_STAGES 			5
+
+////// Types
+
+// Statistics of sending
+
+typedef struct {
+	uint32_t queued;			// Parts put in queue (or sended directly, without queue)
+	uint32_t sent;				// Parts sended
+	uint32_t bytes;				// Bytes sended (of parts sended)
+	uint32_t dropped;			// Parts dropped (queue full)
+	uint32_t failed;			// Parts failed (error of BLE stack or not connected)
+	uint32_t congestions;		// Number of congestions of BLE stack
+	uint32_t congestedTime;		// Time congested (millis)
+	uint32_t coalesced;			// Parts joined to another in same packet (packets saved)
+	uint32_t coalescedDelay;	// Maximum delay added by coalescing (millis)
+} BleSendStats_t;
+
+// Statistics of receiving (lines)
+
+typedef struct {
+	uint32_t received;			// Lines received
+	uint32_t processed;			// Lines processed (callback onReceive)
+	uint32_t dropped;			// Lines dropped (queue full)
+	uint32_t highWater;			// Maximum of lines in queue (waiting or in process)
+	uint32_t latencyTotal;		// Total of time in queue (millis) - average is latencyTotal / processed
+	uint32_t latencyMax;		// Maximum of time in queue (millis)
+	uint32_t overflows;			// Lines larger than the buffer (truncated)
+	uint32_t poolFull;			// Lines larger than short that found the pool exhausted (waited or dropped)
+} BleReceiveStats_t;
+
 ////// Classes
 
 class BleServer;
@@ -73,17 +168,27 @@ class BleServer
 {
 	public:
 
+		void setTransport(const BleTransport_t* transport);
 		void initialize(const char*, BleServerCallbacks*);
 		void finalize();
 		bool connected();
-		void send(const char*);
-		void send(string&);
+		void send(const char*, bool flush = false);
+		void send(const string&, bool flush = false);
+		void send(const char*, uint16_t size, bool flush = false);
+		void sendValues(uint8_t code, const char* prefix, const uint32_t* values, uint8_t count, bool flush = false);
 		const uint8_t* getMacAddress();
-
-	private:
-
-		void processEventConnection();
-		void processEventReceive();
+		uint16_t getMTU();
+		uint16_t getLineMax();
+		void setBinaryMode(bool binary, bool crc);
+		bool binaryMode();
+		void setSendPolicy(uint8_t policy);
+		void setCoalescing(uint16_t deadline);
+		BleSendStats_t getSendStats();
+		void setReceivePolicy(uint8_t policy);
+		const BleReceiveStats_t& getReceiveStats();
+		LatencyHistogram getLatency(uint8_t slot, uint8_t stage);
+		uint8_t getLatencyCode(uint8_t slot);
+		void resetLatency();
 };
 
 // Callbacks - based in Kolban BLE callback example code
@@ -94,7 +199,7 @@ public:
 	virtual ~BleServerCallbacks() {}
 	virtual void onConnect() = 0;
 	virtual void onDisconnect() = 0;
-	virtual void onReceive(const char* message) = 0;
+	virtual void onReceive(const char* message, uint16_t size) = 0;
 
 };
 
@@ -0,0 +1,57 @@
+/*
+ * ble_transport.h
+ */
+
+#ifndef UTIL_BLE_TRANSPORT_H_
+#define UTIL_BLE_TRANSPORT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///// Includes
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+////// Types
+
+// Transport used by BleServer - events of connection/disconnection, MTU, data received and congestion,
+// and sending of data (the routines of ble_uart_server is the default)
+// Note: set it with BleServer::setTransport, before the initialize
+
+typedef struct {
+	const char* name;																// Name (for logging)
+	esp_err_t (*initialize)(const char* deviceName);								// Initialize
+	esp_err_t (*finalize)();														// Finalize
+	void (*setCallbackConnection)(void (*callbackConnection)(), void (*callbackMTU)());	// Connection and MTU
+	void (*setCallbackReceiveData)(void (*callbackReceived)(char* data, uint16_t size));	// Data received
+	void (*setCallbackCongestion)(void (*callbackCongestion)(bool congested));		// Congestion
+	bool (*clientConnected)();														// Client is connected ?
+	esp_err_t (*sendData)(const char* data, uint16_t size);							// Send data
+	uint16_t (*mtu)();																// Actual MTU
+	const uint8_t* (*macAddress)();													// Mac address
+} BleTransport_t;
+
+////// Transports
+
+extern const BleTransport_t bleTransportUart;		// BLE UART server - see ble_uart_server.c
+extern const BleTransport_t bleTransportLoopback;	// Loopback (memory) - see ble_loopback.c
+
+////// Prototypes of loopback - the client side
+
+void ble_loopback_Connect(uint16_t mtu);
+void ble_loopback_Disconnect();
+esp_err_t ble_loopback_Write(const char* data, uint16_t size);
+void ble_loopback_SetCongested(bool congested);
+void ble_loopback_SetCallbackClient(void (*callbackClient)(const char* data, uint16_t size));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UTIL_BLE_TRANSPORT_H_ */
+
+//////// End
@@ -7,6 +7,10 @@
  * ------- 	-------- 	-------------------------
  * 0.1.0 	01/08/18 	First version
  * 0.3.0  	23/08/18	Adjustments to allow sizes of BLE > 255
+ * 0.3.1  	17/10/26	Callback for congestion (ESP_GATTS_CONGEST_EVT)
+ * 						Transport to BleServer (see ble_transport.h)
+ * 						Prepared writes (long write) in RX, with attribute up to 512 bytes
+ * 						Write without response in RX (no ATT round trip for each write)
  */
 
 #include <stdio.h>
@@ -33,6 +37,7 @@
 #include "sdkconfig.h"
 
 #include "ble_uart_server.h"
+#include "ble_transport.h"
 
 ////// Variables
 
@@ -41,13 +46,21 @@ static const char* TAG = "ble_uart_server";							// Log tag
 static void (*mCallbackConnection)();								// Callback for connection/disconnection
 static void (*mCallbackMTU)();										// Callback for MTU change detect
 static void (*mCallbackReceivedData) (char *data, uint16_t size); 	// Callback for receive data
+static void (*mCallbackCongestion) (bool congested); 				// Callback for congestion change
 static esp_gatt_if_t mGatts_if = ESP_GATT_IF_NONE;					// To save gatts_if
 
 static bool mConnected = false;										// Connected ?
+static bool mCongested = false;										// Congested ? (BLE stack is full)
 static char mDeviceName[30];										// Device name
 static uint16_t mMTU = 20;											// MTU of BLE data
 static const uint8_t* mMacAddress;										// Mac address
 
+// Prepared writes (long write) of RX characteristic - joined here, delivered on execute
+
+static uint8_t mPrepareBuffer[GATTS_ATTR_VAL_LEN_MAX];				// Buffer (preallocated)
+static uint16_t mPrepareSize = 0;									// Size of data prepared
+static bool mPrepareError = false;									// Error in a part (discard it on execute)
+
 ////// Prototypes
 
 // Private
@@ -76,15 +89,18 @@ static void descr2_read_handler(esp_gatts_cb_event_t event,
 static void descr2_write_handler(esp_gatts_cb_event_t event,
 		esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t * param);
 
+static void char1_prepare_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t * param);
+static void char1_exec_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t * param);
+
 ////// Routines based on the pbcreflux example
 
-static uint8_t char1_str[GATTS_CHAR_VAL_LEN_MAX] = { 0x11, 0x22, 0x33 };
+static uint8_t char1_str[GATTS_ATTR_VAL_LEN_MAX] = { 0x11, 0x22, 0x33 };
 static uint8_t char2_str[GATTS_CHAR_VAL_LEN_MAX] = { 0x11, 0x22, 0x33 };
 static uint8_t descr1_str[GATTS_CHAR_VAL_LEN_MAX] = { 0x00, 0x00 };
 static uint8_t descr2_str[GATTS_CHAR_VAL_LEN_MAX] = "ESP32_BLE_UART";
 
 static esp_attr_value_t gatts_demo_char1_val = { .attr_max_len =
-		GATTS_CHAR_VAL_LEN_MAX, .attr_len = sizeof(char1_str), .attr_value =
+		GATTS_ATTR_VAL_LEN_MAX, .attr_len = 3, .attr_value =
 		char1_str, };
 
 static esp_attr_value_t gatts_demo_char2_val = { .attr_max_len =
@@ -169,6 +185,7 @@ static struct gatts_char_inst gl_char[GATTS_CHAR_NUM] = { {
 				0xE0, 0x93, 0xF3, 0xA3, 0xB5, 0x02, 0x00, 0x40, 0x6E },
 		.char_perm = ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, .char_property =
 				ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE
+						| ESP_GATT_CHAR_PROP_BIT_WRITE_NR // Changed - write without response too
 						| ESP_GATT_CHAR_PROP_BIT_NOTIFY, .char_val =
 				&gatts_demo_char1_val, .char_control = NULL, .char_handle = 0,
 		.char_read_callback = char1_read_handler, .char_write_callback =
@@ -288,10 +305,32 @@ static void char1_write_handler(esp_gatts_cb_event_t event,
 		esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
 	ble_logD("char1_write_handler %d", param->write.handle);
 
+	// Original code changed here !
+
+	// Prepared write (long write) - the parts is joined, and delivered on execute
+
+	if (param->write.is_prep) {
+		char1_prepare_write(gatts_if, param);
+		return;
+	}
+
+	// Write without response (command) - fast path: no response and no copy to attribute
+	// So the client not waits a round trip for each write
+
+	if (!param->write.need_rsp) {
+
+		if (param->write.len > 0 && mCallbackReceivedData != NULL) {
+
+			mCallbackReceivedData((char*) param->write.value, param->write.len);
+		}
+		return;
+	}
+
 	if (gl_char[0].char_val != NULL) {
 		ble_logD("char1_write_handler char_val %d",param->write.len);
-		gl_char[0].char_val->attr_len = param->write.len;
-		for (uint32_t pos = 0; pos < param->write.len; pos++) {
+		gl_char[0].char_val->attr_len = (param->write.len <= gl_char[0].char_val->attr_max_len) ?
+				param->write.len : gl_char[0].char_val->attr_max_len;
+		for (uint32_t pos = 0; pos < gl_char[0].char_val->attr_len; pos++) {
 			gl_char[0].char_val->attr_value[pos] = param->write.value[pos];
 		} ble_logD("char1_write_handler %.*s", gl_char[0].char_val->attr_len, (char*)gl_char[0].char_val->attr_value);
 	} ble_logD(" char1_write_handler esp_gatt_rsp_t");
@@ -309,11 +348,96 @@ static void char1_write_handler(esp_gatts_cb_event_t event,
 		if (mCallbackReceivedData != NULL) {
 
 			mCallbackReceivedData((char*) gl_char[0].char_val->attr_value,
-					(uint8_t) gl_char[0].char_val->attr_len);
+					(uint16_t) gl_char[0].char_val->attr_len);
+		}
+	}
+}
+
+/**
+* @brief Prepared write of RX characteristic - join the part in buffer (delivered on execute)
+*/
+static void char1_prepare_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
+
+	ble_logD("char1_prepare_write offset %d len %d", param->write.offset, param->write.len);
+
+	// Check it
+
+	esp_gatt_status_t status = ESP_GATT_OK;
+
+	if (param->write.offset > GATTS_ATTR_VAL_LEN_MAX) {
+		status = ESP_GATT_INVALID_OFFSET;
+	} else if ((param->write.offset + param->write.len) > GATTS_ATTR_VAL_LEN_MAX) {
+		status = ESP_GATT_INVALID_ATTR_LEN;
+	}
+
+	if (status == ESP_GATT_OK && !mPrepareError) {
+
+		// Join it
+
+		memcpy(mPrepareBuffer + param->write.offset, param->write.value, param->write.len);
+
+		if ((param->write.offset + param->write.len) > mPrepareSize) {
+			mPrepareSize = (param->write.offset + param->write.len);
 		}
+
+	} else {
+
+		ble_logE("invalid prepared write - offset %d len %d", param->write.offset, param->write.len);
+
+		mPrepareError = true; // Discard all on execute
+	}
+
+	// Response (the value is returned to client, to it verify)
+
+	if (param->write.need_rsp) {
+
+		esp_gatt_rsp_t rsp;
+		memset(&rsp, 0, sizeof(esp_gatt_rsp_t));
+		rsp.attr_value.handle = param->write.handle;
+		rsp.attr_value.offset = param->write.offset;
+		rsp.attr_value.len = param->write.len;
+		rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+		memcpy(rsp.attr_value.value, param->write.value, param->write.len);
+
+		esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
+				param->write.trans_id, status, &rsp);
 	}
 }
 
+/**
+* @brief Execute (or cancel) the prepared writes - deliver the data joined to callback
+*/
+static void char1_exec_write(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
+
+	ble_logD("char1_exec_write flag %d size %d", param->exec_write.exec_write_flag, mPrepareSize);
+
+	esp_ble_gatts_send_response(gatts_if, param->exec_write.conn_id,
+			param->exec_write.trans_id, ESP_GATT_OK, NULL);
+
+	if (param->exec_write.exec_write_flag == ESP_GATT_PREP_WRITE_EXEC &&
+			!mPrepareError && mPrepareSize > 0) {
+
+		// Value of characteristic
+
+		if (gl_char[0].char_val != NULL) {
+			memcpy(gl_char[0].char_val->attr_value, mPrepareBuffer, mPrepareSize);
+			gl_char[0].char_val->attr_len = mPrepareSize;
+		}
+
+		// Callback for receive data (all in one)
+
+		if (mCallbackReceivedData != NULL) {
+
+			mCallbackReceivedData((char*) mPrepareBuffer, mPrepareSize);
+		}
+	}
+
+	// Clear it
+
+	mPrepareSize = 0;
+	mPrepareError = false;
+}
+
 static void char2_write_handler(esp_gatts_cb_event_t event,
 		esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
 	ble_logD("char2_write_handler %d", param->write.handle);
@@ -559,6 +683,13 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
 
 		break;
 	case ESP_GATTS_EXEC_WRITE_EVT:
+
+		// Original code changed here ! (only the RX characteristic has prepared writes)
+
+		ble_logD("ESP_GATTS_EXEC_WRITE_EVT, conn_id %d, trans_id %d", param->exec_write.conn_id, param->exec_write.trans_id);
+
+		char1_exec_write(gatts_if, param);
+		break;
 //	case ESP_GATTS_MTU_EVT:
 	case ESP_GATTS_CONF_EVT:
 	case ESP_GATTS_UNREG_EVT:
@@ -653,7 +784,10 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
 
 		mGatts_if = ESP_GATT_IF_NONE;
 		mConnected = false;
+		mCongested = false;
 		mMTU = 20;
+		mPrepareSize = 0;
+		mPrepareError = false;
 
 		// Callback for connection
 
@@ -662,12 +796,27 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
 			mCallbackConnection();
 		}
 
+		break;
+	case ESP_GATTS_CONGEST_EVT:
+
+		// Original code changed here !
+
+		ble_logD("ESP_GATTS_CONGEST_EVT, congested %d", param->congest.congested);
+
+		mCongested = param->congest.congested;
+
+		// Callback for congestion (to wait for send more)
+
+		if (mCallbackCongestion != NULL) {
+
+			mCallbackCongestion(mCongested);
+		}
+
 		break;
 	case ESP_GATTS_OPEN_EVT:
 	case ESP_GATTS_CANCEL_OPEN_EVT:
 	case ESP_GATTS_CLOSE_EVT:
 	case ESP_GATTS_LISTEN_EVT:
-	case ESP_GATTS_CONGEST_EVT:
 	default:
 		break;
 	}
@@ -823,6 +972,22 @@ void ble_uart_server_SetCallbackReceiveData(void (*callbackReceived) (char* data
 	mCallbackReceivedData = callbackReceived;
 }
 
+/**
+* @brief Set callback to congestion (true - congested, false - can send again)
+*/
+void ble_uart_server_SetCallbackCongestion(void (*callbackCongestion) (bool congested)) {
+
+	mCallbackCongestion = callbackCongestion;
+}
+
+/**
+* @brief Is the BLE stack congested? (not send more data until it is cleared)
+*/
+bool ble_uart_server_Congested () {
+
+	return mCongested;
+}
+
 /**
 * @brief Is a client connected to UART server?
 */
@@ -838,7 +1003,7 @@ bool ble_uart_server_ClientConnected () {
 */
 esp_err_t ble_uart_server_SendData(const char* data, uint16_t size) {
 
-	ble_logD ("data [%d] : %s", size, data);
+	ble_logD ("data [%d] : %.*s", size, size, data);
 
 	// Connected?
 
@@ -853,18 +1018,13 @@ esp_err_t ble_uart_server_SendData(const char* data, uint16_t size) {
 		size = GATTS_CHAR_VAL_LEN_MAX;
 	}
 
-	// Copy the data
-
-	char send [GATTS_CHAR_VAL_LEN_MAX + 1];
-	memset (send, 0, GATTS_CHAR_VAL_LEN_MAX + 1);
-	strncpy (send, data, (size_t) size);
-
 	// Send data via BLE notification
+	// Note: no copy here, the stack copies it (binary frames can have zeros, so not use strings)
 
 	ble_logD("if %d conn %d handle %d", mGatts_if, 0 , gl_char[1].char_handle);
 
 	return esp_ble_gatts_send_indicate(mGatts_if, 0, gl_char[1].char_handle,
-			size, (uint8_t *) send, false);
+			size, (uint8_t *) data, false);
 
 }
 
@@ -888,4 +1048,19 @@ const uint8_t* ble_uart_server_MacAddress() {
 
 }
 
+////// Transport (default of BleServer)
+
+const BleTransport_t bleTransportUart = {
+	"ble_uart_server",
+	ble_uart_server_Initialize,
+	ble_uart_server_Finalize,
+	ble_uart_server_SetCallbackConnection,
+	ble_uart_server_SetCallbackReceiveData,
+	ble_uart_server_SetCallbackCongestion,
+	ble_uart_server_ClientConnected,
+	ble_uart_server_SendData,
+	ble_uart_server_MTU,
+	ble_uart_server_MacAddress
+};
+
 //////// End
@@ -26,6 +26,11 @@ extern "C" {
 //#define GATTS_CHAR_VAL_LEN_MAX	22
 #define GATTS_CHAR_VAL_LEN_MAX		185 - 5 // Changed maximum to avoid split of messages ( - 5 is for safe)
 
+// Maximum size of the RX characteristic (writes of client) - maximum of attributes of ATT
+// Writes larger than MTU is received by prepared writes (long write), joined and delivered on execute
+
+#define GATTS_ATTR_VAL_LEN_MAX		512
+
 #define BLE_PROFILE_APP_ID 0
 
 //#define BLE_TX_POWER ESP_PWR_LVL_N14 // Power TX lowerest -14db -- comment it to default 
@@ -55,6 +60,9 @@ void ble_uart_server_SetCallbackConnection(void (*callbackConnection)(),
 bool ble_uart_server_ClientConnected();
 void ble_uart_server_SetCallbackReceiveData(
 		void (*callbackReceived)(char* data, uint16_t size));
+void ble_uart_server_SetCallbackCongestion(
+		void (*callbackCongestion)(bool congested));
+bool ble_uart_server_Congested();
 esp_err_t ble_uart_server_SendData(const char* data, uint16_t size);
 uint16_t ble_uart_server_MTU();
 const uint8_t* ble_uart_server_MacAddress();
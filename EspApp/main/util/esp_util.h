@@ -78,8 +78,21 @@ class Esp_Util
 
 #ifndef ARDUINO // To ESP-IDF code
 
+// Time source - can be defined before, to use another clock
+// (ex: a virtual clock, to run hours of timeouts in a simulation)
+// Note: the modules with timeouts (scheduler, line_reassembler, ble_frame) not depends of FreeRTOS
+
+#ifndef delay
 #define delay(n) vTaskDelay(n / portTICK_PERIOD_MS)
+#endif
+
+#ifndef millis
 #define millis() (uint32_t)(esp_timer_get_time() / 1000)
+#endif
+
+#ifndef micros
+#define micros() (uint32_t)(esp_timer_get_time())
+#endif
 
 #endif
 
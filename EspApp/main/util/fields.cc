@@ -6,6 +6,10 @@
  * Versions  :
  * ------- 	-------- 	-------------------------
  * 0.1.0 	01/08/18 	First version
+ * 0.3.1 	17/10/26 	FieldsView - fields without copy or heap (offset/size of each field)
+ * 0.3.2 	17/10/26 	Fields with storage per instance (reentrant, no more static vector)
+ * 0.3.3 	17/10/26 	Fields by a FieldsView of your copy of string
+ * 						More fields than FIELDS_MAX is a parse failure (valid), no more only a log
  */
 
 
@@ -13,15 +17,17 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 
 #include <string>
-#include <vector>
 
 using namespace std;
 
 // Utilities
 
-#include"esp_util.h"
+#include "log.h"
 
 // This
 
@@ -33,116 +39,268 @@ using namespace std;
 
 static const char* TAG = "fields";
 
-////// Vector
+////// Class Fields
 
-static vector <string> fields;
+/**
+* @brief Fields C++ class constructor
+* Each instance has a copy of string and yours fields,
+* so can be used in more than one task at same time
+*/
+Fields::Fields(const string& str, const string& delimiter) :
+	mStr(str),
+	mView(mStr.c_str(), mStr.size(), delimiter.c_str()) {
 
-// Utils
+}
+
+/**
+* @brief Fields C++ class destructor
+*/
+Fields::~Fields()
+{
+	// Nothing to do - storage is of this instance
 
-static Esp_Util& Util = Esp_Util::getInstance();
+}
 
-////// Class
+/////// Methods
 
 /**
-* @brief Fields C++ class constructor
+* @brief Parsed without overflow of fields ?
 */
-Fields::Fields(const string& str, const string& delimiter) {
+bool Fields::valid() {
 
-	// Process the string and populate a vector with this fields
+	return mView.valid();
+}
 
-	fields.clear();
+/**
+* @brief Return the size of fields
+*/
+uint8_t Fields::size() {
 
-	// Split
+	return mView.size();
+}
+
+/**
+* @brief Get field type string
+*/
+string Fields::getString(uint8_t fieldNum) {
+
+	return mView.getString(fieldNum).toString();
+}
+
+/**
+* @brief Get field type char
+*/
+char Fields::getChar(uint8_t fieldNum) {
 
-	Util.strSplit(fields, str, delimiter);
+	return mView.getChar(fieldNum);
+}
 
-//	for (int i = 0; i< fields.size(); i++)
-//		logV("Test field %u = %s\n", i, fields[i].c_str());
+/**
+* @brief Returns if the contents is numeric or not
+*/
+bool Fields::isNum(uint8_t fieldNum) {
 
+	return mView.isNum(fieldNum);
 }
 
 /**
-* @brief Fields C++ class destructor
+* @brief Get field type int
 */
-Fields::~Fields()
-{
-	// Clear the vector 
+int32_t Fields::getInt(uint8_t fieldNum) {
 
-	fields.clear();
+	return mView.getInt(fieldNum);
+}
 
+/**
+* @brief Get field type float
+*/
+float Fields::getFloat(uint8_t fieldNum) {
+
+	return mView.getFloat(fieldNum);
 }
 
-/////// Methods
+////// Class FieldsView
 
 /**
-* @brief Return the size of fields load in vector
+* @brief FieldsView C++ class constructor
+* Only marks the offset and size of each field (no copy, no heap)
 */
-uint8_t Fields::size() {
+FieldsView::FieldsView(const char* str, uint16_t length, char delimiter) {
+
+	const char delimiters[2] = { delimiter, '\0' };
 
-	return fields.size();
+	split(str, length, delimiters);
 }
 
 /**
-* @brief Get field type string
+* @brief FieldsView C++ class constructor - for more than one delimiter (any of them)
 */
-string Fields::getString(uint8_t fieldNum) {
+FieldsView::FieldsView(const char* str, uint16_t length, const char* delimiters) {
+
+	split(str, length, delimiters);
+}
 
-	if (fieldNum > 0 && fieldNum <= fields.size()) {
-		return fields[fieldNum - 1];
+/**
+* @brief Split the string - marks the offset and size of each field
+* Note: empty fields are ignored (as old Esp_Util::strSplit)
+*/
+void FieldsView::split(const char* str, uint16_t length, const char* delimiters) {
+
+	mStr = str;
+	mValid = true;
+	mSize = 0;
+
+	bool oneDelimiter = (delimiters[0] != '\0' && delimiters[1] == '\0');
+
+	uint16_t pos = 0;
+
+	while (pos < length) {
+
+		// Skip delimiters
+
+		if (isDelimiter(str[pos], delimiters)) {
+			pos++;
+			continue;
+		}
+
+		// Find the end of this field
+
+		uint16_t stop = pos;
+
+		if (oneDelimiter) { // Fast way
+
+			const char* end = (const char*) memchr(str + pos, delimiters[0], length - pos);
+
+			stop = (end != NULL) ? (uint16_t)(end - str) : length;
+
+		} else {
+
+			while (stop < length && !isDelimiter(str[stop], delimiters)) {
+				stop++;
+			}
+		}
+
+		// Overflow ? (parse failure - the caller must reject it)
+
+		if (mSize == FIELDS_MAX) {
+			logW("too many fields (max=%u)", FIELDS_MAX);
+			mValid = false;
+			break;
+		}
+
+		// Add it
+
+		mFields[mSize].offset = pos;
+		mFields[mSize].length = stop - pos;
+		mSize++;
+
+		pos = stop;
+	}
+}
+
+/**
+* @brief Is this char a delimiter ?
+*/
+bool FieldsView::isDelimiter(char c, const char* delimiters) {
+
+	return (c != '\0' && strchr(delimiters, c) != NULL);
+}
+
+/**
+* @brief Get field type string (a view of original string, no copy)
+*/
+StrView FieldsView::getString(uint8_t fieldNum) const {
+
+	if (fieldNum > 0 && fieldNum <= mSize) {
+		const FieldSpan_t& field = mFields[fieldNum - 1];
+		return StrView(mStr + field.offset, field.length);
 	} else {
-		return "";
+		return StrView();
 	}
 }
 
 /**
 * @brief Get field type char
 */
-char Fields::getChar(uint8_t fieldNum) {
+char FieldsView::getChar(uint8_t fieldNum) const {
 
-	if (fieldNum > 0 && fieldNum <= fields.size()) {
-		return fields[fieldNum - 1][0];
+	if (fieldNum > 0 && fieldNum <= mSize) {
+		return mStr[mFields[fieldNum - 1].offset];
 	} else {
 		return '\0';
 	}
-
 }
 
 /**
-* @brief Returns if the contents is numeric or not
+* @brief Returns if the contents is numeric or not (same rule of Esp_Util::strIsNum)
 */
-bool Fields::isNum(uint8_t fieldNum) {
+bool FieldsView::isNum(uint8_t fieldNum) const {
 
-	if (fieldNum > 0 && fieldNum <= fields.size()) {
-		return Util.strIsNum(fields[fieldNum - 1]);
-	} else {
+	if (fieldNum == 0 || fieldNum > mSize) {
 		return false;
 	}
+
+	const FieldSpan_t& field = mFields[fieldNum - 1];
+
+	for (uint16_t i = 0; i < field.length; i++) {
+		char c = mStr[field.offset + i];
+		if (!(isdigit(c) || c == '+' || c == '.' || c == '-')) {
+			return false;
+		}
+	}
+
+	return (field.length > 0);
 }
 
 /**
-* @brief Get field type int 
+* @brief Get field type int (parsed in place, as atoi)
 */
-int32_t Fields::getInt(uint8_t fieldNum) {
+int32_t FieldsView::getInt(uint8_t fieldNum) const {
 
-	if (fieldNum > 0 && fieldNum <= fields.size()) {
-		return Util.strToInt(fields[fieldNum - 1]);
-	} else {
+	if (!isNum(fieldNum)) {
 		return 0;
 	}
 
+	const FieldSpan_t& field = mFields[fieldNum - 1];
+
+	const char* str = mStr + field.offset;
+	uint16_t pos = 0;
+	bool negative = false;
+
+	if (str[0] == '+' || str[0] == '-') {
+		negative = (str[0] == '-');
+		pos++;
+	}
+
+	int32_t value = 0;
+
+	for (; pos < field.length && isdigit(str[pos]); pos++) {
+		value = (value * 10) + (str[pos] - '0');
+	}
+
+	return (negative) ? -value : value;
 }
 
 /**
 * @brief Get field type float
 */
-float Fields::getFloat(uint8_t fieldNum) {
+float FieldsView::getFloat(uint8_t fieldNum) const {
 
-	if (fieldNum > 0 && fieldNum <= fields.size()) {
-		return Util.strToFloat(fields[fieldNum - 1]);
-	} else {
+	if (!isNum(fieldNum)) {
 		return 0.0f;
 	}
 
+	// Copy to stack, due atof needs a terminator
+
+	const FieldSpan_t& field = mFields[fieldNum - 1];
+
+	char aux[24];
+	uint16_t size = (field.length < sizeof(aux)) ? field.length : sizeof(aux) - 1;
+
+	memcpy(aux, mStr + field.offset, size);
+	aux[size] = '\0';
+
+	return atof(aux);
 }
 
-//////// End
\ No newline at end of file
+//////// End
@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include <string>
 
@@ -16,8 +17,87 @@ using namespace std;
 
 ////// Definitions
 
+// Maximum of fields processed by FieldsView and Fields (fixed array, per instance)
+// More fields than it is a parse failure (valid returns false)
+// TODO: see it - change if you need
+
+#define FIELDS_MAX 16
+
 ///// Class
 
+// View of a part of string (pointer and size) - not copy the contents
+
+class StrView
+{
+	public:
+
+		StrView() : mData(""), mSize(0) {}
+		StrView(const char* data, uint16_t size) : mData(data), mSize(size) {}
+
+		const char* data() const { return mData; }
+		uint16_t size() const { return mSize; }
+		bool empty() const { return (mSize == 0); }
+		char operator[](uint16_t pos) const { return mData[pos]; }
+
+		bool operator==(const char* str) const {
+			return (strlen(str) == mSize && memcmp(mData, str, mSize) == 0);
+		}
+		bool operator!=(const char* str) const {
+			return !(*this == str);
+		}
+
+		string toString() const { return string(mData, mSize); }
+
+	private:
+
+		const char* mData;
+		uint16_t mSize;
+};
+
+// Fields without copy (only offset and size of each field in the original string)
+// Note: the original string must be alive while this is used
+// Note: if the string have more than FIELDS_MAX fields, valid returns false (only the first ones are processed)
+
+class FieldsView
+{
+	public:
+
+		// Constructors
+
+		FieldsView(const char* str, uint16_t length, char delimiter = ':');
+		FieldsView(const char* str, uint16_t length, const char* delimiters);
+
+		// Methods
+
+		bool valid() const { return mValid; }
+		uint8_t size() const { return mSize; }
+		StrView getString(uint8_t fieldNum) const;
+		char getChar(uint8_t fieldNum) const;
+		bool isNum(uint8_t fieldNum) const;
+		int32_t getInt(uint8_t fieldNum) const;
+		float getFloat(uint8_t fieldNum) const;
+
+	private:
+
+		void split(const char* str, uint16_t length, const char* delimiters);
+		static bool isDelimiter(char c, const char* delimiters);
+
+		// Span of field in the original string
+
+		typedef struct {
+			uint16_t offset;
+			uint16_t length;
+		} FieldSpan_t;
+
+		const char* mStr;
+		bool mValid;
+		uint8_t mSize;
+		FieldSpan_t mFields[FIELDS_MAX];
+};
+
+// Fields with storage per instance (copy of string + FieldsView of this copy)
+// Note: can be used by more than one task at same time (each one with yours instance)
+
 class Fields
 {
 	public:
@@ -29,6 +109,7 @@ class Fields
 
 		// Methods
 
+		bool valid();
 		uint8_t size();
 	    string getString(uint8_t fieldNum);
 	    char getChar(uint8_t fieldNum);
@@ -36,8 +117,17 @@ class Fields
 	    int32_t getInt(uint8_t fieldNum);
 	    float getFloat(uint8_t fieldNum);
 
+	private:
+
+		// Not copyable (the view points to the string of this instance)
+
+		Fields(const Fields&);
+		Fields& operator=(const Fields&);
+
+		string mStr;		// Copy of string
+		FieldsView mView;	// Fields of this copy
 };
 
 #endif /* UTIL_FIELDS_H_ */
 
-//////// End
\ No newline at end of file
+//////// End
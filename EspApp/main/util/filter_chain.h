@@ -0,0 +1,233 @@
+/*****************************************
+ * Project   : util - Utilities to esp-idf
+ * Programmer: Joao Lopes
+ * Module    : filter_chain - chain of filters of samples, composed in compile time
+ * Comments  : Each stage have process(in, out), that returns false if no output for this sample
+ *             (ex: decimation), so the next stages is not called
+ *             The stages is members of chain (no heap, no virtual), the calls can be inlined
+ *             Stages: median (running), EMA, decimation and hysteresis
+ *             Ex: FilterChain<uint16_t, MedianStage<uint16_t, 7>, EmaStage<uint16_t, 2> >
+ * Versions:
+ * ------ 	-------- 	-------------------------
+ * 0.3.1  	17/10/26	First version
+ * 0.3.2  	17/10/26	Hysteresis not reads the last output before the first sample
+ *****************************************/
+
+#ifndef UTIL_FILTER_CHAIN_H_
+#define UTIL_FILTER_CHAIN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "median_filter.h"
+
+////// Stages
+
+/**
+ * @brief Stage - running median of the last samples (window of _size)
+ */
+template<typename T, unsigned int _size>
+class MedianStage {
+public:
+
+	void reset() {
+
+		_filter.reset();
+	}
+
+	bool process(T in, T& out) {
+
+		_filter.push(in);
+
+		return _filter.getMedian(out);
+	}
+
+private:
+
+	RunningMedian<T, _size> _filter;
+};
+
+/**
+ * @brief Stage - exponential moving average, with alpha = 1 / 2^_shift (integers, no divisions)
+ */
+template<typename T, uint8_t _shift>
+class EmaStage {
+public:
+
+	EmaStage() {
+
+		reset();
+	}
+
+	void reset() {
+
+		_sum = 0;
+		_first = true;
+	}
+
+	bool process(T in, T& out) {
+
+		if (_first) { // Starts with the first sample
+			_sum = ((typename MedianSum<T>::type) in << _shift);
+			_first = false;
+		} else {
+			_sum = _sum - (_sum >> _shift) + in;
+		}
+
+		out = (T) (_sum >> _shift);
+		return true;
+	}
+
+private:
+
+	typename MedianSum<T>::type _sum;	// Average * 2^_shift
+	bool _first;						// First sample ?
+};
+
+/**
+ * @brief Stage - decimation, outputs one of each _factor samples
+ */
+template<typename T, unsigned int _factor>
+class DecimateStage {
+public:
+
+	DecimateStage() {
+
+		reset();
+	}
+
+	void reset() {
+
+		_count = 0;
+	}
+
+	bool process(T in, T& out) {
+
+		if (++_count < _factor) {
+			return false;
+		}
+
+		_count = 0;
+
+		out = in;
+		return true;
+	}
+
+private:
+
+	unsigned int _count;	// Samples since last output
+};
+
+/**
+ * @brief Stage - hysteresis, the output only changes if the difference is greater than _band
+ */
+template<typename T, T _band>
+class HysteresisStage {
+public:
+
+	HysteresisStage() {
+
+		reset();
+	}
+
+	void reset() {
+
+		_first = true;
+	}
+
+	bool process(T in, T& out) {
+
+		if (_first) { // Starts with the first sample (_last is not valid yet)
+
+			_last = in;
+			_first = false;
+
+		} else {
+
+			T diff = (in > _last) ? (in - _last) : (_last - in);
+
+			if (diff > _band) {
+				_last = in;
+			}
+		}
+
+		out = _last;
+		return true;
+	}
+
+private:
+
+	T _last;		// Last output
+	bool _first;	// First sample ?
+};
+
+////// Chain
+
+// Chain of stages - the output of a stage is the input of next
+
+template<typename T, typename... _stages>
+class FilterChain;
+
+// End of chain
+
+template<typename T>
+class FilterChain<T> {
+public:
+
+	void reset() {
+	}
+
+	bool process(T in, T& out) {
+
+		out = in;
+		return true;
+	}
+};
+
+// A stage and the rest of chain
+
+template<typename T, typename _first, typename... _rest>
+class FilterChain<T, _first, _rest...> {
+public:
+
+	/**
+	 * @brief Clear the state of all stages
+	 */
+	void reset() {
+
+		_stage.reset();
+		_next.reset();
+	}
+
+	/**
+	 * @brief Process a sample - returns false if no output (ex: decimation)
+	 */
+	bool process(T in, T& out) {
+
+		T value;
+
+		if (!_stage.process(in, value)) {
+			return false;
+		}
+
+		return _next.process(value, out);
+	}
+
+private:
+
+	_first _stage;						// This stage
+	FilterChain<T, _rest...> _next;		// Next stages
+};
+
+/**
+ * @brief Process by a chain (static object) - to use as a pointer to function (ex: tables of channels)
+ */
+template<typename _chain, _chain* _object, typename T>
+bool filterChainProcess(T in, T& out) {
+
+	return _object->process(in, out);
+}
+
+#endif /* UTIL_FILTER_CHAIN_H_ */
+
+//////// End
@@ -0,0 +1,167 @@
+/*****************************************
+ * Project   : util - Utilities to esp-idf
+ * Programmer: Joao Lopes
+ * Module    : latency_histogram - histogram log-linear of latencies (micros)
+ * Comments  : Buckets by power of 2, each one divided in 4 linear parts (error < 25%)
+ *             Fixed size (no heap), counts saturated in 16 bits
+ * Versions:
+ * ------ 	-------- 	-------------------------
+ * 0.3.1  	17/10/26	First version
+ *****************************************/
+
+#ifndef UTIL_LATENCY_HISTOGRAM_H_
+#define UTIL_LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+////// Definitions
+
+#define LATENCY_SUB_BITS 	2								// Linear parts by power of 2 (4)
+#define LATENCY_MAX_BIT 	23								// Maximum value (2^24 micros - about 16 secs)
+#define LATENCY_BUCKETS 	((LATENCY_MAX_BIT) << LATENCY_SUB_BITS)	// Number of buckets
+
+////// Class
+
+class LatencyHistogram {
+public:
+
+	// Constructor
+
+	LatencyHistogram() {
+		reset();
+	}
+
+	/**
+	 * @brief Clear the histogram
+	 */
+	void reset() {
+
+		memset(_buckets, 0, sizeof(_buckets));
+		_count = 0;
+		_max = 0;
+	}
+
+	/**
+	 * @brief Add a value (micros)
+	 */
+	void add(uint32_t value) {
+
+		uint16_t index = bucket(value);
+
+		if (_buckets[index] < 0xFFFF) { // Saturated
+			_buckets[index]++;
+		}
+
+		_count++;
+
+		if (value > _max) {
+			_max = value;
+		}
+	}
+
+	/**
+	 * @brief Number of values
+	 */
+	uint32_t count() const {
+
+		return _count;
+	}
+
+	/**
+	 * @brief Maximum value
+	 */
+	uint32_t max() const {
+
+		return _max;
+	}
+
+	/**
+	 * @brief Count of the bucket
+	 */
+	uint16_t countOf(uint16_t index) const {
+
+		return _buckets[index];
+	}
+
+	/**
+	 * @brief Lower value of the bucket
+	 */
+	static uint32_t lower(uint16_t index) {
+
+		const uint16_t subs = (1 << LATENCY_SUB_BITS);
+
+		if (index < subs) { // Linear
+			return index;
+		}
+
+		uint16_t group = (index >> LATENCY_SUB_BITS);
+		uint16_t sub = (index & (subs - 1));
+
+		return ((uint32_t)(subs + sub) << (group - 1));
+	}
+
+	/**
+	 * @brief Percentile (lower value of the bucket that have it) - percent in tenths (ex: 999 is 99.9%)
+	 */
+	uint32_t percentile(uint16_t tenths) const {
+
+		uint32_t total = 0;
+
+		for (uint16_t i = 0; i < LATENCY_BUCKETS; i++) {
+			total += _buckets[i];
+		}
+
+		if (total == 0) {
+			return 0;
+		}
+
+		uint32_t target = ((uint64_t) total * tenths + 999) / 1000;
+		uint32_t sum = 0;
+
+		for (uint16_t i = 0; i < LATENCY_BUCKETS; i++) {
+
+			sum += _buckets[i];
+
+			if (sum >= target) {
+				return lower(i);
+			}
+		}
+
+		return _max;
+	}
+
+private:
+
+	uint16_t _buckets[LATENCY_BUCKETS];	// Counts by bucket
+	uint32_t _count;					// Number of values
+	uint32_t _max;						// Maximum value
+
+	/**
+	 * @brief Bucket of a value
+	 */
+	static uint16_t bucket(uint32_t value) {
+
+		const uint16_t subs = (1 << LATENCY_SUB_BITS);
+
+		if (value < subs) { // Linear
+			return value;
+		}
+
+		uint8_t msb = (31 - __builtin_clz(value));
+
+		if (msb > LATENCY_MAX_BIT) { // Overflow - last bucket
+			return (LATENCY_BUCKETS - 1);
+		}
+
+		uint16_t group = (msb - LATENCY_SUB_BITS + 1);
+		uint16_t sub = ((value >> (msb - LATENCY_SUB_BITS)) & (subs - 1));
+
+		return ((group << LATENCY_SUB_BITS) + sub);
+	}
+};
+
+#endif /* UTIL_LATENCY_HISTOGRAM_H_ */
+
+//////// End
@@ -0,0 +1,165 @@
+/*****************************************
+ * Project   : util - Utilities to esp-idf
+ * Programmer: Joao Lopes
+ * Module    : line_reassembler - join the lines of text received in parts (BLE packets)
+ * Comments  : Fixed buffer (no heap), the new lines is searched by memchr
+ *             Lines complete in the received data is returned without copy
+ *             Only parts of lines (splitted in packets) is copied to buffer
+ * Versions:
+ * ------ 	-------- 	-------------------------
+ * 0.3.1  	17/10/26	First version
+ * 0.3.2  	17/10/26	Removes all CR of line (copy only if the line have it)
+ *****************************************/
+
+#ifndef UTIL_LINE_REASSEMBLER_H_
+#define UTIL_LINE_REASSEMBLER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+template<uint16_t _size>
+class LineReassembler {
+public:
+
+	// Constructor
+
+	LineReassembler() : _length(0), _overflow(false), _overflows(0) {
+	}
+
+	/**
+	 * @brief Clear the line (part received)
+	 */
+	void reset() {
+
+		_length = 0;
+		_overflow = false;
+	}
+
+	/**
+	 * @brief Have a part of line received ?
+	 */
+	bool pending() const {
+
+		return (_length > 0);
+	}
+
+	/**
+	 * @brief Number of lines larger than the buffer (truncated)
+	 */
+	uint32_t overflows() const {
+
+		return _overflows;
+	}
+
+	/**
+	 * @brief Process the received data
+	 * Returns the bytes processed, and if one line is complete, returns it in line and size
+	 * (the line is valid only until the next call, and not have the terminator)
+	 * Call it again with the rest of data, until all data is processed
+	 */
+	uint16_t feed(const char* data, uint16_t size, const char*& line, uint16_t& lineSize) {
+
+		line = NULL;
+		lineSize = 0;
+
+		// Search the new line
+
+		const char* end = (const char*) memchr(data, '\n', size);
+
+		if (end == NULL) { // Not complete - save this part
+
+			append(data, size);
+			return size;
+		}
+
+		uint16_t count = (end - data);
+
+		if (_length == 0) { // Complete line in data - no copy
+
+			line = data;
+			lineSize = count;
+
+		} else { // End of line splitted
+
+			append(data, count);
+
+			line = _buffer;
+			lineSize = _length;
+
+			if (_overflow) {
+				_overflows++;
+			}
+
+			_length = 0; // Buffer is valid until next call
+			_overflow = false;
+		}
+
+		// Remove the CRs (for safe) - copied only if the line have it
+
+		if (lineSize > 0 && memchr(line, '\r', lineSize) != NULL) {
+			removeCR(line, lineSize);
+		}
+
+		// Empty line ?
+
+		if (lineSize == 0) {
+			line = NULL;
+		}
+
+		return (count + 1);
+	}
+
+private:
+
+	char _buffer[_size + 1]; 	// The buffer of parts of line
+	uint16_t _length;			// Length of part of line received
+	bool _overflow;				// Line larger than buffer ?
+	uint32_t _overflows;		// Number of lines truncated
+
+	/**
+	 * @brief Remove the CRs of line - to the buffer (or in place, if the line is in buffer)
+	 */
+	void removeCR(const char*& line, uint16_t& lineSize) {
+
+		uint16_t size = 0;
+
+		for (uint16_t i = 0; i < lineSize; i++) {
+
+			if (line[i] == '\r') {
+				continue;
+			}
+
+			if (size == _size) { // Line without CR larger than buffer - truncated
+				_overflows++;
+				break;
+			}
+
+			_buffer[size++] = line[i];
+		}
+
+		_buffer[size] = '\0';
+
+		line = _buffer;
+		lineSize = size;
+	}
+
+	/**
+	 * @brief Append data to buffer (truncates if it is full)
+	 */
+	void append(const char* data, uint16_t size) {
+
+		if (size > (_size - _length)) {
+			size = (_size - _length);
+			_overflow = true;
+		}
+
+		memcpy(_buffer + _length, data, size);
+		_length += size;
+		_buffer[_length] = '\0';
+	}
+};
+
+#endif /* UTIL_LINE_REASSEMBLER_H_ */
+
+//////// End
@@ -6,16 +6,132 @@
  * Versions:
  * ------ 	-------- 	-------------------------
  * 0.1.0  	01/08/18	First version
+ * 0.3.1  	17/10/26	Running median (RunningMedian) - window of last samples, sorted incrementally
+ * 						Sorting networks (no branches by data) to small windows
+ * 						Average and median by selection (no full sort) to large windows
+ * 						Sums in a wider type (MedianSum), no more overflow
+ * 0.3.2  	17/10/26	Comb sort removed (the windows larger than networks use only the selection)
+ * 						Sorting networks only up to 7 samples (generic network is slower than selection)
  *****************************************/
 
 #ifndef MAIN_UTIL_MEDIAN_FILTER_H_
 #define MAIN_UTIL_MEDIAN_FILTER_H_
 
+#include <stdint.h>
+
 /*
  Based on ArduinoMedianFilter by Rustam Iskenderov
  High performance and low memory usage sorting algorithm for running median filter.
  */
 
+////// Definitions
+
+// Maximum size of window to sort by sorting networks (larger windows use the selection)
+// Note: only the optimal networks (up to 7) are faster than the selection (see host/bench/bench_median.cc)
+
+#define MEDIAN_NETWORK_MAX 7
+
+////// Types
+
+// Type of sums of samples (to averages) - wider than sample, to not overflow
+
+template<typename T> struct MedianSum { typedef T type; }; // Others (ex: float)
+template<> struct MedianSum<uint8_t> { typedef uint32_t type; };
+template<> struct MedianSum<int8_t> { typedef int32_t type; };
+template<> struct MedianSum<uint16_t> { typedef uint32_t type; };
+template<> struct MedianSum<int16_t> { typedef int32_t type; };
+template<> struct MedianSum<uint32_t> { typedef uint64_t type; };
+template<> struct MedianSum<int32_t> { typedef int64_t type; };
+template<> struct MedianSum<float> { typedef double type; };
+
+////// Sorting networks
+// A fixed sequence of compare and swap (min/max), the same for any data - no branches to predict
+
+/**
+ * @brief Compare and swap - a gets the minimum and b the maximum
+ */
+template<typename T>
+inline void medianSwap(T& a, T& b) {
+
+	T low = (b < a) ? b : a;
+	T high = (b < a) ? a : b;
+
+	a = low;
+	b = high;
+}
+
+/**
+ * @brief Sorting network - generic (Batcher's odd-even merge sort, to any size)
+ * Note: the loops depends only of size (compile time), so the compiler can unroll it
+ */
+template<typename T, unsigned int _size>
+struct MedianNetwork {
+
+	static void sort(T* a) {
+
+		for (unsigned int p = 1; p < _size; p <<= 1) {
+			for (unsigned int k = p; k >= 1; k >>= 1) {
+				for (unsigned int j = (k % p); (j + k) < _size; j += (2 * k)) {
+					for (unsigned int i = 0; i < k && (i + j + k) < _size; i++) {
+						if (((i + j) / (2 * p)) == ((i + j + k) / (2 * p))) {
+							medianSwap(a[i + j], a[i + j + k]);
+						}
+					}
+				}
+			}
+		}
+	}
+};
+
+/**
+ * @brief Sorting network - 3 samples (optimal: 3 compare and swap)
+ */
+template<typename T>
+struct MedianNetwork<T, 3> {
+
+	static void sort(T* a) {
+
+		medianSwap(a[0], a[2]);
+		medianSwap(a[0], a[1]);
+		medianSwap(a[1], a[2]);
+	}
+};
+
+/**
+ * @brief Sorting network - 5 samples (optimal: 9 compare and swap)
+ */
+template<typename T>
+struct MedianNetwork<T, 5> {
+
+	static void sort(T* a) {
+
+		medianSwap(a[0], a[3]); medianSwap(a[1], a[4]);
+		medianSwap(a[0], a[2]); medianSwap(a[1], a[3]);
+		medianSwap(a[0], a[1]); medianSwap(a[2], a[4]);
+		medianSwap(a[1], a[2]); medianSwap(a[3], a[4]);
+		medianSwap(a[2], a[3]);
+	}
+};
+
+/**
+ * @brief Sorting network - 7 samples (optimal: 16 compare and swap) - default of ADC readings
+ */
+template<typename T>
+struct MedianNetwork<T, 7> {
+
+	static void sort(T* a) {
+
+		medianSwap(a[0], a[6]); medianSwap(a[2], a[3]); medianSwap(a[4], a[5]);
+		medianSwap(a[0], a[2]); medianSwap(a[1], a[4]); medianSwap(a[3], a[6]);
+		medianSwap(a[0], a[1]); medianSwap(a[2], a[5]); medianSwap(a[3], a[4]);
+		medianSwap(a[1], a[2]); medianSwap(a[4], a[6]);
+		medianSwap(a[2], a[3]); medianSwap(a[4], a[5]);
+		medianSwap(a[1], a[2]); medianSwap(a[3], a[4]); medianSwap(a[5], a[6]);
+	}
+};
+
+////// Class
+
 template<typename T, unsigned int _size>
 class MedianFilter {
 public:
@@ -39,14 +155,21 @@ public:
 	*/
 	bool getMedian(T& value) {
 
-		sort();
+		if (_size <= MEDIAN_NETWORK_MAX) { // Small window - sort it (by network)
+
+			sort();
+
+		} else { // Selection of the central sample only
+
+			select(0, _size - 1, _size / 2);
+		}
 
 		value = _buffer[_size / 2];
 		return true;
 	}
 
 	/**
- 	* @brief Get the average
+ 	* @brief Get the average (of the central samples - trimmed mean)
 	*/
 	bool getAverage(unsigned int samples, T &value) {
 
@@ -57,13 +180,24 @@ public:
 			unsigned int start = (_size - samples) / 2;
 			unsigned int end = start + samples;
 
-			sort();
+			if (_size <= MEDIAN_NETWORK_MAX) { // Small window - sort it (by network)
+
+				sort();
 
-			T sum = 0;
+			} else { // Selection of the first and last central samples (the others are between them)
+
+				select(0, _size - 1, start);
+
+				if ((end - 1) > start) {
+					select(start + 1, _size - 1, end - 1);
+				}
+			}
+
+			typename MedianSum<T>::type sum = 0;
 			for (unsigned int i = start; i < end; ++i) {
 				sum += _buffer[i];
 			}
-			value = sum / samples;
+			value = (T) (sum / samples);
 
 			return true;
 		}
@@ -76,30 +210,210 @@ private:
 	T _buffer[_size]; // The buffer
 
 	/**
- 	* @brief Sort the buffer 
+	 * @brief Selection (quickselect) - put in position k the sample that is there if sorted,
+	 * with the samples before not greater and the samples after not less (between left and right)
+	 * Linear in average, with pivot by median of three
+	 */
+	void select(int left, int right, int k) {
+
+		while (right > left) {
+
+			// Pivot - median of three (left, middle and right)
+
+			int middle = left + ((right - left) / 2);
+
+			medianSwap(_buffer[left], _buffer[middle]);
+			medianSwap(_buffer[left], _buffer[right]);
+			medianSwap(_buffer[middle], _buffer[right]);
+
+			T pivot = _buffer[middle];
+
+			// Partition
+
+			int i = left;
+			int j = right;
+
+			while (i <= j) {
+
+				while (_buffer[i] < pivot) i++;
+				while (pivot < _buffer[j]) j--;
+
+				if (i <= j) {
+
+					T tmp = _buffer[i];
+					_buffer[i] = _buffer[j];
+					_buffer[j] = tmp;
+
+					i++;
+					j--;
+				}
+			}
+
+			// Continue in the part that have k
+
+			if (k <= j) {
+				right = j;
+			} else if (k >= i) {
+				left = i;
+			} else {
+				return; // Between the parts - is the pivot
+			}
+		}
+	}
+
+	/**
+ 	* @brief Sort the buffer (by sorting network) - only to small windows (up to MEDIAN_NETWORK_MAX)
 	*/
 	void sort() {
 
-		unsigned int gap = _size;
-		unsigned int swapped = true;
+		MedianNetwork<T, _size>::sort(_buffer);
+	}
+};
+
+////// Class - running median
+// A running window of the last samples (no need to set all), to filter a stream (ex: ADC readings)
+// The window is kept sorted: each sample is inserted by binary search, and the oldest is removed
+// So the median is O(1), and not need sort all for each sample
+
+template<typename T, unsigned int _size>
+class RunningMedian {
+public:
 
-		while (gap > 1 || swapped == true) {
-			gap = (gap * 10) / 13;
+	// Constructor
 
-			if (gap < 1)
-				gap = 1;
+	RunningMedian() {
 
-			swapped = false;
+		reset();
+	}
 
-			for (unsigned int i = 0; i < _size - gap; ++i) {
-				if (_buffer[i] > _buffer[i + gap]) {
-					T tmp = _buffer[i];
-					_buffer[i] = _buffer[i + gap];
-					_buffer[i + gap] = tmp;
-					swapped = true;
+	/**
+	 * @brief Clear the window
+	 */
+	void reset() {
+
+		_count = 0;
+		_next = 0;
+	}
+
+	/**
+	 * @brief Add a sample to window - the oldest is removed, if the window is full
+	 */
+	void push(T value) {
+
+		unsigned int insert = lowerBound(value, _count);
+
+		if (_count == _size) {
+
+			// Window full - remove the oldest (it is in the position of new sample, in ring)
+
+			unsigned int removed = lowerBound(_window[_next], _count);
+
+			if (insert > removed) { // Shift to left, between them
+
+				insert--;
+
+				for (unsigned int i = removed; i < insert; i++) {
+					_sorted[i] = _sorted[i + 1];
 				}
+
+			} else { // Shift to right, between them
+
+				for (unsigned int i = removed; i > insert; i--) {
+					_sorted[i] = _sorted[i - 1];
+				}
+			}
+
+		} else {
+
+			// Shift to right, after the position
+
+			for (unsigned int i = _count; i > insert; i--) {
+				_sorted[i] = _sorted[i - 1];
+			}
+
+			_count++;
+		}
+
+		_sorted[insert] = value;
+
+		// Ring of samples (order of arrival)
+
+		_window[_next] = value;
+		_next = (_next + 1) % _size;
+	}
+
+	/**
+	 * @brief Number of samples in window
+	 */
+	unsigned int count() const {
+
+		return _count;
+	}
+
+	/**
+	 * @brief Get the median of window
+	 */
+	bool getMedian(T& value) const {
+
+		if (_count == 0) {
+			return false;
+		}
+
+		value = _sorted[_count / 2];
+		return true;
+	}
+
+	/**
+	 * @brief Get the average of the central samples of window (trimmed mean) - no sort is needed
+	 */
+	bool getAverage(unsigned int samples, T& value) const {
+
+		if (samples == 0 || _count == 0) {
+			return false;
+		}
+
+		if (_count < samples)
+			samples = _count;
+
+		unsigned int start = (_count - samples) / 2;
+		unsigned int end = start + samples;
+
+		typename MedianSum<T>::type sum = 0;
+		for (unsigned int i = start; i < end; ++i) {
+			sum += _sorted[i];
+		}
+		value = (T) (sum / samples);
+
+		return true;
+	}
+
+private:
+
+	T _window[_size];		// Samples in order of arrival (ring)
+	T _sorted[_size];		// Samples sorted
+	unsigned int _count;	// Number of samples in window
+	unsigned int _next;		// Next position in ring (the oldest, if full)
+
+	/**
+	 * @brief Position of first sample sorted not less than value (binary search)
+	 */
+	unsigned int lowerBound(T value, unsigned int count) const {
+
+		unsigned int low = 0;
+		unsigned int high = count;
+
+		while (low < high) {
+
+			unsigned int middle = (low + high) / 2;
+
+			if (_sorted[middle] < value) {
+				low = middle + 1;
+			} else {
+				high = middle;
 			}
 		}
+
+		return low;
 	}
 };
 
@@ -0,0 +1,81 @@
+/*****************************************
+ * Project   : util - Utilities to esp-idf
+ * Programmer: Joao Lopes
+ * Module    : msg_table - table of handlers of BLE messages, by code
+ * Comments  : Dense table (code 0-99), so the lookup is direct (no switch or search)
+ * Versions  :
+ * ------- 	-------- 	-------------------------
+ * 0.3.1 	17/10/26 	First version
+ */
+
+///// Includes
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// This
+
+#include "msg_table.h"
+
+////// Variables
+
+// Table of messages - indexed by code
+// Note: is static (zeroed before any constructor), to registers can be done by static variables
+
+static MsgEntry_t mMsgTable[MSG_CODE_MAX + 1];
+
+////// Class
+
+/**
+* @brief Register message code - constructor (to use in static variables)
+*/
+MsgRegister::MsgRegister(uint8_t code, MsgHandler_t handler,
+		MsgPostAction_t postAction, uint8_t flags) {
+
+	msgRegister(code, handler, postAction, flags);
+}
+
+////// Routines
+
+/**
+* @brief Register a message code in the table
+* Returns false if the code is invalid or already registered
+* Note: no logging here, due can be called before app_main
+*/
+bool msgRegister(uint8_t code, MsgHandler_t handler,
+		MsgPostAction_t postAction, uint8_t flags) {
+
+	if (code == 0 || code > MSG_CODE_MAX) {
+		return false;
+	}
+
+	MsgEntry_t& entry = mMsgTable[code];
+
+	if (entry.registered) {
+		return false;
+	}
+
+	entry.registered = true;
+	entry.handler = handler;
+	entry.postAction = postAction;
+	entry.flags = flags;
+
+	return true;
+}
+
+/**
+* @brief Get the entry of message code (NULL if not registered)
+*/
+const MsgEntry_t* msgLookup(uint8_t code) {
+
+	if (code > MSG_CODE_MAX) {
+		return NULL;
+	}
+
+	const MsgEntry_t& entry = mMsgTable[code];
+
+	return (entry.registered) ? &entry : NULL;
+}
+
+//////// End
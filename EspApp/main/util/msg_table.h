@@ -0,0 +1,73 @@
+/*
+ * msg_table.h
+ */
+
+#ifndef UTIL_MSG_TABLE_H_
+#define UTIL_MSG_TABLE_H_
+
+///// Includes
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string>
+
+using namespace std;
+
+// Utilities
+
+#include "fields.h"
+
+////// Definitions
+
+// Maximum code of messages (format is nn:payload, so 2 digits)
+
+#define MSG_CODE_MAX 99
+
+// Flags of messages
+
+#define MSG_FLAG_NONE 		0x00
+#define MSG_FLAG_FEEDBACK 	0x01	// Considers the message received as feedback also
+#define MSG_FLAG_NEED_APP 	0x02	// Only process it if the App is connected (message 01 received)
+#define MSG_FLAG_ENERGY 	0x04	// Send the energy status after the response (if have battery)
+
+// Handler of message (field 1 is the code) - put the return to mobile app in response
+
+typedef void (*MsgHandler_t)(const char* message, uint16_t size, FieldsView& fields, string& response);
+
+// Action to do after the response sended
+
+typedef void (*MsgPostAction_t)();
+
+// Entry of table of messages
+
+typedef struct {
+	bool registered;			// Code registered ?
+	MsgHandler_t handler;		// Handler (can be NULL, if only flags is needed)
+	MsgPostAction_t postAction;	// After response sended (can be NULL)
+	uint8_t flags;				// Flags MSG_FLAG_*
+} MsgEntry_t;
+
+////// Classes
+
+// Register a message code in table
+// Use it as static variable in any module, no need to edit main.cc
+// (the table is static, so it is ready before the constructors of modules)
+
+class MsgRegister
+{
+	public:
+
+		MsgRegister(uint8_t code, MsgHandler_t handler,
+				MsgPostAction_t postAction = NULL, uint8_t flags = MSG_FLAG_FEEDBACK);
+};
+
+////// Prototypes
+
+extern bool msgRegister(uint8_t code, MsgHandler_t handler,
+		MsgPostAction_t postAction = NULL, uint8_t flags = MSG_FLAG_FEEDBACK);
+extern const MsgEntry_t* msgLookup(uint8_t code);
+
+#endif /* UTIL_MSG_TABLE_H_ */
+
+//////// End
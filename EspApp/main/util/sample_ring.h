@@ -0,0 +1,95 @@
+/*****************************************
+ * Project   : util - Utilities to esp-idf
+ * Programmer: Joao Lopes
+ * Module    : sample_ring - ring buffer of samples, lock-free (one producer and one consumer)
+ * Comments  : Fixed size (power of 2, no heap), the producer can be a timer or ISR
+ *             and the consumer a task, without mutex or critical sections
+ *             No dependencies of FreeRTOS (can run in host too)
+ * Versions:
+ * ------ 	-------- 	-------------------------
+ * 0.3.1  	17/10/26	First version
+ *****************************************/
+
+#ifndef UTIL_SAMPLE_RING_H_
+#define UTIL_SAMPLE_RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+template<typename T, uint16_t _size>
+class SampleRing {
+public:
+
+	// Constructor
+
+	SampleRing() : _head(0), _tail(0), _dropped(0) {
+
+		static_assert((_size & (_size - 1)) == 0, "size of ring must be power of 2");
+	}
+
+	/**
+	 * @brief Put a sample (only by the producer) - returns false if full (sample dropped)
+	 */
+	bool push(T value) {
+
+		uint32_t head = _head;
+		uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+
+		if ((head - tail) >= _size) { // Full
+			_dropped++;
+			return false;
+		}
+
+		_buffer[head & (_size - 1)] = value;
+
+		__atomic_store_n(&_head, head + 1, __ATOMIC_RELEASE); // Publish it after the sample
+
+		return true;
+	}
+
+	/**
+	 * @brief Get the oldest sample (only by the consumer) - returns false if empty
+	 */
+	bool pop(T& value) {
+
+		uint32_t tail = _tail;
+		uint32_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+
+		if (head == tail) { // Empty
+			return false;
+		}
+
+		value = _buffer[tail & (_size - 1)];
+
+		__atomic_store_n(&_tail, tail + 1, __ATOMIC_RELEASE); // Free the position after read it
+
+		return true;
+	}
+
+	/**
+	 * @brief Number of samples in ring
+	 */
+	uint16_t count() const {
+
+		return (uint16_t)(__atomic_load_n(&_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE));
+	}
+
+	/**
+	 * @brief Number of samples dropped (ring full)
+	 */
+	uint32_t dropped() const {
+
+		return _dropped;
+	}
+
+private:
+
+	T _buffer[_size];		// Samples
+	uint32_t _head;			// Position to put (only changed by producer)
+	uint32_t _tail;			// Position to get (only changed by consumer)
+	uint32_t _dropped;		// Samples dropped (only changed by producer)
+};
+
+#endif /* UTIL_SAMPLE_RING_H_ */
+
+//////// End
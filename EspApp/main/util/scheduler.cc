@@ -0,0 +1,302 @@
+/*****************************************
+ * Project   : util - Utilities to esp-idf
+ * Programmer: Joao Lopes
+ * Module    : scheduler - jobs (one-shot or periodic) by a timer wheel
+ * Comments  : Portable (the time is passed by caller), no heap
+ *             The caller sleeps until the deadline returned by run
+ * Versions  :
+ * ------- 	-------- 	-------------------------
+ * 0.3.1 	17/10/26 	First version
+ * 0.3.2 	17/10/26 	Deadlines of add and restart from the time passed (not of last run)
+ * 						Run jumps to the next deadline (not visits each tick elapsed)
+ */
+
+///// Includes
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// This
+
+#include "scheduler.h"
+
+////// Class Scheduler
+
+/**
+* @brief Constructor
+*/
+Scheduler::Scheduler() {
+
+	for (uint8_t i = 0; i < SCHEDULER_JOBS_MAX; i++) {
+		mJobs[i].active = false;
+		mJobs[i].due = false;
+		mJobs[i].deadline = 0;
+	}
+
+	for (uint8_t i = 0; i < SCHEDULER_SLOTS; i++) {
+		mSlots[i] = SCHEDULER_NONE;
+	}
+
+	mTick = 0;
+	mLastTime = 0;
+}
+
+/**
+* @brief Begin the time of scheduler (call it before add jobs)
+*/
+void Scheduler::begin(uint32_t now) {
+
+	mLastTime = now;
+}
+
+/**
+* @brief Add a job, to run after delay (millis) of now, and after each period, if it is not 0
+* Returns the id of job (or SCHEDULER_NONE, if not have space)
+*/
+int8_t Scheduler::add(uint32_t now, SchedulerJob_t job, uint32_t delay, uint32_t period, void* arg) {
+
+	for (int8_t id = 0; id < SCHEDULER_JOBS_MAX; id++) {
+
+		if (!mJobs[id].active) {
+
+			mJobs[id].job = job;
+			mJobs[id].arg = arg;
+			mJobs[id].period = ticks(period);
+			mJobs[id].active = true;
+
+			restart(now, id, delay);
+
+			return id;
+		}
+	}
+
+	return SCHEDULER_NONE;
+}
+
+/**
+* @brief Schedule the job again, to run after delay (millis) of now
+* Note: the current tick can be old (the caller sleeps between runs), so the deadline is by now
+*/
+bool Scheduler::restart(uint32_t now, int8_t id, uint32_t delay) {
+
+	if (!active(id)) {
+		return false;
+	}
+
+	remove(id);
+
+	uint32_t delayTicks = ticks(delay);
+
+	if (delayTicks == 0) { // Next tick (the current is already processed)
+		delayTicks = 1;
+	}
+
+	mJobs[id].deadline = tickOf(now) + delayTicks;
+	mJobs[id].due = false;
+
+	insert(id);
+
+	return true;
+}
+
+/**
+* @brief Cancel the job
+*/
+void Scheduler::cancel(int8_t id) {
+
+	if (!active(id)) {
+		return;
+	}
+
+	remove(id);
+
+	mJobs[id].active = false;
+	mJobs[id].due = false;
+}
+
+/**
+* @brief Job is scheduled ?
+*/
+bool Scheduler::active(int8_t id) const {
+
+	return (id >= 0 && id < SCHEDULER_JOBS_MAX && mJobs[id].active);
+}
+
+/**
+* @brief Run the jobs with deadline reached
+* Returns the time (millis) to the next deadline (to sleep until it)
+*/
+uint32_t Scheduler::run(uint32_t now) {
+
+	// Ticks elapsed (by difference, so the overflow of millis is not a problem)
+
+	uint32_t elapsed = (now - mLastTime) / SCHEDULER_TICK_MS;
+
+	// Process only the ticks with deadlines (jumps the others)
+
+	while (elapsed > 0) {
+
+		// Next deadline (it can be changed by the jobs called)
+
+		uint32_t jump = nearest();
+
+		if (jump == SCHEDULER_NO_DEADLINE || jump > elapsed) { // None until now
+			jump = elapsed;
+		} else if (jump == 0) { // Deadlines is always after the current tick, but never loop
+			jump = 1;
+		}
+
+		mTick += jump;
+		mLastTime += (jump * SCHEDULER_TICK_MS); // Time of this tick (to jobs that add or restart)
+
+		elapsed -= jump;
+
+		// Jobs of this slot with deadline reached
+		// First mark all, after calls it, due the routines can change the jobs
+
+		int8_t due[SCHEDULER_JOBS_MAX];
+		uint8_t count = 0;
+
+		int8_t id = mSlots[mTick % SCHEDULER_SLOTS];
+
+		while (id != SCHEDULER_NONE) {
+
+			int8_t next = mJobs[id].next;
+
+			if ((int32_t)(mTick - mJobs[id].deadline) >= 0) {
+
+				remove(id);
+
+				if (mJobs[id].period > 0) { // Periodic - next deadline (no drift)
+
+					mJobs[id].deadline += mJobs[id].period;
+
+					if ((int32_t)(mTick - mJobs[id].deadline) >= 0) { // Late - run on next tick
+						mJobs[id].deadline = mTick + 1;
+					}
+
+					insert(id);
+				}
+
+				mJobs[id].due = true;
+				due[count++] = id;
+			}
+
+			id = next;
+		}
+
+		// Call the jobs (if not cancelled or restarted by previous)
+
+		for (uint8_t j = 0; j < count; j++) {
+
+			Job_t& job = mJobs[due[j]];
+
+			if (!job.active || !job.due) {
+				continue;
+			}
+
+			job.due = false;
+
+			if (job.period == 0) { // One-shot
+				job.active = false;
+			}
+
+			job.job(job.arg);
+		}
+	}
+
+	return next(now);
+}
+
+/**
+* @brief Time (millis) to the next deadline
+*/
+uint32_t Scheduler::next(uint32_t now) const {
+
+	uint32_t minimum = nearest();
+
+	if (minimum == SCHEDULER_NO_DEADLINE) {
+		return minimum;
+	}
+
+	// In millis, discounting the time since the current tick
+
+	minimum *= SCHEDULER_TICK_MS;
+
+	uint32_t sinceTick = (now - mLastTime);
+
+	return (minimum > sinceTick) ? (minimum - sinceTick) : 0;
+}
+
+////// Privates
+
+/**
+* @brief Ticks to the nearest deadline (or SCHEDULER_NO_DEADLINE, if no jobs)
+*/
+uint32_t Scheduler::nearest() const {
+
+	uint32_t minimum = SCHEDULER_NO_DEADLINE;
+
+	for (int8_t id = 0; id < SCHEDULER_JOBS_MAX; id++) {
+
+		if (mJobs[id].active) {
+
+			uint32_t remain = ((int32_t)(mJobs[id].deadline - mTick) > 0) ?
+								(mJobs[id].deadline - mTick) : 0;
+
+			if (remain < minimum) {
+				minimum = remain;
+			}
+		}
+	}
+
+	return minimum;
+}
+
+/**
+* @brief Insert the job in slot of your deadline
+*/
+void Scheduler::insert(int8_t id) {
+
+	uint8_t slot = (mJobs[id].deadline % SCHEDULER_SLOTS);
+
+	mJobs[id].next = mSlots[slot];
+	mSlots[slot] = id;
+}
+
+/**
+* @brief Remove the job of your slot (if it is in slot)
+*/
+void Scheduler::remove(int8_t id) {
+
+	int8_t* pos = &mSlots[mJobs[id].deadline % SCHEDULER_SLOTS];
+
+	while (*pos != SCHEDULER_NONE) {
+
+		if (*pos == id) {
+			*pos = mJobs[id].next;
+			return;
+		}
+
+		pos = &mJobs[*pos].next;
+	}
+}
+
+/**
+* @brief Tick of a time (millis) - the current tick plus the ticks elapsed since it
+*/
+uint32_t Scheduler::tickOf(uint32_t now) const {
+
+	return (mTick + ((now - mLastTime) / SCHEDULER_TICK_MS));
+}
+
+/**
+* @brief Convert millis to ticks (rounding up)
+*/
+uint32_t Scheduler::ticks(uint32_t millis) const {
+
+	return ((millis + SCHEDULER_TICK_MS - 1) / SCHEDULER_TICK_MS);
+}
+
+//////// End
@@ -0,0 +1,77 @@
+/*
+ * scheduler.h
+ */
+
+#ifndef UTIL_SCHEDULER_H_
+#define UTIL_SCHEDULER_H_
+
+///// Includes
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+////// Definitions
+
+// Scheduler of jobs (one-shot or periodic) by a timer wheel (hashed by deadline)
+// Is portable (no FreeRTOS here), the time (millis) is passed by caller in run, add and restart,
+// so the task can sleep exactly until the next deadline (returned by run)
+// TODO: see it - change if you need
+
+#define SCHEDULER_JOBS_MAX 8		// Maximum of jobs (fixed array, no heap)
+#define SCHEDULER_SLOTS 32			// Slots of wheel
+#define SCHEDULER_TICK_MS 10		// Resolution of wheel (millis)
+
+#define SCHEDULER_NONE -1						// Invalid job
+#define SCHEDULER_NO_DEADLINE 0xFFFFFFFF		// No jobs scheduled
+
+// Job - routine called when the deadline is reached
+
+typedef void (*SchedulerJob_t)(void* arg);
+
+////// Classes
+
+class Scheduler
+{
+	public:
+
+		Scheduler();
+
+		void begin(uint32_t now);
+
+		int8_t add(uint32_t now, SchedulerJob_t job, uint32_t delay, uint32_t period = 0, void* arg = NULL);
+		bool restart(uint32_t now, int8_t id, uint32_t delay);
+		void cancel(int8_t id);
+		bool active(int8_t id) const;
+
+		uint32_t run(uint32_t now);
+		uint32_t next(uint32_t now) const;
+
+	private:
+
+		typedef struct {
+			SchedulerJob_t job;		// Routine
+			void* arg;				// Argument to routine
+			uint32_t period;		// Period in ticks (0 - one-shot)
+			uint32_t deadline;		// Deadline in ticks
+			int8_t next;			// Next job in same slot
+			bool active;			// Scheduled ?
+			bool due;				// Reached the deadline, waiting to be called (in run)
+		} Job_t;
+
+		Job_t mJobs[SCHEDULER_JOBS_MAX];	// Jobs
+		int8_t mSlots[SCHEDULER_SLOTS];		// Slots of wheel (first job in slot)
+
+		uint32_t mTick;						// Current tick
+		uint32_t mLastTime;					// Time (millis) of current tick
+
+		void insert(int8_t id);
+		void remove(int8_t id);
+		uint32_t nearest() const;
+		uint32_t ticks(uint32_t millis) const;
+		uint32_t tickOf(uint32_t now) const;
+};
+
+#endif /* UTIL_SCHEDULER_H_ */
+
+//////// End
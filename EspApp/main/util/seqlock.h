@@ -0,0 +1,103 @@
+/*****************************************
+ * Project   : util - Utilities to esp-idf
+ * Programmer: Joao Lopes
+ * Module    : seqlock - snapshot of a value, by sequence lock (one writer, many readers)
+ * Comments  : The writer never waits, the readers retry if the value changed while reading
+ *             So the readers (other tasks) not see a value half written, without mutex
+ *             After SEQLOCK_SPINS retries, the reader sleeps a tick between retries, so a writer
+ *             of less priority, preempted in the middle of write (same core), can finish it
+ *             Note: read only by tasks (not in ISR)
+ * Versions:
+ * ------ 	-------- 	-------------------------
+ * 0.3.1  	17/10/26	First version
+ * 0.3.2  	17/10/26	Retries of reader bounded - sleeps a tick after SEQLOCK_SPINS (no spin forever)
+ *****************************************/
+
+#ifndef UTIL_SEQLOCK_H_
+#define UTIL_SEQLOCK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+////// Definitions
+
+// Retries of reader without sleep (the writer in another core finishes in this time)
+
+#define SEQLOCK_SPINS 16
+
+////// Class
+
+template<typename T>
+class SeqSnapshot {
+public:
+
+	// Constructor
+
+	SeqSnapshot() : _sequence(0) {
+	}
+
+	/**
+	 * @brief Write the value (only by one writer)
+	 */
+	void write(const T& value) {
+
+		uint32_t sequence = _sequence;
+
+		__atomic_store_n(&_sequence, sequence + 1, __ATOMIC_RELAXED); // Odd - writing
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+
+		_value = value;
+
+		__atomic_store_n(&_sequence, sequence + 2, __ATOMIC_RELEASE); // Even - done
+	}
+
+	/**
+	 * @brief Read the value (retry while it is written)
+	 */
+	void read(T& value) const {
+
+		uint32_t retries = 0;
+
+		for (;;) {
+
+			uint32_t before = __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE);
+
+			if ((before & 1u) == 0) { // Not writing
+
+				value = _value;
+
+				__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+				if (__atomic_load_n(&_sequence, __ATOMIC_RELAXED) == before) {
+					return;
+				}
+			}
+
+			// Writing - after some retries, sleeps to the writer (can have less priority) finish it
+
+			if (++retries >= SEQLOCK_SPINS) {
+				vTaskDelay(1);
+			}
+		}
+	}
+
+	/**
+	 * @brief Number of writes
+	 */
+	uint32_t writes() const {
+
+		return (__atomic_load_n(&_sequence, __ATOMIC_ACQUIRE) / 2);
+	}
+
+private:
+
+	T _value;				// Value
+	uint32_t _sequence;		// Sequence (odd while writing)
+};
+
+#endif /* UTIL_SEQLOCK_H_ */
+
+//////// End